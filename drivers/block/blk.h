@@ -361,6 +361,7 @@ static void end_request(int uptodate) {
 #endif /* IDE_DRIVER */
 	if (req->sem != NULL)
 		up(req->sem);
+	elevator_done(req);
 	req->dev = -1;
 	wake_up(&wait_for_request);
 }
@@ -1173,6 +1173,9 @@ static int hd_ioctl(struct inode * inode, struct file * file,
 				return err;
 			put_fs_long(read_ahead[MAJOR(inode->i_rdev)],(long *) arg);
 			return 0;
+		case BLKELVGET:
+		case BLKELVSET:
+			return blkelv_ioctl(inode->i_rdev, cmd, arg);
          	case BLKGETSIZE:   /* Return device size */
 			if (!arg)  return -EINVAL;
 			err = verify_area(VERIFY_WRITE, (long *) arg, sizeof(long));
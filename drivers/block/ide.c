@@ -1633,6 +1633,10 @@ static int ide_ioctl (struct inode *inode, struct file *file,
 		case BLKRAGET:
 			return write_fs_long(arg, read_ahead[MAJOR(inode->i_rdev)]);
 
+		case BLKELVGET:
+		case BLKELVSET:
+			return blkelv_ioctl(inode->i_rdev, cmd, arg);
+
          	case BLKGETSIZE:   /* Return device size */
 			return write_fs_long(arg, ide_hd[DEV_HWIF][MINOR(inode->i_rdev)].nr_sects);
 		case BLKRRPART: /* Re-read partition tables */
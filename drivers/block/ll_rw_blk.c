@@ -127,6 +127,7 @@
 
 #include <asm/system.h>
 #include <asm/io.h>
+#include <asm/segment.h>
 #include "blk.h"
 
 /*
@@ -334,6 +335,51 @@ void set_device_ro(int dev,int flag)
 	else ro_bits[major][minor >> 5] &= ~(1 << (minor & 31));
 }
 
+/*
+ * The elevator.
+ *
+ * Each queue is kept in C-SCAN order: one ascending sweep over the disk
+ * starting at the request at the head of the queue, followed by the
+ * requests that lie behind it, which wait for the next sweep. Reads and
+ * writes are sorted together, the head only ever moves one way, and a
+ * stream of requests just ahead of it is served in a single pass.
+ *
+ * Sorting alone can starve a request at the far end of the disk, so
+ * every request also gets a deadline (the queue's read or write latency).
+ * Once a request has waited longer than that, newer requests are no
+ * longer sorted in front of it - they go behind it instead.
+ *
+ * The head of the queue is never displaced: for some drivers it is the
+ * request that is being worked on right now.
+ */
+#define ELV_READ_LATENCY	(HZ/2)
+#define ELV_WRITE_LATENCY	(5*HZ)
+#define ELV_MAX_SECTORS		248
+
+/* the on-disk order of two requests on the same queue */
+#define ELV_BEFORE(s1,s2) \
+((s1)->dev < (s2)->dev || ((s1)->dev == (s2)->dev && \
+(s1)->sector < (s2)->sector))
+
+/* does 's1' come before 's2' in a sweep that starts at 'head'? */
+static inline int elv_in_order(struct request * head,
+	struct request * s1, struct request * s2)
+{
+	int wrap1 = ELV_BEFORE(s1,head);
+	int wrap2 = ELV_BEFORE(s2,head);
+
+	if (wrap1 != wrap2)
+		return wrap2;
+	return ELV_BEFORE(s1,s2);
+}
+
+static inline int elv_expired(struct elevator * elv, struct request * req)
+{
+	long latency = (req->cmd == READ) ? elv->read_latency : elv->write_latency;
+
+	return (long) (jiffies - req->start_time) > latency;
+}
+
 /*
  * add-request adds a request to the linked list.
  * It disables interrupts so that it can muck with the
@@ -341,7 +387,9 @@ void set_device_ro(int dev,int flag)
  */
 static void add_request(struct blk_dev_struct * dev, struct request * req)
 {
-	struct request * tmp;
+	struct request * tmp, * start;
+	struct elevator * elv = &dev->elevator;
+	unsigned long depth;
 	short disk_index;
 
 	switch (MAJOR(req->dev)) {
@@ -363,34 +411,44 @@ static void add_request(struct blk_dev_struct * dev, struct request * req)
 
 	req->next = NULL;
 	cli();
+	req->start_time = jiffies;
+	elv->nr_requests++;
 	//将缓冲区bh转移到干净页面的LRU队列中
 	if (req->bh)
 		mark_buffer_clean(req->bh);
 	//如果此设备的请求队列为空，当此请求加入此设备的读写请求队列，
 	//调用当前块设备的请求项操作函数进行读写操作
 	if (!(tmp = dev->current_request)) {
+		elv->depth_sum++;
+		if (!elv->max_depth)
+			elv->max_depth = 1;
 		dev->current_request = req;
 		(dev->request_fn)();
 		sti();
 		return;
 	}
-	//执行到这里，说明此设备的请求队列不为空，则利用电梯调度算法将此请求项插入队列
-/*
-	IN_ORDER(tmp，req)的作用类似于在比较tmp和req这两个请求。
-	如果tmp请求“小于”req请求，则IN_ORDER为真。
-	“小于”的意思：
-	（1）读请求小于写请求。
-	（2）若请求类型相同，低设备号小于高设备号。
-	（3）若请求同一设备，低扇区号小于高扇区号。
-*/
+	/*
+	 * Nothing may be sorted in front of a request whose deadline has
+	 * passed, so the search starts after the last such request.
+	 */
+	depth = 2;
+	start = tmp;
 	for ( ; tmp->next ; tmp = tmp->next) {
-		if ((IN_ORDER(tmp,req) ||
-		    !IN_ORDER(tmp,tmp->next)) &&
-		    IN_ORDER(req,tmp->next))
-			break;
+		depth++;
+		if (elv_expired(elv, tmp->next))
+			start = tmp->next;
 	}
+	elv->depth_sum += depth;
+	if (depth > elv->max_depth)
+		elv->max_depth = depth;
+	if (start != dev->current_request)
+		elv->expired++;
 	//将请求链入 注意：这里并不改变第一个请求项的位置，也绝不能替换第一个请求项的位置，
 	//原因请参见/linux/drivers/block/hd.c中hd_request()函数上面的注释
+	for (tmp = start ; tmp->next ; tmp = tmp->next) {
+		if (elv_in_order(dev->current_request, req, tmp->next))
+			break;
+	}
 	req->next = tmp->next;
 	tmp->next = req;
 
@@ -402,11 +460,42 @@ static void add_request(struct blk_dev_struct * dev, struct request * req)
 	sti();
 }
 
+/*
+ * Try to merge the request following 'req' into it, now that 'req' has
+ * grown up to it. The request that goes away can't be active: only the
+ * head of the queue can be, and it never follows anything.
+ * Interrupts must be disabled.
+ */
+static void attempt_merge(struct elevator * elv, struct request * req)
+{
+	struct request * next = req->next;
+
+	if (!next || !next->bh || next->sem || req->sem)
+		return;
+	if (next->dev != req->dev || next->cmd != req->cmd)
+		return;
+	if (req->sector + req->nr_sectors != next->sector)
+		return;
+	if (req->nr_sectors + next->nr_sectors > elv->max_sectors)
+		return;
+	req->bhtail->b_reqnext = next->bh;
+	req->bhtail = next->bhtail;
+	req->nr_sectors += next->nr_sectors;
+	/* the merged request inherits the older deadline */
+	if ((long) (next->start_time - req->start_time) < 0)
+		req->start_time = next->start_time;
+	req->next = next->next;
+	next->dev = -1;
+	elv->coalesced++;
+	wake_up(&wait_for_request);
+}
+
 //将指定的缓冲区bh合并到已存在的请求项中或者单独形成一个请求项
 static void make_request(int major,int rw, struct buffer_head * bh)
 {
 	unsigned int sector, count;
-	struct request * req;
+	struct request * req, * prev;
+	struct elevator * elv = &blk_dev[major].elevator;
 	int rw_ahead, max_req;
 
 /* WRITEA/READA is special case - it is not really needed, so if the */
@@ -473,61 +562,49 @@ repeat:
 #else
 		if (major == FLOPPY_MAJOR)
 #endif CONFIG_BLK_DEV_HD
-			req = req->next;	//为什么要跳过第一个请求项？？？
-					//这是因为当请求队列为空时，要插入多个请求，为了防止立即执行请求，向当前请求队列插入了一个无效的请求
-
-/*	
-		博大精深的内核！！！上面关于要跳过（实际是为了避免替换掉当前请求项）第一个请求项的解释是不对的，
-		原因请参见/linux/drivers/block/hd.c中hd_request()函数上面的注释
-*/
-
-		//这里是为了合并请求队列中读写命令一致的、并且读写扇区相邻的读写请求
-		//如果找到了可以和当前bh合并的请求项，那么就可以不需要申请新的请求项
-		//资源了，提高了系统的效率和节省了系统资源
-		//我觉得循环中的两个if判断语句还可以做的更精湛，使其最多可以将之前两个不连续的请求项合二为一
-		//也可以说是合三为一，其中本bh省下来的请求项也做为其一，然后还可以释放合并省下来的一向请求项资源
-		/*这在《Linux Deviece Driver》中被称为“集簇”技术*/
+			req = req->next;	//跳过正在处理的第一个请求项，
+					//原因请参见/linux/drivers/block/hd.c中hd_request()函数上面的注释
+
+		/*
+		 * Merge the buffer onto either end of a queued request.
+		 * A request that has grown up to its neighbour swallows it
+		 * as well, which gives the neighbour's slot back.
+		 */
+		prev = NULL;
 		while (req) {
 			if (req->dev == bh->b_dev &&
 			    !req->sem &&
 			    req->cmd == rw &&
-			    req->sector + req->nr_sectors == sector &&
-			    req->nr_sectors < 244)
+			    req->nr_sectors + count <= elv->max_sectors)
 			{
-				//将此bh链入此请求项的bh链表中
-				req->bhtail->b_reqnext = bh;
-				req->bhtail = bh;
-				//增加此请求项要读取的扇区数
-				req->nr_sectors += count;
-				//将此bh移到干净队列中
-				mark_buffer_clean(bh);
-				sti();
-				return;
-				//我的想法是在这里不要return，而是将此请求项和下一个请求项“合并”
+				if (req->sector + req->nr_sectors == sector) {
+					//将此bh链入此请求项的bh链表中
+					req->bhtail->b_reqnext = bh;
+					req->bhtail = bh;
+					req->nr_sectors += count;
+					mark_buffer_clean(bh);
+					elv->back_merges++;
+					attempt_merge(elv, req);
+					sti();
+					return;
+				}
+				if (req->sector - count == sector) {
+					req->nr_sectors += count;
+					bh->b_reqnext = req->bh;
+					req->buffer = bh->b_data;
+					//此bh成为请求项的“当前缓冲区”
+					req->current_nr_sectors = count;
+					req->sector = sector;
+					mark_buffer_clean(bh);
+					req->bh = bh;
+					elv->front_merges++;
+					if (prev)
+						attempt_merge(elv, prev);
+					sti();
+					return;
+				}
 			}
-
-			if (req->dev == bh->b_dev &&
-			    !req->sem &&
-			    req->cmd == rw &&
-			    req->sector - count == sector &&
-			    req->nr_sectors < 244)
-			{
-			    	req->nr_sectors += count;
-			    	bh->b_reqnext = req->bh;
-			    	req->buffer = bh->b_data;
-				//因为在这里是将此bh加入到此请求项的bh缓冲区头部
-				//所以此bh成为了当此请求项得到执行的时候首先要执行
-				//的“当前缓冲区”，所以需要更新此请求项的current_nr_sectors
-				//其代表着当前缓冲区所对应的扇区数
-			    	req->current_nr_sectors = count;
-			    	req->sector = sector;
-				mark_buffer_clean(bh);
-			    	req->bh = bh;
-			    	sti();
-			    	return;
-				//我的想法是在这里不要return，而是将此请求项和下一个请求项“合并”
-			}    
-
+			prev = req;
 			req = req->next;
 		}
 	}
@@ -756,15 +833,94 @@ void ll_rw_swap_file(int rw, int dev, unsigned int *b, int nb, char *buf)
 	}
 }
 
+/*
+ * Get or set the elevator tunables of the queue 'dev' is on. Called
+ * from the block drivers' ioctl routines.
+ */
+int blkelv_ioctl(int dev, unsigned int cmd, unsigned long arg)
+{
+	struct blkelv_ioctl_arg tmp;
+	struct elevator * elv;
+	unsigned int major = MAJOR(dev);
+	int error;
+
+	if (major >= MAX_BLKDEV || !arg)
+		return -EINVAL;
+	elv = &blk_dev[major].elevator;
+	switch (cmd) {
+		case BLKELVGET:
+			error = verify_area(VERIFY_WRITE, (void *) arg, sizeof(tmp));
+			if (error)
+				return error;
+			tmp.read_latency = elv->read_latency;
+			tmp.write_latency = elv->write_latency;
+			tmp.max_sectors = elv->max_sectors;
+			memcpy_tofs((void *) arg, &tmp, sizeof(tmp));
+			return 0;
+		case BLKELVSET:
+			if (!suser())
+				return -EACCES;
+			error = verify_area(VERIFY_READ, (void *) arg, sizeof(tmp));
+			if (error)
+				return error;
+			memcpy_fromfs(&tmp, (void *) arg, sizeof(tmp));
+			if (tmp.read_latency < 0 || tmp.write_latency < 0)
+				return -EINVAL;
+			if (tmp.max_sectors < 8 || tmp.max_sectors > 255)
+				return -EINVAL;
+			cli();
+			elv->read_latency = tmp.read_latency;
+			elv->write_latency = tmp.write_latency;
+			elv->max_sectors = tmp.max_sectors;
+			sti();
+			return 0;
+	}
+	return -EINVAL;
+}
+
+int get_elevator_info(char * buffer)
+{
+	int major, len;
+	struct elevator * elv;
+
+	len = sprintf(buffer,
+		"major requests  back front coalesced expired depth/avg/max"
+		"     done wait/avg/max  latency r/w  max_sectors\n");
+	for (major = 0 ; major < MAX_BLKDEV ; major++) {
+		if (!blk_dev[major].request_fn)
+			continue;
+		elv = &blk_dev[major].elevator;
+		len += sprintf(buffer+len,
+			"%5d %8lu %5lu %5lu %9lu %7lu %5lu/%lu %8lu %4lu/%lu %7d/%d %5d\n",
+			major, elv->nr_requests, elv->back_merges,
+			elv->front_merges, elv->coalesced, elv->expired,
+			elv->nr_requests ? elv->depth_sum / elv->nr_requests : 0,
+			elv->max_depth, elv->nr_done,
+			elv->nr_done ? elv->wait_sum / elv->nr_done : 0,
+			elv->max_wait, elv->read_latency, elv->write_latency,
+			elv->max_sectors);
+	}
+	return len;
+}
+
 long blk_dev_init(long mem_start, long mem_end)
 {
 	struct request * req;
+	int i;
 
 	req = all_requests + NR_REQUEST;
 	while (--req >= all_requests) {
 		req->dev = -1;
 		req->next = NULL;
 	}
+	for (i = 0 ; i < MAX_BLKDEV ; i++) {
+		struct elevator * elv = &blk_dev[i].elevator;
+
+		memset(elv, 0, sizeof(*elv));
+		elv->read_latency = ELV_READ_LATENCY;
+		elv->write_latency = ELV_WRITE_LATENCY;
+		elv->max_sectors = ELV_MAX_SECTORS;
+	}
 	memset(ro_bits,0,sizeof(ro_bits));
 #ifdef CONFIG_BLK_DEV_HD
 	mem_start = hd_init(mem_start,mem_end);
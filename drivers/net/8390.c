@@ -86,9 +86,13 @@ int ei_debug = 1;
    Current this may only be examined by a kernel debugger. */
 static int high_water_mark = 0;
 
+/* Frames ei_poll() takes at one go. */
+#define EI_POLL_WEIGHT 16
+
 /* Index to functions. */
 static void ei_tx_intr(struct device *dev);
-static void ei_receive(struct device *dev);
+static int ei_receive(struct device *dev, int budget, struct sk_buff_head *rxq);
+static int ei_poll(struct device *dev, int budget);
 static void ei_rx_overrun(struct device *dev);
 
 /* Routines generic to NS8390-based boards. */
@@ -204,7 +208,7 @@ static int ei_start_xmit(struct sk_buff *skb, struct device *dev)
 					   dev->name);
 			ei_local->irqlock = 0;
 			dev->tbusy = 1;
-			outb_p(ENISR_ALL,  e8390_base + EN0_IMR);
+			outb_p(ei_imr(ei_local),  e8390_base + EN0_IMR);
 			return 1;
 		}
 		ei_block_output(dev, length, skb->data, output_page);
@@ -229,7 +233,7 @@ static int ei_start_xmit(struct sk_buff *skb, struct device *dev)
     
     /* Turn 8390 interrupts back on. */
     ei_local->irqlock = 0;
-    outb_p(ENISR_ALL, e8390_base + EN0_IMR);
+    outb_p(ei_imr(ei_local), e8390_base + EN0_IMR);
 
     dev_kfree_skb (skb, FREE_WRITE);
     
@@ -271,8 +275,10 @@ void ei_interrupt(int irq, struct pt_regs * regs)
 		printk("%s: interrupt(isr=%#2.2x).\n", dev->name,
 			   inb_p(e8390_base + EN0_ISR));
     
-    /* !!Assumption!! -- we stay in page 0.	 Don't break this. */
-    while ((interrupts = inb_p(e8390_base + EN0_ISR)) != 0
+    /* !!Assumption!! -- we stay in page 0.	 Don't break this.
+       While we are being polled the Rx bits are ei_poll()'s business. */
+    while ((interrupts = inb_p(e8390_base + EN0_ISR)
+			& ~(ei_local->rxpoll ? ENISR_RXALL : 0)) != 0
 		   && ++boguscount < 9) {
 		if (dev->start == 0) {
 			printk("%s: interrupt from stopped card\n", dev->name);
@@ -285,9 +291,13 @@ void ei_interrupt(int irq, struct pt_regs * regs)
 		}
 		if (interrupts & ENISR_OVER) {
 			ei_rx_overrun(dev);
-		} else if (interrupts & (ENISR_RX+ENISR_RX_ERR)) {
-			/* Got a good (?) packet. */
-			ei_receive(dev);
+		} else if (interrupts & ENISR_RXALL) {
+			/* Got a good (?) packet: mask the receiver off and let
+			   net_bh fetch it, and any that follow, by polling. */
+			ei_local->rxpoll = 1;
+			outb_p(ei_imr(ei_local), e8390_base + EN0_IMR);
+			outb_p(ENISR_RXALL, e8390_base + EN0_ISR);
+			netif_rx_schedule(dev);
 		}
 		/* Push the next to-transmit packet through. */
 		if (interrupts & ENISR_TX) {
@@ -383,9 +393,10 @@ static void ei_tx_intr(struct device *dev)
     mark_bh (NET_BH);
 }
 
-/* We have a good packet(s), get it/them out of the buffers. */
+/* We have a good packet(s), get up to BUDGET of them out of the buffers.
+   They go on RXQ if there is one, to netif_rx() if not. */
 
-static void ei_receive(struct device *dev)
+static int ei_receive(struct device *dev, int budget, struct sk_buff_head *rxq)
 {
     int e8390_base = dev->base_addr;
     struct ei_device *ei_local = (struct ei_device *) dev->priv;
@@ -394,7 +405,7 @@ static void ei_receive(struct device *dev)
     struct e8390_pkt_hdr rx_frame;
     int num_rx_pages = ei_local->stop_page-ei_local->rx_start_page;
     
-    while (++rx_pkt_count < 10) {
+    while (rx_pkt_count < budget) {
 		int pkt_len;
 		
 		/* Get the rx page (incoming packet pointer). */
@@ -415,6 +426,7 @@ static void ei_receive(struct device *dev)
 		
 		if (this_frame == rxing_page)	/* Read all the frames? */
 			break;				/* Done for now */
+		rx_pkt_count++;
 		
 		current_offset = this_frame << 8;
 		ei_block_input(dev, sizeof(rx_frame), (char *)&rx_frame,
@@ -459,7 +471,10 @@ static void ei_receive(struct device *dev)
 				
 				ei_block_input(dev, pkt_len, (char *) skb->data,
 							   current_offset + sizeof(rx_frame));
-				netif_rx(skb);
+				if (rxq)
+					skb_queue_tail(rxq, skb);
+				else
+					netif_rx(skb);
 				ei_local->stat.rx_packets++;
 			}
 		} else {
@@ -490,9 +505,50 @@ static void ei_receive(struct device *dev)
 	if (rx_pkt_count > high_water_mark)
 		high_water_mark = rx_pkt_count;
 
-    /* Bug alert!  Reset ENISR_OVER to avoid spurious overruns! */
-    outb_p(ENISR_RX+ENISR_RX_ERR+ENISR_OVER, e8390_base+EN0_ISR);
-    return;
+    /* Bug alert!  Reset ENISR_OVER to avoid spurious overruns!
+       (ei_poll() acks the Rx bits itself, before it looks.) */
+    outb_p((rxq ? 0 : ENISR_RXALL) + ENISR_OVER, e8390_base+EN0_ISR);
+    return rx_pkt_count;
+}
+
+/* Polled receive, called from net_bh after ei_interrupt() masked the Rx
+   interrupts. We take the card the way ei_start_xmit() does, so the
+   interrupt handler keeps off it, and hand the frames up once we have
+   let go. When the ring is empty we turn the Rx interrupts back on. */
+static int ei_poll(struct device *dev, int budget)
+{
+    int e8390_base = dev->base_addr;
+    struct ei_device *ei_local = (struct ei_device *) dev->priv;
+    struct sk_buff_head rxq;
+    struct sk_buff *skb;
+    unsigned long flags;
+    int work;
+
+    save_flags(flags);
+    cli();
+    if (ei_local->irqlock || dev->start == 0) {
+		/* ei_start_xmit() was interrupted with the card: try later. */
+		restore_flags(flags);
+		return 0;
+    }
+    outb_p(0x00, e8390_base + EN0_IMR);
+    ei_local->irqlock = 1;
+    restore_flags(flags);
+
+    skb_queue_head_init(&rxq);
+    /* Ack first: a frame that comes in after we last look raises it again. */
+    outb_p(ENISR_RXALL, e8390_base + EN0_ISR);
+    work = ei_receive(dev, budget, &rxq);
+    if (work < budget) {
+		netif_rx_complete(dev);
+		ei_local->rxpoll = 0;
+    }
+    ei_local->irqlock = 0;
+    outb_p(ei_imr(ei_local), e8390_base + EN0_IMR);
+
+    while ((skb = skb_dequeue(&rxq)) != NULL)
+		netif_receive_skb(skb);
+    return work;
 }
 
 /* We have a receiver overrun: we have to kick the 8390 to get it started
@@ -526,7 +582,7 @@ static void ei_rx_overrun(struct device *dev)
 		}
     
     /* Remove packets right away. */
-    ei_receive(dev);
+    ei_receive(dev, ei_local->stop_page - ei_local->rx_start_page, NULL);
     
     outb_p(0xff, e8390_base+EN0_ISR);
     /* Generic 8390 insns to start up again, same as in open_8390(). */
@@ -592,6 +648,8 @@ int ethdev_init(struct device *dev)
     /* We should have a dev->stop entry also. */
     dev->hard_start_xmit = &ei_start_xmit;
     dev->get_stats	= get_stats;
+    dev->poll		= ei_poll;
+    dev->weight		= EI_POLL_WEIGHT;
 #ifdef HAVE_MULTICAST
     dev->set_multicast_list = &set_multicast_list;
 #endif
@@ -650,6 +708,7 @@ void NS8390_init(struct device *dev, int startp)
     dev->interrupt = 0;
     ei_local->tx1 = ei_local->tx2 = 0;
     ei_local->txing = 0;
+    ei_local->rxpoll = 0;
     if (startp) {
 		outb_p(0xff,  e8390_base + EN0_ISR);
 		outb_p(ENISR_ALL,  e8390_base + EN0_IMR);
@@ -47,6 +47,7 @@ struct ei_device {
   unsigned dmaing:2;		/* Remote DMA Active */
   unsigned irqlock:1;		/* 8390's intrs disabled when '1'. */
   unsigned pingpong:1;		/* Using the ping-pong driver */
+  unsigned rxpoll:1;		/* Rx intrs masked, net_bh polls us */
   unsigned char tx_start_page, rx_start_page, stop_page;
   unsigned char current_page;	/* Read pointer in buffer  */
   unsigned char interface_num;	/* Net port (AUI, 10bT.) to use. */
@@ -121,6 +122,10 @@ struct ei_device {
 #define ENISR_RDC	0x40	/* remote dma complete */
 #define ENISR_RESET	0x80	/* Reset completed */
 #define ENISR_ALL	0x3f	/* Interrupts we will enable */
+#define ENISR_RXALL	(ENISR_RX+ENISR_RX_ERR)
+
+/* The interrupt mask for now: the receiver's are off while we are polled. */
+#define ei_imr(ei)	((ei)->rxpoll ? ENISR_ALL & ~ENISR_RXALL : ENISR_ALL)
 
 /* Bits in EN0_DCFG - Data config register */
 #define ENDCFG_WTS	0x01	/* word transfer mode selection */
@@ -1702,7 +1702,7 @@ ppp_xmit(struct sk_buff *skb, struct device *dev)
   /* Get pointers to the various components */
   ppp   = &ppp_ctrl[dev->base_addr];
   tty   = ppp->tty;
-  p     = (unsigned char *) (skb + 1);
+  p     = skb->data;
   len   = skb->len;
   proto = PROTO_IP;
 
@@ -1769,7 +1769,7 @@ ppp_xmit(struct sk_buff *skb, struct device *dev)
     ++ppp->stats.suncomp;
       
   if (ppp_debug_netpackets) {
-    struct iphdr *iph = (struct iphdr *) (skb + 1);
+    struct iphdr *iph = (struct iphdr *) skb->data;
     PRINTK ((KERN_DEBUG "%s ==> proto %x len %d src %x dst %x proto %d\n",
 	    dev->name, (int) proto, (int) len, (int) iph->saddr,
 	    (int) iph->daddr, (int) iph->protocol))
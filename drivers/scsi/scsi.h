@@ -549,8 +549,8 @@ static Scsi_Cmnd * end_scsi_request(Scsi_Cmnd * SCpnt, int uptodate, int sectors
 	    req->sector += bh->b_size >> 9;
 	    bh->b_reqnext = NULL;
 	    bh->b_uptodate = uptodate;
-	    unlock_buffer(bh);
 	    sectors -= bh->b_size >> 9;
+	    unlock_buffer(bh);	/* may free a page cache buffer head */
 	    if ((bh = req->bh) != NULL) {
 	      req->current_nr_sectors = bh->b_size >> 9;
 	      if (req->nr_sectors < req->current_nr_sectors) {
@@ -577,6 +577,7 @@ static Scsi_Cmnd * end_scsi_request(Scsi_Cmnd * SCpnt, int uptodate, int sectors
               wake_up(&next->host_wait);
            }
 
+	elevator_done(req);
 	req->dev = -1;
 	wake_up(&wait_for_request);
 	wake_up(&SCpnt->device->device_wait);
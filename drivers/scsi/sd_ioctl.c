@@ -60,6 +60,9 @@ int sd_ioctl(struct inode * inode, struct file * file, unsigned int cmd, unsigne
 			if(arg > 0xff) return -EINVAL;
 			read_ahead[MAJOR(inode->i_rdev)] = arg;
 			return 0;
+		case BLKELVGET:
+		case BLKELVSET:
+			return blkelv_ioctl(inode->i_rdev, cmd, arg);
 		case BLKFLSBUF:
 			if(!suser())  return -EACCES;
 			if(!inode->i_rdev) return -EINVAL;
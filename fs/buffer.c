@@ -31,6 +31,7 @@
 #include <linux/locks.h>
 #include <linux/errno.h>
 #include <linux/malloc.h>
+#include <linux/pagemap.h>
 
 #include <asm/system.h>
 #include <asm/segment.h>
@@ -73,7 +74,10 @@ static int maybe_shrink_lav_buffers(int);
 */
 
 static int nr_hash = 0;  /* Size of hash table */
+static int hash_shift = 32;	/* 32 - log2(nr_hash) */
 static struct buffer_head ** hash_table;
+static int hash_resizing = 0;
+static unsigned long hash_lookups = 0, hash_probes = 0;
 struct buffer_head ** buffer_pages; //类似于mem_map swap_cache的数组
 
 /*
@@ -393,7 +397,19 @@ void invalidate_buffers(dev_t dev)
 	}
 }
 
-#define _hashfn(dev,block) (((unsigned)(dev^block))%nr_hash)
+/*
+ * The hash table is a power of two in size and is indexed by the top
+ * bits of a multiplicative hash. Unlike (dev^block)%prime this spreads
+ * runs of sequential blocks and the same block on different devices
+ * evenly over the whole table.
+ */
+#define HASH_MULT	0x9e370001U	/* prime close to 2^32/phi */
+#define MIN_HASH_BITS	8
+#define MAX_HASH_BITS	18
+
+#define _hashfn(dev,block) \
+	(((((unsigned int) (dev) << 16) ^ (unsigned int) (block)) * HASH_MULT) \
+	 >> hash_shift)
 #define hash(dev,block) hash_table[_hashfn(dev,block)]
 
 static inline void remove_from_hash_queue(struct buffer_head * bh)
@@ -550,7 +566,8 @@ static struct buffer_head * find_buffer(dev_t dev, int block, int size)
 {		
 	struct buffer_head * tmp;
 
-	for (tmp = hash(dev,block) ; tmp != NULL ; tmp = tmp->b_next)
+	hash_lookups++;
+	for (tmp = hash(dev,block) ; tmp != NULL ; tmp = tmp->b_next, hash_probes++)
 		if (tmp->b_dev==dev && tmp->b_blocknr==block)
 			if (tmp->b_size == size)
 				return tmp;
@@ -1067,22 +1084,31 @@ struct buffer_head * breada(dev_t dev, int block, int bufsize,
 
 /*
  * See fs/inode.c for the weird use of volatile..
+ *
+ * Page cache reads give their buffer heads back from the interrupt that
+ * finishes the I/O, so the unused list is only touched with interrupts
+ * off.
  */
 static void put_unused_buffer_head(struct buffer_head * bh)
 {
 	struct wait_queue * wait;
+	unsigned long flags;
 
 	wait = ((volatile struct buffer_head *) bh)->b_wait;
 	memset(bh,0,sizeof(*bh));
 	((volatile struct buffer_head *) bh)->b_wait = wait;
+	save_flags(flags);
+	cli();
 	bh->b_next_free = unused_list;
 	unused_list = bh;
+	restore_flags(flags);
 }
 
 static void get_more_buffer_heads(void)
 {
 	int i;
 	struct buffer_head * bh;
+	unsigned long flags;
 
 	if (unused_list)
 		return;
@@ -1090,10 +1116,13 @@ static void get_more_buffer_heads(void)
 	if (!(bh = (struct buffer_head*) get_free_page(GFP_BUFFER)))
 		return;
 
+	save_flags(flags);
+	cli();
 	for (nr_buffer_heads+=i=PAGE_SIZE/sizeof*bh ; i>0; i--) {
 		bh->b_next_free = unused_list;	/* only make link */
 		unused_list = bh++;
 	}
+	restore_flags(flags);
 }
 
 //从unused_list链表中或bh_cachep SLAB中得到一个bh对象，如果失败，则跳转到no_grow部分。
@@ -1101,12 +1130,18 @@ static void get_more_buffer_heads(void)
 static struct buffer_head * get_unused_buffer_head(void)
 {
 	struct buffer_head * bh;
+	unsigned long flags;
 
 	get_more_buffer_heads();
-	if (!unused_list)
+	save_flags(flags);
+	cli();
+	if (!unused_list) {
+		restore_flags(flags);
 		return NULL;
+	}
 	bh = unused_list;
 	unused_list = bh->b_next_free;
+	restore_flags(flags);
 	bh->b_next_free = NULL;
 	bh->b_data = NULL;
 	bh->b_size = 0;
@@ -1363,6 +1398,168 @@ unsigned long bread_page(unsigned long address, dev_t dev, int b[], int size, in
 	return address;
 }
 
+/*
+ * Read a page of the page cache. The blocks go straight into the page
+ * through temporary buffer heads that never enter the buffer cache,
+ * except that a block which is already in the buffer cache is copied
+ * from there, as it may be newer than what is on disk.
+ *
+ * This only starts the I/O: the page must be locked on entry, and it is
+ * unlocked (and marked up-to-date if everything went well) when the last
+ * block has arrived. The I/O holds a reference to the page until then.
+ */
+int read_page_async(struct page_info * page, dev_t dev, int b[], int size)
+{
+	struct buffer_head * bh, * head, * tail, * tmp;
+	struct buffer_head * arr[MAX_BUF_PER_PAGE];
+	unsigned long address = page_address(page);
+	unsigned long flags;
+	int i, nr;
+
+	mem_map[MAP_NR(address)]++;
+	set_bit(PG_submit, &page->flags);
+	head = create_buffers(address, size);
+	if (!head) {
+		clear_bit(PG_submit, &page->flags);
+		set_bit(PG_error, &page->flags);
+		clear_bit(PG_locked, &page->flags);
+		wake_up(&page->wait);
+		free_page(address);
+		return -ENOMEM;
+	}
+	nr = 0;
+	tail = head;
+	for (i = 0, bh = head ; bh ; i++, bh = bh->b_this_page) {
+		tail = bh;
+		bh->b_count = 1;
+		bh->b_dev = dev;
+		bh->b_blocknr = b[i];
+		bh->b_list = BUF_CLEAN;
+		bh->b_async = 1;
+		if (!b[i]) {
+			memset(bh->b_data, 0, size);
+			bh->b_uptodate = 1;
+			continue;
+		}
+		tmp = get_hash_table(dev, b[i], size);
+		if (tmp) {
+			wait_on_buffer(tmp);
+			if (tmp->b_uptodate) {
+				memcpy(bh->b_data, tmp->b_data, size);
+				bh->b_uptodate = 1;
+				brelse(tmp);
+				continue;
+			}
+			brelse(tmp);
+		}
+		arr[nr++] = bh;
+	}
+	tail->b_this_page = head;
+	if (nr)
+		ll_rw_block(READ, nr, arr);
+	/*
+	 * Blocks may have come in while the rest were still being queued,
+	 * and ll_rw_block() can refuse a buffer without ever locking it.
+	 * So completions are ignored until everything has been handed
+	 * over, and then whoever sees the last buffer unlocked ends the read.
+	 */
+	save_flags(flags);
+	cli();
+	clear_bit(PG_submit, &page->flags);
+	async_read_done(head);
+	restore_flags(flags);
+	return 0;
+}
+
+/*
+ * Called by unlock_buffer() for the buffer heads of read_page_async(),
+ * usually from the disk interrupt.
+ */
+void async_read_done(struct buffer_head * bh)
+{
+	struct page_info * page;
+	struct buffer_head * tmp, * next;
+	unsigned long flags;
+	int uptodate;
+
+	page = page_info_map + MAP_NR(bh->b_data);
+	save_flags(flags);
+	cli();
+	if (test_bit(PG_submit, &page->flags))
+		goto out;
+	tmp = bh;
+	do {
+		if (tmp->b_lock)
+			goto out;
+		tmp = tmp->b_this_page;
+	} while (tmp != bh);
+	uptodate = 1;
+	tmp = bh;
+	do {
+		if (!tmp->b_uptodate)
+			uptodate = 0;
+		next = tmp->b_this_page;
+		put_unused_buffer_head(tmp);
+		tmp = next;
+	} while (tmp != bh);
+	if (uptodate)
+		set_bit(PG_uptodate, &page->flags);
+	else
+		set_bit(PG_error, &page->flags);
+	clear_bit(PG_locked, &page->flags);
+	wake_up(&page->wait);
+	free_page(page_address(page));
+out:
+	restore_flags(flags);
+}
+
+/*
+ * Double the hash table. The new table is allocated first, which may
+ * sleep, and the buffers are then rehashed with interrupts off so that
+ * nobody sees a half-moved table. Only one resize runs at a time.
+ */
+static void grow_hash_table(void)
+{
+	struct buffer_head ** new_table, ** old_table;
+	struct buffer_head * bh, * next;
+	int i, old_nr, new_nr, new_shift;
+	unsigned long flags;
+
+	if (hash_resizing || hash_shift <= 32 - MAX_HASH_BITS)
+		return;
+	hash_resizing = 1;
+	new_shift = hash_shift - 1;
+	new_nr = nr_hash << 1;
+	new_table = (struct buffer_head **) vmalloc(new_nr * sizeof(struct buffer_head *));
+	if (!new_table) {
+		hash_resizing = 0;
+		return;
+	}
+	for (i = 0 ; i < new_nr ; i++)
+		new_table[i] = NULL;
+
+	save_flags(flags);
+	cli();
+	old_table = hash_table;
+	old_nr = nr_hash;
+	hash_table = new_table;
+	nr_hash = new_nr;
+	hash_shift = new_shift;
+	for (i = 0 ; i < old_nr ; i++) {
+		for (bh = old_table[i] ; bh ; bh = next) {
+			next = bh->b_next;
+			bh->b_prev = NULL;
+			bh->b_next = hash(bh->b_dev,bh->b_blocknr);
+			hash(bh->b_dev,bh->b_blocknr) = bh;
+			if (bh->b_next)
+				bh->b_next->b_prev = bh;
+		}
+	}
+	restore_flags(flags);
+	vfree(old_table);
+	hash_resizing = 0;
+}
+
 /*
  * Try to increase the number of buffers available: the size argument
  * is used to determine what kind of buffers we want.
@@ -1415,6 +1612,9 @@ static int grow_buffers(int pri, int size)
 	tmp->b_this_page = bh;
 	wake_up(&buffer_wait);
 	buffermem += PAGE_SIZE;
+	/* keep the average chain length at or below one */
+	if (nr_buffers > nr_hash && pri != GFP_ATOMIC)
+		grow_hash_table();
 	return 1;
 }
 
@@ -1619,6 +1819,8 @@ void show_buffers(void)
 	printk("Buffer memory:   %6dkB\n",buffermem>>10);
 	printk("Buffer heads:    %6d\n",nr_buffer_heads);
 	printk("Buffer blocks:   %6d\n",nr_buffers);
+	printk("Buffer hash:     %6d entries, %lu lookups, %lu probes\n",
+		nr_hash, hash_lookups, hash_probes);
 
 	for(nlist = 0; nlist < NR_LIST; nlist++) {
 	  shared = found = locked = dirty = used = lastused = 0;
@@ -1863,16 +2065,10 @@ void buffer_init(void)
 {
 	int i;
         int isize = BUFSIZE_INDEX(BLOCK_SIZE);
-	//根据实际物理内存大小确定缓冲哈希表数组大小
-	if (high_memory >= 4*1024*1024) {
-		if(high_memory >= 16*1024*1024)
-			 nr_hash = 16381;
-		else
-			 nr_hash = 4093;
-	} else {
-		nr_hash = 997;
-	};
-	
+	/* the table starts small: grow_buffers() grows it with the buffers */
+	nr_hash = 1 << MIN_HASH_BITS;
+	hash_shift = 32 - MIN_HASH_BITS;
+
 	//用vmalloc函数为内核分配大量虚拟地址连续的内存
 	hash_table = (struct buffer_head **) vmalloc(nr_hash * 
 						     sizeof(struct buffer_head *));
@@ -1893,6 +2089,45 @@ void buffer_init(void)
 	return;
 }
 
+/*
+ * /proc/bufhash: how long the hash chains are. "depth" is the average
+ * number of buffers looked at per find_buffer(), times 100.
+ */
+#define HASH_HIST 8
+
+int get_buffer_hash_info(char * buffer)
+{
+	unsigned long hist[HASH_HIST+1];
+	struct buffer_head * bh;
+	unsigned long flags;
+	int i, len, n, used = 0, longest = 0;
+
+	for (i = 0 ; i <= HASH_HIST ; i++)
+		hist[i] = 0;
+	save_flags(flags);
+	cli();
+	for (i = 0 ; i < nr_hash ; i++) {
+		n = 0;
+		for (bh = hash_table[i] ; bh ; bh = bh->b_next)
+			n++;
+		if (n)
+			used++;
+		if (n > longest)
+			longest = n;
+		hist[n < HASH_HIST ? n : HASH_HIST]++;
+	}
+	restore_flags(flags);
+
+	len = sprintf(buffer, "size:    %d\nbuffers: %d\nused:    %d\nlongest: %d\n",
+		nr_hash, nr_buffers, used, longest);
+	len += sprintf(buffer+len, "lookups: %lu\ndepth:   %lu\nchains: ",
+		hash_lookups, hash_lookups ? hash_probes * 100 / hash_lookups : 0);
+	for (i = 0 ; i < HASH_HIST ; i++)
+		len += sprintf(buffer+len, " %d:%lu", i, hist[i]);
+	len += sprintf(buffer+len, " %d+:%lu\n", HASH_HIST, hist[HASH_HIST]);
+	return len;
+}
+
 
 /* ====================== bdflush support =================== */
 
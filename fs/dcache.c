@@ -24,22 +24,32 @@
  * There is a global hash-table over both caches that hashes the entries
  * based on the directory inode number and device as well as on a
  * string-hash computed over the name. 
+ *
+ * The caches are sized from the amount of memory at boot. Entries with
+ * an inode number of 0 are negative: they remember that a name does not
+ * exist in the directory, so that a failed lookup doesn't have to scan
+ * the directory again.
  */
 
 #include <stddef.h>
 
 #include <linux/fs.h>
 #include <linux/string.h>
+#include <linux/mm.h>
+#include <linux/malloc.h>
 
 /*
- * Don't bother caching long names.. They just take up space in the cache, and
- * for a name cache you just want to cache the "normal" names anyway which tend
- * to be short.
+ * Names up to DCACHE_NAME_LEN characters are kept in the entry itself.
+ * Longer ones are cached too, but their name is kmalloc()ed: they are
+ * rare enough that the extra allocation doesn't matter, and keeping
+ * the entries small means we can afford more of them.
  */
- //只有短的目录条目（最多 15 字符）被缓存，不过这是合理的，因为较短的目录名称是最常用的。
- //例如：当 X 服务器启动的时候，/usr/X11R6/bin 非常频繁地被访问。
+ //短名字（最多 15 字符）直接存放在目录项中，长名字另外用kmalloc分配
 #define DCACHE_NAME_LEN	15
-#define DCACHE_SIZE 128
+
+/* entries per level: one per 32kB of memory, within these limits */
+#define DCACHE_MIN_SIZE	128
+#define DCACHE_MAX_SIZE	4096
 
 struct hash_list {
 	struct dir_cache_entry * next;
@@ -59,20 +69,19 @@ struct dir_cache_entry {
 	unsigned long dev;
 	unsigned long dir;
 	unsigned long version;
-	unsigned long ino;
+	unsigned long ino;	/* 0 for a negative entry */
+	unsigned long hash;	/* full hash of dev, dir and name */
 	unsigned char name_len;
-	char name[DCACHE_NAME_LEN];
+	char * name;		/* iname, or kmalloc()ed if too long */
+	char iname[DCACHE_NAME_LEN];
 	struct dir_cache_entry ** lru_head;	//指向lru链表（level1_head、level2_head）头指针的指针 二级指针 参见update_lru()函数
 	struct dir_cache_entry * next_lru,  * prev_lru;		//形成lru链表
 };
 
-#define COPYDATA(de, newde) \
-memcpy((void *) &newde->dev, (void *) &de->dev, \
-4*sizeof(unsigned long) + 1 + DCACHE_NAME_LEN)
-
 //LRU数组队列
-static struct dir_cache_entry level1_cache[DCACHE_SIZE];
-static struct dir_cache_entry level2_cache[DCACHE_SIZE];
+static int dcache_size = 0;
+static struct dir_cache_entry * level1_cache;
+static struct dir_cache_entry * level2_cache;
 
 /*
  * The LRU-lists are doubly-linked circular lists, and do not change in size
@@ -93,14 +102,21 @@ static struct dir_cache_entry * level2_head;	//level2_cache数组队列头指针
 /*
  * The hash-queues are also doubly-linked circular lists, but the head is
  * itself on the doubly-linked list, not just a pointer to the first entry.
+ * There are as many queues as entries per level, rounded up to a power
+ * of two.
  */
-#define DCACHE_HASH_QUEUES 19
-#define hash_fn(dev,dir,namehash) (((dev) ^ (dir) ^ (namehash)) % DCACHE_HASH_QUEUES)
+static int dcache_hash_shift = 32;
+#define hash_val(dev,dir,namehash) ((dev) ^ (dir) ^ (namehash))
+#define hash_fn(hashval) (((unsigned int) (hashval) * 0x9e370001U) >> dcache_hash_shift)
 
 //目录缓存中包含一个 hash_table，每一个条目都指向一个具有相同的 hash value 的目录缓存条目的列表。
 //Hash 函数使用存放这个文件系统的设备的设备编号和目录的名称来计算在 hash_table 中的偏移量或索引。
 //它允许快速找到缓存的目录条目。如果一个缓存在查找的时候花费时间太长，或根本找不到，这样的缓存是没有用的。
-static struct hash_list hash_table[DCACHE_HASH_QUEUES];
+static struct hash_list * hash_table;
+
+/* statistics for /proc/dcache */
+static unsigned long dcache_hits = 0, dcache_neg_hits = 0, dcache_misses = 0;
+static unsigned long dcache_adds = 0, dcache_long = 0;
 
 static inline void remove_lru(struct dir_cache_entry * de)
 {
@@ -131,13 +147,31 @@ static inline void update_lru(struct dir_cache_entry * de)
 }
 
 /*
- * Stupid name"hash" algorithm. Write something better if you want to,
- * but I doubt it matters that much
+ * Make an entry the first one to be reused on its LRU list.
+ */
+static inline void make_lru_victim(struct dir_cache_entry * de)
+{
+	if (de == *de->lru_head)
+		return;
+	remove_lru(de);
+	add_lru(de,*de->lru_head);
+	*de->lru_head = de;
+}
+
+/*
+ * The name hash needs to look at the whole name: the old len*first-char
+ * put all of "foo.c", "foo.h" and "foo.o" on the same chain.
  */
  //由name得到一个散列值
 static inline unsigned long namehash(const char * name, int len)
 {
-	return len * *(unsigned char *) name;
+	unsigned long hash = 0;
+
+	while (len-- > 0) {
+		unsigned long c = *(const unsigned char *) name++;
+		hash = (hash + (c << 4) + (c >> 4)) * 11;
+	}
+	return hash;
 }
 
 /*
@@ -161,14 +195,29 @@ static inline void add_hash(struct dir_cache_entry * de, struct hash_list * hash
 	hash->next = de;
 }
 
+/*
+ * Drop an entry's name. Entries that are not on a hash queue never
+ * have a kmalloc()ed name.
+ */
+static inline void free_name(struct dir_cache_entry * de)
+{
+	if (de->name != de->iname) {
+		kfree_s(de->name, de->name_len);
+		de->name = de->iname;
+	}
+}
+
 /*
  * Find a directory cache entry given all the necessary info.
  */
-static struct dir_cache_entry * find_entry(struct inode * dir, const char * name, int len, struct hash_list * hash)
+static struct dir_cache_entry * find_entry(struct inode * dir, const char * name, int len,
+	unsigned long hashval, struct hash_list * hash)
 {
 	struct dir_cache_entry * de = hash->next;
 
 	for (de = hash->next ; de != (struct dir_cache_entry *) hash ; de = de->h.next) {
+		if (de->hash != hashval)
+			continue;
 		if (de->dev != dir->i_dev)
 			continue;
 		if (de->dir != dir->i_ino)
@@ -187,6 +236,10 @@ static struct dir_cache_entry * find_entry(struct inode * dir, const char * name
 /*
  * Move a successfully used entry to level2. If already at level2,
  * move it to the end of the LRU queue..
+ *
+ * The level1 entry hands its name over to the level2 one and is
+ * then the first to be reused, so there is only ever one copy of
+ * an entry in the cache.
  */
 static inline void move_to_level2(struct dir_cache_entry * old_de, struct hash_list * hash)
 {
@@ -201,21 +254,46 @@ static inline void move_to_level2(struct dir_cache_entry * old_de, struct hash_l
 	de = level2_head;
 	level2_head = de->next_lru;	//移除链表头部的一个元素
 	remove_hash(de);	//将此移除的元素从hash表中移除
-	COPYDATA(old_de, de);	//将此移除的de结构内容复制为old_de,体现了内核结构的重复利用（old_de扔存在于一集缓存中）
+	free_name(de);
+	de->dev = old_de->dev;
+	de->dir = old_de->dir;
+	de->version = old_de->version;
+	de->ino = old_de->ino;
+	de->hash = old_de->hash;
+	de->name_len = old_de->name_len;
+	if (old_de->name != old_de->iname) {
+		de->name = old_de->name;
+		old_de->name = old_de->iname;
+	} else
+		memcpy(de->iname, old_de->iname, old_de->name_len);
+	remove_hash(old_de);
+	make_lru_victim(old_de);
 	add_hash(de, hash);	//重新加入到hash表，由于被移除的头元素的内容和被添加的元素内容可能不一样，所以需要重新计算hash值
 }
 
+/*
+ * Returns 1 if the name is in the cache, with *ino set to its inode
+ * number - which is 0 if the name is known not to exist.
+ */
 int dcache_lookup(struct inode * dir, const char * name, int len, unsigned long * ino)
 {
 	struct hash_list * hash;
 	struct dir_cache_entry *de;
+	unsigned long hashval;
 
-	if (len > DCACHE_NAME_LEN)
+	if (!dcache_size)
 		return 0;
-	hash = hash_table + hash_fn(dir->i_dev, dir->i_ino, namehash(name,len));
-	de = find_entry(dir, name, len, hash);
-	if (!de)
+	hashval = hash_val(dir->i_dev, dir->i_ino, namehash(name,len));
+	hash = hash_table + hash_fn(hashval);
+	de = find_entry(dir, name, len, hashval, hash);
+	if (!de) {
+		dcache_misses++;
 		return 0;
+	}
+	if (de->ino)
+		dcache_hits++;
+	else
+		dcache_neg_hits++;
 	*ino = de->ino;
 	move_to_level2(de, hash);
 	return 1;
@@ -225,65 +303,128 @@ void dcache_add(struct inode * dir, const char * name, int len, unsigned long in
 {
 	struct hash_list * hash;
 	struct dir_cache_entry *de;
-	//从这里限制了被缓存的目录项名不能超过DCACHE_NAME_LEN个字节
-	if (len > DCACHE_NAME_LEN)
+	unsigned long hashval;
+	char * longname = NULL;
+
+	if (!dcache_size || len <= 0 || len > 255)
 		return;
-	hash = hash_table + hash_fn(dir->i_dev, dir->i_ino, namehash(name,len));
-	if ((de = find_entry(dir, name, len, hash)) != NULL) {
+	/*
+	 * No sleeping here: the entry is stamped with dir->i_version, and
+	 * that is only right for what the caller saw if nothing could have
+	 * changed the directory since. Long names just go uncached when
+	 * memory is short.
+	 */
+	if (len > DCACHE_NAME_LEN) {
+		longname = (char *) kmalloc(len, GFP_ATOMIC);
+		if (!longname)
+			return;
+		memcpy(longname, name, len);
+		dcache_long++;
+	}
+	hashval = hash_val(dir->i_dev, dir->i_ino, namehash(name,len));
+	hash = hash_table + hash_fn(hashval);
+	if ((de = find_entry(dir, name, len, hashval, hash)) != NULL) {
+		if (longname)
+			kfree_s(longname, len);
 		de->ino = ino;
 		update_lru(de);
 		return;
 	}
+	dcache_adds++;
 	de = level1_head;
 	level1_head = de->next_lru;
 	remove_hash(de);
+	free_name(de);
 	de->dev = dir->i_dev;
 	de->dir = dir->i_ino;
 	de->version = dir->i_version;
 	de->ino = ino;
+	de->hash = hashval;
 	de->name_len = len;
-	memcpy(de->name, name, len);
+	if (longname)
+		de->name = longname;
+	else
+		memcpy(de->iname, name, len);
 	add_hash(de, hash);
 }
 
-unsigned long name_cache_init(unsigned long mem_start, unsigned long mem_end)
+int get_dcache_info(char * buffer)
+{
+	int i, n = 0;
+	struct dir_cache_entry * de;
+
+	for (i = 0 ; i < dcache_size ; i++) {
+		de = level1_cache + i;
+		if (de->h.next)
+			n++;
+		de = level2_cache + i;
+		if (de->h.next)
+			n++;
+	}
+	return sprintf(buffer,
+		"size:     %d\n"
+		"used:     %d\n"
+		"hits:     %lu\n"
+		"neghits:  %lu\n"
+		"misses:   %lu\n"
+		"adds:     %lu\n"
+		"longname: %lu\n",
+		2*dcache_size, n, dcache_hits, dcache_neg_hits, dcache_misses,
+		dcache_adds, dcache_long);
+}
+
+static void init_lru(struct dir_cache_entry * cache, struct dir_cache_entry ** head)
 {
-	int i;
 	struct dir_cache_entry * p;
 
-	/*
-	 * Init level1 LRU lists..
-	 */
-	p = level1_cache;
+	p = cache;
 	do {
 		p[1].prev_lru = p;
 		p[0].next_lru = p+1;
-		p[0].lru_head = &level1_head;	//初始化每个dir_cache_entry的二级指针lru_head，时期都指向level1_head
-	} while (++p < level1_cache + DCACHE_SIZE-1);	//形成双向链表
-	level1_cache[0].prev_lru = p;
-	p[0].next_lru = &level1_cache[0];
-	p[0].lru_head =	 &level1_head;
-	level1_head = level1_cache;
+		p[0].lru_head = head;	//初始化每个dir_cache_entry的二级指针lru_head，时期都指向level1_head
+		p[0].name = p[0].iname;
+	} while (++p < cache + dcache_size-1);	//形成双向链表
+	cache[0].prev_lru = p;
+	p[0].next_lru = &cache[0];
+	p[0].lru_head =	head;
+	p[0].name = p[0].iname;
+	*head = cache;
+}
+
+unsigned long name_cache_init(unsigned long mem_start, unsigned long mem_end)
+{
+	int i, bits, nr_queues;
+
+	dcache_size = (mem_end - mem_start) >> 15;
+	if (dcache_size < DCACHE_MIN_SIZE)
+		dcache_size = DCACHE_MIN_SIZE;
+	if (dcache_size > DCACHE_MAX_SIZE)
+		dcache_size = DCACHE_MAX_SIZE;
+	for (bits = 0 ; (1 << bits) < dcache_size ; bits++)
+		/* nothing */;
+	nr_queues = 1 << bits;
+	dcache_hash_shift = 32 - bits;
+
+	mem_start = (mem_start + 15) & ~15;
+	hash_table = (struct hash_list *) mem_start;
+	mem_start += nr_queues * sizeof(struct hash_list);
+	level1_cache = (struct dir_cache_entry *) mem_start;
+	mem_start += dcache_size * sizeof(struct dir_cache_entry);
+	level2_cache = (struct dir_cache_entry *) mem_start;
+	mem_start += dcache_size * sizeof(struct dir_cache_entry);
+	memset(level1_cache, 0, 2 * dcache_size * sizeof(struct dir_cache_entry));
 
 	/*
-	 * Init level2 LRU lists..
+	 * Init level1 and level2 LRU lists..
 	 */
-	p = level2_cache;
-	do {
-		p[1].prev_lru = p;
-		p[0].next_lru = p+1;
-		p[0].lru_head = &level2_head;
-	} while (++p < level2_cache + DCACHE_SIZE-1);
-	level2_cache[0].prev_lru = p;
-	p[0].next_lru = &level2_cache[0];
-	p[0].lru_head = &level2_head;
-	level2_head = level2_cache;
+	init_lru(level1_cache, &level1_head);
+	init_lru(level2_cache, &level2_head);
 
 	/*
 	 * Empty hash queues..
 	 */
-	for (i = 0 ; i < DCACHE_HASH_QUEUES ; i++)
-		hash_table[i].next = hash_table[i].next =	//bug？？？
+	for (i = 0 ; i < nr_queues ; i++)
+		hash_table[i].next = hash_table[i].prev =
 			(struct dir_cache_entry *) &hash_table[i];
 	return mem_start;
 }
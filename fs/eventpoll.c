@@ -0,0 +1,471 @@
+/*
+ *  linux/fs/eventpoll.c
+ *
+ *  Event sets: a persistent poll().
+ *
+ *  select() and poll() put the caller on the wait queue of every
+ *  descriptor, look at them all, and take it off again, each time they
+ *  are called. A server with a thousand mostly idle connections pays
+ *  for all thousand on every call.
+ *
+ *  An event set joins the wait queues of a descriptor once, when it is
+ *  added with ev_ctl(), using a wait_queue entry with a func instead of
+ *  a task. When the driver does its wake_up() (tcp, pipes, ttys, unix
+ *  sockets all do, they need no changes) the func puts the descriptor
+ *  on the set's ready list. ev_wait() then only checks the descriptors
+ *  on that list. It is level triggered: one that is still ready after
+ *  being reported stays on the list, one that is not drops off until
+ *  the next wakeup.
+ */
+
+#include <linux/types.h>
+#include <linux/fs.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/errno.h>
+#include <linux/stat.h>
+#include <linux/fcntl.h>
+#include <linux/malloc.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+
+#include <asm/segment.h>
+#include <asm/system.h>
+
+#define EV_WAITS	4	/* wait queues one descriptor may put us on */
+
+struct ev_item;
+
+struct ev_wait {
+	struct wait_queue wait;		/* must be first: ev_wakeup() casts */
+	struct wait_queue ** wait_address;
+	struct ev_item * item;
+};
+
+struct ev_item {
+	struct ev_set * set;
+	struct file * file;
+	struct ev_item * f_next;	/* other sets watching this file */
+	struct ev_item * ready_next;	/* on set->ready */
+	struct ev_item * scan_next;	/* being looked at by ev_wait() */
+	int fd;
+	short events;
+	char ready;
+	char nwaits;
+	struct ev_wait waits[EV_WAITS];
+};
+
+struct ev_set {
+	struct ev_item * fds[NR_OPEN];	/* indexed by descriptor */
+	struct ev_item * ready;
+	struct wait_queue * wait;	/* sleeping in ev_wait() */
+	int nr;
+};
+
+/*
+ * Called by wake_up() on one of the queues an item is on, maybe from
+ * an interrupt.
+ */
+static void ev_wakeup(struct wait_queue * wait)
+{
+	struct ev_item * item = ((struct ev_wait *) wait)->item;
+	struct ev_set * set = item->set;
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (item->ready) {
+		/* already queued: whoever sleeps in ev_wait() knows */
+		restore_flags(flags);
+		return;
+	}
+	item->ready = 1;
+	item->ready_next = set->ready;
+	set->ready = item;
+	restore_flags(flags);
+	wake_up_interruptible(&set->wait);
+}
+
+static void ev_ready(struct ev_item * item)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (!item->ready) {
+		item->ready = 1;
+		item->ready_next = item->set->ready;
+		item->set->ready = item;
+	}
+	restore_flags(flags);
+}
+
+/*
+ * Get the item onto the wait queues of its file. The file's select
+ * routine puts a select_table entry on each queue it would have us
+ * sleep on; we swap each of those for one of our own wait entries.
+ */
+static int ev_arm(struct ev_item * item)
+{
+	select_table table;
+	struct select_table_entry * entry;
+	unsigned long flags;
+	int i, j, mask;
+
+	entry = (struct select_table_entry *) __get_free_page(GFP_KERNEL);
+	if (!entry)
+		return -ENOMEM;
+	table.nr = 0;
+	table.entry = entry;
+	mask = poll_file(item->file, item->events, &table);
+
+	save_flags(flags);
+	cli();
+	for (i = 0 ; i < table.nr ; i++) {
+		remove_wait_queue(entry[i].wait_address, &entry[i].wait);
+		for (j = 0 ; j < item->nwaits ; j++)
+			if (item->waits[j].wait_address == entry[i].wait_address)
+				break;
+		if (j < item->nwaits)
+			continue;
+		if (item->nwaits == EV_WAITS) {
+			printk("ev_arm: too many wait queues\n");
+			continue;
+		}
+		item->waits[j].wait.task = NULL;
+		item->waits[j].wait.next = NULL;
+		item->waits[j].wait.func = ev_wakeup;
+		item->waits[j].wait_address = entry[i].wait_address;
+		item->waits[j].item = item;
+		add_wait_queue(entry[i].wait_address, &item->waits[j].wait);
+		item->nwaits++;
+	}
+	restore_flags(flags);
+	free_page((unsigned long) entry);
+
+	/* It may have become ready while we were changing over */
+	if (mask || poll_file(item->file, item->events, NULL))
+		ev_ready(item);
+	return 0;
+}
+
+static void ev_disarm(struct ev_item * item)
+{
+	struct ev_item ** p;
+	unsigned long flags;
+	int i;
+
+	save_flags(flags);
+	cli();
+	for (i = 0 ; i < item->nwaits ; i++)
+		remove_wait_queue(item->waits[i].wait_address, &item->waits[i].wait);
+	item->nwaits = 0;
+	if (item->ready) {
+		for (p = &item->set->ready ; *p ; p = &(*p)->ready_next)
+			if (*p == item) {
+				*p = item->ready_next;
+				break;
+			}
+		item->ready = 0;
+	}
+	restore_flags(flags);
+}
+
+static void ev_remove(struct ev_item * item)
+{
+	struct ev_item ** p;
+
+	ev_disarm(item);
+	for (p = &item->file->f_ev ; *p ; p = &(*p)->f_next)
+		if (*p == item) {
+			*p = item->f_next;
+			break;
+		}
+	item->set->fds[item->fd] = NULL;
+	item->set->nr--;
+	kfree_s(item, sizeof(*item));
+}
+
+/*
+ * The last reference to a watched file is going away: forget it in
+ * every set it is in. Called from close_fp().
+ */
+void ev_file_release(struct file * file)
+{
+	while (file->f_ev)
+		ev_remove(file->f_ev);
+}
+
+static int ev_select(struct inode * inode, struct file * file, int sel_type, select_table * wait)
+{
+	struct ev_set * set = (struct ev_set *) file->private_data;
+
+	if (sel_type != SEL_IN)
+		return 0;
+	if (set->ready)
+		return 1;
+	select_wait(&set->wait, wait);
+	return 0;
+}
+
+static void ev_release(struct inode * inode, struct file * file)
+{
+	struct ev_set * set = (struct ev_set *) file->private_data;
+	int i;
+
+	for (i = 0 ; i < NR_OPEN && set->nr ; i++)
+		if (set->fds[i])
+			ev_remove(set->fds[i]);
+	kfree_s(set, sizeof(*set));
+	file->private_data = NULL;
+}
+
+static struct file_operations ev_fops = {
+	NULL,		/* lseek */
+	NULL,		/* read */
+	NULL,		/* write */
+	NULL,		/* readdir */
+	ev_select,	/* select */
+	NULL,		/* ioctl */
+	NULL,		/* mmap */
+	NULL,		/* open */
+	ev_release,	/* release */
+	NULL,		/* fsync */
+	NULL,		/* fasync */
+	NULL,		/* check_media_change */
+	NULL		/* revalidate */
+};
+
+static struct ev_set * ev_get_set(int efd)
+{
+	struct file * file;
+
+	if (efd < 0 || efd >= NR_OPEN || !(file = current->files->fd[efd]))
+		return NULL;
+	if (file->f_op != &ev_fops)
+		return NULL;
+	return (struct ev_set *) file->private_data;
+}
+
+/*
+ * ev_create(): a new, empty event set, returned as a descriptor.
+ */
+asmlinkage int sys_ev_create(void)
+{
+	struct inode * inode;
+	struct file * file;
+	struct ev_set * set;
+	int fd;
+
+	for (fd = 0 ; fd < NR_OPEN && fd < current->rlim[RLIMIT_NOFILE].rlim_cur ; fd++)
+		if (!current->files->fd[fd])
+			break;
+	if (fd >= NR_OPEN || fd >= current->rlim[RLIMIT_NOFILE].rlim_cur)
+		return -EMFILE;
+	set = (struct ev_set *) kmalloc(sizeof(*set), GFP_KERNEL);
+	if (!set)
+		return -ENOMEM;
+	memset(set, 0, sizeof(*set));
+	if (!(file = get_empty_filp())) {
+		kfree_s(set, sizeof(*set));
+		return -ENFILE;
+	}
+	if (!(inode = get_empty_inode())) {
+		file->f_count--;
+		kfree_s(set, sizeof(*set));
+		return -ENFILE;
+	}
+	inode->i_mode = S_IRUSR;
+	inode->i_uid = current->fsuid;
+	inode->i_gid = current->fsgid;
+	inode->i_atime = inode->i_mtime = inode->i_ctime = CURRENT_TIME;
+
+	file->f_inode = inode;
+	file->f_op = &ev_fops;
+	file->f_flags = O_RDONLY;
+	file->f_mode = 1;
+	file->f_pos = 0;
+	file->private_data = set;
+	FD_CLR(fd, &current->files->close_on_exec);
+	current->files->fd[fd] = file;
+	return fd;
+}
+
+/*
+ * ev_ctl(efd, op, fd, events): add fd to the set, change the events
+ * wanted on it, or take it out again.
+ */
+asmlinkage int sys_ev_ctl(int efd, int op, int fd, int events)
+{
+	struct ev_set * set;
+	struct ev_item * item;
+	struct file * file;
+	int error;
+
+	if (!(set = ev_get_set(efd)))
+		return -EBADF;
+	if (fd < 0 || fd >= NR_OPEN || !(file = current->files->fd[fd]) ||
+	    !file->f_inode)
+		return -EBADF;
+	/*
+	 * No sets inside sets: two sets holding each other would have
+	 * ev_wakeup() chase its own tail.
+	 */
+	if (file->f_op == &ev_fops)
+		return -EINVAL;
+	item = set->fds[fd];
+
+	/*
+	 * An item for a different file on this descriptor number is left
+	 * over from a file that is still open elsewhere (dup, fork): the
+	 * descriptor has been reused, so the old entry goes.
+	 */
+	if (item && item->file != file) {
+		ev_remove(item);
+		item = NULL;
+	}
+
+	switch (op) {
+		case EV_CTL_ADD:
+			if (item)
+				return -EEXIST;
+			item = (struct ev_item *) kmalloc(sizeof(*item), GFP_KERNEL);
+			if (!item)
+				return -ENOMEM;
+			memset(item, 0, sizeof(*item));
+			item->set = set;
+			item->file = file;
+			item->fd = fd;
+			item->events = events;
+			error = ev_arm(item);
+			if (error) {
+				kfree_s(item, sizeof(*item));
+				return error;
+			}
+			item->f_next = file->f_ev;
+			file->f_ev = item;
+			set->fds[fd] = item;
+			set->nr++;
+			return 0;
+		case EV_CTL_MOD:
+			if (!item)
+				return -ENOENT;
+			ev_disarm(item);
+			item->events = events;
+			return ev_arm(item);
+		case EV_CTL_DEL:
+			if (!item)
+				return -ENOENT;
+			ev_remove(item);
+			return 0;
+	}
+	return -EINVAL;
+}
+
+/*
+ * ev_wait(efd, events, maxevents, timeout): fill in up to maxevents
+ * pollfds for the ready descriptors. timeout is in milliseconds,
+ * negative to wait for ever.
+ */
+asmlinkage int sys_ev_wait(int efd, struct pollfd * events, int maxevents, int timeout)
+{
+	struct wait_queue wait = { current, NULL };
+	struct ev_set * set;
+	struct ev_item * item, * scan, * rest, * done, ** rest_tail, ** done_tail;
+	unsigned long flags;
+	int count, mask, error, reported;
+
+	if (!(set = ev_get_set(efd)))
+		return -EBADF;
+	if (maxevents <= 0)
+		return -EINVAL;
+	error = verify_area(VERIFY_WRITE, events, maxevents * sizeof(struct pollfd));
+	if (error)
+		return error;
+
+	if (timeout < 0)
+		current->timeout = ~0UL;
+	else if (timeout) {
+		current->timeout = (timeout / 1000) * HZ;
+		current->timeout += ((timeout % 1000) * HZ + 999) / 1000;
+		current->timeout += jiffies + 1;
+	} else
+		current->timeout = 0;
+
+	add_wait_queue(&set->wait, &wait);
+repeat:
+	current->state = TASK_INTERRUPTIBLE;
+
+	/*
+	 * Take the ready list as it stands. From here on a wakeup puts an
+	 * item back on set->ready, without disturbing our scan list.
+	 */
+	save_flags(flags);
+	cli();
+	scan = set->ready;
+	set->ready = NULL;
+	for (item = scan ; item ; item = item->ready_next) {
+		item->scan_next = item->ready_next;
+		item->ready = 0;
+	}
+	restore_flags(flags);
+
+	count = 0;
+	rest = done = NULL;
+	rest_tail = &rest;
+	done_tail = &done;
+	while ((item = scan) != NULL) {
+		scan = item->scan_next;
+		mask = poll_file(item->file, item->events, NULL);
+		if (!mask)
+			continue;
+		reported = 0;
+		if (count < maxevents) {
+			put_fs_long(item->fd, (unsigned long *) &events[count].fd);
+			put_fs_word(item->events, &events[count].events);
+			put_fs_word(mask, &events[count].revents);
+			count++;
+			reported = 1;
+		}
+		/* Still ready: it stays on the list */
+		cli();
+		if (!item->ready) {
+			item->ready = 1;
+			item->ready_next = NULL;
+			if (reported) {
+				*done_tail = item;
+				done_tail = &item->ready_next;
+			} else {
+				*rest_tail = item;
+				rest_tail = &item->ready_next;
+			}
+		}
+		restore_flags(flags);
+	}
+
+	/*
+	 * Put back what is still ready: first what didn't fit this time,
+	 * then what came in meanwhile, and what we just reported last, so
+	 * that with more ready items than maxevents they all get a turn.
+	 */
+	if (rest || done) {
+		cli();
+		*rest_tail = set->ready;
+		while (*rest_tail)
+			rest_tail = &(*rest_tail)->ready_next;
+		*rest_tail = done;
+		set->ready = rest;
+		restore_flags(flags);
+	}
+
+	if (!count && current->timeout && !(current->signal & ~current->blocked)) {
+		schedule();
+		goto repeat;
+	}
+	current->state = TASK_RUNNING;
+	remove_wait_queue(&set->wait, &wait);
+	current->timeout = 0;
+	if (!count && (current->signal & ~current->blocked))
+		return -EINTR;
+	return count;
+}
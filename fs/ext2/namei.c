@@ -22,6 +22,7 @@
 #include <linux/stat.h>
 #include <linux/string.h>
 #include <linux/locks.h>
+#include <linux/mm.h>
 
 /*
  * comment out this line if you want names > EXT2_NAME_LEN chars to be
@@ -56,6 +57,680 @@ static int ext2_match (int len, const char * const name,
 	return !memcmp(name, de->name, len);
 }
 
+/*
+ * Hash-indexed directories. See <linux/ext2_fs.h> for the layout.
+ *
+ * With the index a lookup reads the root block, at most one index node
+ * and one leaf, whatever the size of the directory. Adding a name reads
+ * the same blocks, and when the leaf is full splits it at its median
+ * hash into a new block at the end of the directory.
+ *
+ * Nothing read from the disk is trusted: if the index doesn't check out
+ * it is dropped (EXT2_INDEX_FL is cleared) and we go back to the linear
+ * search, which always works.
+ */
+#define is_dx(dir)		((dir)->u.ext2_i.i_flags & EXT2_INDEX_FL)
+#define dx_special(name,len)	(!(len) || ((len) <= 2 && (name)[0] == '.' && \
+				 ((len) == 1 || (name)[1] == '.')))
+#define DX_ROOT_OFFSET		(EXT2_DIR_REC_LEN(1) + EXT2_DIR_REC_LEN(2))
+#define DX_HASH_LIMIT		0x80000000UL
+#define dx_root_limit(sb)	(((sb)->s_blocksize - DX_ROOT_OFFSET - \
+				  sizeof (struct ext2_dx_head)) / \
+				 sizeof (struct ext2_dx_entry))
+#define dx_node_limit(sb)	(((sb)->s_blocksize - \
+				  sizeof (struct ext2_dx_head)) / \
+				 sizeof (struct ext2_dx_entry))
+#define dx_entries(head)	((struct ext2_dx_entry *) ((head) + 1))
+/* index entries sort by hash, a continuation just after its plain hash */
+#define dx_order(h)		((((h) & ~EXT2_DX_CONT) << 1) | ((h) >> 31))
+
+struct dx_frame {
+	struct buffer_head * bh;
+	struct ext2_dx_head * head;
+	struct ext2_dx_entry * at;
+};
+
+/*
+ * The hash is part of the on-disk format: don't change it.
+ */
+static unsigned long dx_hash (const char * name, int len)
+{
+	unsigned long hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+
+	while (len-- > 0) {
+		hash = hash1 + (hash0 ^ (*(const unsigned char *) name++ * 7152373));
+		if (hash & 0x80000000)
+			hash -= 0x7fffffff;
+		hash1 = hash0;
+		hash0 = hash;
+	}
+	return hash0 & (DX_HASH_LIMIT - 1);
+}
+
+static void dx_drop (struct inode * dir, const char * why)
+{
+	ext2_warning (dir->i_sb, "dx_drop", "directory #%lu: %s, "
+		      "using linear search", dir->i_ino, why);
+	dir->u.ext2_i.i_flags &= ~EXT2_INDEX_FL;
+	dir->i_dirt = 1;
+}
+
+static void dx_init_head (struct ext2_dx_head * head, int rec_len, int limit)
+{
+	memset (head, 0, sizeof (*head));
+	head->rec_len = rec_len;
+	head->magic = EXT2_DX_MAGIC;
+	head->limit = limit;
+}
+
+static int dx_check_head (struct inode * dir, struct ext2_dx_head * head,
+			  int rec_len, int limit, int levels)
+{
+	unsigned long nblocks = dir->i_size >> EXT2_BLOCK_SIZE_BITS(dir->i_sb);
+	struct ext2_dx_entry * entries = dx_entries(head);
+	int i;
+
+	if (head->inode || head->name_len || head->magic != EXT2_DX_MAGIC ||
+	    head->rec_len != rec_len || head->limit != limit ||
+	    head->levels > levels || !head->count || head->count > limit)
+		return 0;
+	for (i = 0; i < head->count; i++) {
+		if (!entries[i].block || entries[i].block >= nblocks)
+			return 0;
+		if (i > 1 && (dx_order(entries[i].hash) <
+			      dx_order(entries[i-1].hash) ||
+			      (entries[i].hash == entries[i-1].hash &&
+			       !(entries[i].hash & EXT2_DX_CONT))))
+			return 0;
+	}
+	return 1;
+}
+
+static struct ext2_dx_head * dx_root (struct inode * dir,
+				      struct buffer_head * bh)
+{
+	struct ext2_dir_entry * de = (struct ext2_dir_entry *) bh->b_data;
+	struct ext2_dx_head * head;
+
+	if (de->rec_len != EXT2_DIR_REC_LEN(1) || de->name_len != 1 ||
+	    de->name[0] != '.')
+		return NULL;
+	de = (struct ext2_dir_entry *) (bh->b_data + EXT2_DIR_REC_LEN(1));
+	if (de->rec_len != EXT2_DIR_REC_LEN(2) || de->name_len != 2 ||
+	    de->name[0] != '.' || de->name[1] != '.')
+		return NULL;
+	head = (struct ext2_dx_head *) (bh->b_data + DX_ROOT_OFFSET);
+	if (!dx_check_head (dir, head, dir->i_sb->s_blocksize - DX_ROOT_OFFSET,
+			    dx_root_limit(dir->i_sb), EXT2_DX_MAX_LEVELS))
+		return NULL;
+	return head;
+}
+
+/*
+ * Find the last entry whose hash is <= hash, not counting continuations
+ * of hash itself: that is where names with this hash start. The hash of
+ * the first entry is never looked at.
+ */
+static struct ext2_dx_entry * dx_search (struct ext2_dx_head * head,
+					 unsigned long hash)
+{
+	struct ext2_dx_entry * entries = dx_entries(head);
+	int lo = 1, hi = head->count - 1, mid;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (dx_order(entries[mid].hash) > hash << 1)
+			hi = mid - 1;
+		else
+			lo = mid + 1;
+	}
+	return entries + lo - 1;
+}
+
+static void dx_release (struct dx_frame * frames, int n)
+{
+	while (n-- > 0)
+		brelse (frames[n].bh);
+}
+
+/*
+ * Walk the index down to the leaf for a hash. Returns the number of
+ * frames filled in - the last one points at the leaf - or 0 with *err
+ * set. -EINVAL means that the index is no good.
+ */
+static int dx_probe (struct inode * dir, unsigned long hash,
+		     struct dx_frame * frames, int * err)
+{
+	struct super_block * sb = dir->i_sb;
+	struct buffer_head * bh;
+	struct ext2_dx_head * head;
+	int n = 0;
+
+	*err = 0;
+	bh = ext2_bread (dir, 0, 0, err);
+	if (!bh)
+		goto io_error;
+	if (!(head = dx_root (dir, bh)))
+		goto bad;
+	frames[0].bh = bh;
+	frames[0].head = head;
+	frames[0].at = dx_search (head, hash);
+	n = 1;
+	if (!head->levels)
+		return 1;
+	bh = ext2_bread (dir, frames[0].at->block, 0, err);
+	if (!bh)
+		goto io_error;
+	head = (struct ext2_dx_head *) bh->b_data;
+	if (!dx_check_head (dir, head, sb->s_blocksize, dx_node_limit(sb), 0))
+		goto bad;
+	frames[1].bh = bh;
+	frames[1].head = head;
+	frames[1].at = dx_search (head, hash);
+	return 2;
+
+bad:
+	brelse (bh);
+	dx_release (frames, n);
+	*err = -EINVAL;
+	return 0;
+io_error:
+	dx_release (frames, n);
+	if (!*err)
+		*err = -EIO;
+	return 0;
+}
+
+/*
+ * Insert an entry for a new block after the one the frame points at.
+ * The caller has made sure there is room.
+ */
+static void dx_insert (struct dx_frame * frame, unsigned long hash,
+		       unsigned long block)
+{
+	struct ext2_dx_entry * at = frame->at + 1;
+	struct ext2_dx_entry * end = dx_entries(frame->head) + frame->head->count;
+
+	memmove (at + 1, at, (char *) end - (char *) at);
+	at->hash = hash;
+	at->block = block;
+	frame->head->count++;
+	mark_buffer_dirty (frame->bh, 1);
+}
+
+/*
+ * Move the frames on to the next leaf if it is a continuation of hash,
+ * reading the next index node if need be. Returns 1 if it is, 0 if it
+ * isn't, or an error.
+ */
+static int dx_next_leaf (struct inode * dir, unsigned long hash,
+			 struct dx_frame * frames, int n)
+{
+	struct super_block * sb = dir->i_sb;
+	struct dx_frame * frame = frames + n - 1;
+	struct buffer_head * bh;
+	struct ext2_dx_head * head;
+	int err = 0;
+
+	while (frame->at + 1 >= dx_entries(frame->head) + frame->head->count) {
+		if (frame == frames)
+			return 0;
+		frame--;
+	}
+	if (frame->at[1].hash != (hash | EXT2_DX_CONT))
+		return 0;
+	frame->at++;
+	while (++frame < frames + n) {
+		bh = ext2_bread (dir, frame[-1].at->block, 0, &err);
+		if (!bh)
+			return err ? err : -EIO;
+		head = (struct ext2_dx_head *) bh->b_data;
+		if (!dx_check_head (dir, head, sb->s_blocksize,
+				    dx_node_limit(sb), 0)) {
+			brelse (bh);
+			return -EINVAL;
+		}
+		brelse (frame->bh);
+		frame->bh = bh;
+		frame->head = head;
+		frame->at = dx_entries(head);
+	}
+	return 1;
+}
+
+/*
+ * Search one directory block. Returns 1 if the name was found, 0 if it
+ * wasn't and -1 if the block is corrupted.
+ */
+static int search_dirblock (struct inode * dir, struct buffer_head * bh,
+			    const char * name, int namelen,
+			    unsigned long offset,
+			    struct ext2_dir_entry ** res_dir)
+{
+	struct ext2_dir_entry * de = (struct ext2_dir_entry *) bh->b_data;
+	char * dlimit = bh->b_data + dir->i_sb->s_blocksize;
+
+	while ((char *) de < dlimit) {
+		if (!ext2_check_dir_entry ("search_dirblock", dir, de, bh,
+					   offset))
+			return -1;
+		if (de->inode != 0 && ext2_match (namelen, name, de)) {
+			*res_dir = de;
+			return 1;
+		}
+		offset += de->rec_len;
+		de = (struct ext2_dir_entry *) ((char *) de + de->rec_len);
+	}
+	return 0;
+}
+
+/*
+ * Same as the inner loop of ext2_add_entry(), for a single block.
+ */
+static int add_dirent_to_block (struct inode * dir, struct buffer_head * bh,
+				const char * name, int namelen,
+				unsigned long offset,
+				struct ext2_dir_entry ** res_dir)
+{
+	struct ext2_dir_entry * de = (struct ext2_dir_entry *) bh->b_data;
+	struct ext2_dir_entry * de1;
+	char * dlimit = bh->b_data + dir->i_sb->s_blocksize;
+	unsigned short rec_len = EXT2_DIR_REC_LEN(namelen);
+
+	while ((char *) de < dlimit) {
+		if (!ext2_check_dir_entry ("add_dirent_to_block", dir, de, bh,
+					   offset))
+			return -ENOENT;
+		if (de->inode != 0 && ext2_match (namelen, name, de))
+			return -EEXIST;
+		if ((de->inode == 0 && de->rec_len >= rec_len) ||
+		    (de->rec_len >= EXT2_DIR_REC_LEN(de->name_len) + rec_len)) {
+			if (de->inode) {
+				de1 = (struct ext2_dir_entry *) ((char *) de +
+					EXT2_DIR_REC_LEN(de->name_len));
+				de1->rec_len = de->rec_len -
+					EXT2_DIR_REC_LEN(de->name_len);
+				de->rec_len = EXT2_DIR_REC_LEN(de->name_len);
+				de = de1;
+			}
+			de->inode = 0;
+			de->name_len = namelen;
+			memcpy (de->name, name, namelen);
+			dir->i_mtime = dir->i_ctime = CURRENT_TIME;
+			dir->i_dirt = 1;
+			dir->i_version = ++event;
+			mark_buffer_dirty(bh, 1);
+			*res_dir = de;
+			return 0;
+		}
+		offset += de->rec_len;
+		de = (struct ext2_dir_entry *) ((char *) de + de->rec_len);
+	}
+	return -ENOSPC;
+}
+
+/*
+ * Pack the live entries in len bytes at from whose hash is in [lo, hi)
+ * at the start of the new block at to, and make the last one cover the
+ * rest of the block.
+ */
+static void dx_move_entries (char * from, int len, char * to, int bs,
+			     unsigned long lo, unsigned long hi)
+{
+	struct ext2_dir_entry * de, * last = NULL;
+	char * top = from + len, * dest = to;
+	unsigned long hash;
+	int rec_len, size;
+
+	for (de = (struct ext2_dir_entry *) from; (char *) de < top;
+	     de = (struct ext2_dir_entry *) ((char *) de + rec_len)) {
+		rec_len = de->rec_len;
+		if (!de->inode)
+			continue;
+		hash = dx_hash (de->name, de->name_len);
+		if (hash < lo || hash >= hi)
+			continue;
+		size = EXT2_DIR_REC_LEN(de->name_len);
+		memmove (dest, de, size);
+		last = (struct ext2_dir_entry *) dest;
+		last->rec_len = size;
+		dest += size;
+	}
+	if (!last) {
+		last = (struct ext2_dir_entry *) to;
+		last->inode = 0;
+		last->name_len = 0;
+	}
+	last->rec_len = to + bs - (char *) last;
+}
+
+/*
+ * Take the entries whose hash is >= split out of a leaf that has been
+ * split, as ext2_delete_entry() would. The others stay where they are,
+ * so a readdir() half way through the block doesn't miss any of them.
+ */
+static void dx_remove_entries (char * base, int bs, unsigned long split)
+{
+	struct ext2_dir_entry * de, * pde = NULL;
+	char * top = base + bs;
+	int rec_len;
+
+	for (de = (struct ext2_dir_entry *) base; (char *) de < top;
+	     de = (struct ext2_dir_entry *) ((char *) de + rec_len)) {
+		rec_len = de->rec_len;
+		if (de->inode && dx_hash (de->name, de->name_len) >= split) {
+			de->inode = 0;
+			if (pde) {
+				pde->rec_len += rec_len;
+				continue;
+			}
+		}
+		pde = de;
+	}
+}
+
+/*
+ * The leaf that frames[*n-1] points at has no room for a name with the
+ * given hash: split it at the median hash, counting the new name, into
+ * a new block at the end of the directory. If all of them have the same
+ * hash the new block becomes a continuation of the leaf instead. If the
+ * index block pointing to it is full too, make room there first - by
+ * adding a level under the root, or by splitting the index node.
+ *
+ * Everything that can sleep is done before anything is changed. If the
+ * directory has been changed meanwhile we return -EAGAIN and the caller
+ * starts over; otherwise the split is done without sleeping, so nobody
+ * ever sees a half-split directory. -EINVAL means the index can't take
+ * any more.
+ */
+static int dx_split_leaf (struct inode * dir, struct dx_frame * frames, int * n,
+			  struct buffer_head * bh, unsigned long hash,
+			  unsigned long version)
+{
+	struct super_block * sb = dir->i_sb;
+	int bits = EXT2_BLOCK_SIZE_BITS(sb), bs = sb->s_blocksize;
+	struct dx_frame * frame = frames + *n - 1;
+	struct buffer_head * node_bh = NULL, * leaf_bh = NULL;
+	struct ext2_dx_head * head;
+	struct ext2_dir_entry * de;
+	unsigned long * hashes = NULL;
+	unsigned long size = dir->i_size, block, node_block = 0, split;
+	int count, i, gap, idx, err;
+
+	if (frame->head->count >= frame->head->limit) {
+		if (*n > 1 && frames[0].head->count >= frames[0].head->limit)
+			return -EINVAL;
+		node_block = size >> bits;
+	}
+	block = (size >> bits) + (node_block ? 1 : 0);
+	if (node_block && !(node_bh = ext2_bread (dir, node_block, 1, &err)))
+		goto out;
+	if (!(leaf_bh = ext2_bread (dir, block, 1, &err)))
+		goto out;
+	err = -ENOMEM;
+	if (!(hashes = (unsigned long *) __get_free_page (GFP_KERNEL)))
+		goto out;
+	err = -EAGAIN;
+	if (dir->i_version != version || dir->i_size != size)
+		goto out;
+
+	/* Find the median hash: equal hashes must stay in one block */
+	count = 0;
+	for (de = (struct ext2_dir_entry *) bh->b_data;
+	     (char *) de < bh->b_data + bs;
+	     de = (struct ext2_dir_entry *) ((char *) de + de->rec_len)) {
+		if (!ext2_check_dir_entry ("dx_split_leaf", dir, de, bh, 0)) {
+			err = -EIO;
+			goto out;
+		}
+		if (de->inode)
+			hashes[count++] = dx_hash (de->name, de->name_len);
+	}
+	hashes[count++] = hash;
+	for (gap = count / 2; gap > 0; gap /= 2)
+		for (i = gap; i < count; i++) {
+			unsigned long h = hashes[i];
+			int j;
+
+			for (j = i; j >= gap && hashes[j-gap] > h; j -= gap)
+				hashes[j] = hashes[j-gap];
+			hashes[j] = h;
+		}
+	err = -EINVAL;
+	if (count < 2)
+		goto out;
+	for (i = count / 2; i < count && hashes[i] == hashes[i-1]; i++)
+		;
+	if (i == count)
+		for (i = count / 2; i > 0 && hashes[i] == hashes[i-1]; i--)
+			;
+	split = i ? hashes[i] : hash | EXT2_DX_CONT;
+
+	if (node_block && *n == 1) {
+		/* the root moves down into the new node */
+		head = (struct ext2_dx_head *) node_bh->b_data;
+		dx_init_head (head, bs, dx_node_limit(sb));
+		memcpy (dx_entries(head), dx_entries(frame->head),
+			frame->head->count * sizeof (struct ext2_dx_entry));
+		head->count = frame->head->count;
+		frames[1].bh = node_bh;
+		frames[1].head = head;
+		frames[1].at = dx_entries(head) +
+			(frame->at - dx_entries(frame->head));
+		node_bh = NULL;
+		frame->head->levels = 1;
+		frame->head->count = 1;
+		frame->at = dx_entries(frame->head);
+		frame->at->hash = 0;
+		frame->at->block = node_block;
+		mark_buffer_dirty (frame->bh, 1);
+		frame = frames + 1;
+		*n = 2;
+	} else if (node_block) {
+		/* split the index node, the upper half goes to the new one */
+		struct ext2_dx_head * old = frame->head;
+		int half = old->count / 2;
+
+		head = (struct ext2_dx_head *) node_bh->b_data;
+		dx_init_head (head, bs, dx_node_limit(sb));
+		memcpy (dx_entries(head), dx_entries(old) + half,
+			(old->count - half) * sizeof (struct ext2_dx_entry));
+		head->count = old->count - half;
+		old->count = half;
+		dx_insert (frames, dx_entries(head)->hash, node_block);
+		mark_buffer_dirty (frame->bh, 1);
+		idx = frame->at - dx_entries(old);
+		if (idx >= half) {
+			brelse (frame->bh);
+			frame->bh = node_bh;
+			frame->head = head;
+			frame->at = dx_entries(head) + idx - half;
+			node_bh = NULL;
+		}
+	}
+	if (node_bh)
+		mark_buffer_dirty (node_bh, 1);
+
+	if (split & EXT2_DX_CONT) {
+		de = (struct ext2_dir_entry *) leaf_bh->b_data;
+		de->inode = 0;
+		de->name_len = 0;
+		de->rec_len = bs;
+	} else {
+		dx_move_entries (bh->b_data, bs, leaf_bh->b_data, bs,
+				 split, DX_HASH_LIMIT);
+		dx_remove_entries (bh->b_data, bs, split);
+		mark_buffer_dirty (bh, 1);
+	}
+	dx_insert (frame, split, block);
+	mark_buffer_dirty (leaf_bh, 1);
+	dir->i_size = (block + 1) << bits;
+	dir->i_dirt = 1;
+	dir->i_version = ++event;
+	err = 0;
+out:
+	if (hashes)
+		free_page ((unsigned long) hashes);
+	brelse (node_bh);
+	brelse (leaf_bh);
+	return err;
+}
+
+static struct buffer_head * dx_find_entry (struct inode * dir,
+					   const char * name, int namelen,
+					   struct ext2_dir_entry ** res_dir,
+					   int * err)
+{
+	struct dx_frame frames[EXT2_DX_MAX_LEVELS + 1];
+	struct buffer_head * bh;
+	unsigned long hash = dx_hash (name, namelen), version, block;
+	int n, tries;
+
+	for (tries = 0; tries < 4; tries++) {
+		version = dir->i_version;
+		n = dx_probe (dir, hash, frames, err);
+		if (!n)
+			return NULL;
+		do {
+			block = frames[n-1].at->block;
+			bh = ext2_bread (dir, block, 0, err);
+			if (!bh) {
+				dx_release (frames, n);
+				if (!*err)
+					*err = -EIO;
+				return NULL;
+			}
+			switch (search_dirblock (dir, bh, name, namelen,
+					block << EXT2_BLOCK_SIZE_BITS(dir->i_sb),
+					res_dir)) {
+			case 1:
+				dx_release (frames, n);
+				*err = 0;
+				return bh;
+			case 0:
+				*err = dx_next_leaf (dir, hash, frames, n);
+				break;
+			default:
+				*err = -EIO;
+			}
+			brelse (bh);
+		} while (*err == 1);
+		dx_release (frames, n);
+		/* the leaf may have been split while we slept */
+		if (*err || dir->i_version == version)
+			break;
+	}
+	return NULL;
+}
+
+static struct buffer_head * dx_add_entry (struct inode * dir,
+					  const char * name, int namelen,
+					  struct ext2_dir_entry ** res_dir,
+					  int * err)
+{
+	struct dx_frame frames[EXT2_DX_MAX_LEVELS + 1];
+	struct buffer_head * bh;
+	unsigned long hash = dx_hash (name, namelen), version, block;
+	int n, tries;
+
+	for (tries = 0; tries < 8; tries++) {
+		version = dir->i_version;
+		n = dx_probe (dir, hash, frames, err);
+		if (!n)
+			return NULL;
+		do {
+			block = frames[n-1].at->block;
+			bh = ext2_bread (dir, block, 0, err);
+			if (!bh) {
+				dx_release (frames, n);
+				if (!*err)
+					*err = -EIO;
+				return NULL;
+			}
+			/* if we slept, the index may have changed under us */
+			if (dir->i_version != version) {
+				*err = -EAGAIN;
+				break;
+			}
+			*err = add_dirent_to_block (dir, bh, name, namelen,
+				block << EXT2_BLOCK_SIZE_BITS(dir->i_sb),
+				res_dir);
+			if (!*err) {
+				dx_release (frames, n);
+				return bh;
+			}
+			if (*err != -ENOSPC)
+				break;
+			/* try the rest of the run, split the last leaf */
+			*err = dx_next_leaf (dir, hash, frames, n);
+			if (!*err)
+				*err = dx_split_leaf (dir, frames, &n, bh,
+						      hash, version);
+			else if (*err == 1)
+				brelse (bh);
+		} while (*err == 1);
+		brelse (bh);
+		dx_release (frames, n);
+		if (*err && *err != -EAGAIN)
+			return NULL;
+	}
+	*err = -ENOSPC;
+	return NULL;
+}
+
+/*
+ * Turn a full one-block directory into an indexed one: everything but
+ * "." and ".." moves to a new leaf, and the index root takes its place.
+ */
+static int dx_make_index (struct inode * dir)
+{
+	struct super_block * sb = dir->i_sb;
+	struct buffer_head * bh, * leaf_bh;
+	struct ext2_dir_entry * de;
+	struct ext2_dx_head * head;
+	unsigned long version = dir->i_version;
+	int bs = sb->s_blocksize, skip, err;
+
+	if (!(leaf_bh = ext2_bread (dir, 1, 1, &err)))
+		return -EIO;
+	if (!(bh = ext2_bread (dir, 0, 0, &err))) {
+		brelse (leaf_bh);
+		return -EIO;
+	}
+	err = -EAGAIN;
+	if (dir->i_version != version || dir->i_size != bs)
+		goto out;
+	err = -EINVAL;
+	de = (struct ext2_dir_entry *) bh->b_data;
+	if (de->rec_len != EXT2_DIR_REC_LEN(1) || de->name_len != 1 ||
+	    de->name[0] != '.')
+		goto out;
+	de = (struct ext2_dir_entry *) (bh->b_data + EXT2_DIR_REC_LEN(1));
+	if (de->rec_len < EXT2_DIR_REC_LEN(2) || de->name_len != 2 ||
+	    de->name[0] != '.' || de->name[1] != '.')
+		goto out;
+	skip = EXT2_DIR_REC_LEN(1) + de->rec_len;
+	dx_move_entries (bh->b_data + skip, bs - skip, leaf_bh->b_data, bs,
+			 0, DX_HASH_LIMIT);
+	de->rec_len = EXT2_DIR_REC_LEN(2);
+	head = (struct ext2_dx_head *) (bh->b_data + DX_ROOT_OFFSET);
+	dx_init_head (head, bs - DX_ROOT_OFFSET, dx_root_limit(sb));
+	head->count = 1;
+	dx_entries(head)->hash = 0;
+	dx_entries(head)->block = 1;
+	mark_buffer_dirty (bh, 1);
+	mark_buffer_dirty (leaf_bh, 1);
+	dir->i_size = 2 * bs;
+	dir->u.ext2_i.i_flags |= EXT2_INDEX_FL;
+	dir->i_dirt = 1;
+	dir->i_version = ++event;
+	err = 0;
+out:
+	brelse (bh);
+	brelse (leaf_bh);
+	return err;
+}
+
 /*
  *	ext2_find_entry()
  *
@@ -87,6 +762,15 @@ static struct buffer_head * ext2_find_entry (struct inode * dir,
 		namelen = EXT2_NAME_LEN;
 #endif
 
+	if (is_dx(dir) && !dx_special(name, namelen)) {
+		struct buffer_head * bh;
+
+		bh = dx_find_entry (dir, name, namelen, res_dir, &err);
+		if (bh || err != -EINVAL)
+			return bh;
+		dx_drop (dir, "bad index");
+	}
+
 	memset (bh_use, 0, sizeof (bh_use));
 	toread = 0;
 	for (block = 0; block < NAMEI_RA_SIZE; ++block) {
@@ -246,6 +930,12 @@ static struct buffer_head * ext2_add_entry (struct inode * dir,
 		*err = -ENOENT;
 		return NULL;
 	}
+	if (is_dx(dir)) {
+		bh = dx_add_entry (dir, name, namelen, res_dir, err);
+		if (bh || *err != -EINVAL)
+			return bh;
+		dx_drop (dir, "index full or bad");
+	}
 	bh = ext2_bread (dir, 0, 0, err);
 	if (!bh)
 		return NULL;
@@ -257,6 +947,11 @@ static struct buffer_head * ext2_add_entry (struct inode * dir,
 		if ((char *)de >= sb->s_blocksize + bh->b_data) {
 			brelse (bh);
 			bh = NULL;
+			/* a one-block directory is full: index it? */
+			if (offset == sb->s_blocksize && dir->i_size == offset &&
+			    test_opt (sb, INDEX) && !dx_make_index (dir))
+				return dx_add_entry (dir, name, namelen,
+						     res_dir, err);
 			bh = ext2_bread (dir, offset >> EXT2_BLOCK_SIZE_BITS(sb), 1, err);
 			if (!bh)
 				return NULL;
@@ -616,7 +1311,9 @@ repeat:
 		goto end_rmdir;
 	if (inode->i_dev != dir->i_dev)
 		goto end_rmdir;
-	if (de->inode != inode->i_ino) {
+	/* iget() may have slept while a split moved the entry */
+	if (de->inode != inode->i_ino ||
+	    !ext2_match (len > EXT2_NAME_LEN ? EXT2_NAME_LEN : len, name, de)) {
 		iput(inode);
 		brelse(bh);
 		current->counter = 0;
@@ -636,7 +1333,9 @@ repeat:
 	down(&inode->i_sem);
 	if (!empty_dir (inode))
 		retval = -ENOTEMPTY;
-	else if (de->inode != inode->i_ino)
+	else if (de->inode != inode->i_ino ||
+		 !ext2_match (len > EXT2_NAME_LEN ? EXT2_NAME_LEN : len,
+			      name, de))
 		retval = -ENOENT;
 	else {
 		if (inode->i_count > 1) {
@@ -699,7 +1398,9 @@ repeat:
 		goto end_unlink;
 	if (IS_APPEND(inode) || IS_IMMUTABLE(inode))
 		goto end_unlink;
-	if (de->inode != inode->i_ino) {
+	/* iget() may have slept while a split moved the entry */
+	if (de->inode != inode->i_ino ||
+	    !ext2_match (len > EXT2_NAME_LEN ? EXT2_NAME_LEN : len, name, de)) {
 		iput(inode);
 		brelse(bh);
 		current->counter = 0;
@@ -1013,7 +1714,10 @@ start_up:
 		goto try_again;
 	if (new_de->inode && !new_inode)
 		goto try_again;
-	if (old_de->inode != old_inode->i_ino)
+	/* adding the new name may have split the block holding the old one */
+	if (old_de->inode != old_inode->i_ino ||
+	    !ext2_match (old_len > EXT2_NAME_LEN ? EXT2_NAME_LEN : old_len,
+			 old_name, old_de))
 		goto try_again;
 	/*
 	 * ok, that's it
@@ -239,6 +239,8 @@ static int parse_options (char * options, unsigned long * sb_block,
 		else if (!strcmp (this_char, "grpid") ||
 			 !strcmp (this_char, "bsdgroups"))
 			set_opt (*mount_options, GRPID);
+		else if (!strcmp (this_char, "index"))
+			set_opt (*mount_options, INDEX);
 		else if (!strcmp (this_char, "minixdf"))
 			set_opt (*mount_options, MINIX_DF);
 		else if (!strcmp (this_char, "nocheck")) {
@@ -19,10 +19,13 @@
 #include <linux/fs.h>
 #include <linux/string.h>
 #include <linux/mm.h>
+#include <linux/slab.h>
 
 struct file * first_file;	//当前内核中所有扥file节点均链入到此链表中
 int nr_files = 0;	//first_file链表中节点个数
 
+static kmem_cache_t * filp_cache = NULL;
+
 //将file结构插入到first_file链表头部
 static void insert_file_free(struct file *file)
 {
@@ -56,23 +59,35 @@ static void put_last_free(struct file *file)
 }
 
 //增加内核中struct_file数据结构个数
+/*
+ * File structures come from their own cache, a page's worth at a time.
+ * They are never given back: a file with f_count == 0 simply stays on
+ * the list to be reused.
+ */
 void grow_files(void)
 {
 	struct file * file;
 	int i;
 
-	file = (struct file *) get_free_page(GFP_KERNEL);
-
-	if (!file)
-		return;
-
-	nr_files+=i= PAGE_SIZE/sizeof(struct file);
-
-	if (!first_file)
-		file->f_next = file->f_prev = first_file = file++, i--;
+	if (!filp_cache) {
+		filp_cache = kmem_cache_create("filp", sizeof(struct file),
+			0, SLAB_HWCACHE_ALIGN, NULL);
+		if (!filp_cache)
+			return;
+	}
 
-	for (; i ; i--)
-		insert_file_free(file++);
+	for (i = PAGE_SIZE/sizeof(struct file); i ; i--) {
+		file = (struct file *) kmem_cache_alloc(filp_cache, GFP_KERNEL);
+		if (!file)
+			return;
+		memset(file, 0, sizeof(*file));
+		nr_files++;
+		if (!first_file) {
+			file->f_next = file->f_prev = first_file = file;
+			continue;
+		}
+		insert_file_free(file);
+	}
 }
 
 unsigned long file_table_init(unsigned long start, unsigned long end)
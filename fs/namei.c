@@ -33,6 +33,7 @@
 #include <linux/fcntl.h>
 #include <linux/stat.h>
 #include <linux/mm.h>
+#include <linux/pagemap.h>
 
 #define ACC_MODE(x) ("\000\004\002\006"[(x)&O_ACCMODE])
 
@@ -545,6 +546,7 @@ int open_namei(const char * pathname, int flag, int mode,
 		inode->i_size = 0;	//notify_change()函数内已经修改了i_size，但这里还要再做一次，可见内核开发者的严谨
 		if (inode->i_op && inode->i_op->truncate)
 			inode->i_op->truncate(inode);
+		truncate_inode_pages(inode, 0);
 		inode->i_dirt = 1;
 		put_write_access(inode);
 	}
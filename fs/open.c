@@ -17,6 +17,8 @@
 #include <linux/tty.h>
 #include <linux/time.h>
 #include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/poll.h>
 
 #include <asm/segment.h>
 
@@ -99,6 +101,7 @@ asmlinkage int sys_truncate(const char * path, unsigned int length)
 	inode->i_size = newattrs.ia_size = length;
 	if (inode->i_op && inode->i_op->truncate)
 		inode->i_op->truncate(inode);
+	truncate_inode_pages(inode, length);
 	newattrs.ia_ctime = newattrs.ia_mtime = CURRENT_TIME;
 	newattrs.ia_valid = ATTR_SIZE | ATTR_CTIME | ATTR_MTIME;
 	inode->i_dirt = 1;
@@ -125,6 +128,7 @@ asmlinkage int sys_ftruncate(unsigned int fd, unsigned int length)
 	inode->i_size = newattrs.ia_size = length;
 	if (inode->i_op && inode->i_op->truncate)
 		inode->i_op->truncate(inode);
+	truncate_inode_pages(inode, length);
 	newattrs.ia_ctime = newattrs.ia_mtime = CURRENT_TIME;
 	newattrs.ia_valid = ATTR_SIZE | ATTR_CTIME | ATTR_MTIME;
 	inode->i_dirt = 1;
@@ -492,6 +496,8 @@ int close_fp(struct file *filp)
 		filp->f_count--;
 		return 0;
 	}
+	if (filp->f_ev)
+		ev_file_release(filp);
 	if (filp->f_op && filp->f_op->release)
 		filp->f_op->release(inode,filp);
 	filp->f_count--;
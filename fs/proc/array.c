@@ -449,7 +449,7 @@ static int get_stat(int pid, char * buffer)
 {
 	struct task_struct ** p = get_task(pid);
 	unsigned long sigignore=0, sigcatch=0, bit=1, wchan;
-	unsigned long vsize, eip, esp;
+	unsigned long vsize, eip, esp, it_real = 0, flags;
 	int i,tty_pgrp;
 	char state;
 
@@ -469,6 +469,15 @@ static int get_stat(int pid, char * buffer)
 			vsize += TASK_SIZE - esp;
 	}
 	wchan = get_wchan(*p);
+	/* ITIMER_REAL runs on real_timer: work it out as getitimer() does */
+	save_flags(flags);
+	cli();
+	if ((*p)->real_timer.next) {
+		it_real = (*p)->real_timer.expires - jiffies;
+		if ((long) it_real <= 0)
+			it_real = 1;
+	}
+	restore_flags(flags);
 	for(i=0; i<32; ++i) {
 		switch((unsigned long) (*p)->sigaction[i].sa_handler) {
 		case 1: sigignore |= bit; break;
@@ -500,12 +509,12 @@ static int get_stat(int pid, char * buffer)
 		(*p)->stime,
 		(*p)->cutime,
 		(*p)->cstime,
-		(*p)->counter,  /* this is the kernel priority ---
+		task_counter(*p), /* this is the kernel priority ---
 				   subtract 30 in your user-level program. */
 		(*p)->priority, /* this is the nice value ---
 				   subtract 15 in your user-level program. */
 		(*p)->timeout,
-		(*p)->it_real_value,
+		it_real,
 		(*p)->start_time,
 		vsize,
 		(*p)->mm->rss, /* you might want to shift this left 3 */
@@ -752,6 +761,10 @@ extern int get_irq_list(char *);
 extern int get_dma_list(char *);
 extern int get_cpuinfo(char *);
 extern int get_pci_list(char*);
+extern int get_slabinfo(char *);
+extern int get_buffer_hash_info(char *);
+extern int get_dcache_info(char *);
+extern int get_elevator_info(char *);
 
 static int get_root_array(char * page, int type)
 {
@@ -804,6 +817,17 @@ static int get_root_array(char * page, int type)
 
 		case PROC_IOPORTS:
 			return get_ioport_list(page);
+
+		case PROC_SLABINFO:
+			return get_slabinfo(page);
+
+		case PROC_BUFHASH:
+			return get_buffer_hash_info(page);
+
+		case PROC_DCACHE:
+			return get_dcache_info(page);
+		case PROC_ELEVATOR:
+			return get_elevator_info(page);
 	}
 	return -EBADF;
 }
@@ -53,8 +53,11 @@ extern int raw_get_info(char *, char **, off_t, int);
 extern int arp_get_info(char *, char **, off_t, int);
 extern int rarp_get_info(char *, char **, off_t, int);
 extern int dev_get_info(char *, char **, off_t, int);
+extern int qdisc_get_info(char *, char **, off_t, int);
 extern int rt_get_info(char *, char **, off_t, int);
+extern int rt_cache_get_info(char *, char **, off_t, int);
 extern int snmp_get_info(char *, char **, off_t, int);
+extern int ip_frag_get_info(char *, char **, off_t, int);
 extern int afinet_get_info(char *, char **, off_t, int);
 #if	defined(CONFIG_WAVELAN)
 extern int wavelan_get_info(char *, char **, off_t, int);
@@ -136,6 +139,9 @@ static struct proc_dir_entry net_dir[] = {
 	{ PROC_NET_TCP,		3, "tcp" },
 	{ PROC_NET_UDP,		3, "udp" },
 	{ PROC_NET_SNMP,	4, "snmp" },
+	{ PROC_NET_RTCACHE,	8, "rt_cache" },
+	{ PROC_NET_QDISC,	5, "qdisc" },
+	{ PROC_NET_IPFRAG,	7, "ip_frag" },
 	{ PROC_NET_SOCKSTAT,	8, "sockstat" },
 #ifdef CONFIG_INET_RARP
 	{ PROC_NET_RARP,	4, "rarp"},
@@ -273,9 +279,15 @@ static int proc_readnet(struct inode * inode, struct file * file,
 			case PROC_NET_ROUTE:
 				length = rt_get_info(page,&start,file->f_pos,thistime);
 				break;
+			case PROC_NET_RTCACHE:
+				length = rt_cache_get_info(page,&start,file->f_pos,thistime);
+				break;
 			case PROC_NET_DEV:
 				length = dev_get_info(page,&start,file->f_pos,thistime);
 				break;
+			case PROC_NET_QDISC:
+				length = qdisc_get_info(page,&start,file->f_pos,thistime);
+				break;
 			case PROC_NET_RAW:
 				length = raw_get_info(page,&start,file->f_pos,thistime);
 				break;
@@ -288,6 +300,9 @@ static int proc_readnet(struct inode * inode, struct file * file,
 			case PROC_NET_SNMP:
 				length = snmp_get_info(page, &start, file->f_pos,thistime);
 				break;
+			case PROC_NET_IPFRAG:
+				length = ip_frag_get_info(page, &start, file->f_pos,thistime);
+				break;
 #ifdef CONFIG_IP_MULTICAST
 			case PROC_NET_IGMP:
 				length = ip_mc_procinfo(page, &start, file->f_pos,thistime);
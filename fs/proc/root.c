@@ -80,6 +80,10 @@ static struct proc_dir_entry root_dir[] = {
 #ifdef CONFIG_PROFILE
 	{ PROC_PROFILE,		7, "profile"},
 #endif
+	{ PROC_SLABINFO,	8, "slabinfo" },
+	{ PROC_BUFHASH,		7, "bufhash" },
+	{ PROC_DCACHE,		6, "dcache" },
+	{ PROC_ELEVATOR,	8, "elevator" },
 };
 
 #define NR_ROOT_DIRENTRY ((sizeof (root_dir))/(sizeof (root_dir[0])))
@@ -28,6 +28,8 @@
 #include <linux/errno.h>
 #include <linux/personality.h>
 #include <linux/mm.h>
+#include <linux/malloc.h>
+#include <linux/poll.h>
 
 #include <asm/segment.h>
 #include <asm/system.h>
@@ -392,3 +394,129 @@ asmlinkage int sys_select( unsigned long *buffer )
 	set_fd_set(n, exp, &res_ex);
 	return i;
 }
+
+/*
+ * The poll() events a file has ready, checked (and waited for, if wait
+ * is set) through its select routine. Also used by the event sets.
+ */
+int poll_file(struct file * file, int events, select_table * wait)
+{
+	int mask = 0;
+
+	if ((events & POLLIN) && check(SEL_IN, wait, file))
+		mask |= POLLIN;
+	if ((events & POLLOUT) && check(SEL_OUT, wait, file))
+		mask |= POLLOUT;
+	if ((events & POLLPRI) && check(SEL_EX, wait, file))
+		mask |= POLLPRI;
+	return mask;
+}
+
+/*
+ * One select_table holds a page of wait entries, which is not enough
+ * when every one of NR_OPEN descriptors puts us on a queue or three.
+ * poll() moves on to a fresh table when the current one is nearly full.
+ */
+#define POLL_TABLE_SLACK	8
+#define POLL_TABLE_ENTRIES	(__MAX_SELECT_TABLE_ENTRIES - POLL_TABLE_SLACK)
+
+static int do_poll(unsigned int nfds, struct pollfd * fds,
+	select_table * tables, int ntables)
+{
+	select_table * wait = tables;
+	int count, i;
+
+repeat:
+	current->state = TASK_INTERRUPTIBLE;
+	count = 0;
+	for (i = 0 ; i < nfds ; i++) {
+		struct file * file;
+		int fd = fds[i].fd;
+		int mask;
+
+		if (fd < 0) {
+			fds[i].revents = 0;
+			continue;
+		}
+		if (fd >= NR_OPEN || !(file = current->files->fd[fd]) ||
+		    !file->f_inode) {
+			fds[i].revents = POLLNVAL;
+			count++;
+			wait = NULL;
+			continue;
+		}
+		if (wait && wait->nr >= POLL_TABLE_ENTRIES &&
+		    wait + 1 < tables + ntables)
+			wait++;
+		mask = poll_file(file, fds[i].events, wait);
+		fds[i].revents = mask;
+		if (mask) {
+			count++;
+			wait = NULL;
+		}
+	}
+	wait = NULL;
+	if (!count && current->timeout && !(current->signal & ~current->blocked)) {
+		schedule();
+		goto repeat;
+	}
+	current->state = TASK_RUNNING;
+	return count;
+}
+
+/*
+ * poll(fds, nfds, timeout): timeout is in milliseconds, negative to
+ * wait for ever. We return -EINTR rather than restarting on a signal,
+ * as a restarted call would start the timeout over again.
+ */
+asmlinkage int sys_poll(struct pollfd * ufds, unsigned int nfds, int timeout)
+{
+	struct pollfd * fds;
+	select_table * tables;
+	int ntables, size, i, t, error;
+
+	if (nfds > NR_OPEN)
+		return -EINVAL;
+	size = nfds * sizeof(struct pollfd);
+	error = verify_area(VERIFY_WRITE, ufds, size);
+	if (error)
+		return error;
+	ntables = ROUND_UP(nfds * 3, POLL_TABLE_ENTRIES);
+	if (!ntables)
+		ntables = 1;
+	error = -ENOMEM;
+	fds = (struct pollfd *) kmalloc(size + ntables * sizeof(select_table), GFP_KERNEL);
+	if (!fds)
+		return error;
+	tables = (select_table *) (fds + nfds);
+	for (t = 0 ; t < ntables ; t++) {
+		tables[t].nr = 0;
+		tables[t].entry = (struct select_table_entry *) __get_free_page(GFP_KERNEL);
+		if (!tables[t].entry)
+			goto out;
+	}
+	memcpy_fromfs(fds, ufds, size);
+
+	if (timeout < 0)
+		current->timeout = ~0UL;
+	else if (timeout) {
+		current->timeout = (timeout / 1000) * HZ;
+		current->timeout += ROUND_UP((timeout % 1000) * HZ, 1000);
+		current->timeout += jiffies + 1;
+	} else
+		current->timeout = 0;
+	error = do_poll(nfds, fds, tables, ntables);
+	current->timeout = 0;
+
+	if (!error && (current->signal & ~current->blocked))
+		error = -EINTR;
+	else for (i = 0 ; i < nfds ; i++)
+		put_fs_word(fds[i].revents, &ufds[i].revents);
+out:
+	while (--t >= 0) {
+		free_wait(tables + t);
+		free_page((unsigned long) tables[t].entry);
+	}
+	kfree(fds);
+	return error;
+}
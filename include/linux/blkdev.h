@@ -24,12 +24,43 @@ struct request {
 	struct buffer_head * bh;	//读写缓冲区链表的头指针 注：缓冲区链表中的缓冲区对应的扇区编号是相邻递增的
 	struct buffer_head * bhtail;	//读写缓冲区链表的尾指针
 	struct request * next;	//指向下一个请求
+	unsigned long start_time;	/* jiffies when queued */
+};
+
+/*
+ * Per-queue elevator state. The latencies are the number of jiffies a
+ * request may sit in the queue before newer requests are no longer
+ * allowed to be sorted in front of it: reads get a much shorter one
+ * than writes, as somebody is usually waiting for them.
+ */
+struct elevator {
+	int read_latency;
+	int write_latency;
+	int max_sectors;		/* largest request we build by merging */
+
+	unsigned long nr_requests;	/* requests queued */
+	unsigned long back_merges;
+	unsigned long front_merges;
+	unsigned long coalesced;	/* requests merged into a neighbour */
+	unsigned long expired;		/* insertions held back by a deadline */
+	unsigned long depth_sum;	/* queue depth seen at each insertion */
+	unsigned long max_depth;
+	unsigned long nr_done;		/* requests completed */
+	unsigned long wait_sum;		/* jiffies from queueing to completion */
+	unsigned long max_wait;
+};
+
+struct blkelv_ioctl_arg {
+	int read_latency;
+	int write_latency;
+	int max_sectors;
 };
 
 struct blk_dev_struct {
 	void (*request_fn)(void);	//指向请求处理函数的指针，请求处理函数是写设备驱动程序的重要一环，
 					//设备驱动程序在此函数中通过outb向位于I/O空间中的设备命令寄存器发出命令
 	struct request * current_request;	//指向当前正在处理的请求
+	struct elevator elevator;
 };
 
 struct sec_size {
@@ -49,4 +80,26 @@ extern int * blksize_size[MAX_BLKDEV];
 
 extern int * hardsect_size[MAX_BLKDEV];
 
+extern int blkelv_ioctl(int dev, unsigned int cmd, unsigned long arg);
+extern int get_elevator_info(char * buffer);
+
+/*
+ * Called by the drivers' end_request() when a request is finished,
+ * to account for the time it spent waiting.
+ */
+extern inline void elevator_done(struct request * req)
+{
+	struct elevator * elv;
+	unsigned long wait;
+
+	if ((unsigned) MAJOR(req->dev) >= MAX_BLKDEV)
+		return;
+	elv = &blk_dev[MAJOR(req->dev)].elevator;
+	wait = jiffies - req->start_time;
+	elv->nr_done++;
+	elv->wait_sum += wait;
+	if (wait > elv->max_wait)
+		elv->max_wait = wait;
+}
+
 #endif
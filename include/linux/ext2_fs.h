@@ -199,6 +199,7 @@ struct ext2_group_desc
 #define EXT2_IMMUTABLE_FL		0x00000010 /* Immutable file */
 #define EXT2_APPEND_FL			0x00000020 /* writes to file may only append */
 #define EXT2_NODUMP_FL			0x00000040 /* do not dump file */
+#define EXT2_INDEX_FL			0x00001000 /* hash-indexed directory */
 
 /*
  * ioctl commands
@@ -305,6 +306,7 @@ struct ext2_inode {
 #define EXT2_MOUNT_ERRORS_RO		0x0020	/* Remount fs ro on errors */
 #define EXT2_MOUNT_ERRORS_PANIC		0x0040	/* Panic on errors */
 #define EXT2_MOUNT_MINIX_DF		0x0080	/* Mimics the Minix statfs */
+#define EXT2_MOUNT_INDEX		0x0100	/* Index large directories */
 
 #define clear_opt(o, opt)		o &= ~EXT2_MOUNT_##opt
 #define set_opt(o, opt)			o |= EXT2_MOUNT_##opt
@@ -387,6 +389,52 @@ struct ext2_dir_entry {
 #define EXT2_DIR_REC_LEN(name_len)	(((name_len) + 8 + EXT2_DIR_ROUND) & \
 					 ~EXT2_DIR_ROUND)
 
+/*
+ * Hash-indexed directories (EXT2_INDEX_FL)
+ *
+ * Block 0 holds "." and "..", each with a rec_len of exactly 12, and
+ * then the index root. Index blocks start with a header that is also a
+ * valid, empty directory entry covering the rest of the block, so
+ * kernels that don't know about the index just see a linear directory
+ * with some unused space in it. The leaf blocks are ordinary directory
+ * blocks.
+ *
+ * An older kernel adding a name will find the empty entry in block 0
+ * before any other free space, and writing the name there destroys the
+ * magic number: the index is then ignored and the directory is treated
+ * as linear again.
+ *
+ * Each index entry maps names whose hash is >= hash (the first entry
+ * of a block covers everything below the second) to a block: a leaf if
+ * levels is 0, an index node otherwise. The root has at most one level
+ * of index nodes below it.
+ *
+ * Hashes are 31 bits. The top bit of an index entry's hash marks a
+ * continuation: a leaf full of names that all have the same hash can't
+ * be split, so the overflow goes to a new block whose entry has that
+ * hash with EXT2_DX_CONT set, and lookups go on from one to the next.
+ * A continuation sorts just after the plain entry for its hash.
+ */
+#define EXT2_DX_MAGIC		0x58444e49	/* "INDX" */
+#define EXT2_DX_MAX_LEVELS	1
+#define EXT2_DX_CONT		0x80000000
+
+struct ext2_dx_head {
+	__u32	inode;			/* 0: an empty directory entry */
+	__u16	rec_len;		/* to the end of the block */
+	__u16	name_len;		/* 0 */
+	__u32	magic;
+	__u8	levels;			/* root only, 0 in index nodes */
+	__u8	reserved[3];
+	__u16	limit;			/* entries that fit in the block */
+	__u16	count;			/* entries in use */
+};
+
+struct ext2_dx_entry {
+	__u32	hash;
+	__u32	block;
+};
+
 #ifdef __KERNEL__
 /*
  * Function prototypes
@@ -117,6 +117,8 @@ extern unsigned long name_cache_init(unsigned long start, unsigned long end);
 #define BLKFLSBUF 4705 /* flush buffer cache */
 #define BLKRASET 4706 /* Set read ahead for block device */
 #define BLKRAGET 4707 /* get current read ahead setting */
+#define BLKELVGET 4708 /* get elevator tunables */
+#define BLKELVSET 4709 /* set elevator tunables */
 
 /* These are a few other constants  only used by scsi  devices */
 
@@ -146,6 +148,7 @@ struct buffer_head {
 	unsigned char b_req;		/* 0 if the buffer has been invalidated */	  
 	unsigned char b_list;		/* List that this buffer appears *//* 本缓冲区所出现的LRU链表 [其实是数组lru_list的下标 参见buffer.c insert_into_queues函数]*/ 
 	unsigned char b_retain;         /* Expected number of times this will be used.  Put on freelist when 0 */
+	unsigned char b_async;		/* page cache read: freed when the I/O is done */
 	unsigned long b_flushtime;      /* Time when this (dirty) buffer should be written */	/* 对脏缓冲区进行刷新的时间*/ 
 	unsigned long b_lru_time;       /* Time when this buffer was last used. */
 	struct wait_queue * b_wait;		/* 缓冲区等待解锁任务队列 */ 
@@ -250,6 +253,7 @@ struct inode {
 	struct wait_queue * i_wait;
 	struct file_lock * i_flock;	 /* 文件锁链表 */
 	struct vm_area_struct * i_mmap;	 /* 相关的地址映射 */
+	struct page_info * i_pages;	/* pages in the page cache */
 	struct inode * i_next, * i_prev;	/* 索引节点链表 */
 	struct inode * i_hash_next, * i_hash_prev;	/* 哈希表 */
 	struct inode * i_bound_to, * i_bound_by;
@@ -298,6 +302,11 @@ struct file {
 	struct file_operations * f_op;	//file对象的操作函数集 通过具体的文件系统的i节点来初始化
 	unsigned long f_version;
 	void *private_data;	/* needed for tty driver, and maybe others */
+	unsigned long f_rapos;	/* where the last read() stopped */
+	unsigned long f_raend;	/* end of the last read-ahead window */
+	unsigned long f_ralen;	/* and its size */
+	unsigned long f_ramax;	/* size of the next window, 0 for none */
+	struct ev_item * f_ev;	/* event sets watching this file */
 };
 
 //我觉得struct flock结构和struct file_lock结构不同之处在于
@@ -394,6 +403,8 @@ struct file_operations {
 	int (*revalidate) (dev_t dev);
 };
 
+struct page_info;
+
 struct inode_operations {
 	struct file_operations * default_file_ops;
 	int (*create) (struct inode *,const char *,int,int,struct inode **);
@@ -411,6 +422,7 @@ struct inode_operations {
 	void (*truncate) (struct inode *);
 	int (*permission) (struct inode *, int);
 	int (*smap) (struct inode *,int);	//类似于bamp smap->sector map
+	int (*readpage) (struct inode *, struct page_info *);
 };
 
 struct super_operations {
@@ -0,0 +1,107 @@
+/*
+ * INET		An implementation of the TCP/IP protocol suite for the LINUX
+ *		operating system.  INET is implemented using the  BSD Socket
+ *		interface as the means of communication with the user level.
+ *
+ *		Definitions for the transmit queueing disciplines.
+ *
+ *		Each device hands its outgoing frames to a queueing
+ *		discipline (qdisc), which decides how many may wait and
+ *		in which order they go to the driver. The kinds are
+ *
+ *		pfifo_fast	the default: three priority bands kept in
+ *				dev->buffs[], as we always had, but with
+ *				a limit on the frames queued.
+ *		pfifo		one FIFO with a limit.
+ *		prio		up to QDISC_MAX_BANDS strict priority bands.
+ *		tbf		a FIFO drained by a token bucket.
+ *		sfq		stochastic fair queueing: flows are hashed
+ *				onto queues which are served round robin.
+ *
+ *		SIOCSIFQDISC attaches a new one and SIOCGIFQDISC reads the
+ *		settings and statistics back, both with a struct qdisc_conf.
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ */
+#ifndef _LINUX_IF_QDISC_H
+#define _LINUX_IF_QDISC_H
+
+#include <linux/types.h>
+#include <linux/if.h>
+
+#define QDISC_NAMSIZ	12
+#define QDISC_MAX_BANDS	8
+
+struct qdisc_stats
+{
+	unsigned long	packets;	/* handed to the driver		*/
+	unsigned long	bytes;
+	unsigned long	drops;		/* refused or pushed out	*/
+	unsigned long	overlimits;	/* held back by the shaper	*/
+	unsigned long	requeues;	/* driver was busy		*/
+	unsigned long	qlen;		/* frames queued now		*/
+	unsigned long	backlog;	/* bytes queued now		*/
+};
+
+struct qdisc_conf
+{
+	char		qc_dev[IFNAMSIZ];	/* device name			*/
+	char		qc_kind[QDISC_NAMSIZ];	/* "pfifo_fast", "tbf", ...	*/
+	unsigned long	qc_limit;	/* frames queued at most, 0 default */
+	unsigned long	qc_bands;	/* prio: number of bands	*/
+	unsigned long	qc_rate;	/* tbf: bytes per second	*/
+	unsigned long	qc_burst;	/* tbf: bucket size in bytes	*/
+	unsigned long	qc_quantum;	/* sfq: bytes per flow per round */
+	unsigned long	qc_perturb;	/* sfq: seconds between rehashes */
+	struct qdisc_stats qc_stats;	/* SIOCGIFQDISC only		*/
+};
+
+#ifdef __KERNEL__
+
+#include <linux/skbuff.h>
+
+struct device;
+struct Qdisc;
+
+struct qdisc_ops
+{
+	char		*kind;
+	int		size;		/* private data after the Qdisc	*/
+	int		(*init)(struct Qdisc *q, struct qdisc_conf *qc);
+	int		(*enqueue)(struct sk_buff *skb, struct Qdisc *q);
+	struct sk_buff	*(*dequeue)(struct Qdisc *q);
+	void		(*requeue)(struct sk_buff *skb, struct Qdisc *q);
+	void		(*reset)(struct Qdisc *q);
+	void		(*destroy)(struct Qdisc *q);
+	void		(*dump)(struct Qdisc *q, struct qdisc_conf *qc);
+};
+
+/*
+ *	The qdisc calls are made with interrupts off. Frames on a qdisc
+ *	are kept on sk_buff_head lists, because TCP unlinks frames it no
+ *	longer wants from the device queue without asking.
+ */
+
+struct Qdisc
+{
+	struct qdisc_ops	*ops;
+	struct device		*dev;
+	unsigned long		limit;
+	struct qdisc_stats	stats;
+	unsigned long		data[0];	/* ops->size bytes of private data */
+};
+
+#define QDISC_DEFAULT_LIMIT	100
+
+extern int		qdisc_attach_default(struct device *dev);
+extern void		qdisc_reset(struct device *dev);
+extern void		qdisc_drop(struct sk_buff *skb, struct Qdisc *q);
+extern int		qdisc_ioctl(unsigned int cmd, void *arg);
+extern int		qdisc_get_info(char *buffer, char **start, off_t offset, int length);
+
+#endif /* __KERNEL__ */
+
+#endif	/* _LINUX_IF_QDISC_H */
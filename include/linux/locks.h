@@ -6,6 +6,7 @@
  * lock buffers.
  */
 extern void __wait_on_buffer(struct buffer_head *);
+extern void async_read_done(struct buffer_head *);
 
 extern inline void wait_on_buffer(struct buffer_head * bh)
 {
@@ -24,6 +25,8 @@ extern inline void unlock_buffer(struct buffer_head * bh)
 {
 	bh->b_lock = 0;
 	wake_up(&bh->b_wait);
+	if (bh->b_async)
+		async_read_done(bh);
 }
 
 /*
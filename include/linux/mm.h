@@ -127,15 +127,24 @@ struct vm_operations_struct {
 
 extern mem_map_t * mem_map;
 
-/* planning stage.. */
-#define P_DIRTY		0x0001
-#define P_LOCKED	0x0002
-#define P_UPTODATE	0x0004
-#define P_RESERVED	0x8000
+/*
+ * Every page of memory has a page_info next to its mem_map count. A page
+ * that caches file data is hashed on (inode, offset) and linked on the
+ * inode's i_pages list. The page cache holds one mem_map reference to each
+ * of its pages, and so does any I/O in flight on one: a cached page nobody
+ * else uses has a count of exactly 1.
+ *
+ * The flags are changed from interrupts, so only ever use the bit
+ * operations on them.
+ */
+#define PG_locked	0	/* being read in */
+#define PG_uptodate	1
+#define PG_error	2
+#define PG_referenced	3
+#define PG_submit	4	/* I/O still being queued, see read_page_async() */
 
 struct page_info {
-	unsigned short flags;
-	unsigned short count;
+	unsigned long flags;
 	struct inode * inode;
 	unsigned long offset;
 	struct page_info * next_same_inode;
@@ -144,7 +153,8 @@ struct page_info {
 	struct page_info * prev_hash;
 	struct wait_queue *wait;
 };
-/* end of planning stage */
+
+extern struct page_info * page_info_map;
 
 /*
  * Free area management
@@ -134,6 +134,9 @@ struct device
   /* Pointer to the interface buffers. */
   struct sk_buff_head	  buffs[DEV_NUMBUFFS];
 
+  /* Transmit queueing discipline (see if_qdisc.h), which may use buffs. */
+  struct Qdisc		  *qdisc;
+
   /* Pointers to interface service routines. */
   int			  (*open)(struct device *dev);
   int			  (*stop)(struct device *dev);
@@ -159,7 +162,21 @@ struct device
   int			  (*do_ioctl)(struct device *dev, struct ifreq *ifr, int cmd);
 #define HAVE_SET_CONFIG
   int			  (*set_config)(struct device *dev, struct ifmap *map);
-  
+
+  /*
+   * Polled receive. A driver with a poll routine can mask its receive
+   * interrupt and call netif_rx_schedule(); net_bh() then calls poll
+   * with a budget of frames until the driver says netif_rx_complete().
+   */
+#define HAVE_NETIF_POLL
+  int			  (*poll)(struct device *dev, int budget);
+  int			  weight;	/* frames per poll, 0 for default */
+  struct device		  *poll_next;	/* on the poll list		*/
+  volatile unsigned char  rx_sched;	/* wants polling		*/
+  volatile unsigned char  rx_queued;	/* is on the poll list		*/
+  unsigned long		  rx_polls;	/* poll calls			*/
+  unsigned long		  rx_squeeze;	/* left with the budget used up	*/
+  unsigned long		  rx_backlog_drops; /* dropped by netif_rx()	*/
 };
 
 
@@ -202,6 +219,9 @@ extern void		dev_queue_xmit(struct sk_buff *skb, struct device *dev,
 				       int pri);
 #define HAVE_NETIF_RX 1
 extern void		netif_rx(struct sk_buff *skb);
+extern void		netif_rx_schedule(struct device *dev);
+extern void		netif_rx_complete(struct device *dev);
+extern void		netif_receive_skb(struct sk_buff *skb);
 /* The old interface to netif_rx(). */
 extern int		dev_rint(unsigned char *buff, long len, int flags,
 				 struct device * dev);
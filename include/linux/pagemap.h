@@ -0,0 +1,82 @@
+#ifndef _LINUX_PAGEMAP_H
+#define _LINUX_PAGEMAP_H
+
+/*
+ * The page cache: file data, indexed by (inode, offset).
+ *
+ * read() and mmap() both go through it, so a page of a file is in memory
+ * only once, however it is being accessed. The buffer cache is left for
+ * metadata (and for writes, which still go through it and then update
+ * any cached copy with update_vm_cache()).
+ */
+
+#include <linux/mm.h>
+#include <linux/fs.h>
+
+#include <asm/bitops.h>
+
+extern unsigned long page_cache_size;
+extern struct page_info ** page_hash_table;
+extern unsigned long page_hash_shift;
+
+extern inline unsigned long page_address(struct page_info * page)
+{
+	return PAGE_OFFSET + ((page - page_info_map) << PAGE_SHIFT);
+}
+
+#define page_hashfn(inode,offset) \
+	(((unsigned int) (((unsigned long) (inode) / sizeof(struct inode)) ^ \
+	((offset) >> PAGE_SHIFT)) * 0x9e370001U) >> page_hash_shift)
+#define page_hash(inode,offset) (page_hash_table + page_hashfn(inode,offset))
+
+extern inline struct page_info * find_page(struct inode * inode, unsigned long offset)
+{
+	struct page_info * page;
+
+	for (page = *page_hash(inode, offset); page ; page = page->next_hash) {
+		if (page->inode != inode)
+			continue;
+		if (page->offset != offset)
+			continue;
+		set_bit(PG_referenced, &page->flags);
+		return page;
+	}
+	return NULL;
+}
+
+extern void __wait_on_page(struct page_info *);
+
+extern inline void wait_on_page(struct page_info * page)
+{
+	if (test_bit(PG_locked, &page->flags))
+		__wait_on_page(page);
+}
+
+extern unsigned long page_cache_init(unsigned long start_mem, unsigned long end_mem);
+extern void add_to_page_cache(struct page_info * page, struct inode * inode,
+	unsigned long offset);
+extern void remove_from_page_cache(struct page_info * page);
+extern int shrink_mmap(int priority);
+
+extern int generic_readpage(struct inode * inode, struct page_info * page);
+
+/*
+ * do_generic_file_read() hands each piece of a cached page to an actor,
+ * which takes up to nr bytes at kernel address 'area' and returns how
+ * many it took (fewer stops the read) or an error.
+ */
+typedef int (*read_actor_t)(void * data, const char * area, unsigned long nr);
+
+extern int do_generic_file_read(struct inode * inode, struct file * filp,
+	int count, read_actor_t actor, void * data);
+extern int generic_file_read(struct inode * inode, struct file * filp,
+	char * buf, int count);
+extern void update_vm_cache(struct inode * inode, unsigned long pos,
+	const char * buf, int count);
+extern void truncate_inode_pages(struct inode * inode, unsigned long start);
+extern void invalidate_inode_pages(struct inode * inode);
+
+/* fs/buffer.c */
+extern int read_page_async(struct page_info * page, dev_t dev, int b[], int size);
+
+#endif /* _LINUX_PAGEMAP_H */
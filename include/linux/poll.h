@@ -0,0 +1,43 @@
+#ifndef _LINUX_POLL_H
+#define _LINUX_POLL_H
+
+/*
+ * poll() and event sets.
+ *
+ * poll() is select() with an array of descriptors instead of bitmaps.
+ * An event set is a descriptor that remembers a list of descriptors
+ * and the events wanted on them: the wait queues are joined once, when
+ * a descriptor is added, and a wakeup puts it on the set's ready list.
+ * ev_wait() then only looks at what is on that list, so waiting costs
+ * in proportion to the descriptors that are active, not to those that
+ * are watched.
+ */
+
+struct pollfd {
+	int fd;
+	short events;
+	short revents;
+};
+
+#define POLLIN		0x0001	/* data to read (SEL_IN) */
+#define POLLPRI		0x0002	/* urgent data/exception (SEL_EX) */
+#define POLLOUT		0x0004	/* room to write (SEL_OUT) */
+#define POLLERR		0x0008	/* not reported, the select() interface can't tell */
+#define POLLHUP		0x0010	/* ditto */
+#define POLLNVAL	0x0020	/* fd is not open */
+
+/* ev_ctl() operations */
+#define EV_CTL_ADD	1
+#define EV_CTL_DEL	2
+#define EV_CTL_MOD	3
+
+#ifdef __KERNEL__
+
+#include <linux/fs.h>
+
+extern int poll_file(struct file * file, int events, select_table * wait);
+extern void ev_file_release(struct file * file);
+
+#endif /* __KERNEL__ */
+
+#endif
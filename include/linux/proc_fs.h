@@ -30,7 +30,11 @@ enum root_directory_inos {
 	PROC_KSYMS,
 	PROC_DMA,	
 	PROC_IOPORTS,
-	PROC_PROFILE /* whether enabled or not */
+	PROC_PROFILE, /* whether enabled or not */
+	PROC_SLABINFO,
+	PROC_BUFHASH,
+	PROC_DCACHE,
+	PROC_ELEVATOR
 };
 
 enum pid_directory_inos {
@@ -61,6 +65,9 @@ enum net_directory_inos {
 	PROC_NET_TCP,
 	PROC_NET_UDP,
 	PROC_NET_SNMP,
+	PROC_NET_RTCACHE,
+	PROC_NET_QDISC,
+	PROC_NET_IPFRAG,
 #ifdef CONFIG_INET_RARP
 	PROC_NET_RARP,
 #endif
@@ -65,6 +65,7 @@ extern unsigned long avenrun[];		/* Load averages */
 #include <linux/fs.h>
 #include <linux/signal.h>
 #include <linux/time.h>
+#include <linux/timer.h>
 #include <linux/param.h>
 #include <linux/resource.h>
 #include <linux/vm86.h>
@@ -84,6 +85,8 @@ extern unsigned long avenrun[];		/* Load averages */
 #define NULL ((void *) 0)
 #endif
 
+struct run_array;
+
 #ifdef __KERNEL__
 
 extern void sched_init(void);
@@ -174,6 +177,10 @@ struct task_struct {
 */
 	struct linux_binfmt *binfmt;
 	struct task_struct *next_task, *prev_task;
+	struct task_struct *next_run, *prev_run;	/* run-queue links */
+	struct run_array *run_array;	/* NULL if not on the run-queue */
+	int run_slot;
+	unsigned long sched_epoch;	/* last counter recalculation seen */
 	struct sigaction sigaction[32];
 	//为MS-DOS的仿真程序(或叫系统调用vm86)保存的堆栈指针
 	unsigned long saved_kernel_stack;
@@ -210,6 +217,7 @@ struct task_struct {
 	unsigned long timeout;
 	unsigned long it_real_value, it_prof_value, it_virt_value;
 	unsigned long it_real_incr, it_prof_incr, it_virt_incr;
+	struct timer_list real_timer;
 	long utime, stime, cutime, cstime, start_time;
 /*
 	结构rlimit用于资源管理，定义在linux/include/linux/resource.h中，成员共有两项:
@@ -279,6 +287,7 @@ struct task_struct {
 /* exec domain */&default_exec_domain, \
 /* binfmt */	NULL, \
 /* schedlink */	&init_task,&init_task, \
+/* runqueue */	NULL,NULL,NULL,0,0, \
 /* signals */	{{ 0, },}, \
 /* stack */	0,(unsigned long) &init_kernel_stack, \
 /* ec,brk... */	0,0,0,0,0, \
@@ -286,7 +295,9 @@ struct task_struct {
 /* suppl grps*/ {NOGROUP,}, \
 /* proc links*/ &init_task,&init_task,NULL,NULL,NULL,NULL, \
 /* uid etc */	0,0,0,0,0,0,0,0, \
-/* timeout */	0,0,0,0,0,0,0,0,0,0,0,0, \
+/* timeout */	0,0,0,0,0,0,0, \
+/* timer */	{ NULL, NULL, 0, 0, it_real_fn }, \
+/* utime */	0,0,0,0,0, \
 /* rlimits */   { {LONG_MAX, LONG_MAX}, {LONG_MAX, LONG_MAX},  \
 		  {LONG_MAX, LONG_MAX}, {LONG_MAX, LONG_MAX},  \
 		  {       0, LONG_MAX}, {LONG_MAX, LONG_MAX}, \
@@ -309,8 +320,6 @@ extern struct task_struct *task[NR_TASKS];
 extern struct task_struct *last_task_used_math;
 extern struct task_struct *current;
 extern unsigned long volatile jiffies;
-extern unsigned long itimer_ticks;
-extern unsigned long itimer_next;
 extern struct timeval xtime;
 extern int need_resched;
 
@@ -320,6 +329,8 @@ extern void sleep_on(struct wait_queue ** p);
 extern void interruptible_sleep_on(struct wait_queue ** p);
 extern void wake_up(struct wait_queue ** p);
 extern void wake_up_interruptible(struct wait_queue ** p);
+extern void wake_up_process(struct task_struct * p);
+extern long task_counter(struct task_struct * p);
 
 extern void notify_parent(struct task_struct * tsk);
 extern int send_sig(unsigned long sig,struct task_struct * p,int priv);
@@ -333,6 +344,8 @@ extern void copy_thread(int, unsigned long, unsigned long, struct task_struct *,
 extern void flush_thread(void);
 extern void exit_thread(void);
 
+extern void it_real_fn(unsigned long);
+
 extern int do_execve(char *, char **, char **, struct pt_regs *);
 extern int do_fork(unsigned long, unsigned long, struct pt_regs *);
 asmlinkage int do_signal(unsigned long, struct pt_regs *);
@@ -440,6 +453,7 @@ extern inline void select_wait(struct wait_queue ** wait_address, select_table *
 	entry->wait_address = wait_address;	//entry中wait节点变量所属的等待队列
 	entry->wait.task = current;	//entry中wait节点变量所代表的睡眠进程
 	entry->wait.next = NULL;
+	entry->wait.func = NULL;
 	//将entry->wait睡眠节点加入到wait_address睡眠队列
 	add_wait_queue(wait_address,&entry->wait);
 	//增加p所指向的select_table中有效select_table_entry数
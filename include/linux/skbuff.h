@@ -33,6 +33,7 @@ struct sk_buff_head {
 #if CONFIG_SKB_CHECK
   int				magic_debug_cookie;
 #endif
+  unsigned long			qlen;		/* Buffers on the list */
 };
 
 
@@ -43,11 +44,14 @@ struct sk_buff {
   int				magic_debug_cookie;
 #endif
   struct sk_buff		* volatile link3;
+  struct sk_buff_head		*list;		/* List we are on */
   struct sock			*sk;
   volatile unsigned long	when;	/* used to compute rtt's	*/
   struct timeval		stamp;
   struct device			*dev;
   struct sk_buff		*mem_addr;
+  unsigned char			*data;		/* Packet data, maybe in another buffer */
+  struct sk_buff		*data_skb;	/* Buffer whose memory holds our data */
   union {
 	struct tcphdr	*th;
 	struct ethhdr	*eth;
@@ -62,6 +66,7 @@ struct sk_buff {
   unsigned long			fraglen;
   struct sk_buff		*fraglist;	/* Fragment list */
   unsigned long			truesize;
+  unsigned long			csum;		/* Partial checksum of the payload, where kept */
   unsigned long 		saddr;
   unsigned long 		daddr;
   unsigned long			raddr;		/* next hop addr */
@@ -70,21 +75,26 @@ struct sk_buff {
 				free,
 				arp;
   unsigned char			tries,lock,localroute,pkt_type;
+  unsigned char			sacked;		/* TCP: receiver has it (SACK) */
+  unsigned char			priority;	/* Device queue band (dev_queue_xmit) */
 #define PACKET_HOST		0		/* To us */
 #define PACKET_BROADCAST	1
 #define PACKET_MULTICAST	2
 #define PACKET_OTHERHOST	3		/* Unmatched promiscuous */
   unsigned short		users;		/* User count - see datagram.c (and soon seqpacket.c/stream.c) */
+  unsigned short		dataref;	/* Buffers using this one's memory */
+  unsigned char			pool;		/* Free pool we go back to (skbuff.c) */
   unsigned short		pkt_class;	/* For drivers that need to cache the packet type with the skbuff (new PPP) */
 #ifdef CONFIG_SLAVE_BALANCING
   unsigned short		in_dev_queue;
 #endif  
   unsigned long			padding[0];
-  unsigned char			data[0];
+  unsigned char			head[0];	/* Data area of this buffer */
 };
 
 #define SK_WMEM_MAX	32767
 #define SK_RMEM_MAX	32767
+#define SK_BUF_LIMIT	262144		/* Largest SO_SNDBUF/SO_RCVBUF */
 
 #ifdef CONFIG_SKB_CHECK
 #define SK_FREED_SKB	0x0DE2C0DE
@@ -111,9 +121,13 @@ extern void 			skb_insert(struct sk_buff *old,struct sk_buff *newsk);
 extern void			skb_append(struct sk_buff *old,struct sk_buff *newsk);
 extern void			skb_unlink(struct sk_buff *buf);
 extern struct sk_buff *		skb_peek_copy(struct sk_buff_head *list);
+extern void			skb_init(void);
 extern struct sk_buff *		alloc_skb(unsigned int size, int priority);
 extern void			kfree_skbmem(struct sk_buff *skb, unsigned size);
 extern struct sk_buff *		skb_clone(struct sk_buff *skb, int priority);
+extern int			skb_unshare_data(struct sk_buff *skb, int priority);
+extern void			skb_pool_refill(void);
+extern volatile int		skb_pool_low;
 extern void			skb_device_lock(struct sk_buff *skb);
 extern void			skb_device_unlock(struct sk_buff *skb);
 extern void			dev_kfree_skb(struct sk_buff *skb, int mode);
@@ -130,6 +144,25 @@ static __inline__ struct sk_buff *skb_peek(struct sk_buff_head *list_)
 	return (list->next != list)? list->next : NULL;
 }
 
+/*
+ *	Number of buffers on a list. Like a peek it is only a snapshot
+ *	unless interrupts are off.
+ */
+static __inline__ unsigned long skb_queue_len(struct sk_buff_head *list_)
+{
+	return list_->qlen;
+}
+
+/*
+ *	A clone shares its data with the buffer it was cloned from. Anyone
+ *	who wants to write into the packet (rather than just read it) must
+ *	check this and call skb_unshare_data() first.
+ */
+static __inline__ int skb_data_shared(struct sk_buff *skb)
+{
+	return skb->data_skb->dataref > 1;
+}
+
 #if CONFIG_SKB_CHECK
 extern int 			skb_check(struct sk_buff *skb,int,int, char *);
 #define IS_SKB(skb)		skb_check((skb), 0, __LINE__,__FILE__)
@@ -142,6 +175,7 @@ extern __inline__ void skb_queue_head_init(struct sk_buff_head *list)
 {
 	list->prev = (struct sk_buff *)list;
 	list->next = (struct sk_buff *)list;
+	list->qlen = 0;
 }
 
 /*
@@ -159,6 +193,8 @@ extern __inline__ void skb_queue_head(struct sk_buff_head *list_,struct sk_buff
 	newsk->prev = list;
 	newsk->next->prev = newsk;
 	newsk->prev->next = newsk;
+	newsk->list = list_;
+	list_->qlen++;
 	restore_flags(flags);
 }
 
@@ -179,6 +215,8 @@ extern __inline__ void skb_queue_tail(struct sk_buff_head *list_, struct sk_buff
 
 	newsk->next->prev = newsk;
 	newsk->prev->next = newsk;
+	newsk->list = list_;
+	list_->qlen++;
 
 	restore_flags(flags);
 }
@@ -208,6 +246,8 @@ extern __inline__ struct sk_buff *skb_dequeue(struct sk_buff_head *list_)
 
 	result->next = NULL;
 	result->prev = NULL;
+	list_->qlen--;
+	result->list = NULL;
 
 	restore_flags(flags);
 
@@ -228,6 +268,9 @@ extern __inline__ void skb_insert(struct sk_buff *old, struct sk_buff *newsk)
 	newsk->prev = old->prev;
 	old->prev = newsk;
 	newsk->prev->next = newsk;
+	newsk->list = old->list;
+	if (newsk->list)
+		newsk->list->qlen++;
 
 	restore_flags(flags);
 }
@@ -247,6 +290,9 @@ extern __inline__ void skb_append(struct sk_buff *old, struct sk_buff *newsk)
 	newsk->next = old->next;
 	newsk->next->prev = newsk;
 	old->next = newsk;
+	newsk->list = old->list;
+	if (newsk->list)
+		newsk->list->qlen++;
 
 	restore_flags(flags);
 }
@@ -271,6 +317,9 @@ extern __inline__ void skb_unlink(struct sk_buff *skb)
 		skb->prev->next = skb->next;
 		skb->next = NULL;
 		skb->prev = NULL;
+		if (skb->list)
+			skb->list->qlen--;
+		skb->list = NULL;
 	}
 	restore_flags(flags);
 }
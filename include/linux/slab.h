@@ -0,0 +1,43 @@
+#ifndef _LINUX_SLAB_H
+#define _LINUX_SLAB_H
+
+/*
+ * Object caches.
+ *
+ * A cache hands out objects of one fixed size, carved out of "slabs" of
+ * one or more contiguous pages. Objects that have been freed go back to
+ * their slab and are reused first, so a subsystem that allocates lots of
+ * one kind of structure gets it without the rounding waste of the
+ * power-of-two kmalloc() buckets. kmalloc() itself is built on a set of
+ * general caches.
+ *
+ * The constructor is run once when a slab is created, on every object in
+ * it: objects must be returned to the cache in their constructed state.
+ */
+
+#include <linux/mm.h>
+
+typedef struct kmem_cache_s kmem_cache_t;
+
+/* flags for kmem_cache_create() */
+#define SLAB_HWCACHE_ALIGN	0x0001	/* align objects on L1 cache lines */
+#define SLAB_DMA		0x0002	/* objects must be DMA-able */
+#define SLAB_NO_COLOUR		0x0004	/* don't colour the slabs */
+
+extern kmem_cache_t * kmem_cache_create(const char * name, unsigned long size,
+	unsigned long align, unsigned long flags,
+	void (*ctor)(void *, kmem_cache_t *));
+extern int kmem_cache_destroy(kmem_cache_t * cachep);
+extern int kmem_cache_shrink(kmem_cache_t * cachep);
+extern void * kmem_cache_alloc(kmem_cache_t * cachep, int priority);
+extern void kmem_cache_free(kmem_cache_t * cachep, void * objp);
+
+/* for kmalloc()/kfree() */
+extern kmem_cache_t * kmem_find_cache(void * objp);
+extern unsigned long kmem_cache_size(kmem_cache_t * cachep);
+
+extern unsigned long kmem_cache_init(unsigned long start_mem, unsigned long end_mem);
+extern int kmem_cache_reap(int priority);
+extern int get_slabinfo(char * buffer);
+
+#endif /* _LINUX_SLAB_H */
@@ -105,6 +105,8 @@ struct linger {
 /* TCP options - this way around because someone left a set in the c library includes */
 #define TCP_NODELAY	1
 #define TCP_MAXSEG	2
+#define TCP_CONGESTION	3	/* congestion control algorithm, by name */
+#define TCP_CONGESTION_DEFAULT	4	/* ... and the default for new sockets */
 
 /* The various priorities. */
 #define SOPRI_INTERACTIVE	0
@@ -83,6 +83,11 @@
 #define SIOCGIFMAP	0x8970		/* Get device parameters	*/
 #define SIOCSIFMAP	0x8971		/* Set device parameters	*/
 
+/* Transmit queueing discipline calls */
+
+#define SIOCGIFQDISC	0x8980		/* Get queueing discipline	*/
+#define SIOCSIFQDISC	0x8981		/* Set queueing discipline	*/
+
 /* Device private ioctl calls */
 
 /*
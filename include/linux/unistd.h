@@ -146,6 +146,11 @@
 #define __NR_setfsuid		138
 #define __NR_setfsgid		139
 #define __NR__llseek		140
+#define __NR_poll		141
+#define __NR_ev_create		142
+#define __NR_ev_ctl		143
+#define __NR_ev_wait		144
+#define __NR_sendfile		145
 
 extern int errno;
 
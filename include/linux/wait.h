@@ -12,6 +12,12 @@
 struct wait_queue {
 	struct task_struct * task;	//睡眠的进程
 	struct wait_queue * next;	//指向下一个等待节点
+	/*
+	 * If set, wake_up() calls this instead of waking a task. It
+	 * runs from whatever context did the wake_up() and must not
+	 * touch the queue it is on.
+	 */
+	void (*func)(struct wait_queue *);
 };
 
 struct semaphore {
@@ -29,6 +29,8 @@ static int generate(unsigned long sig, struct task_struct * p)
 	/* always generate signals for traced processes ??? */
 	if (p->flags & PF_PTRACED) {
 		p->signal |= mask;
+		if (p->state == TASK_INTERRUPTIBLE && (p->signal & ~p->blocked))
+			wake_up_process(p);
 		return 1;
 	}
 	/* don't bother with ignored signals (but SIGCHLD is special) */
@@ -39,6 +41,8 @@ static int generate(unsigned long sig, struct task_struct * p)
 	    (sig == SIGCONT || sig == SIGCHLD || sig == SIGWINCH))
 		return 0;
 	p->signal |= mask;
+	if (p->state == TASK_INTERRUPTIBLE && (p->signal & ~p->blocked))
+		wake_up_process(p);
 	return 1;
 }
 
@@ -66,7 +70,7 @@ int send_sig(unsigned long sig,struct task_struct * p,int priv)
 	if ((sig == SIGKILL) || (sig == SIGCONT)) {
 		//如果当前进程处于stop状态，则将其置于TASK_RUNNING状态
 		if (p->state == TASK_STOPPED)
-			p->state = TASK_RUNNING;
+			wake_up_process(p);
 		p->exit_code = 0;
 		//消除SIGSTOP SIGTSTP SIGTTIN SIGTTOU
 		p->signal &= ~( (1<<(SIGSTOP-1)) | (1<<(SIGTSTP-1)) |
@@ -484,6 +488,7 @@ NORET_TYPE void do_exit(long code)
 fake_volatile:
 	//设置当前进程的退出标志
 	current->flags |= PF_EXITING;
+	del_timer(&current->real_timer);
 	//对当前进程的信号量集合做退出处理
 	sem_exit();
 	/* Release all mmaps. */
@@ -238,6 +238,8 @@ int do_fork(unsigned long clone_flags, unsigned long usp, struct pt_regs *regs)
 	p->kernel_stack_page = new_stack;
 	*(unsigned long *) p->kernel_stack_page = STACK_MAGIC;
 	p->state = TASK_UNINTERRUPTIBLE;
+	p->next_run = p->prev_run = NULL;
+	p->run_array = NULL;
 	p->flags &= ~(PF_PTRACED|PF_TRACESYS);
 	//设置进程的pid
 	p->pid = last_pid;
@@ -249,6 +251,8 @@ int do_fork(unsigned long clone_flags, unsigned long usp, struct pt_regs *regs)
 	//此进程的内核间隔定时器
 	p->it_real_value = p->it_virt_value = p->it_prof_value = 0;
 	p->it_real_incr = p->it_virt_incr = p->it_prof_incr = 0;
+	init_timer(&p->real_timer);
+	p->real_timer.data = (unsigned long) p;
 	p->leader = 0;		/* process leadership doesn't inherit */
 	p->tty_old_pgrp = 0;
 	p->utime = p->stime = 0;
@@ -278,7 +282,7 @@ int do_fork(unsigned long clone_flags, unsigned long usp, struct pt_regs *regs)
 	//子进程获取其父进程运行时间的一半
 	p->counter = current->counter >> 1;
 	//可以将子进程置为可运行状态了
-	p->state = TASK_RUNNING;	/* do this last, just in case */
+	wake_up_process(p);		/* do this last, just in case */
 	return p->pid;
 bad_fork_cleanup:
 	task[nr] = NULL;
@@ -64,6 +64,22 @@ static void jiffiestotv(unsigned long jiffies, struct timeval *value)
 	return;
 }
 
+/*
+ * The real-time itimer is an ordinary timer-list entry embedded in the
+ * task structure: it only costs anything when it actually fires.
+ */
+void it_real_fn(unsigned long __data)
+{
+	struct task_struct * p = (struct task_struct *) __data;
+
+	send_sig(SIGALRM, p, 1);
+	if (p->it_real_incr) {
+		p->real_timer.expires = p->it_real_incr;
+		add_timer(&p->real_timer);
+	} else
+		p->it_real_value = 0;
+}
+
 int _getitimer(int which, struct itimerval *value)
 {
 	//用局部变量val和interval分别表示待查询间隔定时器的间隔计数器的当前值和初始值
@@ -72,8 +88,19 @@ int _getitimer(int which, struct itimerval *value)
 	switch (which) {
 	//如果which＝ITIMER_REAL，则查询当前进程的ITIMER_REAL间隔定时器
 	case ITIMER_REAL:
-		val = current->it_real_value;
 		interval = current->it_real_incr;
+		val = 0;
+		if (current->real_timer.next) {
+			unsigned long flags;
+
+			save_flags(flags);
+			cli();
+			val = current->real_timer.expires - jiffies;
+			restore_flags(flags);
+			/* look out for negative/zero itimer.. */
+			if ((long) val <= 0)
+				val = 1;
+		}
 		break;
 	//如果which＝ITIMER_VIRT，则查询当前进程的ITIMER_VIRT间隔定时器
 	case ITIMER_VIRTUAL:
@@ -147,20 +174,13 @@ int _setitimer(int which, struct itimerval *value, struct itimerval *ovalue)
 	switch (which) {
 		//如果which=ITITMER_REAL，表示设置ITIMER_REAL间隔定时器
 		case ITIMER_REAL:
-			//如果j=0，说明不必启动real_timer定时器.这种间隔定时器在启动后，
-			//不管进程是否运行，每个时钟滴答都将其间隔计数器减1。当减到0值时
-			//内核向进程发送SIGALRM信号。
-			if (j) {
-				//j不为0，则需要启动real_timer定时器
-				//要明白这里为什么这么做 需要理解itimer_ticks和itimer_next两个全局变量的意义
-				//参见sched.c文件中do_timer()函数中对itimer_ticks的注释以及schedule()函数中
-				//对itimer_next的注释，便可深刻的理解内核间隔定时器的运行机制
-				j += 1+itimer_ticks;
-				if (j < itimer_next)
-					itimer_next = j;
-			}
+			del_timer(&current->real_timer);
 			current->it_real_value = j;
 			current->it_real_incr = i;
+			if (!j)
+				break;
+			current->real_timer.expires = j;
+			add_timer(&current->real_timer);
 			break;
 		case ITIMER_VIRTUAL:
 			if (j)
@@ -235,6 +235,7 @@ struct symbol_table symbol_table = {
 	/* process management */
 	X(wake_up),
 	X(wake_up_interruptible),
+	X(wake_up_process),
 	X(sleep_on),
 	X(interruptible_sleep_on),
 	X(schedule),
@@ -110,10 +110,164 @@ struct task_struct * task[NR_TASKS] = {&init_task, };
 //kernel_stat定义于linux/include/linux/kernel_stat.h文件中
 struct kernel_stat kstat = { 0 };
 
-//下面这两个全局变量的意义，请参加do_timer()函数和schedule()函数中的相关注释
-//总之，内核机制很经典
-unsigned long itimer_ticks = 0;
-unsigned long itimer_next = ~0;
+/*
+ * The run-queue.
+ *
+ * Runnable tasks live on one of NR_RUNSLOTS circular lists, indexed by
+ * their "counter" when they were queued, and a bitmap tells us which of
+ * the lists are non-empty. Picking the task with the highest counter is
+ * then a bit-scan over a handful of words, independent of the number of
+ * processes in the system.
+ *
+ * Tasks that have used up their timeslice (counter == 0) go to the
+ * "expired" array instead, filed under the counter they will get at the
+ * next recalculation. When the active array runs dry the two are simply
+ * swapped and sched_epoch is bumped: everybody else gets the
+ * "counter = counter/2 + priority" treatment lazily, the next time we
+ * look at them (see sync_counter()).
+ *
+ * The idle task is never on the run-queue. The current process stays
+ * queued while it runs, and is re-filed by schedule().
+ */
+#define NR_RUNSLOTS	128
+#define RUN_WORDS	(NR_RUNSLOTS/32)
+
+struct run_array {
+	int nr_running;
+	unsigned long bitmap[RUN_WORDS];
+	struct task_struct * slot[NR_RUNSLOTS];
+};
+
+static struct run_array run_arrays[2];
+static struct run_array * active = run_arrays+0;
+static struct run_array * expired = run_arrays+1;
+static unsigned long sched_epoch = 0;
+
+/*
+ * Catch up with the counter recalculations done while the task was
+ * not looking. The recurrence converges in a few steps, so there is
+ * no need to iterate more than a bounded number of times.
+ */
+static inline void sync_counter(struct task_struct * p)
+{
+	unsigned long n = sched_epoch - p->sched_epoch;
+
+	if (!n)
+		return;
+	p->sched_epoch = sched_epoch;
+	if (n > 32)
+		n = 32;
+	do {
+		long c = (p->counter >> 1) + p->priority;
+		if (c == p->counter)
+			break;
+		p->counter = c;
+	} while (--n);
+}
+
+static inline int run_slot(long c)
+{
+	if (c >= NR_RUNSLOTS)
+		return NR_RUNSLOTS-1;
+	return c;
+}
+
+/* Must be called with interrupts disabled */
+static inline void add_to_runqueue(struct task_struct * p)
+{
+	struct run_array * array = active;
+	struct task_struct ** head;
+	int nr;
+
+	sync_counter(p);
+	nr = run_slot(p->counter);
+	if (nr <= 0) {
+		array = expired;
+		nr = run_slot(p->priority);
+	}
+	head = array->slot + nr;
+	if (!*head) {
+		p->next_run = p->prev_run = p;
+		*head = p;
+		set_bit(nr, array->bitmap);
+	} else {
+		p->next_run = *head;
+		p->prev_run = (*head)->prev_run;
+		(*head)->prev_run->next_run = p;
+		(*head)->prev_run = p;
+	}
+	p->run_array = array;
+	p->run_slot = nr;
+	array->nr_running++;
+}
+
+/* Must be called with interrupts disabled */
+static inline void del_from_runqueue(struct task_struct * p)
+{
+	struct run_array * array = p->run_array;
+	struct task_struct ** head = array->slot + p->run_slot;
+
+	if (p->next_run == p) {
+		*head = NULL;
+		clear_bit(p->run_slot, array->bitmap);
+	} else {
+		p->next_run->prev_run = p->prev_run;
+		p->prev_run->next_run = p->next_run;
+		if (*head == p)
+			*head = p->next_run;
+	}
+	p->next_run = p->prev_run = NULL;
+	p->run_array = NULL;
+	array->nr_running--;
+}
+
+/* Must be called with interrupts disabled */
+static inline struct task_struct * highest_runnable(struct run_array * array)
+{
+	int i = RUN_WORDS;
+	unsigned long word;
+
+	while (i-- > 0) {
+		if ((word = array->bitmap[i]) != 0) {
+			__asm__("bsrl %1,%0"
+				:"=r" (word)
+				:"r" (word));
+			return array->slot[i*32 + word];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Make a process runnable. This is the only way another process
+ * should be put into TASK_RUNNING: setting the state by hand would
+ * leave it off the run-queue, and it would never be chosen.
+ */
+void wake_up_process(struct task_struct * p)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	p->state = TASK_RUNNING;
+	if (!p->run_array && p != task[0])
+		add_to_runqueue(p);
+	restore_flags(flags);
+}
+
+/*
+ * The counter as the old scheduler would have it: used for /proc.
+ */
+long task_counter(struct task_struct * p)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	sync_counter(p);
+	restore_flags(flags);
+	return p->counter;
+}
 
 /*
  *  'schedule()' is the scheduler function. It's a very simple and nice
@@ -123,80 +277,50 @@ unsigned long itimer_next = ~0;
  *   NOTE!!  Task 0 is the 'idle' task, which gets called when no other
  * tasks can run. It can not be killed, and it cannot sleep. The 'state'
  * information in task[0] is never used.
- *
- * The "confuse_gcc" goto is used only to get better assembly code..
- * Dijkstra probably hates me.
  */
+/*
+ * Wake up a process whose schedule() timeout has run out: the timer
+ * is set up on the sleeper's stack by schedule() itself.
+ */
+static void process_timeout(unsigned long __data)
+{
+	struct task_struct * p = (struct task_struct *) __data;
+
+	p->timeout = 0;
+	wake_up_process(p);
+}
+
 asmlinkage void schedule(void)
 {
-	int c;
-	struct task_struct * p;
+	struct task_struct * prev;
 	struct task_struct * next;
-	unsigned long ticks;
+	unsigned long timeout = 0;
 
-/* check alarm, wake up any interruptible tasks that have got a signal */
+/* check for a pending signal or an expired timeout of the current process */
 
 	if (intr_count) {
 		printk("Aiee: scheduling in interrupt\n");
 		intr_count = 0;
 	}
-	//关中断 因为时钟中断时刻都可能发生 并改变itimer_ticks的值
-	cli();
-	//取真实间隔定时器自上次更新以来所经过的滴答数，然后将其置0
-	ticks = itimer_ticks;
-	itimer_ticks = 0;
-	//itimer_next应该是itimer_ticks的最大值
-	itimer_next = ~0;
-	sti();
 	need_resched = 0;
-	p = &init_task;
-	for (;;) {
-		if ((p = p->next_task) == &init_task)
-			goto confuse_gcc1;
-		//如果ticks不为0，并且当前进程的真实间隔定时器的当前值不为0
-		if (ticks && p->it_real_value) {
-			//如果当前进程的真实间隔定时器的当前值小于等于ticks的值
-			//说明自当前进程的真实间隔定时器值上次更新后，所经历的
-			//时钟滴答数足以使其超时
-			if (p->it_real_value <= ticks) {
-				//向此进程发送SIGALRM信号
-				send_sig(SIGALRM, p, 1);
-				//如果此进程的真实间隔定时器的it_real_incr为0
-				if (!p->it_real_incr) {
-					p->it_real_value = 0;
-					goto end_itimer;
-				}
-				//执行到这里，说明此进程的真实间隔定时器的it_real_incr不为0
-				//因为ticks的值可能很大，所以不能简单地将p->it_real_value -= ticks;
-				//而是先将恢复到一定的值
-				do {
-					p->it_real_value += p->it_real_incr;
-				} while (p->it_real_value <= ticks);
-			}
-			//更新it_real_value的值
-			p->it_real_value -= ticks;
-			//从这里以及结合在do_timer()函数中更新itimer_next的值的方法来看
-			//itimer_next保存了系统中各个进程的真实间隔定时器中当前值最小的
-			//间隔值，意义就是下一次要触发的真实间隔定时器。当在do_timer()函数
-			//中更新itimer_ticks的值后，会比较两者之间的大小，若itimer_ticks的值
-			//大于itimer_next的值，则标记系统发生进程调度，从而在这里触发某个
-			//进程的真实间隔定时器
-			if (p->it_real_value < itimer_next)
-				itimer_next = p->it_real_value;
-		}
-end_itimer:
-		if (p->state != TASK_INTERRUPTIBLE)
-			continue;
-		if (p->signal & ~p->blocked) {
-			p->state = TASK_RUNNING;
-			continue;
-		}
-		if (p->timeout && p->timeout <= jiffies) {
-			p->timeout = 0;
-			p->state = TASK_RUNNING;
+	prev = current;
+	/*
+	 * Signals sent to other processes wake them up in generate(),
+	 * and timeouts are handled by process_timeout(), but a process
+	 * that is just going to sleep may already have one pending.
+	 */
+	if (prev->state == TASK_INTERRUPTIBLE) {
+		if (prev->signal & ~prev->blocked)
+			prev->state = TASK_RUNNING;
+		else if ((timeout = prev->timeout) != 0 && timeout <= jiffies) {
+			prev->timeout = 0;
+			timeout = 0;
+			prev->state = TASK_RUNNING;
 		}
 	}
-confuse_gcc1:
+	/* ~0UL is "sleep until woken": it gets no timer */
+	if (timeout == ~0UL)
+		timeout = 0;
 
 /* this is the scheduler proper: */
 #if 0
@@ -209,23 +333,40 @@ confuse_gcc1:
 		++current->counter;
 	}
 #endif
-	c = -1000;
-	next = p = &init_task;
-	for (;;) {
-		if ((p = p->next_task) == &init_task)
-			goto confuse_gcc2;
-		if (p->state == TASK_RUNNING && p->counter > c)
-			c = p->counter, next = p;
+	cli();
+	/* re-file the previous process under its new counter */
+	if (prev->run_array)
+		del_from_runqueue(prev);
+	if (prev->state == TASK_RUNNING && prev != task[0])
+		add_to_runqueue(prev);
+	next = highest_runnable(active);
+	if (!next && expired->nr_running) {
+		struct run_array * tmp = active;
+		active = expired;
+		expired = tmp;
+		sched_epoch++;
+		next = highest_runnable(active);
 	}
-confuse_gcc2:
-	if (!c) {
-		for_each_task(p)
-			p->counter = (p->counter >> 1) + p->priority;
+	if (!next)
+		next = task[0];
+	else
+		sync_counter(next);
+	sti();
+	if (prev != next) {
+		struct timer_list timer;
+
+		kstat.context_swtch++;
+		if (timeout) {
+			init_timer(&timer);
+			timer.expires = timeout - jiffies - 1;
+			timer.data = (unsigned long) prev;
+			timer.function = process_timeout;
+			add_timer(&timer);
+		}
+		switch_to(next);
+		if (timeout)
+			del_timer(&timer);
 	}
-	if (current == next)
-		return;
-	kstat.context_swtch++;
-	switch_to(next);
 }
 
 asmlinkage int sys_pause(void)
@@ -242,6 +383,9 @@ asmlinkage int sys_pause(void)
  * Note that this doesn't need cli-sti pairs: interrupts may not change
  * the wait-queue structures directly, but only call wake_up() to wake
  * a process. The process itself must remove the queue once it has woken.
+ *
+ * An entry with a func is not a sleeping process but someone (an event
+ * set) who wants to hear about the wakeup: we call it instead.
  */
 void wake_up(struct wait_queue **q)
 {
@@ -251,10 +395,12 @@ void wake_up(struct wait_queue **q)
 	if (!q || !(tmp = *q))
 		return;
 	do {
-		if ((p = tmp->task) != NULL) {
+		if (tmp->func)
+			tmp->func(tmp);
+		else if ((p = tmp->task) != NULL) {
 			if ((p->state == TASK_UNINTERRUPTIBLE) ||
 			    (p->state == TASK_INTERRUPTIBLE)) {
-				p->state = TASK_RUNNING;
+				wake_up_process(p);
 				if (p->counter > current->counter + 3)
 					need_resched = 1;
 			}
@@ -279,9 +425,11 @@ void wake_up_interruptible(struct wait_queue **q)
 	if (!q || !(tmp = *q))
 		return;
 	do {
-		if ((p = tmp->task) != NULL) {
+		if (tmp->func)
+			tmp->func(tmp);
+		else if ((p = tmp->task) != NULL) {
 			if (p->state == TASK_INTERRUPTIBLE) {
-				p->state = TASK_RUNNING;
+				wake_up_process(p);
 				if (p->counter > current->counter + 3)
 					need_resched = 1;
 			}
@@ -340,17 +488,105 @@ void sleep_on(struct wait_queue **p)
 }
 
 /*
- * The head for the timer-list has a "expires" field of MAX_UINT,
- * and the sorting routine counts on this..
+ * The timer-list is kept in a "timer wheel": five arrays of circular
+ * lists, the first with one list per jiffy for the next 256 ticks, the
+ * others with one list per 256, 2^14, 2^20 and 2^26 ticks. A timer is
+ * filed in the finest array that covers its expiry, and whenever the
+ * first array wraps around the next slot of the coarser ones is
+ * redistributed ("cascaded") downwards. That makes both add_timer()
+ * and del_timer() O(1), no matter how many timers are pending.
+ *
+ * The list heads are dummy timers, so a pending timer always has
+ * non-NULL next and prev pointers, as before.
  */
-static struct timer_list timer_head = { &timer_head, &timer_head, ~0, 0, NULL };
+#define TVN_BITS 6
+#define TVR_BITS 8
+#define TVN_SIZE (1 << TVN_BITS)
+#define TVR_SIZE (1 << TVR_BITS)
+#define TVN_MASK (TVN_SIZE - 1)
+#define TVR_MASK (TVR_SIZE - 1)
+
+struct timer_vec {
+	int index;
+	struct timer_list vec[TVN_SIZE];
+};
+
+struct timer_vec_root {
+	int index;
+	struct timer_list vec[TVR_SIZE];
+};
+
+static struct timer_vec tv5 = { 0 };
+static struct timer_vec tv4 = { 0 };
+static struct timer_vec tv3 = { 0 };
+static struct timer_vec tv2 = { 0 };
+static struct timer_vec_root tv1 = { 0 };
+
+static struct timer_vec * const tvecs[] = {
+	(struct timer_vec *)&tv1, &tv2, &tv3, &tv4, &tv5
+};
+
+#define NOOF_TVECS (sizeof(tvecs) / sizeof(tvecs[0]))
+
+/* the jiffy the first array's current slot belongs to */
+static unsigned long timer_jiffies = 0;
+
 #define SLOW_BUT_DEBUGGING_TIMERS 1
 
+static void init_timervecs(void)
+{
+	int i, shift;
+
+	for (i = 0; i < TVR_SIZE; i++)
+		tv1.vec[i].next = tv1.vec[i].prev = tv1.vec + i;
+	for (i = 0; i < TVN_SIZE; i++) {
+		tv2.vec[i].next = tv2.vec[i].prev = tv2.vec + i;
+		tv3.vec[i].next = tv3.vec[i].prev = tv3.vec + i;
+		tv4.vec[i].next = tv4.vec[i].prev = tv4.vec + i;
+		tv5.vec[i].next = tv5.vec[i].prev = tv5.vec + i;
+	}
+	timer_jiffies = jiffies;
+	tv1.index = timer_jiffies & TVR_MASK;
+	/* the coarser arrays point at the next slot to be cascaded */
+	for (i = 1, shift = TVR_BITS; i < NOOF_TVECS; i++, shift += TVN_BITS) {
+		unsigned long idx = timer_jiffies >> shift;
+		if (timer_jiffies & ((1UL << shift) - 1))
+			idx++;
+		tvecs[i]->index = idx & TVN_MASK;
+	}
+}
+
+/* Must be called with interrupts disabled */
+static inline void internal_add_timer(struct timer_list * timer)
+{
+	unsigned long expires = timer->expires;
+	unsigned long idx = expires - timer_jiffies;
+	struct timer_list * head;
+
+	if (idx < TVR_SIZE) {
+		head = tv1.vec + (expires & TVR_MASK);
+	} else if (idx < 1 << (TVR_BITS + TVN_BITS)) {
+		head = tv2.vec + ((expires >> TVR_BITS) & TVN_MASK);
+	} else if (idx < 1 << (TVR_BITS + 2 * TVN_BITS)) {
+		head = tv3.vec + ((expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK);
+	} else if (idx < 1 << (TVR_BITS + 3 * TVN_BITS)) {
+		head = tv4.vec + ((expires >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK);
+	} else if ((signed long) idx < 0) {
+		/* already overdue: run it at the next timer_bh() */
+		head = tv1.vec + tv1.index;
+	} else {
+		head = tv5.vec + ((expires >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK);
+	}
+	timer->next = head;
+	timer->prev = head->prev;
+	head->prev->next = timer;
+	head->prev = timer;
+}
+
 //函 数add_timer()用来将参数timer指针所指向的定时器插入到定时器链表中
 void add_timer(struct timer_list * timer)
 {
 	unsigned long flags;
-	struct timer_list *p;
 
 #if SLOW_BUT_DEBUGGING_TIMERS
 	//新加入的定时器的next和prev域应该为空
@@ -360,22 +596,18 @@ void add_timer(struct timer_list * timer)
 		return;
 	}
 #endif
-	//p指向定时器链表头
-	p = &timer_head;
-	//设置超时时间
-	timer->expires += jiffies;
 	save_flags(flags);
 	//关中断 因为要对系统全局共享链表进行操作了
 	cli();
-	//遍历定时器链表 找到合适的位置将定时器timer插入
-	do {
-		p = p->next;
-	} while (timer->expires > p->expires);
-	//将timer插入定时器链表
-	timer->next = p;
-	timer->prev = p->prev;
-	p->prev = timer;
-	timer->prev->next = timer;
+	/*
+	 * More than LONG_MAX ticks away would look overdue to
+	 * internal_add_timer(): park it as far out in tv5 as goes.
+	 */
+	if ((long) timer->expires < 0)
+		timer->expires = (~0UL >> 1) - (jiffies - timer_jiffies);
+	//设置超时时间
+	timer->expires += jiffies;
+	internal_add_timer(timer);
 	restore_flags(flags);
 }
 
@@ -383,37 +615,18 @@ void add_timer(struct timer_list * timer)
 int del_timer(struct timer_list * timer)
 {
 	unsigned long flags;
-#if SLOW_BUT_DEBUGGING_TIMERS
-	struct timer_list * p;
 
-	//p指向内核定时器链表
-	p = &timer_head;
 	save_flags(flags);
-	//关中断
 	cli();
-	//遍历内核定时器链表 找到指定的要删除的定时器
-	while ((p = p->next) != &timer_head) {
-		//找到了指定的定时器
-		if (p == timer) {
-			//将此定时器从内核定时器链表中移除
-			timer->next->prev = timer->prev;
-			timer->prev->next = timer->next;
-			timer->next = timer->prev = NULL;
-			//恢复标志寄存器的值 这里应该是开中断了 因为对内核定时器链表的操作结束了
+	if (timer->next) {
+#if SLOW_BUT_DEBUGGING_TIMERS
+		if (!timer->prev || timer->next->prev != timer) {
+			printk("del_timer() called from %p with timer not initialized\n",
+				__builtin_return_address(0));
 			restore_flags(flags);
-			timer->expires -= jiffies;
-			return 1;
+			return 0;
 		}
-	}
-	if (timer->next || timer->prev)
-		printk("del_timer() called from %p with timer not initialized\n",
-			__builtin_return_address(0));
-	restore_flags(flags);
-	return 0;
-#else	
-	save_flags(flags);
-	cli();
-	if (timer->next) {
+#endif
 		timer->next->prev = timer->prev;
 		timer->prev->next = timer->next;
 		timer->next = timer->prev = NULL;
@@ -423,7 +636,56 @@ int del_timer(struct timer_list * timer)
 	}
 	restore_flags(flags);
 	return 0;
-#endif
+}
+
+/* Must be called with interrupts disabled */
+static inline void cascade_timers(struct timer_vec * tv)
+{
+	struct timer_list * head = tv->vec + tv->index;
+	struct timer_list * timer = head->next;
+
+	while (timer != head) {
+		struct timer_list * next = timer->next;
+		internal_add_timer(timer);
+		timer = next;
+	}
+	head->next = head->prev = head;
+	tv->index = (tv->index + 1) & TVN_MASK;
+}
+
+/*
+ * Run every timer whose "expires" is before the current jiffy,
+ * cascading the coarser arrays as the first one wraps.
+ */
+static inline void run_timer_list(void)
+{
+	struct timer_list * head;
+	struct timer_list * timer;
+
+	cli();
+	while ((long)(jiffies - timer_jiffies) > 0) {
+		if (!tv1.index) {
+			int n = 1;
+			do {
+				cascade_timers(tvecs[n]);
+			} while (tvecs[n]->index == 1 && ++n < NOOF_TVECS);
+		}
+		head = tv1.vec + tv1.index;
+		while ((timer = head->next) != head) {
+			void (*fn)(unsigned long) = timer->function;
+			unsigned long data = timer->data;
+
+			timer->next->prev = timer->prev;
+			timer->prev->next = timer->next;
+			timer->next = timer->prev = NULL;
+			sti();
+			fn(data);
+			cli();
+		}
+		++timer_jiffies;
+		tv1.index = (tv1.index + 1) & TVR_MASK;
+	}
+	sti();
 }
 
 unsigned long timer_active = 0;
@@ -578,30 +840,9 @@ static void timer_bh(void * unused)
 {
 	unsigned long mask;
 	struct timer_struct *tp;
-	struct timer_list * timer;
 
-	//关中断 因为要操作内核定时器链表了
-	cli();
-	//遍历内核定时器链表 找到已经到时的定时器
-	while ((timer = timer_head.next) != &timer_head && timer->expires < jiffies) {
-		//fn指向此定时器中指定的函数
-		void (*fn)(unsigned long) = timer->function;
-		//data是此定时器执行函数的参数
-		unsigned long data = timer->data;
-		//将此定时器从内核定时器链表中移除
-		timer->next->prev = timer->prev;
-		timer->prev->next = timer->next;
-		timer->next = timer->prev = NULL;
-		//开中断
-		sti();
-		//执行定时器函数
-		fn(data);
-		//关中断 为下一个可能到时的定时器的遍历做准备
-		cli();
-	}
-	//开中断
-	sti();
-	
+	run_timer_list();
+
 	for (mask = 1, tp = timer_table+0 ; mask ; tp++,mask += mask) {
 		if (mask > timer_active)
 			break;
@@ -777,24 +1018,13 @@ static void do_timer(int irq, struct pt_regs * regs)
 		mark_bh(TIMER_BH);
 	}
 	cli();
-/*
-	itimer_ticks是系统中真实间隔定时器的一个“计数器”，记录着自上次某进程的
-	真实间隔定时器的值更新之后所经历的滴答数。实际上，itimer_next全局变量
-	记录着系统中所有进程的所有真实间隔定时器中当前值最小的那一个定时器的
-	值。若更新itimer_ticks的值后，其值大于itimer_next，则说明系统中某个进程
-	的真实间隔定时器到时了，则需要触发此定时器。于是标记系统需要进行进程调度，
-	在进程调度函数中遍历所有的进程并检查器真实间隔定时器。
-*/	
-	itimer_ticks++;
-	if (itimer_ticks > itimer_next)
-		need_resched = 1;
 /*
 	上半部在屏蔽中断的上下文中运行，用于完成关键性的处理动作；而下半部则相对来
 	说并不是非常紧急的，通常还是比较耗时的，因此由系统自行安排运行时机，不在中
 	断服务上下文中执行。这里，关键性的处理动作就是标记
 */
-	if (timer_head.next->expires < jiffies)
-		mark_bh(TIMER_BH);
+	/* the timer wheel has to advance every tick */
+	mark_bh(TIMER_BH);
 	if (tq_timer != &tq_last)
 		//调用mark_bh()函数激活时钟中断的Bottom Half向量TQUEUE_BH
 		mark_bh(TQUEUE_BH);
@@ -915,6 +1145,7 @@ void show_state(void)
 */
 void sched_init(void)
 {
+	init_timervecs();
 	bh_base[TIMER_BH].routine = timer_bh;
 	bh_base[TQUEUE_BH].routine = tqueue_bh;
 	bh_base[IMMEDIATE_BH].routine = immediate_bh;
@@ -20,25 +20,627 @@
 #include <linux/mman.h>
 #include <linux/string.h>
 #include <linux/malloc.h>
+#include <linux/locks.h>
+#include <linux/pagemap.h>
 
 #include <asm/segment.h>
 #include <asm/system.h>
 #include <asm/pgtable.h>
 
+/*
+ * The page cache. See <linux/pagemap.h>.
+ */
+struct page_info * page_info_map = NULL;
+unsigned long page_cache_size = 0;
+struct page_info ** page_hash_table = NULL;
+unsigned long page_hash_shift = 32;
+
+/*
+ * Read-ahead window limits. The window of a file starts out at the
+ * device's read_ahead[] (but at least MIN_READAHEAD) once the reads look
+ * sequential, and doubles every time the reader gets into the pages that
+ * were read ahead for it. MAX_READAHEAD also limits the reads started for
+ * one read() call.
+ */
+#define MIN_READAHEAD	(2*PAGE_SIZE)
+#define MAX_READAHEAD	(32*PAGE_SIZE)
+
+/*
+ * Set up a page_info for every page of memory, and one hash chain for
+ * every two pages (rounded down to a power of two).
+ */
+unsigned long page_cache_init(unsigned long start_mem, unsigned long end_mem)
+{
+	unsigned long size, nr;
+	int bits;
+
+	start_mem = (start_mem + sizeof(long) - 1) & ~(sizeof(long) - 1);
+	page_info_map = (struct page_info *) start_mem;
+	size = MAP_NR(end_mem) * sizeof(struct page_info);
+	memset(page_info_map, 0, size);
+	start_mem += size;
+
+	nr = MAP_NR(end_mem) >> 1;
+	for (bits = 4 ; (2UL << bits) <= nr ; bits++)
+		/* nothing */;
+	page_hash_shift = 32 - bits;
+	page_hash_table = (struct page_info **) start_mem;
+	size = sizeof(struct page_info *) << bits;
+	memset(page_hash_table, 0, size);
+	return start_mem + size;
+}
+
+/*
+ * The caller's reference to the page becomes the cache's. The page is
+ * locked: the caller is expected to start reading it.
+ */
+void add_to_page_cache(struct page_info * page, struct inode * inode,
+	unsigned long offset)
+{
+	struct page_info ** p = page_hash(inode, offset);
+
+	page->flags = 1 << PG_locked;
+	page->inode = inode;
+	page->offset = offset;
+	page->prev_hash = NULL;
+	if ((page->next_hash = *p) != NULL)
+		page->next_hash->prev_hash = page;
+	*p = page;
+	page->prev_same_inode = NULL;
+	if ((page->next_same_inode = inode->i_pages) != NULL)
+		page->next_same_inode->prev_same_inode = page;
+	inode->i_pages = page;
+	page_cache_size++;
+}
+
+/*
+ * Drop the page from the cache, along with the cache's reference. I/O
+ * still in flight holds its own, so this is safe on a locked page too.
+ */
+void remove_from_page_cache(struct page_info * page)
+{
+	struct inode * inode = page->inode;
+
+	if (page->next_hash)
+		page->next_hash->prev_hash = page->prev_hash;
+	if (page->prev_hash)
+		page->prev_hash->next_hash = page->next_hash;
+	else
+		*page_hash(inode, page->offset) = page->next_hash;
+	if (page->next_same_inode)
+		page->next_same_inode->prev_same_inode = page->prev_same_inode;
+	if (page->prev_same_inode)
+		page->prev_same_inode->next_same_inode = page->next_same_inode;
+	else
+		inode->i_pages = page->next_same_inode;
+	page->next_hash = page->prev_hash = NULL;
+	page->next_same_inode = page->prev_same_inode = NULL;
+	page->inode = NULL;
+	page_cache_size--;
+	free_page(page_address(page));
+}
+
+void __wait_on_page(struct page_info * page)
+{
+	struct wait_queue wait = { current, NULL };
+
+	add_wait_queue(&page->wait, &wait);
+repeat:
+	current->state = TASK_UNINTERRUPTIBLE;
+	if (test_bit(PG_locked, &page->flags)) {
+		schedule();
+		goto repeat;
+	}
+	remove_wait_queue(&page->wait, &wait);
+	current->state = TASK_RUNNING;
+}
+
+/*
+ * Free a cached page nobody else is using. A clock hand goes round
+ * memory, and a page that has been looked up since the hand last passed
+ * gets another round.
+ */
+int shrink_mmap(int priority)
+{
+	static unsigned long clock = 0;
+	struct page_info * page;
+	unsigned long limit = MAP_NR(high_memory);
+	int count = (limit << 1) >> priority;
+
+	while (count-- > 0) {
+		if (clock >= limit)
+			clock = 0;
+		page = page_info_map + clock++;
+		if (!page->inode)
+			continue;
+		if (clear_bit(PG_referenced, &page->flags))
+			continue;
+		if (test_bit(PG_locked, &page->flags))
+			continue;
+		if (mem_map[MAP_NR(page_address(page))] != 1)
+			continue;
+		remove_from_page_cache(page);
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * The readpage() of filesystems that have a bmap(). The page must be
+ * locked; it is unlocked when the read is done.
+ */
+int generic_readpage(struct inode * inode, struct page_info * page)
+{
+	unsigned long block;
+	int nr[PAGE_SIZE/512];
+	int i, *p;
+
+	i = PAGE_SIZE >> inode->i_sb->s_blocksize_bits;
+	block = page->offset >> inode->i_sb->s_blocksize_bits;
+	p = nr;
+	do {
+		*p = bmap(inode, block);
+		i--;
+		block++;
+		p++;
+	} while (i > 0);
+	return read_page_async(page, inode->i_dev, nr, inode->i_sb->s_blocksize);
+}
+
+/*
+ * Look the page up, and start reading it in if it isn't cached.
+ * '*page_cache' is a free page to use for that: it is cleared if it
+ * was used, and the caller frees it otherwise.
+ *
+ * Returns the page with a reference held, possibly still locked, or
+ * NULL if there was no memory.
+ */
+static struct page_info * find_or_read_page(struct inode * inode,
+	unsigned long offset, unsigned long * page_cache)
+{
+	struct page_info * page;
+
+	for (;;) {
+		page = find_page(inode, offset);
+		if (page) {
+			mem_map[MAP_NR(page_address(page))]++;
+			return page;
+		}
+		if (*page_cache)
+			break;
+		/* this can sleep, so look again afterwards */
+		*page_cache = __get_free_page(GFP_KERNEL);
+		if (!*page_cache)
+			return NULL;
+	}
+	page = page_info_map + MAP_NR(*page_cache);
+	*page_cache = 0;
+	add_to_page_cache(page, inode, offset);
+	mem_map[MAP_NR(page_address(page))]++;
+	inode->i_op->readpage(inode, page);
+	return page;
+}
+
+/*
+ * Start reading the page at 'offset' unless it's cached already. Nobody
+ * waits for it.
+ */
+static unsigned long try_to_read_ahead(struct inode * inode,
+	unsigned long offset, unsigned long page_cache)
+{
+	struct page_info * page;
+
+	if (offset >= inode->i_size)
+		return page_cache;
+	if (!page_cache) {
+		page_cache = __get_free_page(GFP_KERNEL);
+		if (!page_cache)
+			return 0;
+	}
+	if (find_page(inode, offset))
+		return page_cache;
+	page = page_info_map + MAP_NR(page_cache);
+	add_to_page_cache(page, inode, offset);
+	inode->i_op->readpage(inode, page);
+	return 0;
+}
+
+/*
+ * Wait for a page we hold a reference to. A page that couldn't be read
+ * is thrown out of the cache, so that the next attempt tries again.
+ */
+static int wait_for_page_read(struct inode * inode, struct page_info * page)
+{
+	wait_on_page(page);
+	if (test_bit(PG_uptodate, &page->flags))
+		return 0;
+	if (page->inode == inode)
+		remove_from_page_cache(page);
+	return -EIO;
+}
+
+/*
+ * Read-ahead for a sequential reader that has got to the page at 'ppos'.
+ *
+ * Nothing happens until the reader gets into the last window read ahead
+ * for it; then the next window is started right after it, so that one
+ * window is always in flight while the previous one is being copied out.
+ * Nobody waits for these reads. A window whose first page is gone again
+ * by the time the reader gets there was read too far ahead for the
+ * memory we have: the window is halved. Otherwise it's doubled.
+ */
+static unsigned long generic_file_readahead(struct inode * inode,
+	struct file * filp, unsigned long ppos, unsigned long page_cache)
+{
+	unsigned long start, end;
+
+	if (ppos < filp->f_raend - filp->f_ralen)
+		return page_cache;
+	if (filp->f_ralen && ppos < filp->f_raend && !find_page(inode, ppos)) {
+		filp->f_ramax >>= 1;
+		if (filp->f_ramax < MIN_READAHEAD)
+			filp->f_ramax = MIN_READAHEAD;
+	} else if (filp->f_ralen) {
+		filp->f_ramax <<= 1;
+		if (filp->f_ramax > MAX_READAHEAD)
+			filp->f_ramax = MAX_READAHEAD;
+	}
+	start = filp->f_raend;
+	if (start <= ppos)
+		start = ppos + PAGE_SIZE;
+	end = start + filp->f_ramax;
+	filp->f_raend = end;
+	filp->f_ralen = end - start;
+	while (start < end && start < inode->i_size) {
+		page_cache = try_to_read_ahead(inode, start, page_cache);
+		start += PAGE_SIZE;
+	}
+	return page_cache;
+}
+
+/*
+ * This is the read() of filesystems that use the page cache: hand out
+ * pieces of cached pages, reading in the ones that are missing. While
+ * we have to wait anyway, the reads for the rest of the request are
+ * started too. The actor decides where the data goes: read() copies it
+ * to user space, sendfile() writes it to another file.
+ *
+ * Each open file has its own read-ahead window (see above). A read()
+ * that doesn't start where the last one stopped is taken as random
+ * access: the window is halved, and dropped when it gets too small, so
+ * a random reader doesn't waste memory and disk time on pages it never
+ * uses. Two reads in a row that follow each other turn it back on.
+ */
+int do_generic_file_read(struct inode * inode, struct file * filp,
+	int count, read_actor_t actor, void * data)
+{
+	struct page_info * page;
+	unsigned long pos, ppos, offset, nr, ahead, end, page_cache = 0;
+	int read = 0, error = 0, copied;
+
+	if (count <= 0)
+		return 0;
+	pos = filp->f_pos;
+	if (filp->f_ramax > MAX_READAHEAD)
+		filp->f_ramax = MAX_READAHEAD;
+	if (!filp->f_reada || pos != filp->f_rapos) {
+		filp->f_ramax >>= 1;
+		if (filp->f_ramax < MIN_READAHEAD)
+			filp->f_ramax = 0;
+		filp->f_raend = filp->f_ralen = 0;
+	} else if (!filp->f_ramax) {
+		filp->f_ramax = read_ahead[MAJOR(inode->i_dev)] << 9;
+		if (filp->f_ramax < MIN_READAHEAD)
+			filp->f_ramax = MIN_READAHEAD;
+		if (filp->f_ramax > MAX_READAHEAD)
+			filp->f_ramax = MAX_READAHEAD;
+		filp->f_raend = filp->f_ralen = 0;
+	}
+	while (count > 0 && pos < inode->i_size) {
+		offset = pos & ~PAGE_MASK;
+		nr = PAGE_SIZE - offset;
+		if (nr > count)
+			nr = count;
+		if (nr > inode->i_size - pos)
+			nr = inode->i_size - pos;
+		ppos = pos & PAGE_MASK;
+		if (filp->f_ramax)
+			page_cache = generic_file_readahead(inode, filp, ppos, page_cache);
+		page = find_or_read_page(inode, ppos, &page_cache);
+		if (!page) {
+			error = -ENOMEM;
+			break;
+		}
+		if (test_bit(PG_locked, &page->flags)) {
+			end = pos + count;
+			if (end > ppos + MAX_READAHEAD)
+				end = ppos + MAX_READAHEAD;
+			ahead = ppos;
+			while ((ahead += PAGE_SIZE) < end)
+				page_cache = try_to_read_ahead(inode, ahead, page_cache);
+		}
+		error = wait_for_page_read(inode, page);
+		if (error) {
+			free_page(page_address(page));
+			break;
+		}
+		copied = actor(data, (char *) (page_address(page) + offset), nr);
+		free_page(page_address(page));
+		if (copied <= 0) {
+			error = copied;
+			break;
+		}
+		pos += copied;
+		read += copied;
+		count -= copied;
+		if (copied < nr)
+			break;
+	}
+	if (page_cache)
+		free_page(page_cache);
+	filp->f_pos = pos;
+	filp->f_rapos = pos;
+	filp->f_reada = 1;
+	if (!IS_RDONLY(inode)) {
+		inode->i_atime = CURRENT_TIME;
+		inode->i_dirt = 1;
+	}
+	return read ? read : error;
+}
+
+static int file_read_actor(void * data, const char * area, unsigned long nr)
+{
+	char ** buf = (char **) data;
+
+	memcpy_tofs(*buf, area, nr);
+	*buf += nr;
+	return nr;
+}
+
+int generic_file_read(struct inode * inode, struct file * filp,
+	char * buf, int count)
+{
+	return do_generic_file_read(inode, filp, count, file_read_actor, &buf);
+}
+
+/*
+ * sendfile(): copy from one file to another without going through user
+ * space. The data is handed to the output file's write() as a kernel
+ * address, so for a TCP socket the one copy there is from the cached
+ * page straight into the segment, with the checksum done on the way.
+ * Any other output file works the same way, just not as cheaply.
+ */
+static int file_send_actor(void * data, const char * area, unsigned long nr)
+{
+	struct file * file = (struct file *) data;
+	unsigned long old_fs;
+	int written;
+
+	old_fs = get_fs();
+	set_fs(get_ds());
+	written = file->f_op->write(file->f_inode, file, (char *) area, nr);
+	set_fs(old_fs);
+	return written;
+}
+
+/*
+ * Input files that aren't in the page cache (block devices, /proc,
+ * filesystems without readpage()) are read into a page of our own
+ * first. What the output didn't take is given back to the input by
+ * moving f_pos back, so the input has to be seekable: sys_sendfile()
+ * turns away pipes, sockets and ttys.
+ */
+static int file_send_bounce(struct inode * inode, struct file * in,
+	struct file * out, unsigned int count)
+{
+	unsigned long page, old_fs;
+	int n, written, sent = 0, error = 0;
+
+	page = __get_free_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+	while (count > 0) {
+		n = count > PAGE_SIZE ? PAGE_SIZE : count;
+		old_fs = get_fs();
+		set_fs(get_ds());
+		n = in->f_op->read(inode, in, (char *) page, n);
+		set_fs(old_fs);
+		if (n <= 0) {
+			error = n;
+			break;
+		}
+		written = file_send_actor(out, (char *) page, n);
+		if (written > 0) {
+			sent += written;
+			count -= written;
+		} else
+			error = written;
+		if (written < n) {
+			in->f_pos -= n - (written > 0 ? written : 0);
+			break;
+		}
+	}
+	free_page(page);
+	return sent ? sent : error;
+}
+
+/*
+ * With 'offset' the input is read from *offset, which is moved on by what
+ * was sent, and the file's own position is left alone. Without it the
+ * file position is used and moved on, as read() would.
+ */
+asmlinkage int sys_sendfile(int out_fd, int in_fd, off_t * offset, unsigned int count)
+{
+	struct file * in_file, * out_file;
+	struct inode * in_inode, * out_inode;
+	off_t old_pos = 0;
+	int error;
+
+	if (in_fd < 0 || in_fd >= NR_OPEN || !(in_file = current->files->fd[in_fd]) ||
+	    !(in_inode = in_file->f_inode))
+		return -EBADF;
+	if (!(in_file->f_mode & 1))
+		return -EBADF;
+	if (!in_file->f_op || !in_file->f_op->read)
+		return -EINVAL;
+	/* unsent data is given back by seeking: see file_send_bounce() */
+	if (!S_ISREG(in_inode->i_mode) && !S_ISBLK(in_inode->i_mode))
+		return -EINVAL;
+	if (out_fd < 0 || out_fd >= NR_OPEN || !(out_file = current->files->fd[out_fd]) ||
+	    !(out_inode = out_file->f_inode))
+		return -EBADF;
+	if (!(out_file->f_mode & 2))
+		return -EBADF;
+	if (!out_file->f_op || !out_file->f_op->write)
+		return -EINVAL;
+	if (offset) {
+		error = verify_area(VERIFY_WRITE, offset, sizeof(off_t));
+		if (error)
+			return error;
+	}
+	if (!count)
+		return 0;
+	if (offset) {
+		old_pos = in_file->f_pos;
+		in_file->f_pos = get_fs_long((unsigned long *) offset);
+		if (in_file->f_pos < 0) {
+			in_file->f_pos = old_pos;
+			return -EINVAL;
+		}
+	}
+	/*
+	 * Look at the inode, not f_op->read: filesystems wrap
+	 * generic_file_read() in their own read routine.
+	 */
+	if (S_ISREG(in_inode->i_mode) && in_inode->i_op && in_inode->i_op->readpage)
+		error = do_generic_file_read(in_inode, in_file, count,
+			file_send_actor, out_file);
+	else
+		error = file_send_bounce(in_inode, in_file, out_file, count);
+	if (offset) {
+		put_fs_long(in_file->f_pos, (unsigned long *) offset);
+		in_file->f_pos = old_pos;
+	}
+	/*
+	 * As for write(): data written to the file clears setuid/setgid.
+	 */
+	if (error > 0 && !suser() && (out_inode->i_mode & (S_ISUID | S_ISGID))) {
+		struct iattr newattrs;
+		newattrs.ia_mode = out_inode->i_mode & ~(S_ISUID | S_ISGID);
+		newattrs.ia_valid = ATTR_MODE;
+		notify_change(out_inode, &newattrs);
+	}
+	return error;
+}
+
+/*
+ * Writes still go through the buffer cache: this brings any cached
+ * copy of the data up to date. 'buf' is a kernel address.
+ */
+void update_vm_cache(struct inode * inode, unsigned long pos,
+	const char * buf, int count)
+{
+	struct page_info * page;
+	unsigned long offset, len;
+
+	while (count > 0) {
+		offset = pos & ~PAGE_MASK;
+		len = PAGE_SIZE - offset;
+		if (len > count)
+			len = count;
+		page = find_page(inode, pos & PAGE_MASK);
+		if (page) {
+			mem_map[MAP_NR(page_address(page))]++;
+			wait_on_page(page);
+			if (test_bit(PG_uptodate, &page->flags))
+				memcpy((void *) (page_address(page) + offset), buf, len);
+			free_page(page_address(page));
+		}
+		buf += len;
+		pos += len;
+		count -= len;
+	}
+}
+
+/*
+ * The file has been cut down to 'start' bytes: drop the pages past the
+ * end, and clear the tail of the last one.
+ */
+void truncate_inode_pages(struct inode * inode, unsigned long start)
+{
+	struct page_info * page, * next;
+	unsigned long offset;
+
+	for (page = inode->i_pages ; page ; page = next) {
+		next = page->next_same_inode;
+		if (page->offset >= start) {
+			remove_from_page_cache(page);
+			continue;
+		}
+		offset = start - page->offset;
+		if (offset >= PAGE_SIZE)
+			continue;
+		if (test_bit(PG_locked, &page->flags)) {
+			remove_from_page_cache(page);
+			continue;
+		}
+		memset((void *) (page_address(page) + offset), 0, PAGE_SIZE - offset);
+	}
+}
+
+/*
+ * Throw out all the pages of an inode that is going away.
+ */
+void invalidate_inode_pages(struct inode * inode)
+{
+	while (inode->i_pages)
+		remove_from_page_cache(inode->i_pages);
+}
+
 /*
  * Shared mappings implemented 30.11.1994. It's not fully working yet,
  * though.
  */
 
+/*
+ * Pages of filesystems with a readpage() come from the page cache. A
+ * page that is only read is mapped straight out of the cache (with
+ * copy-on-write, as the count is > 1), otherwise it gets a copy.
+ */
 static unsigned long filemap_nopage(struct vm_area_struct * area, unsigned long address,
 	unsigned long page, int no_share)
 {
 	struct inode * inode = area->vm_inode;
+	struct page_info * cached;
+	unsigned long offset, page_cache = 0;
 	unsigned int block;
 	int nr[8];	//4K？
 	int i, *p;
 
 	address &= PAGE_MASK;
+	offset = address - area->vm_start + area->vm_offset;
+	if (inode->i_op->readpage && !(offset & ~PAGE_MASK)) {
+		/* past the end of the file, or no memory/IO error: zeroes */
+		if (offset >= inode->i_size)
+			return page;
+		cached = find_or_read_page(inode, offset, &page_cache);
+		if (page_cache)
+			free_page(page_cache);
+		if (!cached)
+			return page;
+		if (wait_for_page_read(inode, cached)) {
+			free_page(page_address(cached));
+			return page;
+		}
+		if (no_share) {
+			memcpy((void *) page, (void *) page_address(cached), PAGE_SIZE);
+			free_page(page_address(cached));
+			return page;
+		}
+		/* our reference to the cached page becomes the mapping's */
+		free_page(page);
+		return page_address(cached);
+	}
 	block = address - area->vm_start + area->vm_offset;	//获取address地址处对应的文件中的块地址
 	block >>= inode->i_sb->s_blocksize_bits;	//将block转化为块数
 	i = PAGE_SIZE >> inode->i_sb->s_blocksize_bits;
@@ -0,0 +1,663 @@
+/*
+ *  linux/mm/slab.c
+ *
+ *  Object caches, and kmalloc() on top of them.
+ *
+ *  Replaces the power-of-two block allocator in the old mm/kmalloc.c,
+ *  written by R.E. Wolff and Alex Bligh.
+ */
+
+/*
+ * A cache manages objects of a single size. The objects live in "slabs":
+ * runs of 1<<order contiguous pages, each holding c_num objects, a small
+ * header and an array of free-list indices ("bufctls"). For small objects
+ * the header is at the start of the slab itself, for larger ones it is
+ * kmalloc()ed separately so that it doesn't eat into the object space.
+ *
+ * Every cache keeps its slabs on three lists - full, partial and free -
+ * and always allocates from a partially used slab first, so that memory
+ * gets packed and completely free slabs can be handed back. We only keep
+ * one free slab around per cache: further empty slabs are returned to the
+ * page allocator straight away.
+ *
+ * Slabs are "coloured": the first object of successive slabs is offset by
+ * a different multiple of the L1 line size, using up the space that is
+ * left over at the end of the slab anyway. That way objects at the same
+ * index in different slabs don't all compete for the same cache lines.
+ *
+ * slab_map[] has an entry for every physical page that points back to the
+ * slab using it, so freeing an object never has to search for anything.
+ *
+ * Much as in the old kmalloc(), everything that touches the lists runs
+ * with interrupts disabled, and the routines restore the interrupt state
+ * so that they can be called with interrupts off. The statistics are not
+ * protected: they are only there to be reported in /proc/slabinfo.
+ */
+
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/errno.h>
+#include <linux/malloc.h>
+#include <linux/slab.h>
+
+#include <asm/system.h>
+
+#define GFP_LEVEL_MASK 0xf
+
+/* L1 cache line size of the i486 and Pentium */
+#define SLAB_L1_BYTES	32
+
+/* biggest slab we will ask the page allocator for */
+#define SLAB_MAX_ORDER	5
+
+/*
+ * Caches of objects smaller than this get slabs of at most
+ * 1<<SLAB_SMALL_ORDER pages: large contiguous areas are hard
+ * to come by, and small objects pack well enough anyway.
+ */
+#define SLAB_SMALL_ORDER	2
+
+/* objects of at least this size have their slab header off-slab */
+#define SLAB_OFF_SLAB_SIZE	(PAGE_SIZE >> 3)
+
+/* private cache flags */
+#define SLAB_OFF_SLAB	0x8000
+
+#define SLAB_MAGIC	0x51ab51ab
+#define SLAB_FREED	0xdead51ab
+
+typedef unsigned short kmem_bufctl_t;
+
+#define BUFCTL_END	0xffff		/* end of the free list */
+#define BUFCTL_USED	0xfffe		/* object is allocated */
+
+struct kmem_slab {
+	struct kmem_slab * s_next, * s_prev;
+	kmem_cache_t * s_cache;
+	unsigned long s_magic;
+	unsigned long s_pages;		/* start of the slab's pages */
+	char * s_mem;			/* first object */
+	unsigned int s_inuse;		/* number of allocated objects */
+	unsigned int s_free;		/* index of the first free object */
+};
+
+/* the bufctl array follows the header */
+#define slab_bufctl(slabp)	((kmem_bufctl_t *) ((slabp)+1))
+
+struct kmem_cache_s {
+	struct kmem_slab * c_full;
+	struct kmem_slab * c_partial;
+	struct kmem_slab * c_free;
+	unsigned long c_size;		/* object size, aligned */
+	unsigned long c_objsize;	/* object size as asked for */
+	unsigned long c_flags;
+	unsigned int c_num;		/* objects per slab */
+	unsigned int c_gfporder;	/* 1<<c_gfporder pages per slab */
+	unsigned int c_hdrsize;		/* header + bufctls */
+	unsigned int c_colour;		/* number of different colours */
+	unsigned int c_colour_off;	/* colour step */
+	unsigned int c_colour_next;
+	void (*c_ctor)(void *, kmem_cache_t *);
+	const char * c_name;
+	kmem_cache_t * c_nextp;		/* all caches are on one chain */
+/* statistics */
+	unsigned long c_active;		/* objects allocated right now */
+	unsigned long c_high;		/* most objects ever allocated */
+	unsigned long c_slabs;		/* slabs we have */
+	unsigned long c_grown;		/* slabs ever created */
+	unsigned long c_reaped;		/* slabs ever given back */
+	unsigned long c_failed;		/* failed attempts to grow */
+};
+
+static struct kmem_slab ** slab_map = NULL;
+static unsigned long slab_map_size = 0;
+
+/* the cache of cache descriptors, and the head of the cache chain */
+static kmem_cache_t cache_cache;
+
+static void kmem_slab_destroy(kmem_cache_t * cachep, struct kmem_slab * slabp);
+
+static inline struct kmem_slab ** slab_list(kmem_cache_t * cachep, struct kmem_slab * slabp)
+{
+	if (!slabp->s_inuse)
+		return &cachep->c_free;
+	if (slabp->s_inuse == cachep->c_num)
+		return &cachep->c_full;
+	return &cachep->c_partial;
+}
+
+static inline void slab_link(struct kmem_slab ** list, struct kmem_slab * slabp)
+{
+	slabp->s_prev = NULL;
+	if ((slabp->s_next = *list) != NULL)
+		slabp->s_next->s_prev = slabp;
+	*list = slabp;
+}
+
+static inline void slab_unlink(struct kmem_slab ** list, struct kmem_slab * slabp)
+{
+	if (slabp->s_next)
+		slabp->s_next->s_prev = slabp->s_prev;
+	if (slabp->s_prev)
+		slabp->s_prev->s_next = slabp->s_next;
+	else
+		*list = slabp->s_next;
+	slabp->s_next = slabp->s_prev = NULL;
+}
+
+/*
+ * How many objects fit into a slab of the given order, and how
+ * much space is left over for colouring?
+ */
+static unsigned int cache_estimate(kmem_cache_t * cachep, unsigned int order,
+	unsigned long align, unsigned long * left)
+{
+	unsigned long total = PAGE_SIZE << order;
+	unsigned long base = 0, extra = 0, hdr;
+	unsigned int num;
+
+	if (!(cachep->c_flags & SLAB_OFF_SLAB)) {
+		base = sizeof(struct kmem_slab);
+		extra = sizeof(kmem_bufctl_t);
+	}
+	num = (total - base) / (cachep->c_size + extra);
+	if (num >= BUFCTL_USED)
+		num = BUFCTL_USED - 1;
+	for (;;) {
+		hdr = base + num * extra;
+		if (base)
+			hdr = (hdr + align - 1) & ~(align - 1);
+		if (!num || hdr + num * cachep->c_size <= total)
+			break;
+		num--;
+	}
+	if (cachep->c_flags & SLAB_OFF_SLAB)
+		hdr = sizeof(struct kmem_slab) + num * sizeof(kmem_bufctl_t);
+	cachep->c_hdrsize = hdr;
+	*left = total - (base ? hdr : 0) - num * cachep->c_size;
+	return num;
+}
+
+/*
+ * Fill in a cache descriptor. This doesn't allocate anything, so it can
+ * be used for the statically allocated caches before mem_init().
+ */
+static int kmem_cache_setup(kmem_cache_t * cachep, const char * name,
+	unsigned long size, unsigned long align, unsigned long flags,
+	void (*ctor)(void *, kmem_cache_t *))
+{
+	unsigned long left = 0, flags2;
+	unsigned int order, num = 0;
+
+	memset(cachep, 0, sizeof(*cachep));
+	if (align < sizeof(long))
+		align = sizeof(long);
+	if ((flags & SLAB_HWCACHE_ALIGN) && align < SLAB_L1_BYTES)
+		align = SLAB_L1_BYTES;
+	cachep->c_name = name;
+	cachep->c_objsize = size;
+	cachep->c_size = (size + align - 1) & ~(align - 1);
+	cachep->c_flags = flags;
+	cachep->c_ctor = ctor;
+	if (cachep->c_size >= SLAB_OFF_SLAB_SIZE)
+		cachep->c_flags |= SLAB_OFF_SLAB;
+
+	/* find the smallest slab that doesn't waste more than 1/8 */
+	for (order = 0; order <= SLAB_MAX_ORDER; order++) {
+		num = cache_estimate(cachep, order, align, &left);
+		if (!num)
+			continue;
+		if (left * 8 <= (PAGE_SIZE << order))
+			break;
+		if (order >= SLAB_SMALL_ORDER && cachep->c_size < PAGE_SIZE)
+			break;
+	}
+	if (!num) {
+		printk("kmem_cache_create: %s objects of %lu bytes are too big\n",
+			name, size);
+		return 0;
+	}
+	if (order > SLAB_MAX_ORDER)
+		num = cache_estimate(cachep, --order, align, &left);
+	cachep->c_num = num;
+	cachep->c_gfporder = order;
+
+	cachep->c_colour_off = align > SLAB_L1_BYTES ? align : SLAB_L1_BYTES;
+	cachep->c_colour = 1;
+	if (!(flags & SLAB_NO_COLOUR))
+		cachep->c_colour += left / cachep->c_colour_off;
+
+	save_flags(flags2);
+	cli();
+	cachep->c_nextp = cache_cache.c_nextp;
+	cache_cache.c_nextp = cachep;
+	restore_flags(flags2);
+	return 1;
+}
+
+/*
+ * Get a new slab for the cache: allocate the pages, set up the free
+ * list and run the constructor on every object.
+ */
+static int kmem_cache_grow(kmem_cache_t * cachep, int priority)
+{
+	unsigned long flags, pages, offset;
+	struct kmem_slab * slabp;
+	kmem_bufctl_t * bufctl;
+	unsigned int i;
+	char * objp;
+
+	/* This can be done with ints on: it's private to this invocation */
+	if (cachep->c_flags & SLAB_DMA)
+		pages = __get_dma_pages(priority & GFP_LEVEL_MASK, cachep->c_gfporder);
+	else
+		pages = __get_free_pages(priority & GFP_LEVEL_MASK, cachep->c_gfporder);
+	if (!pages) {
+		cachep->c_failed++;
+		return 0;
+	}
+
+	save_flags(flags);
+	cli();
+	offset = cachep->c_colour_next * cachep->c_colour_off;
+	if (++cachep->c_colour_next >= cachep->c_colour)
+		cachep->c_colour_next = 0;
+	restore_flags(flags);
+
+	if (cachep->c_flags & SLAB_OFF_SLAB) {
+		slabp = (struct kmem_slab *) kmalloc(cachep->c_hdrsize, priority);
+		if (!slabp) {
+			free_pages(pages, cachep->c_gfporder);
+			cachep->c_failed++;
+			return 0;
+		}
+		objp = (char *) pages + offset;
+	} else {
+		slabp = (struct kmem_slab *) pages;
+		objp = (char *) pages + cachep->c_hdrsize + offset;
+	}
+	slabp->s_cache = cachep;
+	slabp->s_magic = SLAB_MAGIC;
+	slabp->s_pages = pages;
+	slabp->s_mem = objp;
+	slabp->s_inuse = 0;
+	slabp->s_free = 0;
+	bufctl = slab_bufctl(slabp);
+	for (i = 0; i < cachep->c_num; i++) {
+		bufctl[i] = i+1;
+		if (cachep->c_ctor)
+			cachep->c_ctor(objp, cachep);
+		objp += cachep->c_size;
+	}
+	bufctl[cachep->c_num-1] = BUFCTL_END;
+
+	for (i = 0; i < (1 << cachep->c_gfporder); i++)
+		slab_map[MAP_NR(pages) + i] = slabp;
+
+	cli();
+	slab_link(&cachep->c_free, slabp);
+	cachep->c_slabs++;
+	cachep->c_grown++;
+	restore_flags(flags);
+	return 1;
+}
+
+/* Must be called with interrupts disabled, on an unlinked slab */
+static void kmem_slab_destroy(kmem_cache_t * cachep, struct kmem_slab * slabp)
+{
+	unsigned long pages = slabp->s_pages;
+	int i;
+
+	for (i = 0; i < (1 << cachep->c_gfporder); i++)
+		slab_map[MAP_NR(pages) + i] = NULL;
+	slabp->s_magic = SLAB_FREED;
+	if (cachep->c_flags & SLAB_OFF_SLAB)
+		kfree_s(slabp, cachep->c_hdrsize);
+	free_pages(pages, cachep->c_gfporder);
+	cachep->c_slabs--;
+	cachep->c_reaped++;
+}
+
+kmem_cache_t * kmem_cache_create(const char * name, unsigned long size,
+	unsigned long align, unsigned long flags,
+	void (*ctor)(void *, kmem_cache_t *))
+{
+	kmem_cache_t * cachep;
+
+	if (!name || !size || (flags & SLAB_OFF_SLAB)) {
+		printk("kmem_cache_create: bad arguments from %p\n",
+			__builtin_return_address(0));
+		return NULL;
+	}
+	cachep = (kmem_cache_t *) kmem_cache_alloc(&cache_cache, GFP_KERNEL);
+	if (!cachep)
+		return NULL;
+	if (!kmem_cache_setup(cachep, name, size, align, flags, ctor)) {
+		kmem_cache_free(&cache_cache, cachep);
+		return NULL;
+	}
+	return cachep;
+}
+
+/*
+ * Give all the completely free slabs of a cache back to the page
+ * allocator. Returns the number of slabs released.
+ */
+int kmem_cache_shrink(kmem_cache_t * cachep)
+{
+	unsigned long flags;
+	struct kmem_slab * slabp;
+	int ret = 0;
+
+	save_flags(flags);
+	cli();
+	while ((slabp = cachep->c_free) != NULL) {
+		slab_unlink(&cachep->c_free, slabp);
+		kmem_slab_destroy(cachep, slabp);
+		ret++;
+	}
+	restore_flags(flags);
+	return ret;
+}
+
+/*
+ * Remove a cache. All its objects must have been freed already.
+ */
+int kmem_cache_destroy(kmem_cache_t * cachep)
+{
+	unsigned long flags;
+	kmem_cache_t * p;
+
+	if (cachep == &cache_cache)
+		return -EINVAL;
+	kmem_cache_shrink(cachep);
+	save_flags(flags);
+	cli();
+	if (cachep->c_full || cachep->c_partial) {
+		restore_flags(flags);
+		printk("kmem_cache_destroy: %s still has objects in use\n",
+			cachep->c_name);
+		return -EBUSY;
+	}
+	for (p = &cache_cache; p->c_nextp; p = p->c_nextp) {
+		if (p->c_nextp == cachep) {
+			p->c_nextp = cachep->c_nextp;
+			break;
+		}
+	}
+	restore_flags(flags);
+	kmem_cache_free(&cache_cache, cachep);
+	return 0;
+}
+
+void * kmem_cache_alloc(kmem_cache_t * cachep, int priority)
+{
+	unsigned long flags;
+	struct kmem_slab * slabp;
+	struct kmem_slab ** list;
+	kmem_bufctl_t * bufctl;
+	unsigned int index;
+
+/* Sanity check... */
+	if (intr_count && (priority & GFP_LEVEL_MASK) != GFP_ATOMIC) {
+		static int count = 0;
+		if (++count < 5) {
+			printk("kmem_cache_alloc called nonatomically from interrupt %p\n",
+				__builtin_return_address(0));
+		}
+		priority = (priority & ~GFP_LEVEL_MASK) | GFP_ATOMIC;
+	}
+
+	save_flags(flags);
+	for (;;) {
+		cli();
+		if ((slabp = cachep->c_partial) != NULL || (slabp = cachep->c_free) != NULL)
+			break;
+		restore_flags(flags);
+		if (!kmem_cache_grow(cachep, priority))
+			return NULL;
+	}
+	list = slab_list(cachep, slabp);
+	bufctl = slab_bufctl(slabp);
+	index = slabp->s_free;
+	slabp->s_free = bufctl[index];
+	bufctl[index] = BUFCTL_USED;
+	slabp->s_inuse++;
+	if (slab_list(cachep, slabp) != list) {
+		slab_unlink(list, slabp);
+		slab_link(slab_list(cachep, slabp), slabp);
+	}
+	if (++cachep->c_active > cachep->c_high)
+		cachep->c_high = cachep->c_active;
+	restore_flags(flags);
+	return slabp->s_mem + index * cachep->c_size;
+}
+
+static inline struct kmem_slab * kmem_find_slab(void * objp)
+{
+	unsigned long nr = MAP_NR(objp);
+	struct kmem_slab * slabp;
+
+	if (nr >= slab_map_size || !(slabp = slab_map[nr]))
+		return NULL;
+	if (slabp->s_magic != SLAB_MAGIC)
+		return NULL;
+	return slabp;
+}
+
+/* Must be called with interrupts disabled */
+static void kmem_slab_free(struct kmem_slab * slabp, void * objp)
+{
+	kmem_cache_t * cachep = slabp->s_cache;
+	struct kmem_slab ** list = slab_list(cachep, slabp);
+	kmem_bufctl_t * bufctl = slab_bufctl(slabp);
+	unsigned long offset = (char *) objp - slabp->s_mem;
+	unsigned int index = offset / cachep->c_size;
+
+	if (offset % cachep->c_size || index >= cachep->c_num) {
+		printk("kmem_cache_free: bad pointer %p in %s\n", objp, cachep->c_name);
+		return;
+	}
+	if (bufctl[index] != BUFCTL_USED) {
+		printk("kmem_cache_free: %p in %s freed twice\n", objp, cachep->c_name);
+		return;
+	}
+	bufctl[index] = slabp->s_free;
+	slabp->s_free = index;
+	slabp->s_inuse--;
+	cachep->c_active--;
+	if (slab_list(cachep, slabp) == list)
+		return;
+	slab_unlink(list, slabp);
+	/* keep one free slab around, give the others back */
+	if (!slabp->s_inuse && cachep->c_free) {
+		kmem_slab_destroy(cachep, slabp);
+		return;
+	}
+	slab_link(slab_list(cachep, slabp), slabp);
+}
+
+void kmem_cache_free(kmem_cache_t * cachep, void * objp)
+{
+	unsigned long flags;
+	struct kmem_slab * slabp;
+
+	save_flags(flags);
+	cli();
+	slabp = kmem_find_slab(objp);
+	if (!slabp || slabp->s_cache != cachep) {
+		restore_flags(flags);
+		printk("kmem_cache_free: %p is not a %s object (from %p)\n",
+			objp, cachep->c_name, __builtin_return_address(0));
+		return;
+	}
+	kmem_slab_free(slabp, objp);
+	restore_flags(flags);
+}
+
+kmem_cache_t * kmem_find_cache(void * objp)
+{
+	struct kmem_slab * slabp = kmem_find_slab(objp);
+
+	return slabp ? slabp->s_cache : NULL;
+}
+
+unsigned long kmem_cache_size(kmem_cache_t * cachep)
+{
+	return cachep->c_objsize;
+}
+
+/*
+ * The general caches that kmalloc() uses. They are much closer together
+ * than the old power-of-two buckets, so that common structure sizes don't
+ * waste up to half of each block.
+ */
+static struct cache_sizes {
+	unsigned long cs_size;
+	const char * cs_name;
+	const char * cs_dmaname;
+	kmem_cache_t cs_cache;
+	kmem_cache_t cs_dmacache;
+} cache_sizes[] = {
+	{     32, "size-32",     "size-32(DMA)" },
+	{     64, "size-64",     "size-64(DMA)" },
+	{     96, "size-96",     "size-96(DMA)" },
+	{    128, "size-128",    "size-128(DMA)" },
+	{    192, "size-192",    "size-192(DMA)" },
+	{    256, "size-256",    "size-256(DMA)" },
+	{    384, "size-384",    "size-384(DMA)" },
+	{    512, "size-512",    "size-512(DMA)" },
+	{    768, "size-768",    "size-768(DMA)" },
+	{   1024, "size-1024",   "size-1024(DMA)" },
+	{   1536, "size-1536",   "size-1536(DMA)" },
+	{   2048, "size-2048",   "size-2048(DMA)" },
+	{   3072, "size-3072",   "size-3072(DMA)" },
+	{   4096, "size-4096",   "size-4096(DMA)" },
+	{   8192, "size-8192",   "size-8192(DMA)" },
+	{  16384, "size-16384",  "size-16384(DMA)" },
+	{  32768, "size-32768",  "size-32768(DMA)" },
+	{  65536, "size-65536",  "size-65536(DMA)" },
+	{ 131072, "size-131072", "size-131072(DMA)" },
+	{      0, NULL, NULL }
+};
+
+unsigned long kmem_cache_init(unsigned long start_mem, unsigned long end_mem)
+{
+	start_mem = (start_mem + 15) & ~15;
+	slab_map = (struct kmem_slab **) start_mem;
+	slab_map_size = MAP_NR(end_mem);
+	memset(slab_map, 0, slab_map_size * sizeof(struct kmem_slab *));
+	start_mem = (unsigned long) (slab_map + slab_map_size);
+
+	cache_cache.c_nextp = NULL;
+	if (!kmem_cache_setup(&cache_cache, "kmem_cache", sizeof(kmem_cache_t),
+			0, SLAB_HWCACHE_ALIGN, NULL))
+		panic("kmem_cache_init: can't set up the cache of caches");
+	/* kmem_cache_setup() linked it to itself */
+	cache_cache.c_nextp = NULL;
+	return start_mem;
+}
+
+long kmalloc_init(long start_mem, long end_mem)
+{
+	struct cache_sizes * cs;
+
+	start_mem = kmem_cache_init(start_mem, end_mem);
+	for (cs = cache_sizes; cs->cs_size; cs++) {
+		if (!kmem_cache_setup(&cs->cs_cache, cs->cs_name,
+				cs->cs_size, 0, 0, NULL) ||
+		    !kmem_cache_setup(&cs->cs_dmacache, cs->cs_dmaname,
+				cs->cs_size, 0, SLAB_DMA, NULL))
+			panic("This only happens if someone messes with kmalloc");
+	}
+	return start_mem;
+}
+
+void * kmalloc(size_t size, int priority)
+{
+	struct cache_sizes * cs;
+
+	for (cs = cache_sizes; cs->cs_size; cs++) {
+		if (size <= cs->cs_size) {
+			if (priority & GFP_DMA)
+				return kmem_cache_alloc(&cs->cs_dmacache, priority);
+			return kmem_cache_alloc(&cs->cs_cache, priority);
+		}
+	}
+	printk("kmalloc of too large a block (%d bytes).\n", (int) size);
+	return NULL;
+}
+
+/*
+ * Free memory from kmalloc(). This works for an object from any cache,
+ * as the slab it lives in tells us where it came from.
+ */
+void kfree_s(void * ptr, int size)
+{
+	unsigned long flags;
+	struct kmem_slab * slabp;
+
+	save_flags(flags);
+	cli();
+	slabp = kmem_find_slab(ptr);
+	if (!slabp) {
+		restore_flags(flags);
+		printk("kfree of non-kmalloced memory: %p (from %p)\n",
+			ptr, __builtin_return_address(0));
+		return;
+	}
+	if (size > slabp->s_cache->c_objsize) {
+		restore_flags(flags);
+		printk("Trying to free pointer at %p with wrong size: %d instead of at most %lu.\n",
+			ptr, size, slabp->s_cache->c_objsize);
+		return;
+	}
+	kmem_slab_free(slabp, ptr);
+	restore_flags(flags);
+}
+
+/*
+ * Called when memory is tight: give back the free slab that every
+ * cache keeps around.
+ */
+int kmem_cache_reap(int priority)
+{
+	kmem_cache_t * cachep;
+	int ret = 0;
+
+	for (cachep = &cache_cache; cachep; cachep = cachep->c_nextp)
+		ret += kmem_cache_shrink(cachep);
+	return ret;
+}
+
+/*
+ * /proc/slabinfo: per-cache usage. "frag" is the part of the slab
+ * memory that doesn't hold live objects, in percent - free objects,
+ * padding, headers and the unused space at the end of every slab.
+ */
+int get_slabinfo(char * buffer)
+{
+	kmem_cache_t * cachep;
+	int len;
+
+	len = sprintf(buffer, "%-18s %7s %7s %6s %5s %3s %4s %5s\n",
+		"name", "active", "total", "size", "slabs", "ord", "frag", "fail");
+	for (cachep = &cache_cache; cachep; cachep = cachep->c_nextp) {
+		unsigned long total = cachep->c_slabs * cachep->c_num;
+		unsigned long bytes = cachep->c_slabs * (PAGE_SIZE << cachep->c_gfporder);
+		unsigned long frag = 0;
+
+		if (bytes)
+			frag = (bytes - cachep->c_active * cachep->c_objsize) / (bytes / 100);
+		if (len > PAGE_SIZE - 80) {
+			len += sprintf(buffer+len, "...\n");
+			break;
+		}
+		len += sprintf(buffer+len, "%-18s %7lu %7lu %6lu %5lu %3u %3lu%% %5lu\n",
+			cachep->c_name, cachep->c_active, total, cachep->c_objsize,
+			cachep->c_slabs, cachep->c_gfporder, frag, cachep->c_failed);
+	}
+	return len;
+}
@@ -60,6 +60,8 @@
 #include <linux/string.h>
 #include <linux/stat.h>
 #include <linux/fs.h>
+#include <linux/slab.h>
+#include <linux/pagemap.h>
 
 #include <asm/dma.h>
 #include <asm/system.h> /* for cli()/sti() */
@@ -785,16 +787,22 @@ static int try_to_free_page(int priority)
 	static int state = 0;
 	int i=6;
 
+	if (kmem_cache_reap(priority))
+		return 1;
 	switch (state) {
 		do {
 		case 0:
-			if (priority != GFP_NOBUFFER && shrink_buffers(i))
+			if (shrink_mmap(i))
 				return 1;
 			state = 1;
 		case 1:
-			if (shm_swap(i))
+			if (priority != GFP_NOBUFFER && shrink_buffers(i))
 				return 1;
 			state = 2;
+		case 2:
+			if (shm_swap(i))
+				return 1;
+			state = 3;
 		default:
 			if (swap_out(i))
 				return 1;
@@ -1530,6 +1538,7 @@ unsigned long free_area_init(unsigned long start_mem, unsigned long end_mem)
 	//全部页面初始化为MAP_PAGE_RESERVED的
 	while (p > mem_map)
 		*--p = MAP_PAGE_RESERVED;
+	start_mem = page_cache_init(start_mem, end_mem);
 
 	//初始化free_area_list及free_area_map
 	for (i = 0 ; i < NR_MEM_LISTS ; i++) {
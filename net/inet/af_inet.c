@@ -77,6 +77,116 @@
 
 extern struct proto packet_prot;
 
+/*
+ *	Besides its place on the per-port sock_array, every socket that has
+ *	been put_sock()ed is on one of two hash tables that get_sock() uses.
+ *	Sockets with both ends fully known (local and remote address and
+ *	port) are on sock_ehash, keyed on all four of them: a segment for an
+ *	established connection is found without walking every other
+ *	connection to the same server port. Everything else (listeners,
+ *	unconnected UDP, sockets without a local address) is on sock_lhash,
+ *	keyed on the local port, and gets the old best-match treatment.
+ *
+ *	The connection table is sized from memory at boot. Until then, or
+ *	if there was no memory for it, all sockets go on sock_lhash.
+ */
+
+#define SOCK_HASH_MULT	0x9e370001U	/* prime close to 2^32/phi */
+
+static struct sock **sock_ehash = NULL;
+static int sock_ehash_shift = 32;
+static struct sock *sock_lhash[SOCK_ARRAY_SIZE];
+static struct sock *sock_last_hit = NULL;	/* one-entry get_sock() cache */
+
+static inline unsigned int sock_ehashfn(unsigned long laddr, unsigned short lport,
+	unsigned long raddr, unsigned short rport)
+{
+	unsigned int h;
+
+	h = (unsigned int) (laddr ^ raddr) * SOCK_HASH_MULT;
+	h += (unsigned int) lport << 16 | rport;
+	h ^= h >> 15;
+	return (h * SOCK_HASH_MULT) >> sock_ehash_shift;
+}
+
+static inline struct sock **sock_hash_chain(struct sock *sk)
+{
+	if (sock_ehash && sk->saddr && sk->daddr && sk->dummy_th.dest)
+		return sock_ehash + sock_ehashfn(sk->saddr, htons(sk->num),
+			sk->daddr, sk->dummy_th.dest);
+	return sock_lhash + (sk->num & (SOCK_ARRAY_SIZE - 1));
+}
+
+/*
+ *	These two must be called with interrupts off.
+ */
+
+static void hash_sock(struct sock *sk)
+{
+	struct sock **p = sock_hash_chain(sk);
+
+	if ((sk->hash_next = *p) != NULL)
+		sk->hash_next->hash_pprev = &sk->hash_next;
+	*p = sk;
+	sk->hash_pprev = p;
+}
+
+static void unhash_sock(struct sock *sk)
+{
+	if (!sk->hash_pprev)
+		return;
+	if (sk->hash_next)
+		sk->hash_next->hash_pprev = sk->hash_pprev;
+	*sk->hash_pprev = sk->hash_next;
+	sk->hash_next = NULL;
+	sk->hash_pprev = NULL;
+	if (sock_last_hit == sk)
+		sock_last_hit = NULL;
+}
+
+/*
+ *	The addresses or ports of a bound socket have changed (connect()):
+ *	move it to the chain it now belongs on.
+ */
+
+void rehash_sock(struct sock *sk)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (sk->hash_pprev) 
+	{
+		unhash_sock(sk);
+		hash_sock(sk);
+	}
+	restore_flags(flags);
+}
+
+/*
+ *	Size the connection hash table: about one chain per page of memory.
+ */
+
+static void sock_hash_init(void)
+{
+	unsigned long size;
+	int bits, order;
+
+	for (bits = 8; bits < 13 && (1UL << (bits + PAGE_SHIFT)) < high_memory; bits++)
+		/* nothing */;
+	size = sizeof(struct sock *) << bits;
+	for (order = 0; (PAGE_SIZE << order) < size; order++)
+		/* nothing */;
+	sock_ehash = (struct sock **) __get_free_pages(GFP_KERNEL, order);
+	if (!sock_ehash) 
+	{
+		printk("NET: no memory for the socket hash table\n");
+		return;
+	}
+	memset(sock_ehash, 0, size);
+	sock_ehash_shift = 32 - bits;
+}
+
 
 /*
  *	See if a socket number is in use.
@@ -174,6 +284,7 @@ void put_sock(unsigned short num, struct sock *sk)
 	sk->prot->inuse += 1;
 	if (sk->prot->highestinuse < sk->prot->inuse)
 		sk->prot->highestinuse = sk->prot->inuse;
+	hash_sock(sk);
 
 	if (sk->prot->sock_array[num] == NULL) 
 	{
@@ -236,6 +347,7 @@ static void remove_sock(struct sock *sk1)
 	/* We can't have this changing out from under us. */
 	save_flags(flags);
 	cli();
+	unhash_sock(sk1);
 	sk2 = sk1->prot->sock_array[sk1->num &(SOCK_ARRAY_SIZE -1)];
 	if (sk2 == sk1) 
 	{
@@ -627,9 +739,8 @@ static int inet_create(struct socket *sock, int protocol)
 	sk->mdev = 0;
 	sk->backoff = 0;
 	sk->packets_out = 0;
-	sk->cong_window = 1; /* start with only sending one packet at a time. */
-	sk->cong_count = 0;
-	sk->ssthresh = 0;
+	sk->cong_ops = tcp_cong_default;
+	sk->cong_ops->init(sk); /* start with only sending one packet at a time. */
 	sk->max_window = 0;
 	sk->urginline = 0;
 	sk->intr = 0;
@@ -642,6 +753,11 @@ static int inet_create(struct socket *sock, int protocol)
 	sk->done = 0;
 	sk->ack_backlog = 0;
 	sk->window = 0;
+	sk->snd_wscale = 0;
+	sk->rcv_wscale = 0;
+	sk->tstamp_ok = 0;
+	sk->sack_ok = 0;
+	sk->ts_recent = 0;
 	sk->bytes_rcv = 0;
 	sk->state = TCP_CLOSE;
 	sk->dead = 0;
@@ -667,6 +783,8 @@ static int inet_create(struct socket *sock, int protocol)
 	sk->saddr = 0 /* ip_my_addr() */;
 	sk->err = 0;
 	sk->next = NULL;
+	sk->hash_next = NULL;
+	sk->hash_pprev = NULL;
 	sk->pair = NULL;
 	sk->send_tail = NULL;
 	sk->send_head = NULL;
@@ -896,10 +1014,10 @@ static int inet_bind(struct socket *sock, struct sockaddr *uaddr,
 		sti();
 
 		remove_sock(sk);
-		put_sock(snum, sk);
-		sk->dummy_th.source = ntohs(sk->num);
 		sk->daddr = 0;
 		sk->dummy_th.dest = 0;
+		put_sock(snum, sk);
+		sk->dummy_th.source = ntohs(sk->num);
 	}
 	return(0);
 }
@@ -1322,6 +1440,8 @@ static int inet_ioctl(struct socket *sock, unsigned int cmd, unsigned long arg)
 		case SIOCGIFMAP:
 		case SIOCSIFSLAVE:
 		case SIOCGIFSLAVE:
+		case SIOCGIFQDISC:
+		case SIOCSIFQDISC:
 			return(dev_ioctl(cmd,(void *) arg));
 
 		default:
@@ -1344,6 +1464,11 @@ static int inet_ioctl(struct socket *sock, unsigned int cmd, unsigned long arg)
  * We give priority to more closely bound ports: if some socket
  * is bound to a particular foreign address, it will get the packet
  * rather than somebody listening to any address..
+ *
+ * A perfect match can only be on the connection hash, so that is tried
+ * first (after the socket that got the last segment: with a busy
+ * connection it is usually the same one). Only if that fails do we
+ * look for the best partial match among the sockets on the port.
  */
 
 struct sock *get_sock(struct proto *prot, unsigned short num,
@@ -1357,21 +1482,35 @@ struct sock *get_sock(struct proto *prot, unsigned short num,
 
 	hnum = ntohs(num);
 
-	/*
-	 * SOCK_ARRAY_SIZE must be a power of two.  This will work better
-	 * than a prime unless 3 or more sockets end up using the same
-	 * array entry.  This should not be a problem because most
-	 * well known sockets don't overlap that much, and for
-	 * the other ones, we can just be careful about picking our
-	 * socket number when we choose an arbitrary one.
-	 */
+	s = sock_last_hit;
+	if (s && s->prot == prot && s->num == hnum && s->saddr == laddr &&
+	    s->daddr == raddr && s->dummy_th.dest == rnum &&
+	    !(s->dead && s->state == TCP_CLOSE))
+		return s;
+
+	if (sock_ehash) 
+	{
+		for(s = sock_ehash[sock_ehashfn(laddr, num, raddr, rnum)];
+				s != NULL; s = s->hash_next) 
+		{
+			if (s->prot != prot || s->num != hnum)
+				continue;
+			if (s->saddr != laddr || s->daddr != raddr ||
+			    s->dummy_th.dest != rnum)
+				continue;
+			if(s->dead && (s->state == TCP_CLOSE))
+				continue;
+			sock_last_hit = s;
+			return s;
+		}
+	}
 
-	for(s = prot->sock_array[hnum & (SOCK_ARRAY_SIZE - 1)];
-			s != NULL; s = s->next) 
+	for(s = sock_lhash[hnum & (SOCK_ARRAY_SIZE - 1)];
+			s != NULL; s = s->hash_next) 
 	{
 		int score = 0;
 
-		if (s->num != hnum) 
+		if (s->prot != prot || s->num != hnum) 
 			continue;
 
 		if(s->dead && (s->state == TCP_CLOSE))
@@ -1527,6 +1666,12 @@ void inet_proto_init(struct net_proto *pro)
 
   	seq_offset = CURRENT_TIME*250;
 
+	/*
+	 *	Set up the buffer cache
+	 */
+
+	skb_init();
+
 	/*
 	 *	Add all the protocols. 
 	 */
@@ -1536,7 +1681,9 @@ void inet_proto_init(struct net_proto *pro)
 		tcp_prot.sock_array[i] = NULL;
 		udp_prot.sock_array[i] = NULL;
 		raw_prot.sock_array[i] = NULL;
+		sock_lhash[i] = NULL;
   	}
+	sock_hash_init();
 	tcp_prot.inuse = 0;
 	tcp_prot.highestinuse = 0;
 	udp_prot.inuse = 0;
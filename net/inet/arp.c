@@ -79,6 +79,8 @@
 struct arp_table
 {
 	struct arp_table		*next;			/* Linked entry list 		*/
+	struct arp_table		*lru_next;		/* Least recently used list	*/
+	struct arp_table		*lru_prev;
 	unsigned long			last_used;		/* For expiry 			*/
 	unsigned int			flags;			/* Control status 		*/
 	unsigned long			ip;			/* ip address of entry 		*/
@@ -128,7 +130,26 @@ struct arp_table
  *	(ARP_TIMEOUT+ARP_CHECK_INTERVAL).
  */
 
-#define ARP_CHECK_INTERVAL	(60 * HZ)
+#define ARP_CHECK_INTERVAL	(10 * HZ)
+
+/*
+ *	The most entries the cache will learn by itself. When it is full the
+ *	least recently used resolved entry is recycled. Only entries that
+ *	can expire count against this: permanent and proxy entries set with
+ *	SIOCSARP don't.
+ */
+
+#define ARP_MAX_ENTRIES		8192
+
+/*
+ *	Expiry runs from the cold end of the LRU list, so each check only
+ *	looks at entries which really are stale. If there are more than
+ *	ARP_EXPIRE_BATCH of them, the rest are done a tick later rather than
+ *	all with interrupts off.
+ */
+
+#define ARP_EXPIRE_BATCH	64
+#define ARP_EXPIRE_AGAIN	(HZ/10)
 
 enum proxy {
    PROXY_EXACT=0,
@@ -154,34 +175,195 @@ static struct timer_list arp_timer =
 
 
 /*
- * 	The size of the hash table. Must be a power of two.
- * 	Maybe we should remove hashing in the future for arp and concentrate
- * 	on Patrick Schaaf's Host-Cache-Lookup...
+ *	The hash table starts small and doubles whenever the cache holds more
+ *	than two entries per chain, up to ARP_TABLE_MAX chains. Its size is
+ *	always a power of two.
  */
 
+#define ARP_TABLE_MIN	16
+#define ARP_TABLE_MAX	4096
 
-#define ARP_TABLE_SIZE  16
+static struct arp_table *arp_table_min[ARP_TABLE_MIN] = { NULL, };
+static struct arp_table **arp_tables = arp_table_min;
+static unsigned int arp_table_size = ARP_TABLE_MIN;
+static unsigned int arp_hash_shift = 32 - 4;
+static unsigned int arp_count = 0;		/* entries in arp_tables */
 
-/* The ugly +1 here is to cater for proxy entries. They are put in their 
-   own list for efficiency of lookup. If you don't want to find a proxy
-   entry then don't look in the last entry, otherwise do 
-*/
+/*
+ *	Proxy entries have a netmask, so they can't be hashed. They are kept
+ *	in their own list, which is only looked at when we want a proxy.
+ */
+
+static struct arp_table *arp_proxies = NULL;
+
+/*
+ *	All the dynamic (not ATF_PERM and not proxy) entries, most recently
+ *	used first. arp_lru_tail is the next one to expire or be recycled.
+ */
+
+static struct arp_table *arp_lru_head = NULL;
+static struct arp_table *arp_lru_tail = NULL;
+static unsigned int arp_lru_count = 0;		/* entries on the list */
+
+/*
+ *	Multiplicative hash on the host order address, so that the low bits
+ *	which vary most on a LAN reach the top bits we keep.
+ */
 
-#define FULL_ARP_TABLE_SIZE (ARP_TABLE_SIZE+1)
+#define HASH(paddr) \
+	(((unsigned int) ntohl(paddr) * 0x9e370001U) >> arp_hash_shift)
 
-struct arp_table *arp_tables[FULL_ARP_TABLE_SIZE] =
+static inline int arp_on_lru(struct arp_table *entry)
 {
-	NULL,
-};
+	return entry->lru_prev != NULL || arp_lru_head == entry;
+}
+
+static inline void arp_lru_del(struct arp_table *entry)
+{
+	if (!arp_on_lru(entry))
+		return;
+	if (entry->lru_prev)
+		entry->lru_prev->lru_next = entry->lru_next;
+	else
+		arp_lru_head = entry->lru_next;
+	if (entry->lru_next)
+		entry->lru_next->lru_prev = entry->lru_prev;
+	else
+		arp_lru_tail = entry->lru_prev;
+	entry->lru_next = entry->lru_prev = NULL;
+	arp_lru_count--;
+}
+
+/*
+ *	Mark an entry as just used. Permanent and proxy entries never expire,
+ *	so they stay off the list. Called with interrupts off.
+ */
+
+static inline void arp_touch(struct arp_table *entry)
+{
+	entry->last_used = jiffies;
+	arp_lru_del(entry);
+	if (entry->flags & (ATF_PERM|ATF_PUBL))
+		return;
+	entry->lru_prev = NULL;
+	entry->lru_next = arp_lru_head;
+	if (arp_lru_head)
+		arp_lru_head->lru_prev = entry;
+	else
+		arp_lru_tail = entry;
+	arp_lru_head = entry;
+	arp_lru_count++;
+}
 
+/*
+ *	Double the hash table. If we can't get the memory we just carry on
+ *	with longer chains. Called with interrupts off.
+ */
+
+static void arp_grow_table(void)
+{
+	struct arp_table **new_tables, **old_tables = arp_tables;
+	struct arp_table *entry, *next;
+	unsigned int i, old_size = arp_table_size;
+
+	new_tables = (struct arp_table **) kmalloc(2 * old_size * sizeof(struct arp_table *),
+		GFP_ATOMIC);
+	if (new_tables == NULL)
+		return;
+	memset(new_tables, 0, 2 * old_size * sizeof(struct arp_table *));
+	arp_tables = new_tables;
+	arp_table_size = 2 * old_size;
+	arp_hash_shift--;
+	for (i = 0; i < old_size; i++)
+	{
+		for (entry = old_tables[i]; entry != NULL; entry = next)
+		{
+			unsigned int hash = HASH(entry->ip);
+			next = entry->next;
+			entry->next = new_tables[hash];
+			new_tables[hash] = entry;
+		}
+	}
+	if (old_tables != arp_table_min)
+		kfree_s(old_tables, old_size * sizeof(struct arp_table *));
+}
+
+/*
+ *	Put a new entry in the cache. Called with interrupts off.
+ */
+
+static void arp_link(struct arp_table *entry)
+{
+	entry->lru_next = entry->lru_prev = NULL;
+	if (entry->flags & ATF_PUBL)
+	{
+		entry->next = arp_proxies;
+		arp_proxies = entry;
+	}
+	else
+	{
+		unsigned int hash = HASH(entry->ip);
+		entry->next = arp_tables[hash];
+		arp_tables[hash] = entry;
+		if (++arp_count > 2 * arp_table_size && arp_table_size < ARP_TABLE_MAX)
+			arp_grow_table();
+	}
+	arp_touch(entry);
+}
+
+/*
+ *	Take an entry out of the cache. It is up to the caller to free it.
+ *	Returns 0 if it wasn't there. Called with interrupts off.
+ */
+
+static int arp_unlink(struct arp_table *entry)
+{
+	struct arp_table **pentry;
+
+	if (entry->flags & ATF_PUBL)
+		pentry = &arp_proxies;
+	else
+		pentry = &arp_tables[HASH(entry->ip)];
+	while (*pentry != NULL)
+	{
+		if (*pentry == entry)
+		{
+			*pentry = entry->next;
+			if (!(entry->flags & ATF_PUBL))
+				arp_count--;
+			arp_lru_del(entry);
+			return 1;
+		}
+		pentry = &(*pentry)->next;
+	}
+	return 0;
+}
 
 /*
- *	The last bits in the IP address are used for the cache lookup.
- *      A special entry is used for proxy arp entries
+ *	Get a new dynamic entry. If the cache is full, recycle the least
+ *	recently used entry that is resolved and has nothing queued. The
+ *	entry is not yet linked in. Called with interrupts off.
  */
 
-#define HASH(paddr) 		(htonl(paddr) & (ARP_TABLE_SIZE - 1))
-#define PROXY_HASH ARP_TABLE_SIZE
+static struct arp_table *arp_alloc_entry(void)
+{
+	struct arp_table *entry;
+	int n;
+
+	if (arp_lru_count < ARP_MAX_ENTRIES)
+		return (struct arp_table *) kmalloc(sizeof(struct arp_table), GFP_ATOMIC);
+
+	for (entry = arp_lru_tail, n = 0; entry != NULL && n < 16; entry = entry->lru_prev, n++)
+	{
+		if ((entry->flags & ATF_COM) && skb_peek(&entry->skb) == NULL)
+		{
+			arp_unlink(entry);
+			del_timer(&entry->timer);
+			return entry;
+		}
+	}
+	return NULL;
+}
 
 /*
  *	Check if there are too old entries and remove them. If the ATF_PERM
@@ -193,29 +375,20 @@ struct arp_table *arp_tables[FULL_ARP_TABLE_SIZE] =
 
 static void arp_check_expire(unsigned long dummy)
 {
-	int i;
+	struct arp_table *entry;
 	unsigned long now = jiffies;
 	unsigned long flags;
+	int n = 0;
+
 	save_flags(flags);
 	cli();
-
-	for (i = 0; i < FULL_ARP_TABLE_SIZE; i++)
+	while ((entry = arp_lru_tail) != NULL && (now - entry->last_used) > ARP_TIMEOUT)
 	{
-		struct arp_table *entry;
-		struct arp_table **pentry = &arp_tables[i];
-
-		while ((entry = *pentry) != NULL)
-		{
-			if ((now - entry->last_used) > ARP_TIMEOUT
-				&& !(entry->flags & ATF_PERM))
-			{
-				*pentry = entry->next;	/* remove from list */
-				del_timer(&entry->timer);	/* Paranoia */
-				kfree_s(entry, sizeof(struct arp_table));
-			}
-			else
-				pentry = &entry->next;	/* go to next entry */
-		}
+		if (++n > ARP_EXPIRE_BATCH)
+			break;
+		arp_unlink(entry);
+		del_timer(&entry->timer);	/* Paranoia */
+		kfree_s(entry, sizeof(struct arp_table));
 	}
 	restore_flags(flags);
 
@@ -224,7 +397,7 @@ static void arp_check_expire(unsigned long dummy)
 	 */
 
 	del_timer(&arp_timer);
-	arp_timer.expires = ARP_CHECK_INTERVAL;
+	arp_timer.expires = (n > ARP_EXPIRE_BATCH) ? ARP_EXPIRE_AGAIN : ARP_CHECK_INTERVAL;
 	add_timer(&arp_timer);
 }
 
@@ -260,6 +433,7 @@ static void arp_release_entry(struct arp_table *entry)
 int arp_device_event(unsigned long event, void *ptr)
 {
 	struct device *dev=ptr;
+	struct arp_table *entry, *next;
 	int i;
 	unsigned long flags;
 	
@@ -271,21 +445,18 @@ int arp_device_event(unsigned long event, void *ptr)
 	 
 	save_flags(flags);
 	cli();
-	for (i = 0; i < FULL_ARP_TABLE_SIZE; i++)
+	for (i = 0; i <= arp_table_size; i++)
 	{
-		struct arp_table *entry;
-		struct arp_table **pentry = &arp_tables[i];
-
-		while ((entry = *pentry) != NULL)
+		entry = (i < arp_table_size) ? arp_tables[i] : arp_proxies;
+		for (; entry != NULL; entry = next)
 		{
+			next = entry->next;
 			if(entry->dev==dev)
 			{
-				*pentry = entry->next;	/* remove from list */
+				arp_unlink(entry);
 				del_timer(&entry->timer);	/* Paranoia */
 				kfree_s(entry, sizeof(struct arp_table));
 			}
-			else
-				pentry = &entry->next;	/* go to next entry */
 		}
 	}
 	restore_flags(flags);
@@ -372,8 +543,6 @@ void arp_send(int type, int ptype, unsigned long dest_ip,
 static void arp_expire_request (unsigned long arg)
 {
 	struct arp_table *entry = (struct arp_table *) arg;
-	struct arp_table **pentry;
-	unsigned long hash;
 	unsigned long flags;
 
 	save_flags(flags);
@@ -408,31 +577,16 @@ static void arp_expire_request (unsigned long arg)
 
 	/*
 	 *	Arp request timed out. Delete entry and all waiting packets.
-	 *	If we give each entry a pointer to itself, we don't have to
-	 *	loop through everything again. Maybe hash is good enough, but
-	 *	I will look at it later.
+	 *	Proxy entries shouldn't really time out, but arp_unlink()
+	 *	copes with them for completeness.
 	 */
 
-	hash = HASH(entry->ip);
-
-	/* proxy entries shouldn't really time out so this is really
-	   only here for completeness
-	*/
-	if (entry->flags & ATF_PUBL)
-	  pentry = &arp_tables[PROXY_HASH];
-	else
-	  pentry = &arp_tables[hash];
-	while (*pentry != NULL)
+	if (arp_unlink(entry))
 	{
-		if (*pentry == entry)
-		{
-			*pentry = entry->next;	/* delete from linked list */
-			del_timer(&entry->timer);
-			restore_flags(flags);
-			arp_release_entry(entry);
-			return;
-		}
-		pentry = &(*pentry)->next;
+		del_timer(&entry->timer);
+		restore_flags(flags);
+		arp_release_entry(entry);
+		return;
 	}
 	restore_flags(flags);
 	printk("Possible ARP queue corruption.\n");
@@ -498,41 +652,23 @@ static void arp_send_q(struct arp_table *entry, unsigned char *hw_dest)
 
 void arp_destroy(unsigned long ip_addr, int force)
 {
-        int checked_proxies = 0;
 	struct arp_table *entry;
-	struct arp_table **pentry;
-	unsigned long hash = HASH(ip_addr);
 
-ugly:
-	cli();
-	pentry = &arp_tables[hash];
-	if (! *pentry) /* also check proxy entries */
-	  pentry = &arp_tables[PROXY_HASH];
+	/*
+	 *	There may be both an ordinary and a proxy entry for the
+	 *	address, so keep going until neither is left.
+	 */
 
-	while ((entry = *pentry) != NULL)
+	cli();
+	while ((entry = arp_lookup(ip_addr, PROXY_EXACT)) != NULL)
 	{
-		if (entry->ip == ip_addr)
-		{
-			if ((entry->flags & ATF_PERM) && !force)
-				return;
-			*pentry = entry->next;
-			del_timer(&entry->timer);
-			sti();
-			arp_release_entry(entry);
-			/* this would have to be cleaned up */
-			goto ugly;
-			/* perhaps like this ?
-			cli();
-			entry = *pentry;
-			*/
-		}
-		pentry = &entry->next;
-		if (!checked_proxies && ! *pentry)
-		  { /* ugly. we have to make sure we check proxy
-		       entries as well */
-		    checked_proxies = 1;
-		    pentry = &arp_tables[PROXY_HASH];
-		  }
+		if ((entry->flags & ATF_PERM) && !force)
+			break;
+		arp_unlink(entry);
+		del_timer(&entry->timer);
+		sti();
+		arp_release_entry(entry);
+		cli();
 	}
 	sti();
 }
@@ -555,7 +691,6 @@ int arp_rcv(struct sk_buff *skb, struct device *dev, struct packet_type *pt)
 	struct arp_table *entry;
 	struct arp_table *proxy_entry;
 	int addr_hint,hlen,htype;
-	unsigned long hash;
 	unsigned char ha[MAX_ADDR_LEN];	/* So we can enable ints again. */
 	long sip,tip;
 	unsigned char *sha,*tha;
@@ -681,7 +816,7 @@ int arp_rcv(struct sk_buff *skb, struct device *dev, struct packet_type *pt)
  * 	we can toss it.
  */
 			cli();
-			for(proxy_entry=arp_tables[PROXY_HASH];
+			for(proxy_entry=arp_proxies;
 			    proxy_entry;
 			    proxy_entry = proxy_entry->next)
 			{
@@ -729,9 +864,8 @@ int arp_rcv(struct sk_buff *skb, struct device *dev, struct packet_type *pt)
  * there.
  */
 
-	hash = HASH(sip);
 	cli();
-	for(entry=arp_tables[hash];entry;entry=entry->next)
+	for(entry=arp_tables[HASH(sip)];entry;entry=entry->next)
 		if(entry->ip==sip && entry->htype==htype)
 			break;
 
@@ -742,7 +876,7 @@ int arp_rcv(struct sk_buff *skb, struct device *dev, struct packet_type *pt)
  */
 		memcpy(entry->ha, sha, hlen);
 		entry->hlen = hlen;
-		entry->last_used = jiffies;
+		arp_touch(entry);
 		if (!(entry->flags & ATF_COM))
 		{
 /*
@@ -769,7 +903,7 @@ int arp_rcv(struct sk_buff *skb, struct device *dev, struct packet_type *pt)
 /*
  * 	No entry found.  Need to add a new entry to the arp table.
  */
-		entry = (struct arp_table *)kmalloc(sizeof(struct arp_table),GFP_ATOMIC);
+		entry = arp_alloc_entry();
 		if(entry == NULL)
 		{
 			sti();
@@ -786,11 +920,9 @@ int arp_rcv(struct sk_buff *skb, struct device *dev, struct packet_type *pt)
 		entry->flags = ATF_COM;
 		init_timer(&entry->timer);
 		memcpy(entry->ha, sha, hlen);
-		entry->last_used = jiffies;
 		entry->dev = skb->dev;
 		skb_queue_head_init(&entry->skb);
-		entry->next = arp_tables[hash];
-		arp_tables[hash] = entry;
+		arp_link(entry);
 		sti();
 	}
 
@@ -810,7 +942,6 @@ int arp_find(unsigned char *haddr, unsigned long paddr, struct device *dev,
 	   unsigned long saddr, struct sk_buff *skb)
 {
 	struct arp_table *entry;
-	unsigned long hash;
 #ifdef CONFIG_IP_MULTICAST
 	unsigned long taddr;
 #endif	
@@ -848,7 +979,6 @@ int arp_find(unsigned char *haddr, unsigned long paddr, struct device *dev,
 			return 0;
 	}
 
-	hash = HASH(paddr);
 	cli();
 
 	/*
@@ -878,7 +1008,7 @@ int arp_find(unsigned char *haddr, unsigned long paddr, struct device *dev,
 		 *	Update the record
 		 */
 		
-		entry->last_used = jiffies;
+		arp_touch(entry);
 		memcpy(haddr, entry->ha, dev->addr_len);
 		if (skb)
 			skb->arp = 1;
@@ -890,8 +1020,7 @@ int arp_find(unsigned char *haddr, unsigned long paddr, struct device *dev,
 	 *	Create a new unresolved entry.
 	 */
 	
-	entry = (struct arp_table *) kmalloc(sizeof(struct arp_table),
-					GFP_ATOMIC);
+	entry = arp_alloc_entry();
 	if (entry != NULL)
 	{
 	        entry->mask = DEF_ARP_NETMASK;
@@ -901,16 +1030,14 @@ int arp_find(unsigned char *haddr, unsigned long paddr, struct device *dev,
 		entry->flags = 0;
 		memset(entry->ha, 0, dev->addr_len);
 		entry->dev = dev;
-		entry->last_used = jiffies;
 		init_timer(&entry->timer);
 		entry->timer.function = arp_expire_request;
 		entry->timer.data = (unsigned long)entry;
 		entry->timer.expires = ARP_RES_TIME;
-		entry->next = arp_tables[hash];
-		arp_tables[hash] = entry;
+		skb_queue_head_init(&entry->skb);
+		arp_link(entry);
 		add_timer(&entry->timer);
 		entry->retries = ARP_MAX_TRIES;
-		skb_queue_head_init(&entry->skb);
 		if (skb != NULL)
 		{
 			skb_queue_tail(&entry->skb, skb);
@@ -958,9 +1085,10 @@ int arp_get_info(char *buffer, char **start, off_t offset, int length)
 	len+=size;
 	  
 	cli();
-	for(i=0; i<FULL_ARP_TABLE_SIZE; i++)
+	for(i=0; i<=arp_table_size; i++)
 	{
-		for(entry=arp_tables[i]; entry!=NULL; entry=entry->next)
+		entry = (i < arp_table_size) ? arp_tables[i] : arp_proxies;
+		for(; entry!=NULL; entry=entry->next)
 		{
 /*
  *	Convert hardware address to XX:XX:XX:XX ... form.
@@ -1025,14 +1153,13 @@ int arp_get_info(char *buffer, char **start, off_t offset, int length)
 static struct arp_table *arp_lookup(unsigned long paddr, enum proxy proxy)
 {
 	struct arp_table *entry;
-	unsigned long hash = HASH(paddr);
 	
-	for (entry = arp_tables[hash]; entry != NULL; entry = entry->next)
+	for (entry = arp_tables[HASH(paddr)]; entry != NULL; entry = entry->next)
 		if (entry->ip == paddr) break;
 
 	/* it's possibly a proxy entry (with a netmask) */
 	if (!entry && proxy != PROXY_NONE)
-	for (entry=arp_tables[PROXY_HASH]; entry != NULL; entry = entry->next)
+	for (entry=arp_proxies; entry != NULL; entry = entry->next)
 	  if ((proxy==PROXY_EXACT) ? (entry->ip==paddr)
 	                           : !((entry->ip^paddr)&entry->mask)) 
 	    break;	  
@@ -1127,10 +1254,6 @@ static int arp_req_set(struct arpreq *req)
 	
 	if (entry == NULL)
 	{
-	        unsigned long hash = HASH(ip);
-		if (r.arp_flags & ATF_PUBL)
-		  hash = PROXY_HASH;
-
 		entry = (struct arp_table *) kmalloc(sizeof(struct arp_table),
 					GFP_ATOMIC);
 		if (entry == NULL)
@@ -1141,18 +1264,18 @@ static int arp_req_set(struct arpreq *req)
 		entry->ip = ip;
 		entry->hlen = hlen;
 		entry->htype = htype;
+		entry->flags = r.arp_flags & ATF_PUBL;
 		init_timer(&entry->timer);
-		entry->next = arp_tables[hash];
-		arp_tables[hash] = entry;
 		skb_queue_head_init(&entry->skb);
+		arp_link(entry);
 	}
 	/*
 	 *	We now have a pointer to an ARP entry.  Update it!
 	 */
 	
 	memcpy(&entry->ha, &r.arp_ha.sa_data, hlen);
-	entry->last_used = jiffies;
 	entry->flags = r.arp_flags | ATF_COM;
+	arp_touch(entry);
 	if ((entry->flags & ATF_PUBL) && (entry->flags & ATF_NETMASK))
 	  {
 	    si = (struct sockaddr_in *) &r.arp_netmask;
@@ -0,0 +1,209 @@
+/*
+ * INET		An implementation of the TCP/IP protocol suite for the LINUX
+ *		operating system.  INET is implemented using the  BSD Socket
+ *		interface as the means of communication with the user level.
+ *
+ *		Internet checksum routines, with and without copying.
+ *
+ *		These are the old tcp_check() loop made general: the main
+ *		loop adds 32 bytes per go with the carry chained through,
+ *		using plain moves instead of lodsl, which is slow on the 486
+ *		and Pentium. The copying versions let the sender checksum the
+ *		data while it is being brought in from user space, so it is
+ *		only touched once.
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/types.h>
+#include "checksum.h"
+
+/*
+ *	Compute a 32 bit partial sum of len bytes, added to sum. Odd
+ *	addresses work, just more slowly.
+ */
+
+unsigned long csum_partial(unsigned char *buff, int len, unsigned long sum)
+{
+	unsigned long d0, d1;
+
+	__asm__("testl $2, %%esi\n\t"
+		"jz 2f\n\t"
+		"subl $2, %%ecx\n\t"
+		"jae 1f\n\t"
+		"addl $2, %%ecx\n\t"
+		"jmp 4f\n"
+		"1:\t"
+		"movzwl (%%esi), %%ebx\n\t"
+		"leal 2(%%esi), %%esi\n\t"
+		"addl %%ebx, %%eax\n\t"
+		"adcl $0, %%eax\n"
+		"2:\t"
+		"movl %%ecx, %%edx\n\t"
+		"shrl $5, %%ecx\n\t"
+		"jz 2f\n\t"
+		"testl %%esi, %%esi\n"
+		"1:\t"
+		"movl (%%esi), %%ebx\n\t"
+		"adcl %%ebx, %%eax\n\t"
+		"movl 4(%%esi), %%ebx\n\t"
+		"adcl %%ebx, %%eax\n\t"
+		"movl 8(%%esi), %%ebx\n\t"
+		"adcl %%ebx, %%eax\n\t"
+		"movl 12(%%esi), %%ebx\n\t"
+		"adcl %%ebx, %%eax\n\t"
+		"movl 16(%%esi), %%ebx\n\t"
+		"adcl %%ebx, %%eax\n\t"
+		"movl 20(%%esi), %%ebx\n\t"
+		"adcl %%ebx, %%eax\n\t"
+		"movl 24(%%esi), %%ebx\n\t"
+		"adcl %%ebx, %%eax\n\t"
+		"movl 28(%%esi), %%ebx\n\t"
+		"adcl %%ebx, %%eax\n\t"
+		"leal 32(%%esi), %%esi\n\t"
+		"decl %%ecx\n\t"
+		"jne 1b\n\t"
+		"adcl $0, %%eax\n"
+		"2:\t"
+		"movl %%edx, %%ecx\n\t"
+		"andl $28, %%edx\n\t"
+		"je 4f\n\t"
+		"shrl $2, %%edx\n\t"
+		"testl %%esi, %%esi\n"
+		"3:\t"
+		"adcl (%%esi), %%eax\n\t"
+		"leal 4(%%esi), %%esi\n\t"
+		"decl %%edx\n\t"
+		"jne 3b\n\t"
+		"adcl $0, %%eax\n"
+		"4:\t"
+		"andl $3, %%ecx\n\t"
+		"jz 7f\n\t"
+		"cmpl $2, %%ecx\n\t"
+		"jb 5f\n\t"
+		"movw (%%esi), %%cx\n\t"
+		"leal 2(%%esi), %%esi\n\t"
+		"je 6f\n\t"
+		"shll $16, %%ecx\n"
+		"5:\t"
+		"movb (%%esi), %%cl\n"
+		"6:\t"
+		"addl %%ecx, %%eax\n\t"
+		"adcl $0, %%eax\n"
+		"7:"
+		: "=a" (sum), "=c" (d0), "=S" (d1)
+		: "0" (sum), "1" (len), "2" (buff)
+		: "bx", "dx", "memory");
+	return sum;
+}
+
+/*
+ *	Copy len bytes and return their partial sum added to sum. SEG is
+ *	the segment override for the source: user data is reached through
+ *	%fs, as memcpy_fromfs() does.
+ */
+
+#define CSUM_COPY(SEG) \
+	__asm__("testl $2, %%esi\n\t" \
+		"jz 2f\n\t" \
+		"subl $2, %%ecx\n\t" \
+		"jae 1f\n\t" \
+		"addl $2, %%ecx\n\t" \
+		"jmp 4f\n" \
+		"1:\t" \
+		"movzwl " SEG "(%%esi), %%ebx\n\t" \
+		"movw %%bx, (%%edi)\n\t" \
+		"leal 2(%%esi), %%esi\n\t" \
+		"leal 2(%%edi), %%edi\n\t" \
+		"addl %%ebx, %%eax\n\t" \
+		"adcl $0, %%eax\n" \
+		"2:\t" \
+		"movl %%ecx, %%edx\n\t" \
+		"shrl $5, %%ecx\n\t" \
+		"jz 2f\n\t" \
+		"testl %%esi, %%esi\n" \
+		"1:\t" \
+		"movl " SEG "(%%esi), %%ebx\n\t" \
+		"adcl %%ebx, %%eax\n\t" \
+		"movl %%ebx, (%%edi)\n\t" \
+		"movl " SEG "4(%%esi), %%ebx\n\t" \
+		"adcl %%ebx, %%eax\n\t" \
+		"movl %%ebx, 4(%%edi)\n\t" \
+		"movl " SEG "8(%%esi), %%ebx\n\t" \
+		"adcl %%ebx, %%eax\n\t" \
+		"movl %%ebx, 8(%%edi)\n\t" \
+		"movl " SEG "12(%%esi), %%ebx\n\t" \
+		"adcl %%ebx, %%eax\n\t" \
+		"movl %%ebx, 12(%%edi)\n\t" \
+		"movl " SEG "16(%%esi), %%ebx\n\t" \
+		"adcl %%ebx, %%eax\n\t" \
+		"movl %%ebx, 16(%%edi)\n\t" \
+		"movl " SEG "20(%%esi), %%ebx\n\t" \
+		"adcl %%ebx, %%eax\n\t" \
+		"movl %%ebx, 20(%%edi)\n\t" \
+		"movl " SEG "24(%%esi), %%ebx\n\t" \
+		"adcl %%ebx, %%eax\n\t" \
+		"movl %%ebx, 24(%%edi)\n\t" \
+		"movl " SEG "28(%%esi), %%ebx\n\t" \
+		"adcl %%ebx, %%eax\n\t" \
+		"movl %%ebx, 28(%%edi)\n\t" \
+		"leal 32(%%esi), %%esi\n\t" \
+		"leal 32(%%edi), %%edi\n\t" \
+		"decl %%ecx\n\t" \
+		"jne 1b\n\t" \
+		"adcl $0, %%eax\n" \
+		"2:\t" \
+		"movl %%edx, %%ecx\n\t" \
+		"andl $28, %%edx\n\t" \
+		"je 4f\n\t" \
+		"shrl $2, %%edx\n\t" \
+		"testl %%esi, %%esi\n" \
+		"3:\t" \
+		"movl " SEG "(%%esi), %%ebx\n\t" \
+		"adcl %%ebx, %%eax\n\t" \
+		"movl %%ebx, (%%edi)\n\t" \
+		"leal 4(%%esi), %%esi\n\t" \
+		"leal 4(%%edi), %%edi\n\t" \
+		"decl %%edx\n\t" \
+		"jne 3b\n\t" \
+		"adcl $0, %%eax\n" \
+		"4:\t" \
+		"andl $3, %%ecx\n\t" \
+		"jz 7f\n\t" \
+		"cmpl $2, %%ecx\n\t" \
+		"jb 5f\n\t" \
+		"movw " SEG "(%%esi), %%cx\n\t" \
+		"leal 2(%%esi), %%esi\n\t" \
+		"movw %%cx, (%%edi)\n\t" \
+		"leal 2(%%edi), %%edi\n\t" \
+		"je 6f\n\t" \
+		"shll $16, %%ecx\n" \
+		"5:\t" \
+		"movb " SEG "(%%esi), %%cl\n\t" \
+		"movb %%cl, (%%edi)\n" \
+		"6:\t" \
+		"addl %%ecx, %%eax\n\t" \
+		"adcl $0, %%eax\n" \
+		"7:" \
+		: "=a" (sum), "=c" (d0), "=S" (d1), "=D" (d2) \
+		: "0" (sum), "1" (len), "2" (src), "3" (dst) \
+		: "bx", "dx", "memory")
+
+unsigned long csum_partial_copy(unsigned char *src, unsigned char *dst, int len, unsigned long sum)
+{
+	unsigned long d0, d1, d2;
+
+	CSUM_COPY("");
+	return sum;
+}
+
+unsigned long csum_partial_copy_fromuser(unsigned char *src, unsigned char *dst, int len, unsigned long sum)
+{
+	unsigned long d0, d1, d2;
+
+	CSUM_COPY("%%fs:");
+	return sum;
+}
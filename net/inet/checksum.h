@@ -0,0 +1,68 @@
+/*
+ * INET		An implementation of the TCP/IP protocol suite for the LINUX
+ *		operating system.  INET is implemented using the  BSD Socket
+ *		interface as the means of communication with the user level.
+ *
+ *		Definitions for the Internet checksum routines.
+ *
+ *		The partial sums are 32 bits wide and not complemented, so
+ *		they can be carried along with the data (skb->csum) and the
+ *		header added in at the end. csum_fold() turns a partial sum
+ *		into the 16 bit value that goes into the packet.
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ */
+#ifndef _CHECKSUM_H
+#define _CHECKSUM_H
+
+#include <asm/byteorder.h>
+
+extern unsigned long	csum_partial(unsigned char *buff, int len, unsigned long sum);
+extern unsigned long	csum_partial_copy(unsigned char *src, unsigned char *dst, int len, unsigned long sum);
+extern unsigned long	csum_partial_copy_fromuser(unsigned char *src, unsigned char *dst, int len, unsigned long sum);
+
+/*
+ *	Fold a partial sum to 16 bits and complement it.
+ */
+
+static inline unsigned short csum_fold(unsigned long sum)
+{
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum += sum >> 16;
+	return (~sum) & 0xffff;
+}
+
+/*
+ *	Add the TCP/UDP pseudo header to the partial sum of the segment
+ *	and fold it. len and proto are in host order.
+ */
+
+static inline unsigned short csum_tcpudp_magic(unsigned long saddr, unsigned long daddr,
+	unsigned short len, unsigned short proto, unsigned long sum)
+{
+	__asm__("addl %1, %0\n\t"
+		"adcl %2, %0\n\t"
+		"adcl %3, %0\n\t"
+		"adcl $0, %0"
+		: "=r" (sum)
+		: "g" (daddr), "g" (saddr), "g" ((ntohs(len) << 16) + proto * 256), "0" (sum));
+	return csum_fold(sum);
+}
+
+/*
+ *	Add the partial sum of a block that starts offset bytes into the
+ *	data. A block at an odd offset has its bytes the other way round.
+ */
+
+static inline unsigned long csum_block_add(unsigned long sum, unsigned long sum2, int offset)
+{
+	if (offset & 1)
+		sum2 = ((sum2 & 0xFF00FF) << 8) + ((sum2 >> 8) & 0xFF00FF);
+	sum += sum2;
+	return sum + (sum < sum2);
+}
+
+#endif	/* _CHECKSUM_H */
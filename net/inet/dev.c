@@ -29,6 +29,10 @@
  *					you start doing multicast video 8)
  *		Alan Cox	:	Rewrote net_bh and list manager.
  *		Alan Cox	: 	Fix ETH_P_ALL echoback lengths.
+ *		Polled receive	:	Drivers may mask their receive interrupt
+ *					and have net_bh poll them instead.
+ *		Queueing disciplines :	dev_queue_xmit() and dev_tint() go
+ *					through dev->qdisc (dev_qdisc.c).
  *
  *	Cleaned up and recommented by Alan Cox 2nd April 1994. I hope to have
  *	the rest as well commented in the end.
@@ -56,6 +60,7 @@
 #include <linux/inet.h>
 #include <linux/netdevice.h>
 #include <linux/etherdevice.h>
+#include <linux/if_qdisc.h>
 #include <linux/notifier.h>
 #include "ip.h"
 #include "route.h"
@@ -96,6 +101,20 @@ static struct sk_buff_head backlog =
  
 static int backlog_size = 0;
 
+/*
+ *	Devices in polled receive mode, waiting for net_bh. NET_RX_BUDGET
+ *	is how many frames one run of net_bh takes from them in all, so a
+ *	flood can't keep us out of everything else.
+ */
+
+static struct device *poll_head = NULL;
+static struct device *poll_tail = NULL;
+
+#define NET_RX_BUDGET		300
+#define NET_POLL_WEIGHT		16
+
+static void netif_rx_unschedule(struct device *dev);
+
 /*
  *	Return the lesser of the two values. 
  */
@@ -181,12 +200,17 @@ struct device *dev_get(char *name)
  
 int dev_open(struct device *dev)
 {
-	int ret = 0;
+	int ret;
+
+	/*
+	 *	Give it a transmit queue the first time it comes up
+	 */
+	ret = qdisc_attach_default(dev);
 
 	/*
 	 *	Call device private open method
 	 */
-	if (dev->open) 
+	if (ret == 0 && dev->open) 
   		ret = dev->open(dev);
 
 	/*
@@ -224,13 +248,13 @@ int dev_close(struct device *dev)
 	 
 	if (dev->flags != 0) 
 	{
-  		int ct=0;
 		dev->flags = 0;
 		/*
 		 *	Call the device specific close. This cannot fail.
 		 */
 		if (dev->stop) 
 			dev->stop(dev);
+		netif_rx_unschedule(dev);
 			
 		notifier_call_chain(&netdev_chain, NETDEV_DOWN, dev);
 #if 0		
@@ -259,14 +283,7 @@ int dev_close(struct device *dev)
 		/*
 		 *	Purge any queued packets when we down the link 
 		 */
-		while(ct<DEV_NUMBUFFS)
-		{
-			struct sk_buff *skb;
-			while((skb=skb_dequeue(&dev->buffs[ct]))!=NULL)
-				if(skb->free)
-					kfree_skb(skb,FREE_WRITE);
-			ct++;
-		}
+		qdisc_reset(dev);
 	}
 	return(0);
 }
@@ -302,6 +319,7 @@ void dev_queue_xmit(struct sk_buff *skb, struct device *dev, int pri)
 	unsigned long flags;
 	int nitcount;
 	struct packet_type *ptype;
+	struct Qdisc *q;
 	int where = 0;		/* used to say if the packet should go	*/
 				/* at the front or the back of the	*/
 				/* queue - front is a retransmit try	*/
@@ -342,9 +360,9 @@ void dev_queue_xmit(struct sk_buff *skb, struct device *dev, int pri)
   	}
 
 	/*
-	 *	Negative priority is used to flag a frame that is being pulled from the
-	 *	queue front as a retransmit attempt. It therefore goes back on the queue
-	 *	start on a failure.
+	 *	Negative priority is used to flag a frame that the caller pulled from
+	 *	the queue front as a retransmit attempt. It therefore goes back on the
+	 *	queue start.
 	 */
 	 
   	if (pri < 0) 
@@ -353,7 +371,7 @@ void dev_queue_xmit(struct sk_buff *skb, struct device *dev, int pri)
 		where = 1;
   	}
 
-	if (pri >= DEV_NUMBUFFS) 
+	if (pri >= QDISC_MAX_BANDS) 
 	{
 		printk("bad priority in dev_queue_xmit.\n");
 		pri = 1;
@@ -368,22 +386,6 @@ void dev_queue_xmit(struct sk_buff *skb, struct device *dev, int pri)
 		return;
 	}
 
-	save_flags(flags);
-	cli();	
-	if (!where) {
-#ifdef CONFIG_SLAVE_BALANCING	
-		skb->in_dev_queue=1;
-#endif		
-		skb_queue_tail(dev->buffs + pri,skb);
-		skb_device_unlock(skb);		/* Buffer is on the device queue and can be freed safely */
-		skb = skb_dequeue(dev->buffs + pri);
-		skb_device_lock(skb);		/* New buffer needs locking down */
-#ifdef CONFIG_SLAVE_BALANCING		
-		skb->in_dev_queue=0;
-#endif		
-	}
-	restore_flags(flags);
-
 	/* copy outgoing packets to any sniffer packet handlers */
 	if(!where)
 	{
@@ -409,25 +411,33 @@ void dev_queue_xmit(struct sk_buff *skb, struct device *dev, int pri)
 			}
 		}
 	}
-	if (dev->hard_start_xmit(skb, dev) == 0) {
-		/*
-		 *	Packet is now solely the responsibility of the driver
-		 */
-		return;
-	}
-
 	/*
-	 *	Transmission failed, put skb back into a list. Once on the list it's safe and
-	 *	no longer device locked (it can be freed safely from the device queue)
+	 *	Hand the frame to the queueing discipline. Once on its queue it's
+	 *	safe and no longer device locked (it can be freed safely from the
+	 *	device queue). Then send whatever the qdisc will let go.
 	 */
+
+	save_flags(flags);
 	cli();
-#ifdef CONFIG_SLAVE_BALANCING
+	skb->priority = pri;
+	skb_device_unlock(skb);
+	if ((q = dev->qdisc) == NULL)
+	{
+		restore_flags(flags);
+		if (skb->free)
+			kfree_skb(skb, FREE_WRITE);
+		return;
+	}
+#ifdef CONFIG_SLAVE_BALANCING	
 	skb->in_dev_queue=1;
 	dev->pkt_queue++;
 #endif		
-	skb_device_unlock(skb);
-	skb_queue_head(dev->buffs + pri,skb);
+	if (where)
+		q->ops->requeue(skb, q);
+	else
+		q->ops->enqueue(skb, q);
 	restore_flags(flags);
+	dev_tint(dev);
 }
 
 /*
@@ -461,6 +471,8 @@ void netif_rx(struct sk_buff *skb)
 
 	if (dropping) 
 	{
+		if (skb->dev)
+			skb->dev->rx_backlog_drops++;
 		kfree_skb(skb, FREE_READ);
 		return;
 	}
@@ -483,6 +495,74 @@ void netif_rx(struct sk_buff *skb)
 	return;
 }
 
+/*
+ *	A driver has masked its receive interrupt and wants net_bh to
+ *	poll it. Called from the interrupt handler.
+ */
+
+void netif_rx_schedule(struct device *dev)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (!dev->rx_sched)
+	{
+		dev->rx_sched = 1;
+		if (!dev->rx_queued)
+		{
+			dev->rx_queued = 1;
+			dev->poll_next = NULL;
+			if (poll_tail)
+				poll_tail->poll_next = dev;
+			else
+				poll_head = dev;
+			poll_tail = dev;
+		}
+	}
+	restore_flags(flags);
+	mark_bh(NET_BH);
+}
+
+/*
+ *	Called by the poll routine when the receive ring is empty, before
+ *	it turns the receive interrupt back on.
+ */
+
+void netif_rx_complete(struct device *dev)
+{
+	dev->rx_sched = 0;
+}
+
+static void netif_rx_unschedule(struct device *dev)
+{
+	struct device **dp;
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	dev->rx_sched = 0;
+	if (dev->rx_queued)
+	{
+		for (dp = &poll_head; *dp != NULL; dp = &(*dp)->poll_next)
+		{
+			if (*dp == dev)
+			{
+				*dp = dev->poll_next;
+				break;
+			}
+		}
+		if (poll_tail == dev)
+		{
+			poll_tail = poll_head;
+			while (poll_tail && poll_tail->poll_next)
+				poll_tail = poll_tail->poll_next;
+		}
+		dev->rx_queued = 0;
+	}
+	restore_flags(flags);
+}
+
 
 /*
  *	The old interface to fetch a packet from a device driver.
@@ -618,13 +698,176 @@ int in_net_bh()	/* Used by timer.c */
  *	mark_bh(NET_BH);
  */
  
-void net_bh(void *tmp)
+/*
+ *	Hand a received frame to the protocols. net_bh does this for the
+ *	backlog; a poll routine (which runs from net_bh) does it directly.
+ */
+
+void netif_receive_skb(struct sk_buff *skb)
 {
-	struct sk_buff *skb;
 	struct packet_type *ptype;
 	struct packet_type *pt_prev;
 	unsigned short type;
 
+	/*
+	 *	Polled frames never went through netif_rx().
+	 */
+
+	skb->sk = NULL;
+	skb->free = 1;
+	if(skb->stamp.tv_sec==0)
+		skb->stamp = xtime;
+
+	/*
+	 *	Bump the pointer to the next structure.
+	 *	This assumes that the basic 'skb' pointer points to
+	 *	the MAC header, if any (as indicated by its "length"
+	 *	field).  Take care now!
+	 */
+
+	skb->h.raw = skb->data + skb->dev->hard_header_len;
+	skb->len -= skb->dev->hard_header_len;
+
+	/*
+	 * 	Fetch the packet protocol ID.  This is also quite ugly, as
+	 * 	it depends on the protocol driver (the interface itself) to
+	 * 	know what the type is, or where to get it from.  The Ethernet
+	 * 	interfaces fetch the ID from the two bytes in the Ethernet MAC
+	 *	header (the h_proto field in struct ethhdr), but other drivers
+	 *	may either use the ethernet ID's or extra ones that do not
+	 *	clash (eg ETH_P_AX25). We could set this before we queue the
+	 *	frame. In fact I may change this when I have time.
+	 */
+	
+	type = skb->dev->type_trans(skb, skb->dev);
+
+	/*
+	 *	We got a packet ID.  Now loop over the "known protocols"
+	 *	table (which is actually a linked list, but this will
+	 *	change soon if I get my way- FvK), and forward the packet
+	 *	to anyone who wants it.
+	 *
+	 *	[FvK didn't get his way but he is right this ought to be
+	 *	hashed so we typically get a single hit. The speed cost
+	 *	here is minimal but no doubt adds up at the 4,000+ pkts/second
+	 *	rate we can hit flat out]
+	 */
+	pt_prev = NULL;
+	for (ptype = ptype_base; ptype != NULL; ptype = ptype->next) 
+	{
+		if ((ptype->type == type || ptype->type == htons(ETH_P_ALL)) && (!ptype->dev || ptype->dev==skb->dev))
+		{
+			/*
+			 *	We already have a match queued. Deliver
+			 *	to it and then remember the new match
+			 */
+			if(pt_prev)
+			{
+				struct sk_buff *skb2;
+
+				skb2=skb_clone(skb, GFP_ATOMIC);
+
+				/*
+				 *	Kick the protocol handler. This should be fast
+				 *	and efficient code.
+				 */
+
+				if(skb2)
+					pt_prev->func(skb2, skb->dev, pt_prev);
+			}
+			/* Remember the current last to do */
+			pt_prev=ptype;
+		}
+	} /* End of protocol list loop */
+	
+	/*
+	 *	Is there a last item to send to ?
+	 */
+
+	if(pt_prev)
+		pt_prev->func(skb, skb->dev, pt_prev);
+	/*
+	 * 	Has an unknown packet has been received ?
+	 */
+ 
+	else
+		kfree_skb(skb, FREE_WRITE);
+}
+
+/*
+ *	Give the devices on the poll list a go each in turn, until they
+ *	are done or the budget is. A device whose poll routine did not
+ *	say netif_rx_complete() goes back on the end of the list.
+ */
+
+static void net_rx_poll(void)
+{
+	struct device *dev;
+	int budget = NET_RX_BUDGET;
+	int quota, work;
+
+	while (budget > 0)
+	{
+		cli();
+		if ((dev = poll_head) == NULL)
+		{
+			sti();
+			return;
+		}
+		poll_head = dev->poll_next;
+		if (poll_head == NULL)
+			poll_tail = NULL;
+		dev->rx_queued = 0;
+		sti();
+
+		quota = dev->weight ? dev->weight : NET_POLL_WEIGHT;
+		if (quota > budget)
+			quota = budget;
+		dev->rx_polls++;
+		work = dev->poll(dev, quota);
+		budget -= work;
+
+		cli();
+		if (dev->rx_sched && !dev->rx_queued)
+		{
+			dev->rx_queued = 1;
+			dev->poll_next = NULL;
+			if (poll_tail)
+				poll_tail->poll_next = dev;
+			else
+				poll_head = dev;
+			poll_tail = dev;
+		}
+		sti();
+		dev_transmit();
+
+		/*
+		 *	A driver that could do nothing now (we came in over
+		 *	its transmit code) is tried again on the next run.
+		 */
+
+		if (work == 0 && dev->rx_sched)
+			break;
+	}
+
+	/*
+	 *	Work left over: come back later rather than now.
+	 */
+
+	cli();
+	if (poll_head != NULL)
+	{
+		for (dev = poll_head; dev != NULL; dev = dev->poll_next)
+			dev->rx_squeeze++;
+		mark_bh(NET_BH);
+	}
+	sti();
+}
+
+void net_bh(void *tmp)
+{
+	struct sk_buff *skb;
+
 	/*
 	 *	Atomically check and mark our BUSY state. 
 	 */
@@ -661,80 +904,7 @@ void net_bh(void *tmp)
 
 		sti();
 		
-	       /*
-		*	Bump the pointer to the next structure.
-		*	This assumes that the basic 'skb' pointer points to
-		*	the MAC header, if any (as indicated by its "length"
-		*	field).  Take care now!
-		*/
-
-		skb->h.raw = skb->data + skb->dev->hard_header_len;
-		skb->len -= skb->dev->hard_header_len;
-
-	       /*
-		* 	Fetch the packet protocol ID.  This is also quite ugly, as
-		* 	it depends on the protocol driver (the interface itself) to
-		* 	know what the type is, or where to get it from.  The Ethernet
-		* 	interfaces fetch the ID from the two bytes in the Ethernet MAC
-		*	header (the h_proto field in struct ethhdr), but other drivers
-		*	may either use the ethernet ID's or extra ones that do not
-		*	clash (eg ETH_P_AX25). We could set this before we queue the
-		*	frame. In fact I may change this when I have time.
-		*/
-		
-		type = skb->dev->type_trans(skb, skb->dev);
-
-		/*
-		 *	We got a packet ID.  Now loop over the "known protocols"
-		 *	table (which is actually a linked list, but this will
-		 *	change soon if I get my way- FvK), and forward the packet
-		 *	to anyone who wants it.
-		 *
-		 *	[FvK didn't get his way but he is right this ought to be
-		 *	hashed so we typically get a single hit. The speed cost
-		 *	here is minimal but no doubt adds up at the 4,000+ pkts/second
-		 *	rate we can hit flat out]
-		 */
-		pt_prev = NULL;
-		for (ptype = ptype_base; ptype != NULL; ptype = ptype->next) 
-		{
-			if ((ptype->type == type || ptype->type == htons(ETH_P_ALL)) && (!ptype->dev || ptype->dev==skb->dev))
-			{
-				/*
-				 *	We already have a match queued. Deliver
-				 *	to it and then remember the new match
-				 */
-				if(pt_prev)
-				{
-					struct sk_buff *skb2;
-
-					skb2=skb_clone(skb, GFP_ATOMIC);
-
-					/*
-					 *	Kick the protocol handler. This should be fast
-					 *	and efficient code.
-					 */
-
-					if(skb2)
-						pt_prev->func(skb2, skb->dev, pt_prev);
-				}
-				/* Remember the current last to do */
-				pt_prev=ptype;
-			}
-		} /* End of protocol list loop */
-		
-		/*
-		 *	Is there a last item to send to ?
-		 */
-
-		if(pt_prev)
-			pt_prev->func(skb, skb->dev, pt_prev);
-		/*
-		 * 	Has an unknown packet has been received ?
-		 */
-	 
-		else
-			kfree_skb(skb, FREE_WRITE);
+		netif_receive_skb(skb);
 
 		/*
 		 *	Again, see if we can transmit anything now. 
@@ -746,10 +916,19 @@ void net_bh(void *tmp)
 		cli();
   	}	/* End of queue loop */
   	
+	sti();
+
+	/*
+	 *	Now the devices that want polling.
+	 */
+
+	net_rx_poll();
+
   	/*
   	 *	We have emptied the queue
   	 */
   	 
+	cli();
   	in_bh = 0;
 	sti();
 	
@@ -758,6 +937,13 @@ void net_bh(void *tmp)
 	 */
 	 
 	dev_transmit();
+
+	/*
+	 *	Top the buffer pools back up now the queue is empty.
+	 */
+
+	if (skb_pool_low)
+		skb_pool_refill();
 }
 
 
@@ -768,42 +954,57 @@ void net_bh(void *tmp)
  
 void dev_tint(struct device *dev)
 {
-	int i;
+	struct Qdisc *q;
 	struct sk_buff *skb;
 	unsigned long flags;
+	unsigned long len;
 	
 	save_flags(flags);	
 	/*
-	 *	Work the queues in priority order
+	 *	Feed the driver whatever the queueing discipline lets go
 	 */
 	 
-	for(i = 0;i < DEV_NUMBUFFS; i++) 
+	cli();
+	while((q = dev->qdisc) != NULL && (skb = q->ops->dequeue(q)) != NULL)
 	{
 		/*
-		 *	Pull packets from the queue
+		 *	Stop anyone freeing the buffer while we transmit it
 		 */
-		 
-
-		cli();
-		while((skb=skb_dequeue(&dev->buffs[i]))!=NULL)
+		skb_device_lock(skb);
+#ifdef CONFIG_SLAVE_BALANCING		
+		skb->in_dev_queue=0;
+		dev->pkt_queue--;
+#endif		
+		len = skb->len;
+		restore_flags(flags);
+		if (dev->hard_start_xmit(skb, dev) != 0)
 		{
 			/*
-			 *	Stop anyone freeing the buffer while we retransmit it
-			 */
-			skb_device_lock(skb);
-			restore_flags(flags);
-			/*
-			 *	Feed them to the output stage and if it fails
-			 *	indicate they re-queue at the front.
-			 */
-			dev_queue_xmit(skb,dev,-i - 1);
-			/*
-			 *	If we can take no more then stop here.
+			 *	Transmission failed, put skb back at the front. Once on
+			 *	the queue it's safe and no longer device locked.
 			 */
-			if (dev->tbusy)
-				return;
 			cli();
+#ifdef CONFIG_SLAVE_BALANCING
+			skb->in_dev_queue=1;
+			dev->pkt_queue++;
+#endif		
+			skb_device_unlock(skb);
+			q->stats.requeues++;
+			q->ops->requeue(skb, q);
+			restore_flags(flags);
+			return;
 		}
+		/*
+		 *	Packet is now solely the responsibility of the driver
+		 */
+		q->stats.packets++;
+		q->stats.bytes += len;
+		/*
+		 *	If we can take no more then stop here.
+		 */
+		if (dev->tbusy)
+			return;
+		cli();
 	}
 	restore_flags(flags);
 }
@@ -900,7 +1101,7 @@ static int sprintf_stats(char *buffer, struct device *dev)
 	int size;
 	
 	if (stats)
-		size = sprintf(buffer, "%6s:%7d %4d %4d %4d %4d %8d %4d %4d %4d %5d %4d\n",
+		size = sprintf(buffer, "%6s:%7d %4d %4d %4d %4d %8d %4d %4d %4d %5d %4d %7lu %7lu %4lu\n",
 		   dev->name,
 		   stats->rx_packets, stats->rx_errors,
 		   stats->rx_dropped + stats->rx_missed_errors,
@@ -910,7 +1111,8 @@ static int sprintf_stats(char *buffer, struct device *dev)
 		   stats->tx_packets, stats->tx_errors, stats->tx_dropped,
 		   stats->tx_fifo_errors, stats->collisions,
 		   stats->tx_carrier_errors + stats->tx_aborted_errors
-		   + stats->tx_window_errors + stats->tx_heartbeat_errors);
+		   + stats->tx_window_errors + stats->tx_heartbeat_errors,
+		   dev->rx_backlog_drops, dev->rx_polls, dev->rx_squeeze);
 	else
 		size = sprintf(buffer, "%6s: No statistics available.\n", dev->name);
 
@@ -932,8 +1134,8 @@ int dev_get_info(char *buffer, char **start, off_t offset, int length)
 	struct device *dev;
 
 
-	size = sprintf(buffer, "Inter-|   Receive                  |  Transmit\n"
-			    " face |packets errs drop fifo frame|packets errs drop fifo colls carrier\n");
+	size = sprintf(buffer, "Inter-|   Receive                  |  Transmit                            |  Backlog/poll\n"
+			    " face |packets errs drop fifo frame|packets errs drop fifo colls carrier|  drops   polls sqz\n");
 	
 	pos+=size;
 	len+=size;
@@ -1103,6 +1305,9 @@ static int dev_ifsioc(void *arg, unsigned int getset)
 			dev->pa_mask = ip_get_mask(dev->pa_addr);
 #endif			
 			dev->pa_brdaddr = dev->pa_addr | ~dev->pa_mask;
+#ifdef CONFIG_INET
+			ip_rt_cache_flush();
+#endif
 			ret = 0;
 			break;
 			
@@ -1120,6 +1325,9 @@ static int dev_ifsioc(void *arg, unsigned int getset)
 		case SIOCSIFBRDADDR:	/* Set the broadcast address */
 			dev->pa_brdaddr = (*(struct sockaddr_in *)
 				&ifr.ifr_broadaddr).sin_addr.s_addr;
+#ifdef CONFIG_INET
+			ip_rt_cache_flush();
+#endif
 			ret = 0;
 			break;
 			
@@ -1162,6 +1370,9 @@ static int dev_ifsioc(void *arg, unsigned int getset)
 				if (bad_mask(mask,0))
 					break;
 				dev->pa_mask = mask;
+#ifdef CONFIG_INET
+				ip_rt_cache_flush();
+#endif
 				ret = 0;
 			}
 			break;
@@ -1387,6 +1598,14 @@ int dev_ioctl(unsigned int cmd, void *arg)
 				return -EPERM;
 			return dev_ifsioc(arg, cmd);
 	
+		case SIOCGIFQDISC:
+			return qdisc_ioctl(cmd, arg);
+
+		case SIOCSIFQDISC:
+			if (!suser())
+				return -EPERM;
+			return qdisc_ioctl(cmd, arg);
+
 		case SIOCSIFLINK:
 			return -EINVAL;
 
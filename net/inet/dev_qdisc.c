@@ -0,0 +1,958 @@
+/*
+ * 	NET3	Transmit queueing disciplines.
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ *
+ *	dev_queue_xmit() used to put every frame on one of the three
+ *	dev->buffs[] lists with no limit at all, so one busy sender could
+ *	queue megabytes in front of everybody else. Each device now has a
+ *	queueing discipline which is asked to queue the frame and asked
+ *	again, by dev_tint(), for the next frame to send.
+ *
+ *	The rules all the disciplines follow:
+ *
+ *	-	Everything is called with interrupts off.
+ *	-	Queued frames sit on sk_buff_head lists. TCP unlinks frames
+ *		it has finished with straight off the device queue, so we
+ *		can't keep private counts that depend on seeing every frame
+ *		leave. The list lengths (skb_queue_len) stay right.
+ *	-	A frame we drop is only freed if skb->free says it is ours.
+ *		TCP frames stay on the socket and get retransmitted.
+ */
+
+#include <asm/segment.h>
+#include <asm/system.h>
+#include <linux/config.h>
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/mm.h>
+#include <linux/malloc.h>
+#include <linux/socket.h>
+#include <linux/sockios.h>
+#include <linux/in.h>
+#include <linux/errno.h>
+#include <linux/interrupt.h>
+#include <linux/timer.h>
+#include <linux/ip.h>
+#include <linux/netdevice.h>
+#include <linux/if_qdisc.h>
+#include <linux/skbuff.h>
+#include "ip.h"
+
+/*
+ *	A frame the protocol still owns (TCP will send it again) is left
+ *	alone when dropped, but it is off the device queue all the same.
+ */
+
+static inline void qdisc_disown(struct sk_buff *skb)
+{
+#ifdef CONFIG_SLAVE_BALANCING
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (skb->in_dev_queue && skb->dev != NULL)
+	{
+		skb->in_dev_queue = 0;
+		skb->dev->pkt_queue--;
+	}
+	restore_flags(flags);
+#endif
+}
+
+/*
+ *	Drop a frame, either refused or pushed out to make room.
+ */
+
+void qdisc_drop(struct sk_buff *skb, struct Qdisc *q)
+{
+	q->stats.drops++;
+	if (skb->free)
+		kfree_skb(skb, FREE_WRITE);
+	else
+		qdisc_disown(skb);
+}
+
+static void qdisc_purge(struct sk_buff_head *list)
+{
+	struct sk_buff *skb;
+
+	while ((skb = skb_dequeue(list)) != NULL)
+		if (skb->free)
+			kfree_skb(skb, FREE_WRITE);
+		else
+			qdisc_disown(skb);
+}
+
+/*
+ *	Add up what is sitting on a list for SIOCGIFQDISC and /proc.
+ */
+
+static void qdisc_backlog(struct sk_buff_head *list, struct qdisc_conf *qc)
+{
+	struct sk_buff *skb;
+
+	for (skb = list->next; skb != (struct sk_buff *)list; skb = skb->next)
+	{
+		qc->qc_stats.qlen++;
+		qc->qc_stats.backlog += skb->len;
+	}
+}
+
+
+/*
+ *	pfifo_fast: the old three bands in dev->buffs[], highest priority
+ *	first, with the whole device limited to q->limit frames.
+ */
+
+/*
+ *	SO_PRIORITY goes up to QDISC_MAX_BANDS for prio's sake. Here the
+ *	extra priorities all share the lowest band.
+ */
+
+static __inline__ struct sk_buff_head *pfifo_fast_band(struct Qdisc *q, struct sk_buff *skb)
+{
+	if (skb->priority < DEV_NUMBUFFS)
+		return q->dev->buffs + skb->priority;
+	return q->dev->buffs + DEV_NUMBUFFS - 1;
+}
+
+static int pfifo_fast_enqueue(struct sk_buff *skb, struct Qdisc *q)
+{
+	struct sk_buff_head *list = q->dev->buffs;
+	unsigned long qlen = 0;
+	int i;
+
+	for (i = 0; i < DEV_NUMBUFFS; i++)
+		qlen += skb_queue_len(list + i);
+	if (qlen >= q->limit)
+	{
+		qdisc_drop(skb, q);
+		return 1;
+	}
+	skb_queue_tail(pfifo_fast_band(q, skb), skb);
+	return 0;
+}
+
+static struct sk_buff *pfifo_fast_dequeue(struct Qdisc *q)
+{
+	struct sk_buff *skb;
+	int i;
+
+	for (i = 0; i < DEV_NUMBUFFS; i++)
+		if ((skb = skb_dequeue(q->dev->buffs + i)) != NULL)
+			return skb;
+	return NULL;
+}
+
+static void pfifo_fast_requeue(struct sk_buff *skb, struct Qdisc *q)
+{
+	skb_queue_head(pfifo_fast_band(q, skb), skb);
+}
+
+static void pfifo_fast_reset(struct Qdisc *q)
+{
+	int i;
+
+	for (i = 0; i < DEV_NUMBUFFS; i++)
+		qdisc_purge(q->dev->buffs + i);
+}
+
+static void pfifo_fast_dump(struct Qdisc *q, struct qdisc_conf *qc)
+{
+	int i;
+
+	qc->qc_bands = DEV_NUMBUFFS;
+	for (i = 0; i < DEV_NUMBUFFS; i++)
+		qdisc_backlog(q->dev->buffs + i, qc);
+}
+
+static struct qdisc_ops pfifo_fast_ops = {
+	"pfifo_fast",
+	0,
+	NULL,
+	pfifo_fast_enqueue,
+	pfifo_fast_dequeue,
+	pfifo_fast_requeue,
+	pfifo_fast_reset,
+	NULL,
+	pfifo_fast_dump
+};
+
+
+/*
+ *	pfifo: a single list holding up to q->limit frames.
+ */
+
+struct fifo_data
+{
+	struct sk_buff_head	queue;
+};
+
+static int pfifo_init(struct Qdisc *q, struct qdisc_conf *qc)
+{
+	struct fifo_data *f = (struct fifo_data *)q->data;
+
+	skb_queue_head_init(&f->queue);
+	return 0;
+}
+
+static int pfifo_enqueue(struct sk_buff *skb, struct Qdisc *q)
+{
+	struct fifo_data *f = (struct fifo_data *)q->data;
+
+	if (skb_queue_len(&f->queue) >= q->limit)
+	{
+		qdisc_drop(skb, q);
+		return 1;
+	}
+	skb_queue_tail(&f->queue, skb);
+	return 0;
+}
+
+static struct sk_buff *pfifo_dequeue(struct Qdisc *q)
+{
+	struct fifo_data *f = (struct fifo_data *)q->data;
+
+	return skb_dequeue(&f->queue);
+}
+
+static void pfifo_requeue(struct sk_buff *skb, struct Qdisc *q)
+{
+	struct fifo_data *f = (struct fifo_data *)q->data;
+
+	skb_queue_head(&f->queue, skb);
+}
+
+static void pfifo_reset(struct Qdisc *q)
+{
+	struct fifo_data *f = (struct fifo_data *)q->data;
+
+	qdisc_purge(&f->queue);
+}
+
+static void pfifo_dump(struct Qdisc *q, struct qdisc_conf *qc)
+{
+	struct fifo_data *f = (struct fifo_data *)q->data;
+
+	qdisc_backlog(&f->queue, qc);
+}
+
+static struct qdisc_ops pfifo_ops = {
+	"pfifo",
+	sizeof(struct fifo_data),
+	pfifo_init,
+	pfifo_enqueue,
+	pfifo_dequeue,
+	pfifo_requeue,
+	pfifo_reset,
+	NULL,
+	pfifo_dump
+};
+
+
+/*
+ *	prio: qc_bands strict priority bands, each of q->limit frames.
+ *	The socket priority (SO_PRIORITY) picks the band, anything past
+ *	the last band goes in the last one. Band 0 is sent first.
+ */
+
+struct prio_data
+{
+	int			bands;
+	struct sk_buff_head	queue[QDISC_MAX_BANDS];
+};
+
+static int prio_init(struct Qdisc *q, struct qdisc_conf *qc)
+{
+	struct prio_data *p = (struct prio_data *)q->data;
+	int i;
+
+	if (qc->qc_bands > QDISC_MAX_BANDS)
+		return -EINVAL;
+	p->bands = qc->qc_bands ? qc->qc_bands : DEV_NUMBUFFS;
+	for (i = 0; i < p->bands; i++)
+		skb_queue_head_init(&p->queue[i]);
+	return 0;
+}
+
+static __inline__ struct sk_buff_head *prio_band(struct prio_data *p, struct sk_buff *skb)
+{
+	if (skb->priority < p->bands)
+		return &p->queue[skb->priority];
+	return &p->queue[p->bands - 1];
+}
+
+static int prio_enqueue(struct sk_buff *skb, struct Qdisc *q)
+{
+	struct sk_buff_head *list = prio_band((struct prio_data *)q->data, skb);
+
+	if (skb_queue_len(list) >= q->limit)
+	{
+		qdisc_drop(skb, q);
+		return 1;
+	}
+	skb_queue_tail(list, skb);
+	return 0;
+}
+
+static struct sk_buff *prio_dequeue(struct Qdisc *q)
+{
+	struct prio_data *p = (struct prio_data *)q->data;
+	struct sk_buff *skb;
+	int i;
+
+	for (i = 0; i < p->bands; i++)
+		if ((skb = skb_dequeue(&p->queue[i])) != NULL)
+			return skb;
+	return NULL;
+}
+
+static void prio_requeue(struct sk_buff *skb, struct Qdisc *q)
+{
+	skb_queue_head(prio_band((struct prio_data *)q->data, skb), skb);
+}
+
+static void prio_reset(struct Qdisc *q)
+{
+	struct prio_data *p = (struct prio_data *)q->data;
+	int i;
+
+	for (i = 0; i < p->bands; i++)
+		qdisc_purge(&p->queue[i]);
+}
+
+static void prio_dump(struct Qdisc *q, struct qdisc_conf *qc)
+{
+	struct prio_data *p = (struct prio_data *)q->data;
+	int i;
+
+	qc->qc_bands = p->bands;
+	for (i = 0; i < p->bands; i++)
+		qdisc_backlog(&p->queue[i], qc);
+}
+
+static struct qdisc_ops prio_ops = {
+	"prio",
+	sizeof(struct prio_data),
+	prio_init,
+	prio_enqueue,
+	prio_dequeue,
+	prio_requeue,
+	prio_reset,
+	NULL,
+	prio_dump
+};
+
+
+/*
+ *	tbf: a FIFO let out through a token bucket. Tokens are bytes,
+ *	they come in at qc_rate a second and at most qc_burst of them are
+ *	kept. A frame goes when there are tokens for all of it; if there
+ *	aren't, a timer kicks the device again when there will be.
+ */
+
+#define TBF_MAX_RATE	(0x7FFFFFFFUL / HZ)
+
+struct tbf_data
+{
+	unsigned long		rate;		/* bytes per second		*/
+	unsigned long		burst;		/* bucket size			*/
+	unsigned long		tokens;
+	unsigned long		part;		/* fractions of a token * HZ	*/
+	unsigned long		t_c;		/* jiffies at the last refill	*/
+	struct timer_list	timer;
+	struct sk_buff_head	queue;
+};
+
+static void tbf_watchdog(unsigned long data)
+{
+	mark_bh(NET_BH);
+}
+
+static int tbf_init(struct Qdisc *q, struct qdisc_conf *qc)
+{
+	struct tbf_data *t = (struct tbf_data *)q->data;
+
+	if (qc->qc_rate == 0 || qc->qc_rate > TBF_MAX_RATE)
+		return -EINVAL;
+	if (qc->qc_burst < q->dev->mtu + q->dev->hard_header_len)
+		return -EINVAL;
+	t->rate = qc->qc_rate;
+	t->burst = qc->qc_burst;
+	t->tokens = t->burst;
+	t->t_c = jiffies;
+	init_timer(&t->timer);
+	t->timer.function = tbf_watchdog;
+	t->timer.data = (unsigned long) q;
+	skb_queue_head_init(&t->queue);
+	return 0;
+}
+
+/*
+ *	Credit the tokens earned since the last call. A long idle spell
+ *	just fills the bucket; otherwise whole seconds and the odd jiffies
+ *	are done apart so rate * elapsed can't overflow.
+ */
+
+static void tbf_refill(struct tbf_data *t)
+{
+	unsigned long elapsed = jiffies - t->t_c;
+
+	t->t_c = jiffies;
+	if (elapsed / HZ > t->burst / t->rate)
+	{
+		t->tokens = t->burst;
+		t->part = 0;
+		return;
+	}
+	t->part += (elapsed % HZ) * t->rate;
+	t->tokens += (elapsed / HZ) * t->rate + t->part / HZ;
+	t->part %= HZ;
+	if (t->tokens > t->burst)
+		t->tokens = t->burst;
+}
+
+static int tbf_enqueue(struct sk_buff *skb, struct Qdisc *q)
+{
+	struct tbf_data *t = (struct tbf_data *)q->data;
+
+	if (skb_queue_len(&t->queue) >= q->limit || skb->len > t->burst)
+	{
+		qdisc_drop(skb, q);
+		return 1;
+	}
+	skb_queue_tail(&t->queue, skb);
+	return 0;
+}
+
+static struct sk_buff *tbf_dequeue(struct Qdisc *q)
+{
+	struct tbf_data *t = (struct tbf_data *)q->data;
+	struct sk_buff *skb = skb_peek(&t->queue);
+
+	if (skb == NULL)
+		return NULL;
+	tbf_refill(t);
+	if (skb->len <= t->tokens)
+	{
+		t->tokens -= skb->len;
+		return skb_dequeue(&t->queue);
+	}
+	q->stats.overlimits++;
+	del_timer(&t->timer);
+	t->timer.expires = ((skb->len - t->tokens) * HZ) / t->rate + 1;
+	add_timer(&t->timer);
+	return NULL;
+}
+
+static void tbf_requeue(struct sk_buff *skb, struct Qdisc *q)
+{
+	struct tbf_data *t = (struct tbf_data *)q->data;
+
+	/* Not sent, so the tokens are given back */
+	t->tokens += skb->len;
+	skb_queue_head(&t->queue, skb);
+}
+
+static void tbf_reset(struct Qdisc *q)
+{
+	struct tbf_data *t = (struct tbf_data *)q->data;
+
+	qdisc_purge(&t->queue);
+	del_timer(&t->timer);
+	t->tokens = t->burst;
+	t->part = 0;
+	t->t_c = jiffies;
+}
+
+static void tbf_destroy(struct Qdisc *q)
+{
+	struct tbf_data *t = (struct tbf_data *)q->data;
+
+	del_timer(&t->timer);
+}
+
+static void tbf_dump(struct Qdisc *q, struct qdisc_conf *qc)
+{
+	struct tbf_data *t = (struct tbf_data *)q->data;
+
+	qc->qc_rate = t->rate;
+	qc->qc_burst = t->burst;
+	qdisc_backlog(&t->queue, qc);
+}
+
+static struct qdisc_ops tbf_ops = {
+	"tbf",
+	sizeof(struct tbf_data),
+	tbf_init,
+	tbf_enqueue,
+	tbf_dequeue,
+	tbf_requeue,
+	tbf_reset,
+	tbf_destroy,
+	tbf_dump
+};
+
+
+/*
+ *	sfq: stochastic fair queueing. Frames are hashed on their addresses,
+ *	protocol and ports onto SFQ_HASH lists. The lists holding frames are
+ *	on a ring that is served round robin, each getting qc_quantum bytes
+ *	a turn (deficit round robin, so big frames don't get more than their
+ *	share). Flows that collide share a list, so the hash is reseeded
+ *	every qc_perturb seconds to keep any two from being stuck together.
+ *	When q->limit frames are queued the longest list loses its last one.
+ */
+
+#define SFQ_HASH	128
+#define SFQ_NONE	(-1)
+
+struct sfq_data
+{
+	unsigned long		quantum;
+	unsigned long		perturb;	/* jiffies, 0 for never		*/
+	unsigned long		seed;
+	unsigned long		qlen;		/* at least the frames queued	*/
+	int			tail;		/* last list on the ring	*/
+	short			next[SFQ_HASH];	/* ring of busy lists		*/
+	unsigned char		active[SFQ_HASH]; /* list is on the ring	*/
+	long			allot[SFQ_HASH];  /* bytes left this turn	*/
+	struct timer_list	timer;
+	struct sk_buff_head	queue[SFQ_HASH];
+};
+
+static void sfq_perturb(unsigned long data)
+{
+	struct sfq_data *s = (struct sfq_data *)data;
+
+	s->seed = s->seed * 69069 + jiffies;
+	s->timer.expires = s->perturb;
+	add_timer(&s->timer);
+}
+
+static int sfq_init(struct Qdisc *q, struct qdisc_conf *qc)
+{
+	struct sfq_data *s = (struct sfq_data *)q->data;
+	int i;
+
+	s->quantum = qc->qc_quantum;
+	if (s->quantum == 0)
+		s->quantum = q->dev->mtu + q->dev->hard_header_len;
+	s->perturb = qc->qc_perturb * HZ;
+	s->seed = jiffies;
+	s->tail = SFQ_NONE;
+	for (i = 0; i < SFQ_HASH; i++)
+		skb_queue_head_init(&s->queue[i]);
+	init_timer(&s->timer);
+	s->timer.function = sfq_perturb;
+	s->timer.data = (unsigned long) s;
+	if (s->perturb)
+	{
+		s->timer.expires = s->perturb;
+		add_timer(&s->timer);
+	}
+	return 0;
+}
+
+/*
+ *	Frames IP has built carry skb->ip_hdr. Anything else (ARP and
+ *	friends) is hashed on its socket.
+ */
+
+static int sfq_hash(struct sfq_data *s, struct sk_buff *skb)
+{
+	struct iphdr *iph = skb->ip_hdr;
+	unsigned long h, h2;
+
+	if (iph != NULL && (unsigned char *)iph >= skb->data &&
+		(unsigned char *)(iph + 1) <= skb->data + skb->len)
+	{
+		h = iph->daddr;
+		h2 = iph->saddr ^ iph->protocol;
+		if (!(iph->frag_off & htons(IP_MF|IP_OFFSET)) &&
+			(iph->protocol == IPPROTO_TCP || iph->protocol == IPPROTO_UDP) &&
+			(unsigned char *)iph + iph->ihl * 4 + 4 <= skb->data + skb->len)
+			h2 ^= *(unsigned long *)((unsigned char *)iph + iph->ihl * 4);
+	}
+	else
+	{
+		h = (unsigned long) skb->sk;
+		h2 = 0;
+	}
+	h = ((h ^ s->seed) * 0x9E3779B1UL) ^ h2;
+	h = (h ^ (h >> 16)) * 0x9E3779B1UL;
+	return h >> 25;		/* top 7 bits: SFQ_HASH lists */
+}
+
+/*
+ *	Take list a, which is next after the tail, off the ring.
+ */
+
+static void sfq_unring(struct sfq_data *s, int a)
+{
+	if (s->next[a] == a)
+		s->tail = SFQ_NONE;
+	else
+		s->next[s->tail] = s->next[a];
+	s->active[a] = 0;
+}
+
+static int sfq_enqueue(struct sk_buff *skb, struct Qdisc *q)
+{
+	struct sfq_data *s = (struct sfq_data *)q->data;
+	int h = sfq_hash(s, skb);
+	int i, m;
+
+	skb_queue_tail(&s->queue[h], skb);
+	if (!s->active[h])
+	{
+		/* New flows join at the end of the round */
+		if (s->tail == SFQ_NONE)
+			s->next[h] = h;
+		else
+		{
+			s->next[h] = s->next[s->tail];
+			s->next[s->tail] = h;
+		}
+		s->tail = h;
+		s->active[h] = 1;
+		s->allot[h] = s->quantum;
+	}
+	if (++s->qlen <= q->limit)
+		return 0;
+
+	/*
+	 *	Over the limit, or TCP has taken some away behind our back.
+	 *	Count properly and drop from the longest list if we must.
+	 */
+
+	s->qlen = 0;
+	m = h;
+	for (i = 0; i < SFQ_HASH; i++)
+	{
+		s->qlen += skb_queue_len(&s->queue[i]);
+		if (skb_queue_len(&s->queue[i]) > skb_queue_len(&s->queue[m]))
+			m = i;
+	}
+	if (s->qlen <= q->limit)
+		return 0;
+	skb = s->queue[m].prev;
+	skb_unlink(skb);
+	s->qlen--;
+	qdisc_drop(skb, q);
+	return m == h;
+}
+
+static struct sk_buff *sfq_dequeue(struct Qdisc *q)
+{
+	struct sfq_data *s = (struct sfq_data *)q->data;
+	struct sk_buff *skb;
+	int a;
+
+	while (s->tail != SFQ_NONE)
+	{
+		a = s->next[s->tail];
+		if ((skb = skb_peek(&s->queue[a])) == NULL)
+		{
+			sfq_unring(s, a);
+			continue;
+		}
+		if (s->allot[a] <= 0)
+		{
+			/* Used its turn: top it up and go round */
+			s->allot[a] += s->quantum;
+			s->tail = a;
+			continue;
+		}
+		skb_unlink(skb);
+		if (s->qlen)
+			s->qlen--;
+		s->allot[a] -= skb->len;
+		if (skb_queue_len(&s->queue[a]) == 0)
+			sfq_unring(s, a);
+		return skb;
+	}
+	return NULL;
+}
+
+/*
+ *	The driver was busy. The frame goes back at the front of its list
+ *	and the list, with its allotment refunded, to the front of the ring
+ *	so it is what we try next.
+ */
+
+static void sfq_requeue(struct sk_buff *skb, struct Qdisc *q)
+{
+	struct sfq_data *s = (struct sfq_data *)q->data;
+	int h = sfq_hash(s, skb);
+
+	skb_queue_head(&s->queue[h], skb);
+	s->qlen++;
+	s->allot[h] += skb->len;
+	if (s->active[h])
+		return;
+	if (s->tail == SFQ_NONE)
+	{
+		s->next[h] = h;
+		s->tail = h;
+	}
+	else
+	{
+		s->next[h] = s->next[s->tail];
+		s->next[s->tail] = h;
+	}
+	s->active[h] = 1;
+}
+
+static void sfq_reset(struct Qdisc *q)
+{
+	struct sfq_data *s = (struct sfq_data *)q->data;
+	int i;
+
+	for (i = 0; i < SFQ_HASH; i++)
+	{
+		qdisc_purge(&s->queue[i]);
+		s->active[i] = 0;
+	}
+	s->tail = SFQ_NONE;
+	s->qlen = 0;
+}
+
+static void sfq_destroy(struct Qdisc *q)
+{
+	struct sfq_data *s = (struct sfq_data *)q->data;
+
+	del_timer(&s->timer);
+}
+
+static void sfq_dump(struct Qdisc *q, struct qdisc_conf *qc)
+{
+	struct sfq_data *s = (struct sfq_data *)q->data;
+	int i;
+
+	qc->qc_quantum = s->quantum;
+	qc->qc_perturb = s->perturb / HZ;
+	for (i = 0; i < SFQ_HASH; i++)
+		qdisc_backlog(&s->queue[i], qc);
+}
+
+static struct qdisc_ops sfq_ops = {
+	"sfq",
+	sizeof(struct sfq_data),
+	sfq_init,
+	sfq_enqueue,
+	sfq_dequeue,
+	sfq_requeue,
+	sfq_reset,
+	sfq_destroy,
+	sfq_dump
+};
+
+
+static struct qdisc_ops *qdisc_kinds[] = {
+	&pfifo_fast_ops,
+	&pfifo_ops,
+	&prio_ops,
+	&tbf_ops,
+	&sfq_ops,
+	NULL
+};
+
+/*
+ *	Build a qdisc for a device. Called from process context only.
+ */
+
+static struct Qdisc *qdisc_create(struct device *dev, struct qdisc_conf *qc, int *err)
+{
+	struct qdisc_ops **ops;
+	struct Qdisc *q;
+
+	for (ops = qdisc_kinds; *ops != NULL; ops++)
+		if (strcmp((*ops)->kind, qc->qc_kind) == 0)
+			break;
+	if (*ops == NULL)
+	{
+		*err = -ENOENT;
+		return NULL;
+	}
+	q = (struct Qdisc *)kmalloc(sizeof(struct Qdisc) + (*ops)->size, GFP_KERNEL);
+	if (q == NULL)
+	{
+		*err = -ENOMEM;
+		return NULL;
+	}
+	memset(q, 0, sizeof(struct Qdisc) + (*ops)->size);
+	q->ops = *ops;
+	q->dev = dev;
+	q->limit = qc->qc_limit ? qc->qc_limit : QDISC_DEFAULT_LIMIT;
+	if (q->ops->init && (*err = q->ops->init(q, qc)) != 0)
+	{
+		kfree_s(q, sizeof(struct Qdisc) + q->ops->size);
+		return NULL;
+	}
+	return q;
+}
+
+/*
+ *	Throw away a qdisc and anything still queued on it. The caller has
+ *	already taken it off the device.
+ */
+
+static void qdisc_destroy(struct Qdisc *q)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	q->ops->reset(q);
+	if (q->ops->destroy)
+		q->ops->destroy(q);
+	restore_flags(flags);
+	kfree_s(q, sizeof(struct Qdisc) + q->ops->size);
+}
+
+/*
+ *	dev_open() gives a device pfifo_fast the first time it comes up.
+ *	A qdisc that is set stays through down and up again.
+ */
+
+int qdisc_attach_default(struct device *dev)
+{
+	struct qdisc_conf qc;
+	int err = 0;
+
+	if (dev->qdisc != NULL)
+		return 0;
+	memset(&qc, 0, sizeof(qc));
+	strcpy(qc.qc_kind, pfifo_fast_ops.kind);
+	dev->qdisc = qdisc_create(dev, &qc, &err);
+	return err;
+}
+
+/*
+ *	Drop everything queued, used when the device goes down.
+ */
+
+void qdisc_reset(struct device *dev)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (dev->qdisc != NULL)
+		dev->qdisc->ops->reset(dev->qdisc);
+	restore_flags(flags);
+}
+
+/*
+ *	SIOCGIFQDISC and SIOCSIFQDISC. dev_ioctl() has done the suser()
+ *	check for the set. Setting a qdisc throws away the frames queued
+ *	on the old one.
+ */
+
+int qdisc_ioctl(unsigned int cmd, void *arg)
+{
+	struct qdisc_conf qc;
+	struct device *dev;
+	struct Qdisc *q, *old;
+	unsigned long flags;
+	int err;
+
+	err = verify_area(cmd == SIOCGIFQDISC ? VERIFY_WRITE : VERIFY_READ, arg, sizeof(qc));
+	if (err)
+		return err;
+	memcpy_fromfs(&qc, arg, sizeof(qc));
+	qc.qc_dev[IFNAMSIZ - 1] = 0;
+	qc.qc_kind[QDISC_NAMSIZ - 1] = 0;
+	if ((dev = dev_get(qc.qc_dev)) == NULL)
+		return -ENODEV;
+
+	switch (cmd)
+	{
+		case SIOCGIFQDISC:
+			memset(qc.qc_kind, 0, sizeof(qc) - IFNAMSIZ);
+			save_flags(flags);
+			cli();
+			if ((q = dev->qdisc) != NULL)
+			{
+				strcpy(qc.qc_kind, q->ops->kind);
+				qc.qc_limit = q->limit;
+				qc.qc_stats = q->stats;
+				qc.qc_stats.qlen = 0;
+				qc.qc_stats.backlog = 0;
+				q->ops->dump(q, &qc);
+			}
+			restore_flags(flags);
+			memcpy_tofs(arg, &qc, sizeof(qc));
+			return 0;
+
+		case SIOCSIFQDISC:
+			q = qdisc_create(dev, &qc, &err);
+			if (q == NULL)
+				return err;
+			save_flags(flags);
+			cli();
+			old = dev->qdisc;
+			dev->qdisc = q;
+			restore_flags(flags);
+			if (old != NULL)
+				qdisc_destroy(old);
+			return 0;
+	}
+	return -EINVAL;
+}
+
+/*
+ *	/proc/net/qdisc
+ */
+
+int qdisc_get_info(char *buffer, char **start, off_t offset, int length)
+{
+	struct qdisc_conf qc;
+	struct device *dev;
+	struct Qdisc *q;
+	unsigned long flags;
+	off_t pos = 0, begin = 0;
+	int len;
+
+	len = sprintf(buffer, "Iface  Kind        Limit  Qlen  Backlog    Packets      Bytes  Drops Overlim Requeue\n");
+	pos = len;
+
+	for (dev = dev_base; dev != NULL; dev = dev->next)
+	{
+		save_flags(flags);
+		cli();
+		if ((q = dev->qdisc) == NULL)
+		{
+			restore_flags(flags);
+			continue;
+		}
+		memset(&qc, 0, sizeof(qc));
+		q->ops->dump(q, &qc);
+		len += sprintf(buffer + len, "%-6s %-10s %6lu %5lu %8lu %10lu %10lu %6lu %7lu %7lu\n",
+			dev->name, q->ops->kind, q->limit,
+			qc.qc_stats.qlen, qc.qc_stats.backlog,
+			q->stats.packets, q->stats.bytes, q->stats.drops,
+			q->stats.overlimits, q->stats.requeues);
+		restore_flags(flags);
+		pos = begin + len;
+		if (pos < offset)
+		{
+			len = 0;
+			begin = pos;
+		}
+		if (pos > offset + length)
+			break;
+	}
+	*start = buffer + (offset - begin);
+	len -= (offset - begin);
+	if (len > length)
+		len = length;
+	return len;
+}
@@ -68,6 +68,7 @@
  *		Bjorn Ekwall	:	Removed ip_csum (from slhc.c too)
  *		Bjorn Ekwall	:	Moved ip_fast_csum to ip.h (inline!)
  *		Stefan Becker   :       Send out ICMP HOST REDIRECT
+ *		Fragment queues	:	Hashed, memory limited, /proc/net/ip_frag.
  *  
  *
  * To Fix:
@@ -115,6 +116,7 @@
 #include "arp.h"
 #include "icmp.h"
 #include "raw.h"
+#include "checksum.h"
 #include <linux/igmp.h>
 #include <linux/ip_fw.h>
 
@@ -502,46 +504,7 @@ do_options(struct iphdr *iph, struct options *opt)
 
 unsigned short ip_compute_csum(unsigned char * buff, int len)
 {
-	unsigned long sum = 0;
-
-	/* Do the first multiple of 4 bytes and convert to 16 bits. */
-	if (len > 3)
-	{
-		__asm__("clc\n"
-		"1:\t"
-		"lodsl\n\t"
-		"adcl %%eax, %%ebx\n\t"
-		"loop 1b\n\t"
-		"adcl $0, %%ebx\n\t"
-		"movl %%ebx, %%eax\n\t"
-		"shrl $16, %%eax\n\t"
-		"addw %%ax, %%bx\n\t"
-		"adcw $0, %%bx"
-		: "=b" (sum) , "=S" (buff)
-		: "0" (sum), "c" (len >> 2) ,"1" (buff)
-		: "ax", "cx", "si", "bx" );
-	}
-	if (len & 2)
-	{
-		__asm__("lodsw\n\t"
-		"addw %%ax, %%bx\n\t"
-		"adcw $0, %%bx"
-		: "=b" (sum), "=S" (buff)
-		: "0" (sum), "1" (buff)
-		: "bx", "ax", "si");
-	}
-	if (len & 1)
-	{
-		__asm__("lodsb\n\t"
-		"movb $0, %%ah\n\t"
-		"addw %%ax, %%bx\n\t"
-		"adcw $0, %%bx"
-		: "=b" (sum), "=S" (buff)
-		: "0" (sum), "1" (buff)
-		: "bx", "ax", "si");
-	}
-	sum =~sum;
-	return(sum & 0xffff);
+	return csum_fold(csum_partial(buff, len, 0));
 }
 
 /*
@@ -562,7 +525,69 @@ void ip_send_check(struct iphdr *iph)
  *	happily and handles things quite well.
  */
 
-static struct ipq *ipqueue = NULL;		/* IP fragment queue	*/
+/*
+ *	Queues are hashed on (id, saddr, daddr, protocol), so finding the
+ *	queue for a fragment doesn't mean walking every incomplete datagram
+ *	we have. They are also on a list in the order they were created,
+ *	which is the order they go in when the memory they hold gets past
+ *	ipfrag_high_thresh.
+ */
+
+#define IPQ_HASHSZ	64
+
+static struct ipq *ipq_hash[IPQ_HASHSZ];	/* IP fragment queues	*/
+static struct ipq *ipq_oldest = NULL;
+static struct ipq *ipq_newest = NULL;
+
+int ipfrag_high_thresh = IPFRAG_HIGH_THRESH;
+int ipfrag_low_thresh = IPFRAG_LOW_THRESH;
+
+static int ip_frag_mem = 0;		/* Memory held by incomplete datagrams */
+
+static struct {
+	unsigned long	queues;		/* incomplete datagrams now	*/
+	unsigned long	created;
+	unsigned long	reassembled;
+	unsigned long	timeouts;
+	unsigned long	evicted;	/* thrown out for memory	*/
+	unsigned long	dropped;	/* fragments we had no room for	*/
+} ipfrag_stats;
+
+static __inline__ int ipqhashfn(unsigned short id, unsigned long saddr,
+	unsigned long daddr, unsigned char prot)
+{
+	unsigned long h = id ^ saddr ^ daddr ^ prot;
+
+	h ^= h >> 16;
+	h ^= h >> 8;
+	return h & (IPQ_HASHSZ - 1);
+}
+
+/*
+ *	Memory handling for the fragment code. Everything a queue holds
+ *	is counted in ip_frag_mem.
+ */
+
+static __inline__ void *frag_kmalloc(int size, int priority)
+{
+	void *vp = kmalloc(size, priority);
+
+	if (vp != NULL)
+		ip_frag_mem += size;
+	return vp;
+}
+
+static __inline__ void frag_kfree_s(void *ptr, int len)
+{
+	ip_frag_mem -= len;
+	kfree_s(ptr, len);
+}
+
+static __inline__ void frag_kfree_skb(struct sk_buff *skb)
+{
+	ip_frag_mem -= skb->truesize;
+	kfree_skb(skb, FREE_READ);
+}
 
 /*
  *	Create a new fragment entry.
@@ -572,7 +597,7 @@ static struct ipfrag *ip_frag_create(int offset, int end, struct sk_buff *skb, u
 {
 	struct ipfrag *fp;
 
-	fp = (struct ipfrag *) kmalloc(sizeof(struct ipfrag), GFP_ATOMIC);
+	fp = (struct ipfrag *) frag_kmalloc(sizeof(struct ipfrag), GFP_ATOMIC);
 	if (fp == NULL)
 	{
 		printk("IP: frag_create: no memory left !\n");
@@ -587,6 +612,9 @@ static struct ipfrag *ip_frag_create(int offset, int end, struct sk_buff *skb, u
 	fp->skb = skb;
 	fp->ptr = ptr;
 
+	/* The fragment's buffer is ours now */
+	ip_frag_mem += skb->truesize;
+
 	return(fp);
 }
 
@@ -599,11 +627,10 @@ static struct ipfrag *ip_frag_create(int offset, int end, struct sk_buff *skb, u
 static struct ipq *ip_find(struct iphdr *iph)
 {
 	struct ipq *qp;
-	struct ipq *qplast;
 
 	cli();
-	qplast = NULL;
-	for(qp = ipqueue; qp != NULL; qplast = qp, qp = qp->next)
+	for(qp = ipq_hash[ipqhashfn(iph->id, iph->saddr, iph->daddr, iph->protocol)];
+		qp != NULL; qp = qp->next)
 	{
 		if (iph->id== qp->iph->id && iph->saddr == qp->iph->saddr &&
 			iph->daddr == qp->iph->daddr && iph->protocol == qp->iph->protocol)
@@ -638,17 +665,21 @@ static void ip_free(struct ipq *qp)
 	/* Remove this entry from the "incomplete datagrams" queue. */
 	cli();
 	if (qp->prev == NULL)
-	{
-		ipqueue = qp->next;
-		if (ipqueue != NULL)
-			ipqueue->prev = NULL;
-	}
+		ipq_hash[ipqhashfn(qp->iph->id, qp->iph->saddr, qp->iph->daddr, qp->iph->protocol)] = qp->next;
 	else
-	{
 		qp->prev->next = qp->next;
-		if (qp->next != NULL)
-			qp->next->prev = qp->prev;
-	}
+	if (qp->next != NULL)
+		qp->next->prev = qp->prev;
+
+	if (qp->lru_prev == NULL)
+		ipq_oldest = qp->lru_next;
+	else
+		qp->lru_prev->lru_next = qp->lru_next;
+	if (qp->lru_next == NULL)
+		ipq_newest = qp->lru_prev;
+	else
+		qp->lru_next->lru_prev = qp->lru_prev;
+	ipfrag_stats.queues--;
 
 	/* Release all fragment data. */
 
@@ -657,19 +688,19 @@ static void ip_free(struct ipq *qp)
 	{
 		xp = fp->next;
 		IS_SKB(fp->skb);
-		kfree_skb(fp->skb,FREE_READ);
-		kfree_s(fp, sizeof(struct ipfrag));
+		frag_kfree_skb(fp->skb);
+		frag_kfree_s(fp, sizeof(struct ipfrag));
 		fp = xp;
 	}
 
 	/* Release the MAC header. */
-	kfree_s(qp->mac, qp->maclen);
+	frag_kfree_s(qp->mac, qp->maclen);
 
 	/* Release the IP header. */
-	kfree_s(qp->iph, qp->ihlen + 8);
+	frag_kfree_s(qp->iph, qp->ihlen + 8);
 
 	/* Finally, release the queue descriptor itself. */
-	kfree_s(qp, sizeof(struct ipq));
+	frag_kfree_s(qp, sizeof(struct ipq));
 	sti();
 }
 
@@ -690,6 +721,7 @@ static void ip_expire(unsigned long arg)
 
 	ip_statistics.IpReasmTimeout++;
 	ip_statistics.IpReasmFails++;   
+	ipfrag_stats.timeouts++;
 	/* This if is always true... shrug */
 	if(qp->fragments!=NULL)
 		icmp_send(qp->fragments->skb,ICMP_TIME_EXCEEDED,
@@ -702,6 +734,24 @@ static void ip_expire(unsigned long arg)
 }
 
 
+/*
+ *	Memory limiting on fragments. Throw away the oldest queues until we
+ *	are back under the low mark. A flood of fragments that never make
+ *	up a datagram can then only cost us ipfrag_high_thresh, and what
+ *	goes first is what is least likely ever to be completed.
+ */
+
+static void ip_evictor(void)
+{
+	while (ip_frag_mem > ipfrag_low_thresh && ipq_oldest != NULL)
+	{
+		ip_statistics.IpReasmFails++;
+		ipfrag_stats.evicted++;
+		ip_free(ipq_oldest);
+	}
+}
+
+
 /*
  * 	Add an entry to the 'ipq' queue for a newly received IP datagram.
  * 	We will (hopefully :-) receive all other fragments of this datagram
@@ -712,15 +762,15 @@ static void ip_expire(unsigned long arg)
 static struct ipq *ip_create(struct sk_buff *skb, struct iphdr *iph, struct device *dev)
 {
 	struct ipq *qp;
+	struct ipq **head;
 	int maclen;
 	int ihlen;
 
-	qp = (struct ipq *) kmalloc(sizeof(struct ipq), GFP_ATOMIC);
+	qp = (struct ipq *) frag_kmalloc(sizeof(struct ipq), GFP_ATOMIC);
 	if (qp == NULL)
 	{
 		printk("IP: create: no memory left !\n");
 		return(NULL);
-		skb->dev = qp->dev;
 	}
 	memset(qp, 0, sizeof(struct ipq));
 
@@ -732,11 +782,11 @@ static struct ipq *ip_create(struct sk_buff *skb, struct iphdr *iph, struct devi
 	 */
 
 	maclen = ((unsigned long) iph) - ((unsigned long) skb->data);
-	qp->mac = (unsigned char *) kmalloc(maclen, GFP_ATOMIC);
+	qp->mac = (unsigned char *) frag_kmalloc(maclen, GFP_ATOMIC);
 	if (qp->mac == NULL)
 	{
 		printk("IP: create: no memory left !\n");
-		kfree_s(qp, sizeof(struct ipq));
+		frag_kfree_s(qp, sizeof(struct ipq));
 		return(NULL);
 	}
 
@@ -745,12 +795,12 @@ static struct ipq *ip_create(struct sk_buff *skb, struct iphdr *iph, struct devi
 	 */
 
 	ihlen = (iph->ihl * sizeof(unsigned long));
-	qp->iph = (struct iphdr *) kmalloc(ihlen + 8, GFP_ATOMIC);
+	qp->iph = (struct iphdr *) frag_kmalloc(ihlen + 8, GFP_ATOMIC);
 	if (qp->iph == NULL)
 	{
 		printk("IP: create: no memory left !\n");
-		kfree_s(qp->mac, maclen);
-		kfree_s(qp, sizeof(struct ipq));
+		frag_kfree_s(qp->mac, maclen);
+		frag_kfree_s(qp, sizeof(struct ipq));
 		return(NULL);
 	}
 
@@ -769,13 +819,24 @@ static struct ipq *ip_create(struct sk_buff *skb, struct iphdr *iph, struct devi
 	qp->timer.function = ip_expire;			/* expire function	*/
 	add_timer(&qp->timer);
 
-	/* Add this entry to the queue. */
+	/* Add this entry to its hash chain, and as the newest queue. */
+	head = &ipq_hash[ipqhashfn(iph->id, iph->saddr, iph->daddr, iph->protocol)];
 	qp->prev = NULL;
 	cli();
-	qp->next = ipqueue;
+	qp->next = *head;
 	if (qp->next != NULL)
 		qp->next->prev = qp;
-	ipqueue = qp;
+	*head = qp;
+
+	qp->lru_next = NULL;
+	qp->lru_prev = ipq_newest;
+	if (ipq_newest != NULL)
+		ipq_newest->lru_next = qp;
+	else
+		ipq_oldest = qp;
+	ipq_newest = qp;
+	ipfrag_stats.queues++;
+	ipfrag_stats.created++;
 	sti();
 	return(qp);
 }
@@ -883,6 +944,7 @@ static struct sk_buff *ip_glue(struct ipq *qp)
 	skb->ip_hdr = iph;
 
 	ip_statistics.IpReasmOKs++;
+	ipfrag_stats.reassembled++;
 	return(skb);
 }
 
@@ -903,6 +965,10 @@ static struct sk_buff *ip_defrag(struct iphdr *iph, struct sk_buff *skb, struct
 
 	ip_statistics.IpReasmReqds++;
 
+	/* Start by making room if we are holding too much already. */
+	if (ip_frag_mem > ipfrag_high_thresh)
+		ip_evictor();
+
 	/* Find the entry of this IP datagram in the "incomplete datagrams" queue. */
 	qp = ip_find(iph);
 
@@ -943,6 +1009,7 @@ static struct sk_buff *ip_defrag(struct iphdr *iph, struct sk_buff *skb, struct
 			skb->sk = NULL;
 			kfree_skb(skb, FREE_READ);
 			ip_statistics.IpReasmFails++;
+			ipfrag_stats.dropped++;
 			return NULL;
 		}
 	}
@@ -1020,11 +1087,11 @@ static struct sk_buff *ip_defrag(struct iphdr *iph, struct sk_buff *skb, struct
 			else
 				qp->fragments = next->next;
 
-			if (tfp->next != NULL)
-				next->next->prev = next->prev;
+			if (tfp != NULL)
+				tfp->prev = next->prev;
 
-			kfree_skb(next->skb,FREE_READ);
-			kfree_s(next, sizeof(struct ipfrag));
+			frag_kfree_skb(next->skb);
+			frag_kfree_s(next, sizeof(struct ipfrag));
 		}
 	}
 
@@ -1043,6 +1110,7 @@ static struct sk_buff *ip_defrag(struct iphdr *iph, struct sk_buff *skb, struct
 	{
 		skb->sk = NULL;
 		kfree_skb(skb, FREE_READ);
+		ipfrag_stats.dropped++;
 		return NULL;
 	}
 	tfp->prev = prev;
@@ -1070,6 +1138,58 @@ static struct sk_buff *ip_defrag(struct iphdr *iph, struct sk_buff *skb, struct
 }
 
 
+/*
+ *	/proc/net/ip_frag: the reassembly statistics, then one line for
+ *	each incomplete datagram.
+ */
+
+int ip_frag_get_info(char *buffer, char **start, off_t offset, int length)
+{
+	off_t pos=0, begin=0;
+	struct ipq *qp;
+	struct ipfrag *fp;
+	unsigned long flags;
+	int len, nfrags, have;
+
+	save_flags(flags);
+	cli();
+	len = sprintf(buffer, "Queues Memory    High     Low Created Reasm Timeout Evicted Dropped\n"
+		"%6lu %6d %7d %7d %7lu %5lu %7lu %7lu %7lu\n"
+		"Source   Destination Id   Proto Frags Bytes  Length Expires\n",
+		ipfrag_stats.queues, ip_frag_mem, ipfrag_high_thresh, ipfrag_low_thresh,
+		ipfrag_stats.created, ipfrag_stats.reassembled, ipfrag_stats.timeouts,
+		ipfrag_stats.evicted, ipfrag_stats.dropped);
+	pos = len;
+
+	for (qp = ipq_oldest; qp != NULL; qp = qp->lru_next)
+	{
+		nfrags = have = 0;
+		for (fp = qp->fragments; fp != NULL; fp = fp->next)
+		{
+			nfrags++;
+			have += fp->len;
+		}
+		len += sprintf(buffer+len, "%08lX %08lX    %04X %5d %5d %5d %7d %7lu\n",
+			qp->iph->saddr, qp->iph->daddr, ntohs(qp->iph->id),
+			qp->iph->protocol, nfrags, have, qp->len, qp->timer.expires - jiffies);
+		pos = begin + len;
+		if (pos < offset)
+		{
+			len = 0;
+			begin = pos;
+		}
+		if (pos > offset + length)
+			break;
+	}
+	restore_flags(flags);
+	*start = buffer + (offset - begin);
+	len -= (offset - begin);
+	if (len > length)
+		len = length;
+	return len;
+}
+
+
 /*
  *	This IP datagram is too large to be sent in one piece.  Break it up into
  *	smaller pieces (each of size equal to the MAC header plus IP header plus
@@ -1287,25 +1407,19 @@ static void ip_forward(struct sk_buff *skb, struct device *dev, int is_frag)
 	 *	We may not generate an ICMP for an ICMP. icmp_send does the
 	 *	enforcement of this so we can forget it here. It is however
 	 *	sometimes VERY important.
+	 *
+	 *	The received buffer may be shared with a packet tap, so it is
+	 *	left alone: the TTL is decreased in the copy we send.
 	 */
 
 	iph = skb->h.iph;
-	iph->ttl--;
-	if (iph->ttl <= 0)
+	if (iph->ttl <= 1)
 	{
 		/* Tell the sender its packet died... */
 		icmp_send(skb, ICMP_TIME_EXCEEDED, ICMP_EXC_TTL, 0, dev);
 		return;
 	}
 
-	/*
-	 *	Re-compute the IP header checksum.
-	 *	This is inefficient. We know what has happened to the header
-	 *	and could thus adjust the checksum as Phil Karn does in KA9Q
-	 */
-
-	ip_send_check(iph);
-
 	/*
 	 * OK, the packet is still valid.  Fetch its destination address,
 	 * and give it to the IP sender for further processing.
@@ -1407,6 +1521,15 @@ static void ip_forward(struct sk_buff *skb, struct device *dev, int is_frag)
 		 */
 		memcpy(ptr + dev2->hard_header_len, skb->h.raw, skb->len);
 
+		/*
+		 *	Decrease the TTL. We know what has happened to the
+		 *	header, so the checksum is adjusted as Phil Karn does
+		 *	in KA9Q rather than recomputed.
+		 */
+
+		iph = (struct iphdr *)(ptr + dev2->hard_header_len);
+		ip_decrease_ttl(iph);
+
 		/* Now build the MAC header. */
 		(void) ip_send(skb2, raddr, skb->len, dev2, dev2->pa_addr);
 
@@ -65,11 +65,22 @@ struct ipq	 {
   short 	maclen;		/* length of the MAC header		*/
   struct timer_list timer;	/* when will this queue expire?		*/
   struct ipfrag		*fragments;	/* linked list of received fragments	*/
-  struct ipq	*next;		/* linked list pointers			*/
+  struct ipq	*next;		/* hash chain pointers			*/
   struct ipq	*prev;
+  struct ipq	*lru_next;	/* all queues, oldest first		*/
+  struct ipq	*lru_prev;
   struct device *dev;		/* Device - for icmp replies */
 };
 
+/*
+ *	Incomplete datagrams may hold this much memory. Past the high mark
+ *	the oldest are thrown away until we are under the low mark again.
+ */
+#define IPFRAG_HIGH_THRESH	(256*1024)
+#define IPFRAG_LOW_THRESH	(192*1024)
+
+extern int		ip_frag_get_info(char *buffer, char **start, off_t offset, int length);
+
 
 extern int		backoff(int n);
 
@@ -127,4 +138,18 @@ static inline unsigned short ip_fast_csum(unsigned char * buff, int wlen)
 	}
 	return (~sum) & 0xffff;
 }
+
+/*
+ *	Decrease the TTL and patch up the header checksum to match
+ *	(RFC 1141). The TTL is the high byte of its 16 bit word.
+ */
+
+static inline void ip_decrease_ttl(struct iphdr *iph)
+{
+	unsigned long check = iph->check;
+
+	check += htons(0x0100);
+	iph->check = check + (check >= 0xFFFF);
+	iph->ttl--;
+}
 #endif	/* _IP_H */
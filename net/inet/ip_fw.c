@@ -19,6 +19,8 @@
  *	Porting bidirectional entries from BSD, fixing accounting issues,
  *	adding struct ip_fwpkt for checking packets with interface address
  *		Jos Vos 5/Mar/1995.
+ *	Chains are compiled into per-protocol indexes, so that a packet
+ *	is only checked against the rules that can match it.
  *
  *	All the real work was done by .....
  */
@@ -134,6 +136,528 @@ extern inline int port_match(unsigned short *portptr,int nports,unsigned short p
 
 #if defined(CONFIG_IP_ACCT) || defined(CONFIG_IP_FIREWALL)
 
+/*
+ *	Compiled chains.
+ *
+ *	Walking a long chain rule by rule for every packet is slow, so each
+ *	chain also has an index that gives, for a packet, the rules that
+ *	could match it. The rules are still checked in chain order with
+ *	the full test below, so first-match semantics and the counters in
+ *	the rules are just as before: the index only skips rules that can't
+ *	match.
+ *
+ *	There is one index per protocol (TCP, UDP, ICMP, anything else),
+ *	holding the rules for that protocol and the "all" rules. Each rule
+ *	goes into one list:
+ *
+ *	- a rule for a single destination host is hashed on that address,
+ *	- else a rule for a single source host is hashed on that,
+ *	- else a TCP/UDP rule with destination ports goes into the port
+ *	  intervals: the port space is cut at every port range boundary of
+ *	  these rules, and each interval lists the rules covering it,
+ *	- and everything else (including bidirectional rules) is always
+ *	  looked at.
+ *
+ *	All lists are in chain order, and a lookup merges the lists that
+ *	apply. The index is rebuilt, with interrupts off, whenever the
+ *	chain changes. If there isn't the memory for it the chain is simply
+ *	walked as it used to be.
+ */
+
+#define FW_NPROTO	4		/* indexed by IP_FW_F_KIND */
+#define FW_HASH		64
+#define FW_MAX_ILIST	8192		/* don't let the intervals get silly */
+#define FW_NONE		0xFFFF
+
+#define fw_hashfn(addr) \
+	(((addr) ^ ((addr) >> 8) ^ ((addr) >> 16) ^ ((addr) >> 24)) & (FW_HASH - 1))
+
+#define FW_CL_DST	0
+#define FW_CL_SRC	1
+#define FW_CL_PORT	2
+#define FW_CL_ANY	3
+
+struct fw_hent
+{
+	__u32		fh_addr;
+	unsigned short	fh_rule;
+};
+
+struct fw_index
+{
+	unsigned short	fi_hash[2][FW_HASH+1];	/* first entry of each chain */
+	struct fw_hent	*fi_hent[2];		/* by destination, by source */
+	int		fi_nint, fi_ncut;	/* intervals, and room for them */
+	unsigned short	*fi_bound;		/* lowest port of each interval */
+	unsigned short	*fi_istart;		/* first fi_ilist entry of each */
+	unsigned short	*fi_ilist;
+	unsigned short	*fi_any;
+	int		fi_nany;
+};
+
+struct fw_compiled
+{
+	struct ip_fw	*fc_head;		/* the chain this was built from */
+	int		fc_nrules;
+	struct ip_fw	**fc_rules;
+	struct fw_index	fc_index[FW_NPROTO];
+};
+
+static struct fw_slot
+{
+	struct ip_fw *volatile *fs_chainptr;
+	struct fw_compiled *fs_compiled;
+} fw_slots[3];
+
+/*
+ *	Walking the candidates for a packet.
+ */
+
+struct fw_iter
+{
+	struct fw_compiled *fc;
+	struct ip_fw	*f;			/* when walking the plain chain */
+	struct fw_hent	*h[2], *hend[2];
+	__u32		addr[2];
+	unsigned short	*il, *ilend;
+	unsigned short	*any, *anyend;
+};
+
+static int fw_dst_ranges(struct ip_fw *f, unsigned short *lo, unsigned short *hi)
+{
+	unsigned short *p = &f->fw_pts[f->fw_nsp];
+	int n = f->fw_ndp, i = 0;
+
+	if (f->fw_flg & IP_FW_F_DRNG)
+	{
+		if (p[0] <= p[1])
+		{
+			lo[i] = p[0];
+			hi[i++] = p[1];
+		}
+		p += 2;
+		n -= 2;
+	}
+	while (n-- > 0)
+	{
+		lo[i] = hi[i] = *p;
+		i++;
+		p++;
+	}
+	return i;
+}
+
+static int fw_class(struct ip_fw *f, int prt, int ports)
+{
+	if (f->fw_flg & IP_FW_F_BIDIR)
+		return FW_CL_ANY;
+	if (f->fw_dmsk.s_addr == 0xFFFFFFFF)
+		return FW_CL_DST;
+	if (f->fw_smsk.s_addr == 0xFFFFFFFF)
+		return FW_CL_SRC;
+	if (ports && (f->fw_flg & IP_FW_F_KIND) == prt && f->fw_ndp)
+		return FW_CL_PORT;
+	return FW_CL_ANY;
+}
+
+static void fw_sort(unsigned short *v, int n)
+{
+	int gap, i, j;
+	unsigned short t;
+
+	for (gap = n / 2; gap > 0; gap /= 2)
+		for (i = gap; i < n; i++)
+			for (j = i - gap; j >= 0 && v[j] > v[j + gap]; j -= gap)
+			{
+				t = v[j];
+				v[j] = v[j + gap];
+				v[j + gap] = t;
+			}
+}
+
+static void *fw_alloc(int size, int *failed)
+{
+	void *p;
+
+	if (size <= 0)
+		return NULL;
+	p = kmalloc(size, GFP_ATOMIC);
+	if (p == NULL)
+		*failed = 1;
+	return p;
+}
+
+#define fw_free(p,size)	do { if (p) kfree_s((p), (size)); } while (0)
+
+static void fw_free_compiled(struct fw_compiled *fc)
+{
+	struct fw_index *fi;
+	int prt;
+
+	if (fc == NULL)
+		return;
+	for (prt = 0; prt < FW_NPROTO; prt++)
+	{
+		fi = &fc->fc_index[prt];
+		fw_free(fi->fi_hent[0], fi->fi_hash[0][FW_HASH] * sizeof(struct fw_hent));
+		fw_free(fi->fi_hent[1], fi->fi_hash[1][FW_HASH] * sizeof(struct fw_hent));
+		fw_free(fi->fi_bound, fi->fi_ncut * sizeof(unsigned short));
+		if (fi->fi_istart)
+		{
+			fw_free(fi->fi_ilist, fi->fi_istart[fi->fi_nint] * sizeof(unsigned short));
+			kfree_s(fi->fi_istart, (fi->fi_ncut + 1) * sizeof(unsigned short));
+		}
+		fw_free(fi->fi_any, fi->fi_nany * sizeof(unsigned short));
+	}
+	fw_free(fc->fc_rules, fc->fc_nrules * sizeof(struct ip_fw *));
+	kfree_s(fc, sizeof(*fc));
+}
+
+/*
+ *	The interval a port is in.
+ */
+
+static inline int fw_find_port(unsigned short *bound, int n, unsigned short port)
+{
+	int lo = 0, hi = n - 1, mid;
+
+	while (lo < hi)
+	{
+		mid = (lo + hi + 1) / 2;
+		if (bound[mid] <= port)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return lo;
+}
+
+/*
+ *	Go through the port rules of one protocol and the intervals each
+ *	covers, counting the list entries or filling them in. A rule can
+ *	cover an interval more than once, but is listed once.
+ */
+
+static int fw_scan_ports(struct fw_compiled *fc, struct fw_index *fi, int prt,
+	unsigned short *last, int fill)
+{
+	unsigned short lo[IP_FW_MAX_PORTS], hi[IP_FW_MAX_PORTS];
+	struct ip_fw *f;
+	int r, i, k, n, total = 0;
+
+	for (i = 0; i < fi->fi_nint; i++)
+		last[i] = FW_NONE;
+	for (r = 0; r < fc->fc_nrules; r++)
+	{
+		f = fc->fc_rules[r];
+		if ((f->fw_flg & IP_FW_F_KIND) != prt || fw_class(f, prt, 1) != FW_CL_PORT)
+			continue;
+		n = fw_dst_ranges(f, lo, hi);
+		for (k = 0; k < n; k++)
+		{
+			i = fw_find_port(fi->fi_bound, fi->fi_nint, lo[k]);
+			for (; i < fi->fi_nint && fi->fi_bound[i] <= hi[k]; i++)
+			{
+				if (last[i] == r)
+					continue;
+				last[i] = r;
+				if (fill)
+					fi->fi_ilist[fi->fi_istart[i + 1]++] = r;
+				else
+					fi->fi_istart[i + 1]++;
+				total++;
+			}
+		}
+	}
+	return total;
+}
+
+/*
+ *	Cut the port space up for the port rules of one protocol. Returns
+ *	0 if there isn't the memory, or if the lists would get too long:
+ *	the port rules then go on the "any" list.
+ */
+
+static int fw_build_ports(struct fw_compiled *fc, struct fw_index *fi, int prt)
+{
+	unsigned short lo[IP_FW_MAX_PORTS], hi[IP_FW_MAX_PORTS];
+	unsigned short *cut, *last = NULL;
+	struct ip_fw *f;
+	int r, i, k, n = 1, total, failed = 0;
+
+	for (r = 0; r < fc->fc_nrules; r++)
+	{
+		f = fc->fc_rules[r];
+		if ((f->fw_flg & IP_FW_F_KIND) == prt && fw_class(f, prt, 1) == FW_CL_PORT)
+			n += 2 * fw_dst_ranges(f, lo, hi);
+	}
+	if (n == 1)
+		return 1;
+	fi->fi_ncut = n;
+	cut = fi->fi_bound = fw_alloc(n * sizeof(unsigned short), &failed);
+	fi->fi_istart = fw_alloc((n + 1) * sizeof(unsigned short), &failed);
+	last = fw_alloc(n * sizeof(unsigned short), &failed);
+	if (failed)
+		goto fail;
+
+	/*
+	 *	The interval boundaries: 0, and the first port of and after
+	 *	every range.
+	 */
+	n = 0;
+	cut[n++] = 0;
+	for (r = 0; r < fc->fc_nrules; r++)
+	{
+		f = fc->fc_rules[r];
+		if ((f->fw_flg & IP_FW_F_KIND) != prt || fw_class(f, prt, 1) != FW_CL_PORT)
+			continue;
+		k = fw_dst_ranges(f, lo, hi);
+		for (i = 0; i < k; i++)
+		{
+			cut[n++] = lo[i];
+			if (hi[i] != 0xFFFF)
+				cut[n++] = hi[i] + 1;
+		}
+	}
+	fw_sort(cut, n);
+	for (i = k = 1; i < n; i++)
+		if (cut[i] != cut[k - 1])
+			cut[k++] = cut[i];
+	fi->fi_nint = k;
+
+	for (i = 0; i <= fi->fi_nint; i++)
+		fi->fi_istart[i] = 0;
+	total = fw_scan_ports(fc, fi, prt, last, 0);
+	if (total > FW_MAX_ILIST)
+		goto fail;
+	fi->fi_ilist = fw_alloc(total * sizeof(unsigned short), &failed);
+	if (failed)
+		goto fail;
+	/* fi_istart[i+1] is where interval i's next entry goes for now */
+	for (i = 1; i <= fi->fi_nint; i++)
+		fi->fi_istart[i] += fi->fi_istart[i - 1];
+	for (i = fi->fi_nint; i > 0; i--)
+		fi->fi_istart[i] = fi->fi_istart[i - 1];
+	fw_scan_ports(fc, fi, prt, last, 1);
+	kfree_s(last, fi->fi_ncut * sizeof(unsigned short));
+	return 1;
+
+fail:
+	fw_free(last, fi->fi_ncut * sizeof(unsigned short));
+	fw_free(fi->fi_bound, fi->fi_ncut * sizeof(unsigned short));
+	fw_free(fi->fi_istart, (fi->fi_ncut + 1) * sizeof(unsigned short));
+	fi->fi_bound = fi->fi_istart = NULL;
+	fi->fi_nint = fi->fi_ncut = 0;
+	return 0;
+}
+
+static inline int fw_in_proto(struct ip_fw *f, int prt)
+{
+	int kind = f->fw_flg & IP_FW_F_KIND;
+
+	return kind == IP_FW_F_ALL || kind == prt;
+}
+
+/*
+ *	Build the index for a chain. Called with interrupts off, so that
+ *	the chain can't change under us.
+ */
+
+static struct fw_compiled *fw_compile(struct ip_fw *chain)
+{
+	struct fw_compiled *fc;
+	struct fw_index *fi;
+	struct ip_fw *f;
+	unsigned short pos[2][FW_HASH];
+	int n, r, h, prt, cl, ports, failed = 0;
+
+	for (n = 0, f = chain; f != NULL; f = f->fw_next)
+		n++;
+	if (n == 0 || n >= FW_NONE)
+		return NULL;
+	fc = fw_alloc(sizeof(*fc), &failed);
+	if (fc == NULL)
+		return NULL;
+	memset(fc, 0, sizeof(*fc));
+	fc->fc_head = chain;
+	fc->fc_rules = fw_alloc(n * sizeof(struct ip_fw *), &failed);
+	if (failed)
+		goto fail;
+	fc->fc_nrules = n;
+	for (r = 0, f = chain; f != NULL; f = f->fw_next)
+		fc->fc_rules[r++] = f;
+
+	for (prt = 0; prt < FW_NPROTO; prt++)
+	{
+		fi = &fc->fc_index[prt];
+		ports = 0;
+		if (prt == IP_FW_F_TCP || prt == IP_FW_F_UDP)
+			ports = fw_build_ports(fc, fi, prt);
+
+		for (r = 0; r < n; r++)
+		{
+			f = fc->fc_rules[r];
+			if (!fw_in_proto(f, prt))
+				continue;
+			cl = fw_class(f, prt, ports);
+			if (cl == FW_CL_DST)
+				fi->fi_hash[0][fw_hashfn(f->fw_dst.s_addr) + 1]++;
+			else if (cl == FW_CL_SRC)
+				fi->fi_hash[1][fw_hashfn(f->fw_src.s_addr) + 1]++;
+			else if (cl == FW_CL_ANY)
+				fi->fi_nany++;
+		}
+		for (h = 0; h < FW_HASH; h++)
+		{
+			fi->fi_hash[0][h + 1] += fi->fi_hash[0][h];
+			fi->fi_hash[1][h + 1] += fi->fi_hash[1][h];
+			pos[0][h] = fi->fi_hash[0][h];
+			pos[1][h] = fi->fi_hash[1][h];
+		}
+		fi->fi_hent[0] = fw_alloc(fi->fi_hash[0][FW_HASH] * sizeof(struct fw_hent), &failed);
+		fi->fi_hent[1] = fw_alloc(fi->fi_hash[1][FW_HASH] * sizeof(struct fw_hent), &failed);
+		fi->fi_any = fw_alloc(fi->fi_nany * sizeof(unsigned short), &failed);
+		if (failed)
+			goto fail;
+
+		fi->fi_nany = 0;
+		for (r = 0; r < n; r++)
+		{
+			f = fc->fc_rules[r];
+			if (!fw_in_proto(f, prt))
+				continue;
+			cl = fw_class(f, prt, ports);
+			if (cl == FW_CL_DST || cl == FW_CL_SRC)
+			{
+				__u32 addr = (cl == FW_CL_DST) ? f->fw_dst.s_addr : f->fw_src.s_addr;
+				struct fw_hent *he;
+
+				h = fw_hashfn(addr);
+				he = fi->fi_hent[cl] + pos[cl][h]++;
+				he->fh_addr = addr;
+				he->fh_rule = r;
+			}
+			else if (cl == FW_CL_ANY)
+				fi->fi_any[fi->fi_nany++] = r;
+		}
+	}
+	return fc;
+
+fail:
+	fw_free_compiled(fc);
+	return NULL;
+}
+
+/*
+ *	The chain at *chainptr has changed: throw its old index away and
+ *	build a new one. Interrupts must be off from before the chain was
+ *	changed until this returns, so nobody uses an index that points at
+ *	rules that are gone.
+ */
+
+static void fw_recompile(struct ip_fw *volatile *chainptr)
+{
+	struct fw_slot *fs, *unused = NULL;
+
+	for (fs = fw_slots; fs < fw_slots + 3; fs++)
+	{
+		if (fs->fs_chainptr == chainptr)
+			break;
+		if (fs->fs_chainptr == NULL && unused == NULL)
+			unused = fs;
+	}
+	if (fs == fw_slots + 3)
+	{
+		if (unused == NULL)
+			return;
+		fs = unused;
+		fs->fs_chainptr = chainptr;
+	}
+	fw_free_compiled(fs->fs_compiled);
+	fs->fs_compiled = fw_compile(*chainptr);
+}
+
+/*
+ *	Start looking at the rules of a chain that could match a packet.
+ */
+
+static void fw_iter_start(struct fw_iter *it, struct ip_fw *chain, int prt,
+	__u32 src, __u32 dst, __u16 dst_port)
+{
+	struct fw_compiled *fc = NULL;
+	struct fw_index *fi;
+	int i, d, h;
+
+	for (i = 0; i < 3; i++)
+	{
+		fc = fw_slots[i].fs_compiled;
+		if (fc != NULL && fc->fc_head == chain)
+			break;
+		fc = NULL;
+	}
+	it->fc = fc;
+	it->f = chain;
+	if (fc == NULL)
+		return;
+	fi = &fc->fc_index[prt];
+	it->addr[0] = dst;
+	it->addr[1] = src;
+	for (d = 0; d < 2; d++)
+	{
+		h = fw_hashfn(it->addr[d]);
+		it->h[d] = fi->fi_hent[d] + fi->fi_hash[d][h];
+		it->hend[d] = fi->fi_hent[d] + fi->fi_hash[d][h + 1];
+	}
+	it->il = it->ilend = NULL;
+	if (fi->fi_nint)
+	{
+		i = fw_find_port(fi->fi_bound, fi->fi_nint, dst_port);
+		it->il = fi->fi_ilist + fi->fi_istart[i];
+		it->ilend = fi->fi_ilist + fi->fi_istart[i + 1];
+	}
+	it->any = fi->fi_any;
+	it->anyend = fi->fi_any + fi->fi_nany;
+}
+
+/*
+ *	The next rule, in chain order, that could match.
+ */
+
+static struct ip_fw *fw_iter_next(struct fw_iter *it)
+{
+	unsigned short r = FW_NONE;
+	struct ip_fw *f;
+	int d;
+
+	if (it->fc == NULL)
+	{
+		f = it->f;
+		if (f != NULL)
+			it->f = f->fw_next;
+		return f;
+	}
+	for (d = 0; d < 2; d++)
+	{
+		while (it->h[d] < it->hend[d] && it->h[d]->fh_addr != it->addr[d])
+			it->h[d]++;
+		if (it->h[d] < it->hend[d] && it->h[d]->fh_rule < r)
+			r = it->h[d]->fh_rule;
+	}
+	if (it->il < it->ilend && *it->il < r)
+		r = *it->il;
+	if (it->any < it->anyend && *it->any < r)
+		r = *it->any;
+	if (r == FW_NONE)
+		return NULL;
+	for (d = 0; d < 2; d++)
+		if (it->h[d] < it->hend[d] && it->h[d]->fh_rule == r)
+			it->h[d]++;
+	if (it->il < it->ilend && *it->il == r)
+		it->il++;
+	if (it->any < it->anyend && *it->any == r)
+		it->any++;
+	return it->fc->fc_rules[r];
+}
 
 /*
  *	Returns 0 if packet should be dropped, 1 if it should be accepted,
@@ -149,6 +673,7 @@ extern inline int port_match(unsigned short *portptr,int nports,unsigned short p
 int ip_fw_chk(struct iphdr *ip, struct device *rif, struct ip_fw *chain, int policy, int opt)
 {
 	struct ip_fw *f;
+	struct fw_iter		it;
 	struct tcphdr		*tcp=(struct tcphdr *)((unsigned long *)ip+ip->ihl);
 	struct udphdr		*udp=(struct udphdr *)((unsigned long *)ip+ip->ihl);
 	__u32			src, dst;
@@ -240,7 +765,8 @@ int ip_fw_chk(struct iphdr *ip, struct device *rif, struct ip_fw *chain, int pol
 		dprintf2(":%d ",dst_port);
 	dprintf1("\n");
 
-	for (f=chain;f;f=f->fw_next) 
+	for (fw_iter_start(&it, chain, prt, src, dst, dst_port);
+	     (f = fw_iter_next(&it)) != NULL; ) 
 	{
 		/*
 		 *	This is a bit simpler as we don't have to walk
@@ -418,6 +944,7 @@ static void free_fw_chain(struct ip_fw *volatile* chainptr)
 		*chainptr = ftmp->fw_next;
 		kfree_s(ftmp,sizeof(*ftmp));
 	}
+	fw_recompile(chainptr);
 	restore_flags(flags);
 }
 
@@ -593,6 +1120,7 @@ skip_check:
 					*chainptr=ftmp;
 					ftmp->fw_next=chtmp;
 				}
+				fw_recompile(chainptr);
 				restore_flags(flags);
 				return 0;
 			}
@@ -604,6 +1132,7 @@ skip_check:
 		chtmp_prev->fw_next=ftmp;
 	else
         	*chainptr=ftmp;
+	fw_recompile(chainptr);
 	restore_flags(flags);
 	return(0);
 }
@@ -675,6 +1204,7 @@ static int del_from_chain(struct ip_fw *volatile*chainptr, struct ip_fw *frwl)
 			ftmp = ftmp->fw_next;
 		 }
 	}
+	fw_recompile(chainptr);
 	restore_flags(flags);
 	if (was_found)
 		return 0;
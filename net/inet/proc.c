@@ -182,9 +182,6 @@ int snmp_get_info(char *buffer, char **start, off_t offset, int length)
 	extern struct tcp_mib tcp_statistics;
 	extern struct udp_mib udp_statistics;
 	int len;
-/*
-  extern unsigned long tcp_rx_miss, tcp_rx_hit1,tcp_rx_hit2;
-*/
 
 	len = sprintf (buffer,
 		"Ip: Forwarding DefaultTTL InReceives InHdrErrors InAddrErrors ForwDatagrams InUnknownProtos InDiscards InDelivers OutRequests OutDiscards OutNoRoutes ReasmTimeout ReasmReqds ReasmOKs ReasmFails FragOKs FragFails FragCreates\n"
@@ -231,11 +228,16 @@ int snmp_get_info(char *buffer, char **start, off_t offset, int length)
 		"Udp: InDatagrams NoPorts InErrors OutDatagrams\nUdp: %lu %lu %lu %lu\n",
 		    udp_statistics.UdpInDatagrams, udp_statistics.UdpNoPorts,
 		    udp_statistics.UdpInErrors, udp_statistics.UdpOutDatagrams);	    
-/*	
-	  len += sprintf( buffer + len,
-	  	"TCP fast path RX:  H2: %ul H1: %ul L: %ul\n",
-	  		tcp_rx_hit2,tcp_rx_hit1,tcp_rx_miss);
-*/
+
+	/*
+	 *	Our own counters go on a line of their own so that anything
+	 *	parsing the MIB lines above isn't upset.
+	 */
+
+	len += sprintf (buffer + len,
+		"TcpExt: PredAcks PredData SlowPath\nTcpExt: %lu %lu %lu\n",
+		    tcp_statistics.TcpPredAcks, tcp_statistics.TcpPredData,
+		    tcp_statistics.TcpSlowPath);
 	
 	if (offset >= len)
 	{
@@ -24,6 +24,8 @@
  *		Alan Cox	: 	MSS actually. Also added the window
  *					clamper.
  *		Sam Lantinga	:	Fixed route matching in rt_del()
+ *					Prefix trie for lookups, route cache
+ *					and /proc/net/rt_cache.
  *
  *		This program is free software; you can redistribute it and/or
  *		modify it under the terms of the GNU General Public License
@@ -64,6 +66,226 @@ static struct rtable *rt_base = NULL;
  
 static struct rtable *rt_loopback = NULL;
 
+/*
+ *	The routes are also kept in a path compressed binary trie on the
+ *	destination bits (in host order), so that the longest matching
+ *	prefix is found in at most 32 steps however many routes there are.
+ *	Every node stands for a prefix, and holds the route for exactly
+ *	that prefix if there is one. A node without a route is only there
+ *	because two subtrees fork at it.
+ *
+ *	Routes with a mask that isn't a prefix can't go in the trie. While
+ *	there are any, lookups walk rt_base like they used to.
+ */
+
+struct rt_node
+{
+	struct rt_node		*rn_child[2];
+	unsigned long		rn_key;		/* host order, masked */
+	int			rn_bits;	/* prefix length */
+	struct rtable		*rn_route;
+};
+
+static struct rt_node *rt_trie = NULL;
+static int rt_nodes = 0;
+static int rt_odd_masks = 0;
+
+#define rt_bitmask(bits)	((bits) ? ~0UL << (32 - (bits)) : 0UL)
+#define rt_bit(key,n)		(((key) >> (31 - (n))) & 1)
+
+/*
+ *	In front of all that there is a small cache of the last route
+ *	found for a destination. Any change to the routes or to an
+ *	interface address empties it.
+ */
+
+#define RT_CACHE_SIZE	256
+
+struct rt_cache_entry
+{
+	unsigned long		rc_dst;
+	struct rtable		*rc_rt;
+};
+
+static struct rt_cache_entry rt_cache[RT_CACHE_SIZE];
+static unsigned long rt_cache_hits = 0;
+static unsigned long rt_cache_misses = 0;
+static unsigned long rt_cache_flushes = 0;
+
+#define rt_cache_hash(daddr) \
+	(((daddr) ^ ((daddr) >> 8) ^ ((daddr) >> 16) ^ ((daddr) >> 24)) & (RT_CACHE_SIZE - 1))
+
+static inline void rt_cache_clear(void)
+{
+	memset(rt_cache, 0, sizeof(rt_cache));
+	rt_cache_flushes++;
+}
+
+void ip_rt_cache_flush(void)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	rt_cache_clear();
+	restore_flags(flags);
+}
+
+/*
+ *	The prefix length of a mask, or -1 if it isn't a prefix.
+ */
+
+static int rt_prefixlen(unsigned long mask)
+{
+	int bits = 0;
+
+	mask = ntohl(mask);
+	while (bits < 32 && rt_bit(mask, bits))
+		bits++;
+	if (mask & ~rt_bitmask(bits) & 0xffffffff)
+		return -1;
+	return bits;
+}
+
+/*
+ *	Take one of the nodes ip_rt_add() allocated for us. The trie is
+ *	changed with interrupts off, so it can't allocate them itself.
+ */
+
+static struct rt_node *rt_get_node(struct rt_node **spare, unsigned long key,
+	int bits, struct rtable *rt)
+{
+	struct rt_node *n;
+
+	n = spare[0];
+	if (n)
+		spare[0] = NULL;
+	else
+	{
+		n = spare[1];
+		spare[1] = NULL;
+	}
+	n->rn_child[0] = n->rn_child[1] = NULL;
+	n->rn_key = key;
+	n->rn_bits = bits;
+	n->rn_route = rt;
+	rt_nodes++;
+	return n;
+}
+
+/*
+ *	Add a route to the trie. This needs at most two new nodes.
+ */
+
+static void rt_trie_add(struct rtable *rt, struct rt_node **spare)
+{
+	struct rt_node *n, *new, **np;
+	unsigned long key, diff;
+	int bits, c;
+
+	bits = rt_prefixlen(rt->rt_mask);
+	if (bits < 0)
+	{
+		rt_odd_masks++;
+		return;
+	}
+	key = ntohl(rt->rt_dst) & rt_bitmask(bits);
+	np = &rt_trie;
+	while ((n = *np) != NULL)
+	{
+		diff = (key ^ n->rn_key) & rt_bitmask(bits < n->rn_bits ? bits : n->rn_bits);
+		if (diff)
+		{
+			/*
+			 *	The two part ways before either prefix ends:
+			 *	fork them at the first bit they differ in.
+			 */
+			for (c = 0; !rt_bit(diff, c); c++)
+				/* nothing */;
+			new = rt_get_node(spare, key & rt_bitmask(c), c, NULL);
+			new->rn_child[rt_bit(n->rn_key, c)] = n;
+			new->rn_child[rt_bit(key, c)] = rt_get_node(spare, key, bits, rt);
+			*np = new;
+			return;
+		}
+		if (n->rn_bits == bits)
+		{
+			n->rn_route = rt;
+			return;
+		}
+		if (n->rn_bits > bits)
+		{
+			new = rt_get_node(spare, key, bits, rt);
+			new->rn_child[rt_bit(n->rn_key, bits)] = n;
+			*np = new;
+			return;
+		}
+		np = &n->rn_child[rt_bit(key, n->rn_bits)];
+	}
+	*np = rt_get_node(spare, key, bits, rt);
+}
+
+/*
+ *	A node that has lost its route or a child may not be needed any
+ *	more: without a route it must fork, or it's replaced by its child.
+ */
+
+static void rt_trie_prune(struct rt_node **np)
+{
+	struct rt_node *n = *np;
+
+	if (n->rn_route || (n->rn_child[0] && n->rn_child[1]))
+		return;
+	*np = n->rn_child[0] ? n->rn_child[0] : n->rn_child[1];
+	kfree_s(n, sizeof(struct rt_node));
+	rt_nodes--;
+}
+
+static void rt_trie_del(struct rtable *rt)
+{
+	struct rt_node *n, **np, **pp;
+	unsigned long key;
+	int bits;
+
+	bits = rt_prefixlen(rt->rt_mask);
+	if (bits < 0)
+	{
+		rt_odd_masks--;
+		return;
+	}
+	key = ntohl(rt->rt_dst) & rt_bitmask(bits);
+	pp = NULL;
+	np = &rt_trie;
+	while ((n = *np) != NULL && n->rn_bits < bits)
+	{
+		pp = np;
+		np = &n->rn_child[rt_bit(key, n->rn_bits)];
+	}
+	if (!n || n->rn_route != rt)
+		return;
+	n->rn_route = NULL;
+	rt_trie_prune(np);
+	if (pp)
+		rt_trie_prune(pp);
+}
+
+/*
+ *	Unlink a route from the list, the trie and the cache, and free it.
+ *	Interrupts must be off.
+ */
+
+static void rt_free(struct rtable **rp)
+{
+	struct rtable *r = *rp;
+
+	*rp = r->rt_next;
+	rt_trie_del(r);
+	if (rt_loopback == r)
+		rt_loopback = NULL;
+	rt_cache_clear();
+	kfree_s(r, sizeof(struct rtable));
+}
+
 /*
  *	Remove a routing table entry.
  */
@@ -91,15 +313,7 @@ static void rt_del(unsigned long dst, char *devname)
 			rp = &r->rt_next;
 			continue;
 		}
-		*rp = r->rt_next;
-		
-		/*
-		 *	If we delete the loopback route update its pointer.
-		 */
-		 
-		if (rt_loopback == r)
-			rt_loopback = NULL;
-		kfree_s(r, sizeof(struct rtable));
+		rt_free(rp);
 	} 
 	restore_flags(flags);
 }
@@ -124,10 +338,7 @@ void ip_rt_flush(struct device *dev)
 			rp = &r->rt_next;
 			continue;
 		}
-		*rp = r->rt_next;
-		if (rt_loopback == r)
-			rt_loopback = NULL;
-		kfree_s(r, sizeof(struct rtable));
+		rt_free(rp);
 	} 
 	restore_flags(flags);
 }
@@ -205,6 +416,7 @@ void ip_rt_add(short flags, unsigned long dst, unsigned long mask,
 {
 	struct rtable *r, *rt;
 	struct rtable **rp;
+	struct rt_node *spare[2];
 	unsigned long cpuflags;
 
 	/*
@@ -267,6 +479,17 @@ void ip_rt_add(short flags, unsigned long dst, unsigned long mask,
 	{
 		return;
 	}
+	spare[0] = (struct rt_node *) kmalloc(sizeof(struct rt_node), GFP_ATOMIC);
+	spare[1] = (struct rt_node *) kmalloc(sizeof(struct rt_node), GFP_ATOMIC);
+	if (spare[0] == NULL || spare[1] == NULL)
+	{
+		if (spare[0])
+			kfree_s(spare[0], sizeof(struct rt_node));
+		if (spare[1])
+			kfree_s(spare[1], sizeof(struct rt_node));
+		kfree_s(rt, sizeof(struct rtable));
+		return;
+	}
 	memset(rt, 0, sizeof(struct rtable));
 	rt->rt_flags = flags | RTF_UP;
 	rt->rt_dst = dst;
@@ -307,10 +530,7 @@ void ip_rt_add(short flags, unsigned long dst, unsigned long mask,
 			rp = &r->rt_next;
 			continue;
 		}
-		*rp = r->rt_next;
-		if (rt_loopback == r)
-			rt_loopback = NULL;
-		kfree_s(r, sizeof(struct rtable));
+		rt_free(rp);
 	}
 	
 	/*
@@ -325,6 +545,8 @@ void ip_rt_add(short flags, unsigned long dst, unsigned long mask,
 	}
 	rt->rt_next = r;
 	*rp = rt;
+	rt_trie_add(rt, spare);
+	rt_cache_clear();
 	
 	/*
 	 *	Update the loopback route
@@ -338,6 +560,10 @@ void ip_rt_add(short flags, unsigned long dst, unsigned long mask,
 	 */
 	 
 	restore_flags(cpuflags);
+	if (spare[0])
+		kfree_s(spare[0], sizeof(struct rt_node));
+	if (spare[1])
+		kfree_s(spare[1], sizeof(struct rt_node));
 	return;
 }
 
@@ -533,6 +759,34 @@ int rt_get_info(char *buffer, char **start, off_t offset, int length)
   	return len;
 }
 
+/* 
+ *	Called from the PROCfs module. This outputs /proc/net/rt_cache.
+ */
+ 
+int rt_cache_get_info(char *buffer, char **start, off_t offset, int length)
+{
+	struct rtable *r;
+	int len, routes = 0;
+
+	for (r = rt_base; r != NULL; r = r->rt_next)
+		routes++;
+	len = sprintf(buffer,
+		"RtCache: Hits Misses Flushes Routes TrieNodes OddMasks\n"
+		"RtCache: %lu %lu %lu %d %d %d\n",
+		rt_cache_hits, rt_cache_misses, rt_cache_flushes,
+		routes, rt_nodes, rt_odd_masks);
+	if (offset >= len)
+	{
+		*start = buffer;
+		return 0;
+	}
+	*start = buffer + offset;
+	len -= offset;
+	if (len > length)
+		len = length;
+	return len;
+}
+
 /*
  *	This is hackish, but results in better code. Use "-S" to see why.
  */
@@ -540,17 +794,40 @@ int rt_get_info(char *buffer, char **start, off_t offset, int length)
 #define early_out ({ goto no_route; 1; })
 
 /*
- *	Route a packet. This needs to be fairly quick. Florian & Co. 
- *	suggested a unified ARP and IP routing cache. Done right its
- *	probably a brilliant idea. I'd actually suggest a unified
- *	ARP/IP routing/Socket pointer cache. Volunteers welcome
+ *	Find the route for a destination the slow way. Broadcasts to an
+ *	interface's broadcast address can match a route that doesn't cover
+ *	them, which the trie knows nothing about: those (and everything, if
+ *	there are masks the trie can't hold) get the old walk down rt_base.
  */
- 
-struct rtable * ip_rt_route(unsigned long daddr, struct options *opt, unsigned long *src_addr)
+
+static struct rtable * rt_lookup(unsigned long daddr)
 {
+	struct rt_node *n;
 	struct rtable *rt;
+	struct device *dev;
+	unsigned long key;
+
+	if (rt_odd_masks)
+		goto slow;
+	for (dev = dev_base; dev != NULL; dev = dev->next)
+		if ((dev->flags & IFF_BROADCAST) && dev->pa_brdaddr == daddr)
+			goto slow;
+
+	rt = NULL;
+	key = ntohl(daddr);
+	for (n = rt_trie; n != NULL; n = n->rn_child[rt_bit(key, n->rn_bits)])
+	{
+		if ((key ^ n->rn_key) & rt_bitmask(n->rn_bits))
+			break;
+		if (n->rn_route)
+			rt = n->rn_route;
+		if (n->rn_bits == 32)
+			break;
+	}
+	return rt;
 
-	for (rt = rt_base; rt != NULL || early_out ; rt = rt->rt_next) 
+slow:
+	for (rt = rt_base; rt != NULL; rt = rt->rt_next) 
 	{
 		if (!((rt->rt_dst ^ daddr) & rt->rt_mask))
 			break;
@@ -563,6 +840,42 @@ struct rtable * ip_rt_route(unsigned long daddr, struct options *opt, unsigned l
 		    (rt->rt_dev->pa_brdaddr == daddr))
 			break;
 	}
+	return rt;
+}
+
+/*
+ *	Route a packet. This needs to be fairly quick. Florian & Co. 
+ *	suggested a unified ARP and IP routing cache. Done right its
+ *	probably a brilliant idea. I'd actually suggest a unified
+ *	ARP/IP routing/Socket pointer cache. Volunteers welcome
+ *
+ *	The route cache holds what rt_lookup() found, so the loopback
+ *	and source address are worked out from the interface each time.
+ */
+ 
+struct rtable * ip_rt_route(unsigned long daddr, struct options *opt, unsigned long *src_addr)
+{
+	struct rt_cache_entry *rc;
+	struct rtable *rt;
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	rc = rt_cache + rt_cache_hash(daddr);
+	if (rc->rc_rt != NULL && rc->rc_dst == daddr) 
+	{
+		rt = rc->rc_rt;
+		rt_cache_hits++;
+	}
+	else 
+	{
+		rt_cache_misses++;
+		rt = rt_lookup(daddr);
+		if (rt == NULL)
+			goto no_route;
+		rc->rc_dst = daddr;
+		rc->rc_rt = rt;
+	}
 	
 	if(src_addr!=NULL)
 		*src_addr= rt->rt_dev->pa_addr;
@@ -572,8 +885,10 @@ struct rtable * ip_rt_route(unsigned long daddr, struct options *opt, unsigned l
 			goto no_route;
 	}
 	rt->rt_use++;
+	restore_flags(flags);
 	return rt;
 no_route:
+	restore_flags(flags);
 	return NULL;
 }
 
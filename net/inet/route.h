@@ -47,7 +47,9 @@ extern void		ip_rt_add(short flags, unsigned long addr, unsigned long mask,
 			       unsigned long gw, struct device *dev, unsigned short mss, unsigned long window);
 extern struct rtable	*ip_rt_route(unsigned long daddr, struct options *opt, unsigned long *src_addr);
 extern struct rtable 	*ip_rt_local(unsigned long daddr, struct options *opt, unsigned long *src_addr);
+extern void		ip_rt_cache_flush(void);
 extern int		rt_get_info(char * buffer, char **start, off_t offset, int length);
+extern int		rt_cache_get_info(char * buffer, char **start, off_t offset, int length);
 extern int		ip_rt_ioctl(unsigned int cmd, void *arg);
 
 #endif	/* _ROUTE_H */
@@ -38,6 +38,7 @@
 #include "tcp.h"
 #include "udp.h"
 #include <linux/skbuff.h>
+#include <linux/slab.h>
 #include "sock.h"
 
 
@@ -52,14 +53,54 @@ volatile unsigned long net_allocs = 0;
 volatile unsigned long net_fails  = 0;
 volatile unsigned long net_free_locked = 0;
 
+/*
+ *	Pools of ready made buffers in the sizes we use most: small ones for
+ *	ACKs and other header-only frames, and ones that hold a full ethernet
+ *	frame. alloc_skb() takes from the free list and the last free of a
+ *	buffer puts it back, so the fast path never sees the allocator. If a
+ *	pool runs below its low water mark net_bh() tops it up; frees above
+ *	the high water mark go back to the slab cache.
+ */
+
+struct skb_pool {
+	char			*name;
+	unsigned long		size;		/* Including the sk_buff itself */
+	int			low, high;
+	kmem_cache_t		*cache;
+	struct sk_buff		*free;		/* Chained through ->next */
+	int			count;
+	unsigned long		hits;
+	unsigned long		misses;
+};
+
+#define SKB_POOL_NONE	0xFF
+
+static struct skb_pool skb_pools[] = {
+	{ "skbuff_small", sizeof(struct sk_buff) + 256, 8, 32 },
+	{ "skbuff", sizeof(struct sk_buff) + 1536, 8, 32 },
+};
+
+#define SKB_NPOOLS	(sizeof(skb_pools) / sizeof(skb_pools[0]))
+
+volatile int skb_pool_low = 0;
+
 void show_net_buffers(void)
 {
+	int i;
+
 	printk("Networking buffers in use          : %lu\n",net_skbcount);
 	printk("Memory committed to network buffers: %lu\n",net_memory);
 	printk("Network buffers locked by drivers  : %lu\n",net_locked);
 	printk("Total network buffer allocations   : %lu\n",net_allocs);
 	printk("Total failed network buffer allocs : %lu\n",net_fails);
 	printk("Total free while locked events     : %lu\n",net_free_locked);
+	for (i = 0; i < SKB_NPOOLS; i++)
+	{
+		struct skb_pool *pool = skb_pools + i;
+		printk("Pool %-12s: %d free (low %d high %d), %lu hits, %lu misses\n",
+			pool->name, pool->count, pool->low, pool->high,
+			pool->hits, pool->misses);
+	}
 }
 
 #if CONFIG_SKB_CHECK
@@ -137,7 +178,7 @@ int skb_check(struct sk_buff *skb, int head, int line, char *file)
 			skb,skb->truesize,skb->mem_len,skb->free);
 		return -1;
 	}
-	if(skb->mem_len!=skb->truesize)
+	if(skb->data_skb==skb && skb->mem_len!=skb->truesize)
 	{
 		printk("File: %s Line %d, Dubious size setting!\n",file,line);
 		printk("skb=%p, real size=%ld, claimed size=%ld\n",
@@ -155,6 +196,7 @@ void skb_queue_head_init(struct sk_buff_head *list)
 {
 	list->prev = (struct sk_buff *)list;
 	list->next = (struct sk_buff *)list;
+	list->qlen = 0;
 	list->magic_debug_cookie = SK_HEAD_SKB;
 }
 
@@ -180,6 +222,8 @@ void skb_queue_head(struct sk_buff_head *list_,struct sk_buff *newsk)
 
 	newsk->next->prev = newsk;
 	newsk->prev->next = newsk;
+	newsk->list = list_;
+	list_->qlen++;
 
 	restore_flags(flags);
 }
@@ -205,6 +249,8 @@ void skb_queue_tail(struct sk_buff_head *list_, struct sk_buff *newsk)
 
 	newsk->next->prev = newsk;
 	newsk->prev->next = newsk;
+	newsk->list = list_;
+	list_->qlen++;
 
 	restore_flags(flags);
 }
@@ -236,6 +282,8 @@ struct sk_buff *skb_dequeue(struct sk_buff_head *list_)
 
 	result->next = NULL;
 	result->prev = NULL;
+	list_->qlen--;
+	result->list = NULL;
 
 	restore_flags(flags);
 
@@ -264,6 +312,9 @@ void skb_insert(struct sk_buff *old, struct sk_buff *newsk)
 	newsk->prev = old->prev;
 	old->prev = newsk;
 	newsk->prev->next = newsk;
+	newsk->list = old->list;
+	if (newsk->list)
+		newsk->list->qlen++;
 
 	restore_flags(flags);
 }
@@ -290,6 +341,9 @@ void skb_append(struct sk_buff *old, struct sk_buff *newsk)
 	newsk->next = old->next;
 	newsk->next->prev = newsk;
 	old->next = newsk;
+	newsk->list = old->list;
+	if (newsk->list)
+		newsk->list->qlen++;
 
 	restore_flags(flags);
 }
@@ -315,6 +369,9 @@ void skb_unlink(struct sk_buff *skb)
 		skb->prev->next = skb->next;
 		skb->next = NULL;
 		skb->prev = NULL;
+		if (skb->list)
+			skb->list->qlen--;
+		skb->list = NULL;
 	}
 #ifdef PARANOID_BUGHUNT_MODE	/* This is legal but we sometimes want to watch it */
 	else
@@ -383,6 +440,76 @@ void kfree_skb(struct sk_buff *skb, int rw)
 		kfree_skbmem(skb, skb->mem_len);
 }
 
+/*
+ *	Clones are just a header pointing at somebody else's data.
+ */
+
+static kmem_cache_t *skbuff_head_cache = NULL;
+
+void skb_init(void)
+{
+	int i;
+
+	for (i = 0; i < SKB_NPOOLS; i++)
+	{
+		struct skb_pool *pool = skb_pools + i;
+		pool->cache = kmem_cache_create(pool->name, pool->size, 0,
+			SLAB_HWCACHE_ALIGN, NULL);
+		if (pool->cache == NULL)
+			printk("skb_init: no %s cache, using kmalloc.\n", pool->name);
+	}
+	skbuff_head_cache = kmem_cache_create("skbuff_head", sizeof(struct sk_buff), 0,
+		SLAB_HWCACHE_ALIGN, NULL);
+	if (skbuff_head_cache == NULL)
+		printk("skb_init: no skbuff_head cache, using kmalloc.\n");
+	skb_pool_low = 1;
+	mark_bh(NET_BH);
+}
+
+/*
+ *	Get the memory for a pool buffer, from its cache if it has one.
+ */
+
+static struct sk_buff *skb_pool_get(struct skb_pool *pool, int priority)
+{
+	if (pool->cache != NULL)
+		return (struct sk_buff *)kmem_cache_alloc(pool->cache,priority);
+	return (struct sk_buff *)kmalloc(pool->size,priority);
+}
+
+/*
+ *	Fill every pool that is below its low water mark half way to the
+ *	high one. Called from net_bh(), so it is atomic but out of the way
+ *	of the interrupt handlers.
+ */
+
+void skb_pool_refill(void)
+{
+	int i;
+	unsigned long flags;
+
+	skb_pool_low = 0;
+	for (i = 0; i < SKB_NPOOLS; i++)
+	{
+		struct skb_pool *pool = skb_pools + i;
+
+		if (pool->count >= pool->low)
+			continue;
+		while (pool->count < (pool->low + pool->high) / 2)
+		{
+			struct sk_buff *skb = skb_pool_get(pool, GFP_ATOMIC);
+			if (skb == NULL)
+				return;
+			save_flags(flags);
+			cli();
+			skb->next = pool->free;
+			pool->free = skb;
+			pool->count++;
+			restore_flags(flags);
+		}
+	}
+}
+
 /*
  *	Allocate a new skbuff. We do this ourselves so we can fill in a few 'private'
  *	fields and also do memory statistics to find all the [BEEP] leaks.
@@ -391,6 +518,7 @@ struct sk_buff *alloc_skb(unsigned int size,int priority)
 {
 	struct sk_buff *skb;
 	unsigned long flags;
+	int pool;
 
 	if (intr_count && priority!=GFP_ATOMIC) {
 		static int count = 0;
@@ -402,7 +530,42 @@ struct sk_buff *alloc_skb(unsigned int size,int priority)
 	}
 
 	size+=sizeof(struct sk_buff);
-	skb=(struct sk_buff *)kmalloc(size,priority);
+	skb = NULL;
+	pool = SKB_POOL_NONE;
+	if (!(priority & GFP_DMA))
+	{
+		for (pool = 0; pool < SKB_NPOOLS; pool++)
+			if (size <= skb_pools[pool].size)
+				break;
+		if (pool == SKB_NPOOLS)
+			pool = SKB_POOL_NONE;
+	}
+	if (pool != SKB_POOL_NONE)
+	{
+		struct skb_pool *p = skb_pools + pool;
+
+		save_flags(flags);
+		cli();
+		skb = p->free;
+		if (skb != NULL)
+		{
+			p->free = skb->next;
+			p->count--;
+			p->hits++;
+		}
+		else
+			p->misses++;
+		if (p->count < p->low && !skb_pool_low)
+		{
+			skb_pool_low = 1;
+			mark_bh(NET_BH);
+		}
+		restore_flags(flags);
+		if (skb == NULL)
+			skb = skb_pool_get(p, priority);
+	}
+	else
+		skb=(struct sk_buff *)kmalloc(size,priority);
 	if (skb == NULL)
 	{
 		net_fails++;
@@ -421,11 +584,20 @@ struct sk_buff *alloc_skb(unsigned int size,int priority)
 	skb->truesize = size;
 	skb->mem_len = size;
 	skb->mem_addr = skb;
+	skb->data = skb->head;
+	skb->data_skb = skb;
+	skb->dataref = 1;
+	skb->pool = pool;
+	skb->csum = 0;
+	skb->sacked = 0;
+	skb->tries = 0;
 #ifdef CONFIG_SLAVE_BALANCING
 	skb->in_dev_queue = 0;
 #endif
 	skb->fraglist = NULL;
+	skb->ip_hdr = NULL;
 	skb->prev = skb->next = NULL;
+	skb->list = NULL;
 	skb->link3 = NULL;
 	skb->sk = NULL;
 	skb->localroute=0;
@@ -443,6 +615,39 @@ struct sk_buff *alloc_skb(unsigned int size,int priority)
 	return skb;
 }
 
+/*
+ *	The memory of a buffer is used by its own header and, if it has been
+ *	cloned, by the clones as well. dataref counts them, and the memory
+ *	only goes back when the last one is done with it.
+ */
+
+static void skb_release(struct sk_buff *skb)
+{
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	if (--skb->dataref == 0)
+	{
+		unsigned long size = skb->truesize;
+		struct skb_pool *pool = NULL;
+
+		if (skb->pool != SKB_POOL_NONE)
+			pool = skb_pools + skb->pool;
+		if (pool != NULL && pool->count < pool->high)
+		{
+			skb->next = pool->free;
+			pool->free = skb;
+			pool->count++;
+		}
+		else
+			kfree_s((void *)skb,size);
+		net_skbcount--;
+		net_memory -= size;
+	}
+	restore_flags(flags);
+}
+
 /*
  *	Free an skbuff by memory
  */
@@ -459,7 +664,7 @@ void kfree_skbmem(struct sk_buff *skb,unsigned size)
 #endif
 #ifdef CONFIG_SKB_CHECK
 	IS_SKB(skb);
-	if(size!=skb->truesize)
+	if(size!=skb->mem_len)
 		printk("kfree_skbmem: size mismatch.\n");
 
 	if(skb->magic_debug_cookie == SK_GOOD_SKB)
@@ -468,9 +673,9 @@ void kfree_skbmem(struct sk_buff *skb,unsigned size)
 		cli();
 		IS_SKB(skb);
 		skb->magic_debug_cookie = SK_FREED_SKB;
-		kfree_s((void *)skb,size);
-		net_skbcount--;
-		net_memory -= size;
+		if (skb->data_skb != skb)
+			skb_release(skb->data_skb);
+		skb_release(skb);
 		restore_flags(flags);
 	}
 	else
@@ -478,53 +683,124 @@ void kfree_skbmem(struct sk_buff *skb,unsigned size)
 #else
 	save_flags(flags);
 	cli();
-	kfree_s((void *)skb,size);
-	net_skbcount--;
-	net_memory -= size;
+	if (skb->data_skb != skb)
+		skb_release(skb->data_skb);
+	skb_release(skb);
 	restore_flags(flags);
 #endif
 }
 
 /*
  *	Duplicate an sk_buff. The new one is not owned by a socket or locked
- *	and will be freed on deletion.
+ *	and will be freed on deletion. It shares the packet data with the
+ *	original instead of copying it, so it must be treated as read only
+ *	(see skb_data_shared()). It is still charged to a socket at the
+ *	full size, or a tap could hold on to any amount of memory for free.
  */
 
 struct sk_buff *skb_clone(struct sk_buff *skb, int priority)
 {
 	struct sk_buff *n;
-	unsigned long offset;
+	unsigned long flags;
 
-	n=alloc_skb(skb->mem_len-sizeof(struct sk_buff),priority);
+	if (skbuff_head_cache != NULL)
+		n=(struct sk_buff *)kmem_cache_alloc(skbuff_head_cache,priority);
+	else
+		n=(struct sk_buff *)kmalloc(sizeof(struct sk_buff),priority);
 	if(n==NULL)
+	{
+		net_fails++;
 		return NULL;
+	}
+	net_allocs++;
 
-	offset=((char *)n)-((char *)skb);
+	save_flags(flags);
+	cli();
+	n->data_skb=skb->data_skb;
+	n->data_skb->dataref++;
+	net_memory += sizeof(struct sk_buff);
+	net_skbcount++;
+	restore_flags(flags);
 
-	memcpy(n->data,skb->data,skb->mem_len-sizeof(struct sk_buff));
+	n->truesize=sizeof(struct sk_buff);
+	n->mem_len=skb->mem_len;
+	n->mem_addr=n;
+	n->dataref=1;
+	n->pool=SKB_POOL_NONE;
+	n->data=skb->data;
 	n->len=skb->len;
+	n->csum=skb->csum;
+	n->prev=n->next=NULL;
+	n->list=NULL;
 	n->link3=NULL;
 	n->sk=NULL;
 	n->when=skb->when;
+	n->stamp=skb->stamp;
 	n->dev=skb->dev;
-	n->h.raw=skb->h.raw+offset;
-	n->ip_hdr=(struct iphdr *)(((char *)skb->ip_hdr)+offset);
+	n->h.raw=skb->h.raw;
+	n->ip_hdr=skb->ip_hdr;
 	n->fraglen=skb->fraglen;
 	n->fraglist=skb->fraglist;
 	n->saddr=skb->saddr;
 	n->daddr=skb->daddr;
 	n->raddr=skb->raddr;
 	n->acked=skb->acked;
+	n->sacked=skb->sacked;
 	n->used=skb->used;
 	n->free=1;
 	n->arp=skb->arp;
 	n->tries=0;
 	n->lock=0;
+	n->localroute=skb->localroute;
 	n->users=0;
 	n->pkt_type=skb->pkt_type;
+	n->pkt_class=skb->pkt_class;
+#ifdef CONFIG_SLAVE_BALANCING
+	n->in_dev_queue=0;
+#endif
+#if CONFIG_SKB_CHECK
+	n->magic_debug_cookie = SK_GOOD_SKB;
+#endif
 	return n;
 }
 
+/*
+ *	Give a buffer a private copy of its data, so it can be written to
+ *	without the clones sharing it seeing the change. The header stays
+ *	where it is: only the data (and the pointers into it) move.
+ */
+
+int skb_unshare_data(struct sk_buff *skb, int priority)
+{
+	struct sk_buff *old = skb->data_skb;
+	struct sk_buff *n;
+	unsigned long size, offset;
+
+	if (old->dataref <= 1)
+		return 0;
+
+	/*
+	 *	The new data lives in a buffer of its own whose header is
+	 *	never used: its single reference is ours.
+	 */
+
+	size = old->truesize - sizeof(struct sk_buff);
+	n = alloc_skb(size, priority);
+	if (n == NULL)
+		return -ENOMEM;
+	n->free = 1;
+	memcpy(n->head, old->head, size);
+
+	offset = n->head - old->head;
+	skb->data += offset;
+	skb->h.raw += offset;
+	skb->ip_hdr = (struct iphdr *)(((char *)skb->ip_hdr) + offset);
+	skb->data_skb = n;
+	if (old != skb)
+		skb_release(old);
+	return 0;
+}
+
 
 /*
  *     Skbuff device locking
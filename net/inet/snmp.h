@@ -93,6 +93,10 @@ struct tcp_mib
  	unsigned long	TcpInSegs;
  	unsigned long	TcpOutSegs;
  	unsigned long	TcpRetransSegs;
+ 	/* Not in the MIB: how often header prediction in tcp_rcv() works */
+ 	unsigned long	TcpPredAcks;
+ 	unsigned long	TcpPredData;
+ 	unsigned long	TcpSlowPath;
 };
  
 struct udp_mib
@@ -95,6 +95,7 @@
 
 #include <linux/inet.h>
 #include <linux/netdevice.h>
+#include <linux/if_qdisc.h>
 #include "ip.h"
 #include "protocol.h"
 #include "arp.h"
@@ -147,8 +148,8 @@ int sock_setsockopt(struct sock *sk, int level, int optname,
 			sk->broadcast=val?1:0;
 			return 0;
 		case SO_SNDBUF:
-			if(val>32767)
-				val=32767;
+			if(val>SK_BUF_LIMIT)
+				val=SK_BUF_LIMIT;
 			if(val<256)
 				val=256;
 			sk->sndbuf=val;
@@ -167,8 +168,8 @@ int sock_setsockopt(struct sock *sk, int level, int optname,
 			}
 			return 0;
 		case SO_RCVBUF:
-			if(val>32767)
-				val=32767;
+			if(val>SK_BUF_LIMIT)
+				val=SK_BUF_LIMIT;
 			if(val<256)
 				val=256;
 			sk->rcvbuf=val;
@@ -203,7 +204,7 @@ int sock_setsockopt(struct sock *sk, int level, int optname,
 			return(0);
 
 		 case SO_PRIORITY:
-			if (val >= 0 && val < DEV_NUMBUFFS) 
+			if (val >= 0 && val < QDISC_MAX_BANDS) 
 			{
 				sk->priority = val;
 			} 
@@ -367,7 +368,9 @@ unsigned long sock_rspace(struct sock *sk)
 	{
 		if (sk->rmem_alloc >= sk->rcvbuf-2*MIN_WINDOW) 
 			return(0);
-		amt = min((sk->rcvbuf-sk->rmem_alloc)/2-MIN_WINDOW, MAX_WINDOW);
+		/* Big buffers may offer more than MAX_WINDOW (window scaling) */
+		amt = min((sk->rcvbuf-sk->rmem_alloc)/2-MIN_WINDOW, 
+			  sk->rcvbuf > 2*MAX_WINDOW ? sk->rcvbuf/2 : MAX_WINDOW);
 		if (amt < 0) 
 			return(0);
 		return(amt);
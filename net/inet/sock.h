@@ -95,6 +95,8 @@ struct sock {
   int				proc;
   struct sock			*next;
   struct sock			*prev; /* Doubly linked chain.. */
+  struct sock			*hash_next;	/* get_sock() hash chain */
+  struct sock			**hash_pprev;
   struct sock			*pair;
   struct sk_buff		* volatile send_head;
   struct sk_buff		* volatile send_tail;
@@ -109,18 +111,26 @@ struct sock {
   unsigned long			daddr;
   unsigned long			saddr;
   unsigned short		max_unacked;
-  unsigned short		window;
+  unsigned long			window;
   unsigned short		bytes_rcv;
 /* mss is min(mtu, max_window) */
   unsigned short		mtu;       /* mss negotiated in the syn's */
   volatile unsigned short	mss;       /* current eff. mss - can change */
   volatile unsigned short	user_mss;  /* mss requested by user in ioctl */
-  volatile unsigned short	max_window;
+  volatile unsigned long	max_window;
   unsigned long 		window_clamp;
   unsigned short		num;
   volatile unsigned short	cong_window;
   volatile unsigned short	cong_count;
   volatile unsigned short	ssthresh;
+  volatile unsigned short	dup_acks;
+  struct tcp_cong_ops		*cong_ops;
+  unsigned long			cong_priv[4];	/* for the congestion control */
+  unsigned char			snd_wscale;	/* shift for the windows he sends */
+  unsigned char			rcv_wscale;	/* ... and for the windows we send */
+  unsigned char			tstamp_ok;	/* timestamps agreed */
+  unsigned char			sack_ok;	/* SACK agreed */
+  unsigned long			ts_recent;	/* timestamp to echo */
   volatile unsigned short	packets_out;
   volatile unsigned short	shutdown;
   volatile unsigned long	rtt;
@@ -137,8 +147,8 @@ struct sock {
   unsigned char			max_ack_backlog;
   unsigned char			priority;
   unsigned char			debug;
-  unsigned short		rcvbuf;
-  unsigned short		sndbuf;
+  unsigned long			rcvbuf;
+  unsigned long			sndbuf;
   unsigned short		type;
   unsigned char			localroute;	/* Route locally only */
 #ifdef CONFIG_IPX
@@ -276,6 +286,7 @@ struct proto {
 extern void			destroy_sock(struct sock *sk);
 extern unsigned short		get_new_socknum(struct proto *, unsigned short);
 extern void			put_sock(unsigned short, struct sock *); 
+extern void			rehash_sock(struct sock *sk);
 extern void			release_sock(struct sock *sk);
 extern struct sock		*get_sock(struct proto *, unsigned short,
 					  unsigned long, unsigned short,
@@ -222,6 +222,7 @@
 #include <linux/skbuff.h>
 #include "sock.h"
 #include "route.h"
+#include "checksum.h"
 #include <linux/errno.h>
 #include <linux/timer.h>
 #include <asm/system.h>
@@ -239,6 +240,8 @@ unsigned long seq_offset;
 struct tcp_mib	tcp_statistics;
 
 static void tcp_close(struct sock *sk, int timeout);
+static void tcp_send_check_skb(struct tcphdr *th, unsigned long saddr,
+		unsigned long daddr, int len, struct sk_buff *skb);
 
 
 /*
@@ -320,9 +323,171 @@ int tcp_select_window(struct sock *sk)
 	 */
 	if (new_window < min(sk->mss, MAX_WINDOW/2) || new_window < sk->window)
 		return(sk->window);
+
+	/*
+	 *	It has to fit the 16 bit field once scaled, and the bits the
+	 *	shift drops must be zero so we both agree what was offered.
+	 */
+
+	if (new_window > (65535UL << sk->rcv_wscale))
+		new_window = 65535UL << sk->rcv_wscale;
+	new_window &= ~((1UL << sk->rcv_wscale) - 1);
+	if (new_window < sk->window)
+		return(sk->window);
 	return(new_window);
 }
 
+/*
+ *	The window scale we offer: enough to cover the receive buffer.
+ */
+
+static int tcp_wscale_offer(struct sock *sk)
+{
+	int ws = 0;
+
+	while (ws < TCP_MAX_WSCALE && (sk->rcvbuf >> ws) > 65535)
+		ws++;
+	return ws;
+}
+
+/*
+ *	Options are filled in a word at a time: these are all multiples of
+ *	four bytes.
+ */
+
+static __inline__ void tcp_put_tstamp(struct sock *sk, unsigned long *ptr)
+{
+	ptr[0] = htonl(TCPOPT_TSTAMP_HDR);
+	ptr[1] = htonl(jiffies);
+	ptr[2] = htonl(sk->ts_recent);
+}
+
+/*
+ *	Add the options that every frame carries once they have been
+ *	agreed (just the timestamp) after a bare header. Returns the bytes
+ *	added.
+ */
+
+static int tcp_add_options(struct sock *sk, struct tcphdr *th)
+{
+	if (!sk->tstamp_ok)
+		return 0;
+	tcp_put_tstamp(sk, (unsigned long *)(th + 1));
+	th->doff += TCPOLEN_TSTAMP_ALIGNED/4;
+	return TCPOLEN_TSTAMP_ALIGNED;
+}
+
+/*
+ *	A queued frame is going out (again): bring its timestamp up to
+ *	date, so the echo times this transmission.
+ */
+
+static __inline__ void tcp_stamp(struct sock *sk, struct tcphdr *th)
+{
+	unsigned long *ptr = (unsigned long *)(th + 1);
+
+	if (th->doff == 8 && ptr[0] == htonl(TCPOPT_TSTAMP_HDR))
+	{
+		ptr[1] = htonl(jiffies);
+		ptr[2] = htonl(sk->ts_recent);
+	}
+}
+
+/*
+ *	Tell him which blocks above the hole we are holding (RFC 2018), so
+ *	he need only resend what is missing. The out of order frames sit
+ *	unacked and in sequence order on the tail of the receive queue;
+ *	adjacent ones are merged into a block. Returns the bytes added.
+ */
+
+static int tcp_add_sacks(struct sock *sk, struct tcphdr *th)
+{
+	struct sk_buff *skb;
+	unsigned char *opt = (unsigned char *)th + th->doff*4;
+	unsigned long *blk = (unsigned long *)(opt + 4);
+	unsigned long flags;
+	int max = sk->tstamp_ok ? TCP_MAX_SACKS-1 : TCP_MAX_SACKS;
+	int n = 0, open = 0;
+
+	save_flags(flags);
+	cli();
+	for (skb = sk->receive_queue.next;
+	     skb != (struct sk_buff *)&sk->receive_queue;
+	     skb = skb->next)
+	{
+		if (skb->acked || !after(skb->h.th->seq, sk->acked_seq))
+			continue;
+		if (open && !before(ntohl(blk[1]), skb->h.th->seq))
+		{
+			if (after(skb->h.th->ack_seq, ntohl(blk[1])))
+				blk[1] = htonl(skb->h.th->ack_seq);
+			continue;
+		}
+		if (open)
+		{
+			blk += 2;
+			if (++n == max)
+			{
+				open = 0;
+				break;
+			}
+		}
+		blk[0] = htonl(skb->h.th->seq);
+		blk[1] = htonl(skb->h.th->ack_seq);
+		open = 1;
+	}
+	restore_flags(flags);
+	n += open;
+	if (n == 0)
+		return 0;
+	opt[0] = TCPOPT_NOP;
+	opt[1] = TCPOPT_NOP;
+	opt[2] = TCPOPT_SACK;
+	opt[3] = 2 + 8*n;
+	th->doff += 1 + 2*n;
+	return 4 + 8*n;
+}
+
+/*
+ *	The options on the SYN or SYN/ACK. We always say what we will do;
+ *	on the SYN/ACK (tstamp etc. already worked out from his SYN) we
+ *	only answer what he offered.
+ */
+
+static int tcp_syn_options(struct sock *sk, unsigned char *ptr, int synack)
+{
+	unsigned char *start = ptr;
+	unsigned short mss = sk->mtu;
+
+	/* On the SYN/ACK tcp_options() has already taken off room for timestamps */
+	if (synack && sk->tstamp_ok)
+		mss += TCPOLEN_TSTAMP_ALIGNED;
+	*ptr++ = TCPOPT_MSS;
+	*ptr++ = 4;
+	*ptr++ = mss >> 8;
+	*ptr++ = mss & 0xff;
+	if (!synack || sk->tstamp_ok)
+	{
+		tcp_put_tstamp(sk, (unsigned long *) ptr);
+		ptr += TCPOLEN_TSTAMP_ALIGNED;
+	}
+	if (!synack || sk->rcv_wscale || sk->snd_wscale)
+	{
+		*ptr++ = TCPOPT_NOP;
+		*ptr++ = TCPOPT_WINDOW;
+		*ptr++ = TCPOLEN_WINDOW;
+		*ptr++ = sk->rcv_wscale;
+	}
+	if (!synack || sk->sack_ok)
+	{
+		*ptr++ = TCPOPT_NOP;
+		*ptr++ = TCPOPT_NOP;
+		*ptr++ = TCPOPT_SACK_PERM;
+		*ptr++ = TCPOLEN_SACK_PERM;
+	}
+	return ptr - start;
+}
+
 /*
  *	Find someone to 'accept'. Must be called with
  *	sk->inuse=1 or cli()
@@ -416,7 +581,26 @@ void tcp_do_retransmit(struct sock *sk, int all)
 
 		dev = skb->dev;
 		IS_SKB(skb);
+
+		/*
+		 *	He told us (SACK) he already has this one.
+		 */
+
+		if (skb->sacked && skb != sk->send_head)
+		{
+			skb = skb->link3;
+			continue;
+		}
+
+		/*
+		 *	A packet tap may still have a clone of this frame
+		 *	sharing the data we are about to rewrite.
+		 */
+
+		if (skb_data_shared(skb) && skb_unshare_data(skb, GFP_ATOMIC))
+			break;
 		skb->when = jiffies;
+		skb->tries++;		/* Karn: no RTT sample off this one */
 
 		/*
 		 * In general it's OK just to use the old packet.  However we
@@ -454,8 +638,12 @@ void tcp_do_retransmit(struct sock *sk, int all)
 		 */
 		 
 		th->ack_seq = ntohl(sk->acked_seq);
-		th->window = ntohs(tcp_select_window(sk));
-		tcp_send_check(th, sk->saddr, sk->daddr, size, sk);
+		if (th->syn)	/* The SYN's window is never scaled */
+			th->window = ntohs(min(tcp_select_window(sk), 65535));
+		else
+			th->window = tcp_window_field(sk, tcp_select_window(sk));
+		tcp_stamp(sk, th);
+		tcp_send_check_skb(th, sk->saddr, sk->daddr, size, skb);
 		
 		/*
 		 *	If the interface is (still) up and running, kick it.
@@ -573,11 +761,24 @@ static void tcp_retransmit(struct sock *sk, int all)
 		return;
 	}
 
-	sk->ssthresh = sk->cong_window >> 1; /* remember window where we lost */
-	/* sk->ssthresh in theory can be zero.  I guess that's OK */
-	sk->cong_count = 0;
+	/* He may have reneged on what he SACKed: send it all again */
+	if (sk->sack_ok)
+	{
+		struct sk_buff *skb;
+		unsigned long flags;
+
+		save_flags(flags);
+		cli();
+		for (skb = sk->send_head; skb != NULL; skb = skb->link3)
+			skb->sacked = 0;
+		restore_flags(flags);
+	}
 
-	sk->cong_window = 1;
+	/* Let the congestion control remember where we lost */
+	if (sk->cong_ops->loss)
+		sk->cong_ops->loss(sk);
+	else
+		tcp_cong_loss(sk);
 
 	/* Do the actual retransmit. */
 	tcp_retransmit_time(sk, all);
@@ -1016,85 +1217,12 @@ int tcp_ioctl(struct sock *sk, int cmd, unsigned long arg)
 unsigned short tcp_check(struct tcphdr *th, int len,
 	  unsigned long saddr, unsigned long daddr)
 {     
-	unsigned long sum;
-   
 	if (saddr == 0) saddr = ip_my_addr();
-
-/*
- * stupid, gcc complains when I use just one __asm__ block,
- * something about too many reloads, but this is just two
- * instructions longer than what I want
- */
-	__asm__("
-	    addl %%ecx, %%ebx
-	    adcl %%edx, %%ebx
-	    adcl $0, %%ebx
-	    "
-	: "=b"(sum)
-	: "0"(daddr), "c"(saddr), "d"((ntohs(len) << 16) + IPPROTO_TCP*256)
-	: "bx", "cx", "dx" );
-	__asm__("
-	    movl %%ecx, %%edx
-	    cld
-	    cmpl $32, %%ecx
-	    jb 2f
-	    shrl $5, %%ecx
-	    clc
-1:	    lodsl
-	    adcl %%eax, %%ebx
-	    lodsl
-	    adcl %%eax, %%ebx
-	    lodsl
-	    adcl %%eax, %%ebx
-	    lodsl
-	    adcl %%eax, %%ebx
-	    lodsl
-	    adcl %%eax, %%ebx
-	    lodsl
-	    adcl %%eax, %%ebx
-	    lodsl
-	    adcl %%eax, %%ebx
-	    lodsl
-	    adcl %%eax, %%ebx
-	    loop 1b
-	    adcl $0, %%ebx
-	    movl %%edx, %%ecx
-2:	    andl $28, %%ecx
-	    je 4f
-	    shrl $2, %%ecx
-	    clc
-3:	    lodsl
-	    adcl %%eax, %%ebx
-	    loop 3b
-	    adcl $0, %%ebx
-4:	    movl $0, %%eax
-	    testw $2, %%dx
-	    je 5f
-	    lodsw
-	    addl %%eax, %%ebx
-	    adcl $0, %%ebx
-	    movw $0, %%ax
-5:	    test $1, %%edx
-	    je 6f
-	    lodsb
-	    addl %%eax, %%ebx
-	    adcl $0, %%ebx
-6:	    movl %%ebx, %%eax
-	    shrl $16, %%eax
-	    addw %%ax, %%bx
-	    adcw $0, %%bx
-	    "
-	: "=b"(sum)
-	: "0"(sum), "c"(len), "S"(th)
-	: "ax", "bx", "cx", "dx", "si" );
-
-  	/* We only want the bottom 16 bits, but we never cleared the top 16. */
-  
-  	return((~sum) & 0xffff);
+	return csum_tcpudp_magic(saddr, daddr, len, IPPROTO_TCP,
+		csum_partial((unsigned char *)th, len, 0));
 }
 
 
-
 void tcp_send_check(struct tcphdr *th, unsigned long saddr, 
 		unsigned long daddr, int len, struct sock *sk)
 {
@@ -1103,6 +1231,20 @@ void tcp_send_check(struct tcphdr *th, unsigned long saddr,
 	return;
 }
 
+/*
+ *	Checksum a segment built by tcp_write(). The sum of the data was
+ *	worked out as it was copied in and kept in skb->csum, so only the
+ *	header needs adding.
+ */
+
+static void tcp_send_check_skb(struct tcphdr *th, unsigned long saddr, 
+		unsigned long daddr, int len, struct sk_buff *skb)
+{
+	th->check = 0;
+	th->check = csum_tcpudp_magic(saddr, daddr, len, IPPROTO_TCP,
+		csum_partial((unsigned char *)th, th->doff << 2, skb->csum));
+}
+
 /*
  *	This is the main buffer sending routine. We queue the buffer
  *	having checked it is sane seeming.
@@ -1136,7 +1278,7 @@ static void tcp_send_skb(struct sock *sk, struct sk_buff *skb)
 	 *	tcp stacks if ack is not set)
 	 */
 	 
-	if (size == sizeof(struct tcphdr)) 
+	if (size == th->doff*4) 
 	{
 		/* If it's got a syn or fin it's notionally included in the size..*/
 		if(!th->syn && !th->fin) 
@@ -1194,9 +1336,10 @@ static void tcp_send_skb(struct sock *sk, struct sk_buff *skb)
 		 */
 		 
 		th->ack_seq = ntohl(sk->acked_seq);
-		th->window = ntohs(tcp_select_window(sk));
+		th->window = tcp_window_field(sk, tcp_select_window(sk));
+		tcp_stamp(sk, th);
 
-		tcp_send_check(th, sk->saddr, sk->daddr, size, sk);
+		tcp_send_check_skb(th, sk->saddr, sk->daddr, size, skb);
 
 		sk->sent_seq = sk->write_seq;
 		
@@ -1360,7 +1503,7 @@ static void tcp_send_ack(unsigned long sequence, unsigned long ack,
 	t1->seq = ntohl(sequence);
 	t1->ack = 1;
 	sk->window = tcp_select_window(sk);
-	t1->window = ntohs(sk->window);
+	t1->window = tcp_window_field(sk, sk->window);
 	t1->res1 = 0;
 	t1->res2 = 0;
 	t1->rst = 0;
@@ -1397,7 +1540,11 @@ static void tcp_send_ack(unsigned long sequence, unsigned long ack,
   	 
   	t1->ack_seq = ntohl(ack);
   	t1->doff = sizeof(*t1)/4;
-  	tcp_send_check(t1, sk->saddr, daddr, sizeof(*t1), sk);
+  	tmp = tcp_add_options(sk, t1);
+  	if (sk->sack_ok)
+  		tmp += tcp_add_sacks(sk, t1);
+  	buff->len += tmp;
+  	tcp_send_check(t1, sk->saddr, daddr, sizeof(*t1)+tmp, sk);
   	if (sk->debug)
   		 printk("\rtcp_ack: seq %lx ack %lx\n", sequence, ack);
   	tcp_statistics.TcpOutSegs++;
@@ -1423,9 +1570,9 @@ extern __inline int tcp_build_header(struct tcphdr *th, struct sock *sk, int pus
 	sk->ack_timed = 0;
 	th->ack_seq = htonl(sk->acked_seq);
 	sk->window = tcp_select_window(sk);
-	th->window = htons(sk->window);
+	th->window = tcp_window_field(sk, sk->window);
 
-	return(sizeof(*th));
+	return(sizeof(*th) + tcp_add_options(sk, th));
 }
 
 /*
@@ -1558,7 +1705,7 @@ static int tcp_write(struct sock *sk, unsigned char *from,
 
 		         /* IP header + TCP header */
 			hdrlen = ((unsigned long)skb->h.th - (unsigned long)skb->data)
-			         + sizeof(struct tcphdr);
+			         + skb->h.th->doff*4;
 	
 			/* Add more stuff to the end of skb->len */
 			if (!(flags & MSG_OOB)) 
@@ -1571,7 +1718,9 @@ static int tcp_write(struct sock *sk, unsigned char *from,
 			  		copy = 0;
 				}
 	  
-				memcpy_fromfs(skb->data + skb->len, from, copy);
+				skb->csum = csum_block_add(skb->csum,
+					csum_partial_copy_fromuser(from, skb->data + skb->len, copy, 0),
+					skb->len - hdrlen);
 				skb->len += copy;
 				from += copy;
 				copied += copy;
@@ -1719,7 +1868,7 @@ static int tcp_write(struct sock *sk, unsigned char *from,
 			((struct tcphdr *)buff)->urg_ptr = ntohs(copy);
 		}
 		skb->len += tmp;
-		memcpy_fromfs(buff+tmp, from, copy);
+		skb->csum = csum_partial_copy_fromuser(from, buff+tmp, copy, 0);
 
 		from += copy;
 		copied += copy;
@@ -1848,10 +1997,12 @@ static void tcp_read_wakeup(struct sock *sk)
 	sk->ack_backlog = 0;
 	sk->bytes_rcv = 0;
 	sk->window = tcp_select_window(sk);
-	t1->window = ntohs(sk->window);
+	t1->window = tcp_window_field(sk, sk->window);
 	t1->ack_seq = ntohl(sk->acked_seq);
 	t1->doff = sizeof(*t1)/4;
-	tcp_send_check(t1, sk->saddr, sk->daddr, sizeof(*t1), sk);
+	tmp = tcp_add_options(sk, t1);
+	buff->len += tmp;
+	tcp_send_check(t1, sk->saddr, sk->daddr, sizeof(*t1)+tmp, sk);
 	sk->prot->queue_xmit(sk, dev, buff, 1);
 	tcp_statistics.TcpOutSegs++;
 }
@@ -2308,7 +2459,7 @@ static void tcp_send_fin(struct sock *sk)
 		
 	release_sock(sk); /* in case the malloc sleeps. */
 	
-	buff = prot->wmalloc(sk, MAX_RESET_SIZE,1 , GFP_KERNEL);
+	buff = prot->wmalloc(sk, MAX_FIN_SIZE,1 , GFP_KERNEL);
 	sk->inuse = 1;
 
 	if (buff == NULL)
@@ -2367,11 +2518,14 @@ static void tcp_send_fin(struct sock *sk)
 	buff->h.seq = sk->write_seq;
 	t1->ack = 1;
 	t1->ack_seq = ntohl(sk->acked_seq);
-	t1->window = ntohs(sk->window=tcp_select_window(sk));
+	sk->window = tcp_select_window(sk);
+	t1->window = tcp_window_field(sk, sk->window);
 	t1->fin = 1;
 	t1->rst = 0;
 	t1->doff = sizeof(*t1)/4;
-	tcp_send_check(t1, sk->saddr, sk->daddr, sizeof(*t1), sk);
+	tmp = tcp_add_options(sk, t1);
+	buff->len += tmp;
+	tcp_send_check(t1, sk->saddr, sk->daddr, sizeof(*t1)+tmp, sk);
 
 	/*
 	 * If there is data in the write queue, the fin must be appended to
@@ -2587,6 +2741,8 @@ static void tcp_options(struct sock *sk, struct tcphdr *th)
 	unsigned char *ptr;
 	int length=(th->doff*4)-sizeof(struct tcphdr);
 	int mss_seen = 0;
+	int wscale = -1, tstamp = 0, sack = 0;
+	unsigned long tsval = 0;
     
 	ptr = (unsigned char *)(th + 1);
   
@@ -2597,15 +2753,19 @@ static void tcp_options(struct sock *sk, struct tcphdr *th)
 	  	switch(opcode)
 	  	{
 	  		case TCPOPT_EOL:
-	  			return;
+	  			length = 0;
+	  			continue;
 	  		case TCPOPT_NOP:	/* Ref: RFC 793 section 3.1 */
 	  			length--;
 	  			ptr--;		/* the opsize=*ptr++ above was a mistake */
 	  			continue;
 	  		
 	  		default:
-	  			if(opsize<=2)	/* Avoid silly options looping forever */
-	  				return;
+	  			if(opsize<2 || opsize>length)	/* Avoid silly options looping forever */
+	  			{
+	  				length = 0;
+	  				continue;
+	  			}
 	  			switch(opcode)
 	  			{
 	  				case TCPOPT_MSS:
@@ -2615,7 +2775,21 @@ static void tcp_options(struct sock *sk, struct tcphdr *th)
 							mss_seen = 1;
 	  					}
 	  					break;
-		  				/* Add other options here as people feel the urge to implement stuff like large windows */
+					case TCPOPT_WINDOW:
+						if(opsize==TCPOLEN_WINDOW)
+							wscale = min(*ptr, TCP_MAX_WSCALE);
+						break;
+					case TCPOPT_TIMESTAMP:
+						if(opsize==TCPOLEN_TIMESTAMP)
+						{
+							tstamp = 1;
+							tsval = ntohl(*(unsigned long *)ptr);
+						}
+						break;
+					case TCPOPT_SACK_PERM:
+						if(opsize==TCPOLEN_SACK_PERM)
+							sack = 1;
+						break;
 	  			}
 	  			ptr+=opsize-2;
 	  			length-=opsize;
@@ -2625,6 +2799,25 @@ static void tcp_options(struct sock *sk, struct tcphdr *th)
 	{
 		if (! mss_seen)
 		      sk->mtu=min(sk->mtu, 536);  /* default MSS if none sent */
+
+		/*
+		 *	The big window, timestamp and SACK options are only
+		 *	used if both ends asked for them on their SYNs. We
+		 *	always do, so it's up to him. The timestamp takes 12
+		 *	bytes out of every frame.
+		 */
+
+		if (wscale >= 0)
+			sk->snd_wscale = wscale;
+		else
+			sk->snd_wscale = sk->rcv_wscale = 0;
+		sk->sack_ok = sack;
+		if (tstamp && !sk->tstamp_ok)
+		{
+			sk->tstamp_ok = 1;
+			sk->ts_recent = tsval;
+			sk->mtu -= TCPOLEN_TSTAMP_ALIGNED;
+		}
 	}
 #ifdef CONFIG_INET_PCTCP
 	sk->mss = min(sk->max_window >> 1, sk->mtu);
@@ -2633,6 +2826,68 @@ static void tcp_options(struct sock *sk, struct tcphdr *th)
 #endif  
 }
 
+/*
+ *	Pick out the options of an ordinary frame: the timestamp and any
+ *	SACK blocks. The usual case, our own aligned timestamp layout, is
+ *	checked first.
+ */
+
+static void tcp_parse_options(struct tcphdr *th, struct tcp_opt *tp)
+{
+	unsigned char *ptr;
+	int length=(th->doff*4)-sizeof(struct tcphdr);
+
+	tp->saw_tstamp = 0;
+	tp->num_sacks = 0;
+	if (length <= 0)
+		return;
+
+	ptr = (unsigned char *)(th + 1);
+	if (length == TCPOLEN_TSTAMP_ALIGNED && 
+	    *(unsigned long *)ptr == htonl(TCPOPT_TSTAMP_HDR))
+	{
+		tp->saw_tstamp = 1;
+		tp->rcv_tsval = ntohl(((unsigned long *)ptr)[1]);
+		tp->rcv_tsecr = ntohl(((unsigned long *)ptr)[2]);
+		return;
+	}
+
+	while(length>0)
+	{
+	  	int opcode=*ptr++;
+	  	int opsize;
+
+		if (opcode == TCPOPT_EOL)
+			return;
+		if (opcode == TCPOPT_NOP)
+		{
+			length--;
+			continue;
+		}
+		opsize=*ptr++;
+		if (opsize<2 || opsize>length)
+			return;
+		if (opcode == TCPOPT_TIMESTAMP && opsize == TCPOLEN_TIMESTAMP)
+		{
+			tp->saw_tstamp = 1;
+			tp->rcv_tsval = ntohl(*(unsigned long *)ptr);
+			tp->rcv_tsecr = ntohl(*(unsigned long *)(ptr+4));
+		}
+		else if (opcode == TCPOPT_SACK && opsize >= 10 && ((opsize-2) & 7) == 0)
+		{
+			int i, n = (opsize-2) >> 3;
+
+			if (n > TCP_MAX_SACKS)
+				n = TCP_MAX_SACKS;
+			for (i = 0; i < 2*n; i++)
+				tp->sacks[i] = ntohl(((unsigned long *)ptr)[i]);
+			tp->num_sacks = n;
+		}
+		ptr+=opsize-2;
+		length-=opsize;
+	}
+}
+
 static inline unsigned long default_mask(unsigned long dst)
 {
 	dst = ntohl(dst);
@@ -2673,7 +2928,6 @@ static void tcp_conn_request(struct sock *sk, struct sk_buff *skb,
 {
 	struct sk_buff *buff;
 	struct tcphdr *t1;
-	unsigned char *ptr;
 	struct sock *newsk;
 	struct tcphdr *th;
 	struct device *ndev=NULL;
@@ -2727,6 +2981,8 @@ static void tcp_conn_request(struct sock *sk, struct sk_buff *skb,
 	}
 
 	memcpy(newsk, sk, sizeof(*newsk));
+	newsk->hash_next = NULL;
+	newsk->hash_pprev = NULL;
 	skb_queue_head_init(&newsk->write_queue);
 	skb_queue_head_init(&newsk->receive_queue);
 	newsk->send_head = NULL;
@@ -2736,9 +2992,12 @@ static void tcp_conn_request(struct sock *sk, struct sk_buff *skb,
 	newsk->rto = TCP_TIMEOUT_INIT;
 	newsk->mdev = 0;
 	newsk->max_window = 0;
-	newsk->cong_window = 1;
-	newsk->cong_count = 0;
-	newsk->ssthresh = 0;
+	newsk->window = 0;
+	newsk->tstamp_ok = 0;
+	newsk->sack_ok = 0;
+	newsk->snd_wscale = 0;
+	newsk->rcv_wscale = tcp_wscale_offer(newsk);
+	newsk->cong_ops->init(newsk);	/* the listener's choice */
 	newsk->backoff = 0;
 	newsk->blog = 0;
 	newsk->intr = 0;
@@ -2861,7 +3120,7 @@ static void tcp_conn_request(struct sock *sk, struct sk_buff *skb,
 		return;
 	}
   
-	buff->len = sizeof(struct tcphdr)+4;
+	buff->len = sizeof(struct tcphdr);
 	buff->sk = newsk;
 	buff->localroute = newsk->localroute;
 
@@ -2906,7 +3165,7 @@ static void tcp_conn_request(struct sock *sk, struct sk_buff *skb,
 	t1->ack = 1;
 	newsk->window = tcp_select_window(newsk);
 	newsk->sent_seq = newsk->write_seq;
-	t1->window = ntohs(newsk->window);
+	t1->window = ntohs(min(newsk->window, 65535));	/* never scaled on a SYN */
 	t1->res1 = 0;
 	t1->res2 = 0;
 	t1->rst = 0;
@@ -2914,14 +3173,11 @@ static void tcp_conn_request(struct sock *sk, struct sk_buff *skb,
 	t1->psh = 0;
 	t1->syn = 1;
 	t1->ack_seq = ntohl(skb->h.th->seq+1);
-	t1->doff = sizeof(*t1)/4+1;
-	ptr =(unsigned char *)(t1+1);
-	ptr[0] = 2;
-	ptr[1] = 4;
-	ptr[2] = ((newsk->mtu) >> 8) & 0xff;
-	ptr[3] =(newsk->mtu) & 0xff;
-
-	tcp_send_check(t1, daddr, saddr, sizeof(*t1)+4, newsk);
+	tmp = tcp_syn_options(newsk, (unsigned char *)(t1+1), 1);
+	t1->doff = (sizeof(*t1) + tmp)/4;
+	buff->len += tmp;
+
+	tcp_send_check(t1, daddr, saddr, sizeof(*t1)+tmp, newsk);
 	newsk->prot->queue_xmit(newsk, ndev, buff, 0);
 	reset_xmit_timer(newsk, TIME_WRITE , TCP_TIMEOUT_INIT);
 	skb->sk = newsk;
@@ -3075,9 +3331,10 @@ static void tcp_write_xmit(struct sock *sk)
 			size = skb->len - (((unsigned char *) th) - skb->data);
 			
 			th->ack_seq = ntohl(sk->acked_seq);
-			th->window = ntohs(tcp_select_window(sk));
+			th->window = tcp_window_field(sk, tcp_select_window(sk));
+			tcp_stamp(sk, th);
 
-			tcp_send_check(th, sk->saddr, sk->daddr, size, sk);
+			tcp_send_check_skb(th, sk->saddr, sk->daddr, size, skb);
 
 			sk->sent_seq = skb->h.seq;
 			
@@ -3101,10 +3358,12 @@ static void tcp_write_xmit(struct sock *sk)
  *	This routine deals with incoming acks, but not outgoing ones.
  */
 
-extern __inline__ int tcp_ack(struct sock *sk, struct tcphdr *th, unsigned long saddr, int len)
+extern __inline__ int tcp_ack(struct sock *sk, struct tcphdr *th, unsigned long saddr, int len,
+	struct tcp_opt *tp)
 {
-	unsigned long ack;
+	unsigned long ack, win;
 	int flag = 0;
+	int ts_rtt;
 
 	/* 
 	 * 1 - there was data in packet as well as ack or new data is sent or 
@@ -3121,10 +3380,11 @@ extern __inline__ int tcp_ack(struct sock *sk, struct tcphdr *th, unsigned long
 	 */
 	 
 	ack = ntohl(th->ack_seq);
+	win = tcp_snd_window(sk, th);
 
-	if (ntohs(th->window) > sk->max_window) 
+	if (win > sk->max_window) 
 	{
-  		sk->max_window = ntohs(th->window);
+  		sk->max_window = win;
 #ifdef CONFIG_INET_PCTCP
 		/* Hack because we don't send partial packets to non SWS
 		   handling hosts */
@@ -3180,11 +3440,21 @@ extern __inline__ int tcp_ack(struct sock *sk, struct tcphdr *th, unsigned long
 	if (len != th->doff*4) 
 		flag |= 1;
 
+	/*
+	 *	A duplicate ack: no data, nothing new acked and the same
+	 *	window, while we have frames out. The other end is telling us
+	 *	it got something past a hole.
+	 */
+
+	if (!flag && ack == sk->rcv_ack_seq && sk->send_head != NULL &&
+		sk->window_seq == ack + win && sk->cong_ops->dup_ack)
+		sk->cong_ops->dup_ack(sk);
+
 	/*
 	 *	See if our window has been shrunk. 
 	 */
 
-	if (after(sk->window_seq, ack+ntohs(th->window))) 
+	if (after(sk->window_seq, ack+win)) 
 	{
 		/*
 		 * We may need to move packets from the send queue
@@ -3208,7 +3478,7 @@ extern __inline__ int tcp_ack(struct sock *sk, struct tcphdr *th, unsigned long
 	
 		flag |= 4;	/* Window changed */
 	
-		sk->window_seq = ack + ntohs(th->window);
+		sk->window_seq = ack + win;
 		cli();
 		while (skb2 != NULL) 
 		{
@@ -3264,44 +3534,14 @@ extern __inline__ int tcp_ack(struct sock *sk, struct tcphdr *th, unsigned long
 	 *	Update the right hand window edge of the host
 	 */
 	 
-	sk->window_seq = ack + ntohs(th->window);
+	sk->window_seq = ack + win;
 
 	/*
 	 *	We don't want too many packets out there. 
 	 */
 	 
-	if (sk->ip_xmit_timeout == TIME_WRITE && 
-		sk->cong_window < 2048 && after(ack, sk->rcv_ack_seq)) 
-	{
-		/* 
-		 * This is Jacobson's slow start and congestion avoidance. 
-		 * SIGCOMM '88, p. 328.  Because we keep cong_window in integral
-		 * mss's, we can't do cwnd += 1 / cwnd.  Instead, maintain a 
-		 * counter and increment it once every cwnd times.  It's possible
-		 * that this should be done only if sk->retransmits == 0.  I'm
-		 * interpreting "new data is acked" as including data that has
-		 * been retransmitted but is just now being acked.
-		 */
-		if (sk->cong_window < sk->ssthresh)  
-			/* 
-			 *	In "safe" area, increase
-			 */
-			sk->cong_window++;
-		else 
-		{
-			/*
-			 *	In dangerous area, increase slowly.  In theory this is
-			 *  	sk->cong_window += 1 / sk->cong_window
-			 */
-			if (sk->cong_count >= sk->cong_window) 
-			{
-				sk->cong_window++;
-				sk->cong_count = 0;
-			}
-			else 
-				sk->cong_count++;
-		}
-	}
+	if (after(ack, sk->rcv_ack_seq))
+		sk->cong_ops->cong_avoid(sk, ack);
 
 	/*
 	 *	Remember the highest ack received.
@@ -3342,6 +3582,13 @@ extern __inline__ int tcp_ack(struct sock *sk, struct tcphdr *th, unsigned long
 		}
 	}
 
+	/*
+	 *	An echoed timestamp times the frame even if it was resent,
+	 *	so Karn's rule need not hold us back.
+	 */
+
+	ts_rtt = tp != NULL && tp->saw_tstamp && tp->rcv_tsecr != 0;
+
 	/* 
 	 *	See if we can take anything off of the retransmit queue.
 	 */
@@ -3406,7 +3653,11 @@ extern __inline__ int tcp_ack(struct sock *sk, struct tcphdr *th, unsigned long
 				sk->write_space(sk);
 			oskb = sk->send_head;
 
-			if (!(flag&2)) 	/* Not retransmitting */
+			/*
+			 *	A fast retransmit leaves sk->retransmits alone,
+			 *	so look at the frame itself too.
+			 */
+			if ((!(flag&2) && !oskb->tries) || ts_rtt)	/* Not retransmitting */
 			{
 				long m;
 	
@@ -3418,9 +3669,15 @@ extern __inline__ int tcp_ack(struct sock *sk, struct tcphdr *th, unsigned long
 				 *	m stands for "measurement".
 				 */
 	
-				m = jiffies - oskb->when;  /* RTT */
+				if (ts_rtt)
+					m = jiffies - tp->rcv_tsecr;
+				else
+					m = jiffies - oskb->when;  /* RTT */
+				ts_rtt = 0;
 				if(m<=0)
 					m=1;		/* IS THIS RIGHT FOR <0 ??? */
+				if (sk->cong_ops->rtt_sample)
+					sk->cong_ops->rtt_sample(sk, m);
 				m -= (sk->rtt >> 3);    /* m is now error in rtt est */
 				sk->rtt += m;           /* rtt = 7/8 rtt + 1/8 new */
 				if (m < 0)
@@ -3467,6 +3724,44 @@ extern __inline__ int tcp_ack(struct sock *sk, struct tcphdr *th, unsigned long
 		}
 	}
 
+	/*
+	 *	Mark what his SACK blocks say he holds, so a retransmit
+	 *	skips over it. The marks are only advisory: a timeout
+	 *	clears them and everything goes again.
+	 */
+
+	if (tp != NULL && tp->num_sacks && sk->sack_ok)
+	{
+		struct sk_buff *skb;
+		struct iphdr *iph;
+		struct tcphdr *th2;
+		int i;
+
+		cli();
+		for (skb = sk->send_head; skb != NULL; skb = skb->link3)
+		{
+			/*
+			 *	h.seq has overwritten h.th on the send queue,
+			 *	so dig the header out the way a retransmit does.
+			 */
+			if (skb->dev == NULL)
+				continue;
+			iph = (struct iphdr *)(skb->data +
+					       skb->dev->hard_header_len);
+			th2 = (struct tcphdr *)(((char *)iph) + (iph->ihl << 2));
+			for (i = 0; i < tp->num_sacks; i++)
+			{
+				if (!before(ntohl(th2->seq), tp->sacks[2*i]) &&
+				    !after(skb->h.seq, tp->sacks[2*i+1]))
+				{
+					skb->sacked = 1;
+					break;
+				}
+			}
+		}
+		sti();
+	}
+
 	/*
 	 * XXX someone ought to look at this too.. at the moment, if skb_peek()
 	 * returns non-NULL, we complete ignore the timer stuff in the else
@@ -4254,7 +4549,6 @@ static int tcp_connect(struct sock *sk, struct sockaddr_in *usin, int addr_len)
 {
 	struct sk_buff *buff;
 	struct device *dev=NULL;
-	unsigned char *ptr;
 	int tmp;
 	int atype;
 	struct tcphdr *t1;
@@ -4300,7 +4594,7 @@ static int tcp_connect(struct sock *sk, struct sockaddr_in *usin, int addr_len)
 		return(-ENOMEM);
 	}
 	sk->inuse = 1;
-	buff->len = 24;
+	buff->len = sizeof(struct tcphdr);
 	buff->sk = sk;
 	buff->free = 0;
 	buff->localroute = sk->localroute;
@@ -4330,6 +4624,12 @@ static int tcp_connect(struct sock *sk, struct sockaddr_in *usin, int addr_len)
 	buff->len += tmp;
 	t1 = (struct tcphdr *)((char *)t1 +tmp);
 
+	/*
+	 *	build_header() has picked our source address if we had none,
+	 *	so the socket can go on its connected hash chain now.
+	 */
+	rehash_sock(sk);
+
 	memcpy(t1,(void *)&(sk->dummy_th), sizeof(*t1));
 	t1->seq = ntohl(sk->write_seq++);
 	sk->sent_seq = sk->write_seq;
@@ -4343,7 +4643,6 @@ static int tcp_connect(struct sock *sk, struct sockaddr_in *usin, int addr_len)
 	t1->psh = 0;
 	t1->syn = 1;
 	t1->urg_ptr = 0;
-	t1->doff = 6;
 	/* use 512 or whatever user asked for */
 	
 	if(rt!=NULL && (rt->rt_flags&RTF_WINDOW))
@@ -4376,16 +4675,19 @@ static int tcp_connect(struct sock *sk, struct sockaddr_in *usin, int addr_len)
 	sk->mtu = min(sk->mtu, dev->mtu - HEADER_SIZE);
 	
 	/*
-	 *	Put in the TCP options to say MTU. 
+	 *	Put in the TCP options to say MTU, and offer timestamps,
+	 *	window scaling and SACK. 
 	 */
 
-	ptr = (unsigned char *)(t1+1);
-	ptr[0] = 2;
-	ptr[1] = 4;
-	ptr[2] = (sk->mtu) >> 8;
-	ptr[3] = (sk->mtu) & 0xff;
+	sk->tstamp_ok = 0;
+	sk->sack_ok = 0;
+	sk->snd_wscale = 0;
+	sk->rcv_wscale = tcp_wscale_offer(sk);
+	tmp = tcp_syn_options(sk, (unsigned char *)(t1+1), 0);
+	t1->doff = (sizeof(*t1) + tmp)/4;
+	buff->len += tmp;
 	tcp_send_check(t1, sk->saddr, sk->daddr,
-		  sizeof(struct tcphdr) + 4, sk);
+		  sizeof(struct tcphdr) + tmp, sk);
 
 	/*
 	 *	This must go first otherwise a really quick response will get reset. 
@@ -4496,6 +4798,91 @@ static int tcp_std_reset(struct sock *sk, struct sk_buff *skb)
 	return(0);
 }
 
+/*
+ *	Header prediction (Van Jacobson). On an established connection nearly
+ *	every segment is either a pure ack for data we sent, or the next block
+ *	of in-order data acking nothing new. Those can skip the RFC793 walk in
+ *	tcp_rcv(). Returns 1 if the frame has been dealt with; if we return 0
+ *	nothing has been touched and it goes the slow way.
+ */
+
+extern __inline__ int tcp_fast_path(struct sk_buff *skb, struct sock *sk,
+	struct tcphdr *th, unsigned long saddr, unsigned short len,
+	struct tcp_opt *tp)
+{
+	unsigned long ack;
+	unsigned long datalen;
+
+	/*
+	 *	Just ACK (and maybe PSH), no options but a timestamp, and the
+	 *	very sequence number we want next.
+	 */
+
+	if (th->syn || th->fin || th->rst || th->urg || !th->ack)
+		return 0;
+	if (th->doff != sizeof(struct tcphdr)/4 &&
+	    (th->doff != (sizeof(struct tcphdr)+TCPOLEN_TSTAMP_ALIGNED)/4 ||
+	     *(unsigned long *)(th + 1) != htonl(TCPOPT_TSTAMP_HDR)))
+		return 0;
+	if (th->seq != sk->acked_seq)
+		return 0;
+	if (sk->zapped || sk->urg_data == URG_NOTYET)
+		return 0;
+
+	ack = ntohl(th->ack_seq);
+	datalen = len - th->doff*4;
+
+	if (datalen == 0)
+	{
+		/*
+		 *	A pure ack for new data. tcp_ack() still has to clean the
+		 *	retransmit queue and time it, but there is nothing else to do.
+		 */
+
+		if (th->psh || !after(ack, sk->rcv_ack_seq) || after(ack, sk->sent_seq))
+			return 0;
+		tcp_statistics.TcpPredAcks++;
+		tcp_ack(sk, th, saddr, len, tp);
+		kfree_skb(skb, FREE_READ);
+		return 1;
+	}
+
+	/*
+	 *	In-order data. The ack and window must be the ones we already
+	 *	have so that tcp_ack() would do nothing, the data must fit the
+	 *	window we offered, and there must be no out of order frames
+	 *	waiting so it simply goes on the end of the queue.
+	 */
+
+	if (ack != sk->rcv_ack_seq || sk->window_seq != ack + tcp_snd_window(sk, th))
+		return 0;
+	if (datalen > sk->window || (sk->shutdown & RCV_SHUTDOWN))
+		return 0;
+	if (sk->ip_xmit_timeout == TIME_PROBE0)
+		return 0;
+	if (skb_peek(&sk->receive_queue) != NULL && !sk->receive_queue.prev->acked)
+		return 0;
+
+	tcp_statistics.TcpPredData++;
+
+	if (sk->keepopen && sk->ip_xmit_timeout == TIME_KEEPOPEN)
+		reset_xmit_timer(sk, TIME_KEEPOPEN, TCP_TIMEOUT_LEN);
+
+	skb->len = datalen;
+	sk->bytes_rcv += datalen;
+	th->ack_seq = th->seq + datalen;
+	skb->acked = 1;
+	skb_queue_tail(&sk->receive_queue, skb);
+
+	sk->acked_seq = th->ack_seq;
+	sk->window -= datalen;
+
+	tcp_send_ack(sk->sent_seq, sk->acked_seq, sk, th, saddr);
+	if (!sk->dead)
+		sk->data_ready(sk,0);
+	return 1;
+}
+
 /*
  *	A TCP packet has arrived.
  */
@@ -4506,6 +4893,7 @@ int tcp_rcv(struct sk_buff *skb, struct device *dev, struct options *opt,
 {
 	struct tcphdr *th;
 	struct sock *sk;
+	struct tcp_opt tp;
 	int syn_ok=0;
 	
 	if (!skb) 
@@ -4528,6 +4916,18 @@ int tcp_rcv(struct sk_buff *skb, struct device *dev, struct options *opt,
 	  	return(0);
 	}
   
+	/*
+	 *	We use the header as scratch space (the sequence number is
+	 *	turned round in place), so we need a private copy if a tap or
+	 *	raw socket is sharing it.
+	 */
+
+	if (!redo && skb_data_shared(skb) && skb_unshare_data(skb, GFP_ATOMIC))
+	{
+		kfree_skb(skb,FREE_READ);
+		return(0);
+	}
+
 	th = skb->h.th;
 
 	/*
@@ -4628,6 +5028,22 @@ int tcp_rcv(struct sk_buff *skb, struct device *dev, struct options *opt,
 	skb->sk=sk;
 	sk->rmem_alloc += skb->mem_len;
 
+	/*
+	 *	Pick out the timestamp and SACK blocks. The timestamp of a
+	 *	frame at the left edge is the one we echo (RFC 1323).
+	 */
+
+	tcp_parse_options(th, &tp);
+	if (tp.saw_tstamp && sk->tstamp_ok && !after(th->seq, sk->acked_seq))
+		sk->ts_recent = tp.rcv_tsval;
+
+	if (sk->state==TCP_ESTABLISHED && tcp_fast_path(skb, sk, th, saddr, len, &tp))
+	{
+		release_sock(sk);
+		return 0;
+	}
+	tcp_statistics.TcpSlowPath++;
+
 	/*
 	 *	This basically follows the flow suggested by RFC793, with the corrections in RFC1122. We
 	 *	don't implement precedence and we process URG incorrectly (deliberately so) for BSD bug
@@ -4699,7 +5115,7 @@ int tcp_rcv(struct sk_buff *skb, struct device *dev, struct options *opt,
 			if(th->ack)
 			{
 				/* We got an ack, but it's not a good ack */
-				if(!tcp_ack(sk,th,saddr,len))
+				if(!tcp_ack(sk,th,saddr,len,&tp))
 				{
 					/* Reset the ack - its an ack from a 
 					   different connection  [ th->rst is checked in tcp_reset()] */
@@ -4843,7 +5259,7 @@ int tcp_rcv(struct sk_buff *skb, struct device *dev, struct options *opt,
 	 */
 	 
 
-	if(th->ack && !tcp_ack(sk,th,saddr,len))
+	if(th->ack && !tcp_ack(sk,th,saddr,len,&tp))
 	{
 		/*
 		 *	Our three way handshake failed.
@@ -4962,9 +5378,11 @@ static void tcp_write_wakeup(struct sock *sk)
 	t1->fin = 0;	/* We are sending a 'previous' sequence, and 0 bytes of data - thus no FIN bit */
 	t1->syn = 0;
 	t1->ack_seq = ntohl(sk->acked_seq);
-	t1->window = ntohs(tcp_select_window(sk));
+	t1->window = tcp_window_field(sk, tcp_select_window(sk));
 	t1->doff = sizeof(*t1)/4;
-	tcp_send_check(t1, sk->saddr, sk->daddr, sizeof(*t1), sk);
+	tmp = tcp_add_options(sk, t1);
+	buff->len += tmp;
+	tcp_send_check(t1, sk->saddr, sk->daddr, sizeof(*t1)+tmp, sk);
 	 /*
 	  *	Send it and free it.
    	  *	This will prevent the timer from automatically being restarted.
@@ -5005,6 +5423,9 @@ int tcp_setsockopt(struct sock *sk, int level, int optname, char *optval, int op
   	if (optval == NULL) 
   		return(-EINVAL);
 
+	if (optname == TCP_CONGESTION || optname == TCP_CONGESTION_DEFAULT)
+		return tcp_cong_setsockopt(sk, optname, optval, optlen);
+
   	err=verify_area(VERIFY_READ, optval, sizeof(int));
   	if(err)
   		return err;
@@ -5040,6 +5461,9 @@ int tcp_getsockopt(struct sock *sk, int level, int optname, char *optval, int *o
 			
 	switch(optname)
 	{
+		case TCP_CONGESTION:
+		case TCP_CONGESTION_DEFAULT:
+			return tcp_cong_getsockopt(sk, optname, optval, optlen);
 		case TCP_MAXSEG:
 			val=sk->user_mss;
 			break;
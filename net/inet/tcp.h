@@ -20,9 +20,9 @@
 
 #include <linux/tcp.h>
 
-#define MAX_SYN_SIZE	44 + MAX_HEADER
-#define MAX_FIN_SIZE	40 + MAX_HEADER
-#define MAX_ACK_SIZE	40 + MAX_HEADER
+#define MAX_SYN_SIZE	64 + MAX_HEADER	/* MSS, timestamp, window scale, SACK ok */
+#define MAX_FIN_SIZE	52 + MAX_HEADER	/* timestamp */
+#define MAX_ACK_SIZE	80 + MAX_HEADER	/* timestamp and SACK blocks */
 #define MAX_RESET_SIZE	40 + MAX_HEADER
 #define MAX_WINDOW	16384
 #define MIN_WINDOW	2048
@@ -73,11 +73,46 @@
 #define TCPOPT_NOP		1	/* Padding */
 #define TCPOPT_EOL		0	/* End of options */
 #define TCPOPT_MSS		2	/* Segment size negotiating */
+#define TCPOPT_WINDOW		3	/* Window scaling (RFC1323) */
+#define TCPOPT_SACK_PERM	4	/* SACK allowed, on the SYN (RFC2018) */
+#define TCPOPT_SACK		5	/* Selective acknowledgement blocks */
+#define TCPOPT_TIMESTAMP	8	/* Better RTT estimations/PAWS (RFC1323) */
+
+#define TCPOLEN_WINDOW		3
+#define TCPOLEN_SACK_PERM	2
+#define TCPOLEN_TIMESTAMP	10
+
+/*
+ *	The timestamp option as we send it, behind two NOPs so the values
+ *	are aligned (RFC1323 appendix A). Header prediction looks for it.
+ */
+
+#define TCPOLEN_TSTAMP_ALIGNED	12
+#define TCPOPT_TSTAMP_HDR	((TCPOPT_NOP << 24) | (TCPOPT_NOP << 16) | \
+				 (TCPOPT_TIMESTAMP << 8) | TCPOLEN_TIMESTAMP)
+
+#define TCP_MAX_WSCALE		14	/* RFC1323 limit */
+#define TCP_MAX_SACKS		4	/* Blocks that fit in 40 bytes of options */
+
 /*
- *	We don't use these yet, but they are for PAWS and big windows
+ *	The options of a received frame that we care about after the SYN.
  */
-#define TCPOPT_WINDOW		3	/* Window scaling */
-#define TCPOPT_TIMESTAMP	8	/* Better RTT estimations/PAWS */
+
+struct tcp_opt
+{
+	unsigned char	saw_tstamp;
+	unsigned char	num_sacks;
+	unsigned long	rcv_tsval;		/* his clock */
+	unsigned long	rcv_tsecr;		/* our clock, echoed */
+	unsigned long	sacks[TCP_MAX_SACKS*2];	/* start, end pairs, host order */
+};
+
+/*
+ *	Window fields. Only frames after the SYNs are scaled.
+ */
+
+#define tcp_snd_window(sk, th)	((unsigned long) ntohs((th)->window) << (sk)->snd_wscale)
+#define tcp_window_field(sk, win) htons((win) >> (sk)->rcv_wscale)
 
 
 /*
@@ -137,6 +172,36 @@ extern void tcp_send_check(struct tcphdr *th, unsigned long saddr,
 extern void tcp_send_probe0(struct sock *sk);
 extern void tcp_enqueue_partial(struct sk_buff *, struct sock *);
 extern struct sk_buff * tcp_dequeue_partial(struct sock *);
+extern void tcp_do_retransmit(struct sock *sk, int all);
+
+/*
+ *	Congestion control (tcp_cong.c). The algorithm decides how
+ *	sk->cong_window and sk->ssthresh move; tcp_ack() and the timers
+ *	just tell it what happened. Each socket has its own, picked with
+ *	the TCP_CONGESTION socket option, and starts with the system
+ *	default. Only init and cong_avoid must be filled in.
+ */
+
+#define TCP_CONG_NAME_MAX	16
+
+struct tcp_cong_ops
+{
+	struct tcp_cong_ops	*next;
+	char			name[TCP_CONG_NAME_MAX];
+	void			(*init)(struct sock *sk);		/* new connection */
+	void			(*cong_avoid)(struct sock *sk, unsigned long ack); /* new data acked */
+	void			(*dup_ack)(struct sock *sk);		/* duplicate ack */
+	void			(*loss)(struct sock *sk);		/* retransmit timeout */
+	void			(*rtt_sample)(struct sock *sk, long rtt); /* jiffies */
+};
+
+extern struct tcp_cong_ops *tcp_cong_default;
+
+extern int	tcp_register_cong(struct tcp_cong_ops *ops);
+extern void	tcp_cong_open(struct sock *sk);
+extern void	tcp_cong_loss(struct sock *sk);
+extern int	tcp_cong_setsockopt(struct sock *sk, int optname, char *optval, int optlen);
+extern int	tcp_cong_getsockopt(struct sock *sk, int optname, char *optval, int *optlen);
 
 
 #endif	/* _TCP_H */
@@ -0,0 +1,424 @@
+/*
+ * INET		An implementation of the TCP/IP protocol suite for the LINUX
+ *		operating system.  INET is implemented using the  BSD Socket
+ *		interface as the means of communication with the user level.
+ *
+ *		TCP congestion control.
+ *
+ *		tcp_ack() and the retransmit timer used to move cong_window
+ *		themselves. They now call through sk->cong_ops, so different
+ *		sockets can run different algorithms. Three come built in:
+ *
+ *		classic	What we always did: slow start and congestion
+ *			avoidance, and nothing but the retransmit timer to
+ *			find a loss.
+ *		reno	Adds fast retransmit and fast recovery: three
+ *			duplicate acks resend the lost frame and halve the
+ *			window without waiting for the timer and going
+ *			back to a window of one.
+ *		vegas	Reno's loss handling, but the window follows the
+ *			round trip time. Once a round trip it compares the
+ *			actual rate with what the base (smallest) RTT says
+ *			we could do, and backs off before the queues fill
+ *			rather than after they overflow.
+ *
+ *		cong_window counts frames, not bytes, as it always has.
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		as published by the Free Software Foundation; either version
+ *		2 of the License, or (at your option) any later version.
+ */
+
+#include <linux/types.h>
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/string.h>
+#include <linux/config.h>
+#include <linux/socket.h>
+#include <linux/in.h>
+#include <linux/inet.h>
+#include <linux/netdevice.h>
+#include "snmp.h"
+#include "ip.h"
+#include "protocol.h"
+#include "tcp.h"
+#include <linux/skbuff.h>
+#include "sock.h"
+#include <linux/errno.h>
+#include <asm/system.h>
+#include <asm/segment.h>
+
+/*
+ *	The window is never opened past this many frames.
+ */
+
+#define TCP_CONG_MAX	2048
+
+static __inline__ int min(unsigned int a, unsigned int b)
+{
+	if (a < b) 
+		return(a);
+	return(b);
+}
+
+static __inline__ int max(unsigned int a, unsigned int b)
+{
+	if (a > b) 
+		return(a);
+	return(b);
+}
+
+/*
+ *	Slow start and congestion avoidance, as tcp_ack() has always done
+ *	it. Called when new data has been acked.
+ */
+
+void tcp_cong_open(struct sock *sk)
+{
+	if (sk->ip_xmit_timeout != TIME_WRITE || sk->cong_window >= TCP_CONG_MAX)
+		return;
+
+	/*
+	 * This is Jacobson's slow start and congestion avoidance.
+	 * SIGCOMM '88, p. 328.  Because we keep cong_window in integral
+	 * mss's, we can't do cwnd += 1 / cwnd.  Instead, maintain a
+	 * counter and increment it once every cwnd times.  It's possible
+	 * that this should be done only if sk->retransmits == 0.  I'm
+	 * interpreting "new data is acked" as including data that has
+	 * been retransmitted but is just now being acked.
+	 */
+
+	if (sk->cong_window < sk->ssthresh)
+		/*
+		 *	In "safe" area, increase
+		 */
+		sk->cong_window++;
+	else
+	{
+		/*
+		 *	In dangerous area, increase slowly.  In theory this is
+		 *  	sk->cong_window += 1 / sk->cong_window
+		 */
+		if (sk->cong_count >= sk->cong_window)
+		{
+			sk->cong_window++;
+			sk->cong_count = 0;
+		}
+		else
+			sk->cong_count++;
+	}
+}
+
+/*
+ *	The retransmit timer went off: remember half the window where we
+ *	lost and start again from one frame.
+ */
+
+void tcp_cong_loss(struct sock *sk)
+{
+	sk->ssthresh = sk->cong_window >> 1;
+	/* sk->ssthresh in theory can be zero.  I guess that's OK */
+	sk->cong_count = 0;
+	sk->cong_window = 1;
+	sk->dup_acks = 0;
+}
+
+/*
+ *	Classic. ssthresh starts at zero, so it is in congestion avoidance
+ *	from the first frame.
+ */
+
+static void classic_init(struct sock *sk)
+{
+	sk->cong_window = 1;
+	sk->cong_count = 0;
+	sk->ssthresh = 0;
+	sk->dup_acks = 0;
+}
+
+static void classic_cong_avoid(struct sock *sk, unsigned long ack)
+{
+	tcp_cong_open(sk);
+}
+
+/*
+ *	Reno.
+ */
+
+static void reno_init(struct sock *sk)
+{
+	sk->cong_window = 1;
+	sk->cong_count = 0;
+	sk->ssthresh = 0xFFFF;		/* Slow start until the first loss */
+	sk->dup_acks = 0;
+}
+
+/*
+ *	The third duplicate ack means a frame was lost but those after it
+ *	are getting through. Resend it, halve the window, and inflate it
+ *	by one for each frame that has left the network (one per duplicate
+ *	ack) so that new data can keep the pipe full meanwhile.
+ */
+
+static void reno_dup_ack(struct sock *sk)
+{
+	sk->dup_acks++;
+	if (sk->dup_acks == 3)
+	{
+		sk->ssthresh = max(sk->cong_window >> 1, 2);
+		sk->cong_window = sk->ssthresh + 3;
+		sk->cong_count = 0;
+		tcp_do_retransmit(sk, 0);
+	}
+	else if (sk->dup_acks > 3 && sk->cong_window < TCP_CONG_MAX)
+		sk->cong_window++;
+}
+
+static void reno_cong_avoid(struct sock *sk, unsigned long ack)
+{
+	/*
+	 *	New data acked ends fast recovery: deflate to the halved
+	 *	window and carry on in congestion avoidance.
+	 */
+
+	if (sk->dup_acks >= 3)
+	{
+		sk->cong_window = sk->ssthresh;
+		sk->cong_count = 0;
+		sk->dup_acks = 0;
+		return;
+	}
+	sk->dup_acks = 0;
+	tcp_cong_open(sk);
+}
+
+static void reno_loss(struct sock *sk)
+{
+	tcp_cong_loss(sk);
+	if (sk->ssthresh < 2)
+		sk->ssthresh = 2;
+}
+
+/*
+ *	Vegas (Brakmo and Peterson, SIGCOMM '94). The per socket state is
+ *	kept in cong_priv[].
+ */
+
+#define vegas_base_rtt(sk)	((sk)->cong_priv[0])	/* smallest RTT seen */
+#define vegas_min_rtt(sk)	((sk)->cong_priv[1])	/* smallest this round */
+#define vegas_beg_seq(sk)	((sk)->cong_priv[2])	/* round ends when this is acked */
+#define vegas_cnt_rtt(sk)	((sk)->cong_priv[3])	/* samples this round */
+
+#define VEGAS_ALPHA	2	/* Fewer frames than this queued: open up */
+#define VEGAS_BETA	4	/* More than this: close down */
+#define VEGAS_GAMMA	1	/* Leave slow start past this */
+
+static void vegas_init(struct sock *sk)
+{
+	reno_init(sk);
+	vegas_base_rtt(sk) = ~0UL;
+	vegas_min_rtt(sk) = ~0UL;
+	vegas_beg_seq(sk) = sk->sent_seq;
+	vegas_cnt_rtt(sk) = 0;
+}
+
+static void vegas_rtt_sample(struct sock *sk, long rtt)
+{
+	if (rtt < vegas_base_rtt(sk))
+		vegas_base_rtt(sk) = rtt;
+	if (rtt < vegas_min_rtt(sk))
+		vegas_min_rtt(sk) = rtt;
+	vegas_cnt_rtt(sk)++;
+}
+
+static void vegas_cong_avoid(struct sock *sk, unsigned long ack)
+{
+	unsigned long rtt, diff;
+
+	if (sk->dup_acks >= 3 || !after(ack, vegas_beg_seq(sk)))
+	{
+		/*
+		 *	Within a round only slow start moves the window, and
+		 *	it does so a frame per ack just like Reno.
+		 */
+
+		if (sk->dup_acks >= 3 || sk->cong_window < sk->ssthresh)
+			reno_cong_avoid(sk, ack);
+		return;
+	}
+
+	/*
+	 *	A round trip is over. With jiffy resolution timing one or two
+	 *	samples tell us nothing, so act like Reno then.
+	 */
+
+	rtt = vegas_min_rtt(sk);
+	vegas_beg_seq(sk) = sk->sent_seq;
+	vegas_min_rtt(sk) = ~0UL;
+
+	if (vegas_cnt_rtt(sk) <= 2)
+	{
+		vegas_cnt_rtt(sk) = 0;
+		reno_cong_avoid(sk, ack);
+		return;
+	}
+	vegas_cnt_rtt(sk) = 0;
+	sk->dup_acks = 0;
+
+	/*
+	 *	diff is how many of our frames are sitting in queues: the
+	 *	window less what it would be at the base RTT.
+	 */
+
+	diff = sk->cong_window * (rtt - vegas_base_rtt(sk)) / rtt;
+
+	if (sk->cong_window < sk->ssthresh)
+	{
+		if (diff > VEGAS_GAMMA)
+		{
+			/* The queues are filling: stop doubling */
+			sk->cong_window -= diff - 1;
+			sk->ssthresh = sk->cong_window;
+		}
+		else if (sk->ip_xmit_timeout == TIME_WRITE && sk->cong_window < TCP_CONG_MAX)
+			sk->cong_window++;
+	}
+	else if (diff > VEGAS_BETA)
+	{
+		if (sk->cong_window > 2)
+			sk->cong_window--;
+
+		/* Keep ssthresh below us so we don't slow start again */
+		if (sk->ssthresh > sk->cong_window)
+			sk->ssthresh = sk->cong_window;
+	}
+	else if (diff < VEGAS_ALPHA && sk->cong_window < TCP_CONG_MAX)
+		sk->cong_window++;
+	sk->cong_count = 0;
+}
+
+static struct tcp_cong_ops tcp_cong_vegas = {
+	NULL,
+	"vegas",
+	vegas_init,
+	vegas_cong_avoid,
+	reno_dup_ack,
+	reno_loss,
+	vegas_rtt_sample
+};
+
+static struct tcp_cong_ops tcp_cong_reno = {
+	&tcp_cong_vegas,
+	"reno",
+	reno_init,
+	reno_cong_avoid,
+	reno_dup_ack,
+	reno_loss,
+	NULL
+};
+
+static struct tcp_cong_ops tcp_cong_classic = {
+	&tcp_cong_reno,
+	"classic",
+	classic_init,
+	classic_cong_avoid,
+	NULL,
+	tcp_cong_loss,
+	NULL
+};
+
+static struct tcp_cong_ops *tcp_cong_list = &tcp_cong_classic;
+
+struct tcp_cong_ops *tcp_cong_default = &tcp_cong_reno;
+
+static struct tcp_cong_ops *tcp_cong_find(char *name)
+{
+	struct tcp_cong_ops *ops;
+
+	for (ops = tcp_cong_list; ops != NULL; ops = ops->next)
+		if (strcmp(ops->name, name) == 0)
+			return ops;
+	return NULL;
+}
+
+/*
+ *	Add an algorithm. There is no way to take one away again as
+ *	sockets may be using it.
+ */
+
+int tcp_register_cong(struct tcp_cong_ops *ops)
+{
+	struct tcp_cong_ops **opp;
+
+	if (ops->init == NULL || ops->cong_avoid == NULL)
+		return -EINVAL;
+	for (opp = &tcp_cong_list; *opp != NULL; opp = &(*opp)->next)
+		if (strcmp((*opp)->name, ops->name) == 0)
+			return -EEXIST;
+	ops->next = NULL;
+	*opp = ops;
+	return 0;
+}
+
+/*
+ *	The socket options. The value is the name of the algorithm, as a
+ *	string. Setting it starts the window again from scratch. Setting
+ *	the default is for the superuser and affects new sockets only.
+ */
+
+int tcp_cong_setsockopt(struct sock *sk, int optname, char *optval, int optlen)
+{
+	struct tcp_cong_ops *ops;
+	char name[TCP_CONG_NAME_MAX];
+	int err;
+
+	if (optlen <= 0)
+		return -EINVAL;
+	if (optlen > TCP_CONG_NAME_MAX - 1)
+		optlen = TCP_CONG_NAME_MAX - 1;
+	err = verify_area(VERIFY_READ, optval, optlen);
+	if (err)
+		return err;
+	memcpy_fromfs(name, optval, optlen);
+	name[optlen] = 0;
+
+	ops = tcp_cong_find(name);
+	if (ops == NULL)
+		return -ENOENT;
+
+	if (optname == TCP_CONGESTION_DEFAULT)
+	{
+		if (!suser())
+			return -EPERM;
+		tcp_cong_default = ops;
+		return 0;
+	}
+
+	sk->cong_ops = ops;
+	ops->init(sk);
+	return 0;
+}
+
+int tcp_cong_getsockopt(struct sock *sk, int optname, char *optval, int *optlen)
+{
+	struct tcp_cong_ops *ops;
+	int len, err;
+
+	ops = (optname == TCP_CONGESTION_DEFAULT) ? tcp_cong_default : sk->cong_ops;
+
+	err = verify_area(VERIFY_WRITE, optlen, sizeof(int));
+	if (err)
+		return err;
+	len = get_fs_long((unsigned long *) optlen);
+	if (len < 0)
+		return -EINVAL;
+	len = min(len, strlen(ops->name) + 1);
+
+	err = verify_area(VERIFY_WRITE, optval, len);
+	if (err)
+		return err;
+	memcpy_tofs(optval, ops->name, len);
+	put_fs_long(len, (unsigned long *) optlen);
+	return 0;
+}
@@ -72,6 +72,7 @@
 #include "udp.h"
 #include "icmp.h"
 #include "route.h"
+#include "checksum.h"
 
 /*
  *	SNMP MIB for the UDP layer
@@ -154,97 +155,8 @@ void udp_err(int err, unsigned char *header, unsigned long daddr,
 
 static unsigned short udp_check(struct udphdr *uh, int len, unsigned long saddr, unsigned long daddr)
 {
-	unsigned long sum;
-
-	__asm__(  "\t addl %%ecx,%%ebx\n"
-		  "\t adcl %%edx,%%ebx\n"
-		  "\t adcl $0, %%ebx\n"
-		  : "=b"(sum)
-		  : "0"(daddr), "c"(saddr), "d"((ntohs(len) << 16) + IPPROTO_UDP*256)
-		  : "cx","bx","dx" );
-
-	if (len > 3) 
-	{
-		__asm__("\tclc\n"
-			"1:\n"
-			"\t lodsl\n"
-			"\t adcl %%eax, %%ebx\n"
-			"\t loop 1b\n"
-			"\t adcl $0, %%ebx\n"
-			: "=b"(sum) , "=S"(uh)
-			: "0"(sum), "c"(len/4) ,"1"(uh)
-			: "ax", "cx", "bx", "si" );
-	}
-
-	/*
-	 *	Convert from 32 bits to 16 bits. 
-	 */
-
-	__asm__("\t movl %%ebx, %%ecx\n"
-		"\t shrl $16,%%ecx\n"
-	  	"\t addw %%cx, %%bx\n"
-	  	"\t adcw $0, %%bx\n"
-	  	: "=b"(sum)
-	  	: "0"(sum)
-	  	: "bx", "cx");
-	
-	/* 
-	 *	Check for an extra word. 
-	 */
-	 
-	if ((len & 2) != 0) 
-	{
-		__asm__("\t lodsw\n"
-			"\t addw %%ax,%%bx\n"
-			"\t adcw $0, %%bx\n"
-			: "=b"(sum), "=S"(uh)
-			: "0"(sum) ,"1"(uh)
-			: "si", "ax", "bx");
-  	}
-
-  	/*
-  	 *	Now check for the extra byte. 
-  	 */
-  	 
-	if ((len & 1) != 0) 
-	{
-		__asm__("\t lodsb\n"
-			"\t movb $0,%%ah\n"
-			"\t addw %%ax,%%bx\n"
-			"\t adcw $0, %%bx\n"
-			: "=b"(sum)
-			: "0"(sum) ,"S"(uh)
-			: "si", "ax", "bx");
-  	}
-
-  	/* 
-  	 *	We only want the bottom 16 bits, but we never cleared the top 16. 
-  	 */
-
-	return((~sum) & 0xffff);
-}
-
-/*
- *	Generate UDP checksums. These may be disabled, eg for fast NFS over ethernet
- *	We default them enabled.. if you turn them off you either know what you are
- *	doing or get burned...
- */
-
-static void udp_send_check(struct udphdr *uh, unsigned long saddr, 
-	       unsigned long daddr, int len, struct sock *sk)
-{
-	uh->check = 0;
-	if (sk && sk->no_check) 
-	  	return;
-	uh->check = udp_check(uh, len, saddr, daddr);
-	
-	/*
-	 *	FFFF and 0 are the same, pick the right one as 0 in the
-	 *	actual field means no checksum.
-	 */
-	 
-	if (uh->check == 0)
-		uh->check = 0xffff;
+	return csum_tcpudp_magic(saddr, daddr, len, IPPROTO_UDP,
+		csum_partial((unsigned char *)uh, len, 0));
 }
 
 
@@ -317,16 +229,23 @@ static int udp_send(struct sock *sk, struct sockaddr_in *sin,
 	buff = (unsigned char *) (uh + 1);
 
 	/*
-	 *	Copy the user data. 
+	 *	Copy the user data, and set up the UDP checksum as we go.
+	 *	FFFF and 0 are the same, pick the right one as 0 in the
+	 *	actual field means no checksum.
 	 */
 	 
-	memcpy_fromfs(buff, from, len);
-
-  	/*
-  	 *	Set up the UDP checksum. 
-  	 */
-  	 
-	udp_send_check(uh, saddr, sin->sin_addr.s_addr, skb->len - tmp, sk);
+	uh->check = 0;
+	if (sk->no_check)
+		memcpy_fromfs(buff, from, len);
+	else
+	{
+		uh->check = csum_tcpudp_magic(saddr, sin->sin_addr.s_addr,
+			len + sizeof(struct udphdr), IPPROTO_UDP,
+			csum_partial((unsigned char *)uh, sizeof(struct udphdr),
+				csum_partial_copy_fromuser(from, buff, len, 0)));
+		if (uh->check == 0)
+			uh->check = 0xffff;
+	}
 
 	/* 
 	 *	Send the datagram to the interface. 
@@ -545,6 +464,7 @@ int udp_connect(struct sock *sk, struct sockaddr_in *usin, int addr_len)
 	sk->daddr = usin->sin_addr.s_addr;
 	sk->dummy_th.dest = usin->sin_port;
 	sk->state = TCP_ESTABLISHED;
+	rehash_sock(sk);
 	return(0);
 }
 
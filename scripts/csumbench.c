@@ -0,0 +1,217 @@
+/*
+ * csumbench.c: time the Internet checksum routines of net/inet/checksum.c
+ * against the loop tcp_check() used before them, at a range of lengths
+ * and alignments. Everything is first checked against a plain C sum.
+ *
+ *	make -C scripts csumbench
+ *	scripts/csumbench
+ *
+ * This is i386 code: it is linked with net/inet/checksum.c as it is.
+ * The old loop is copied from tcp_check() as it was before checksum.c,
+ * csum_fold() and csum_block_add() from net/inet/checksum.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern unsigned long csum_partial(unsigned char *buff, int len, unsigned long sum);
+extern unsigned long csum_partial_copy(unsigned char *src, unsigned char *dst, int len, unsigned long sum);
+
+static inline unsigned short csum_fold(unsigned long sum)
+{
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum += sum >> 16;
+	return (~sum) & 0xffff;
+}
+
+static inline unsigned long csum_block_add(unsigned long sum, unsigned long sum2, int offset)
+{
+	if (offset & 1)
+		sum2 = ((sum2 & 0xFF00FF) << 8) + ((sum2 >> 8) & 0xFF00FF);
+	sum += sum2;
+	return sum + (sum < sum2);
+}
+
+/*
+ * The data loop of the old tcp_check(). The sum is left folded into
+ * the low 16 bits, the high ones are junk.
+ */
+static unsigned long old_csum(unsigned char *buff, int len)
+{
+	unsigned long sum = 0, d0, d1, d2;
+
+	__asm__("movl %%ecx, %%edx\n\t"
+		"cld\n\t"
+		"cmpl $32, %%ecx\n\t"
+		"jb 2f\n\t"
+		"shrl $5, %%ecx\n\t"
+		"clc\n"
+		"1:\tlodsl\n\t"
+		"adcl %%eax, %%ebx\n\t"
+		"lodsl\n\t"
+		"adcl %%eax, %%ebx\n\t"
+		"lodsl\n\t"
+		"adcl %%eax, %%ebx\n\t"
+		"lodsl\n\t"
+		"adcl %%eax, %%ebx\n\t"
+		"lodsl\n\t"
+		"adcl %%eax, %%ebx\n\t"
+		"lodsl\n\t"
+		"adcl %%eax, %%ebx\n\t"
+		"lodsl\n\t"
+		"adcl %%eax, %%ebx\n\t"
+		"lodsl\n\t"
+		"adcl %%eax, %%ebx\n\t"
+		"loop 1b\n\t"
+		"adcl $0, %%ebx\n\t"
+		"movl %%edx, %%ecx\n"
+		"2:\tandl $28, %%ecx\n\t"
+		"je 4f\n\t"
+		"shrl $2, %%ecx\n\t"
+		"clc\n"
+		"3:\tlodsl\n\t"
+		"adcl %%eax, %%ebx\n\t"
+		"loop 3b\n\t"
+		"adcl $0, %%ebx\n"
+		"4:\tmovl $0, %%eax\n\t"
+		"testw $2, %%dx\n\t"
+		"je 5f\n\t"
+		"lodsw\n\t"
+		"addl %%eax, %%ebx\n\t"
+		"adcl $0, %%ebx\n\t"
+		"movw $0, %%ax\n"
+		"5:\ttest $1, %%edx\n\t"
+		"je 6f\n\t"
+		"lodsb\n\t"
+		"addl %%eax, %%ebx\n\t"
+		"adcl $0, %%ebx\n"
+		"6:\tmovl %%ebx, %%eax\n\t"
+		"shrl $16, %%eax\n\t"
+		"addw %%ax, %%bx\n\t"
+		"adcw $0, %%bx"
+		: "=b" (sum), "=c" (d0), "=S" (d1), "=d" (d2)
+		: "0" (sum), "1" (len), "2" (buff)
+		: "ax", "memory");
+	return sum;
+}
+
+/* what it all has to agree with */
+static unsigned short ref_csum(unsigned char *p, int len)
+{
+	unsigned long sum = 0;
+	int i;
+
+	for (i = 0; i + 1 < len; i += 2)
+		sum += p[i] | (p[i+1] << 8);
+	if (len & 1)
+		sum += p[len-1];
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return (~sum) & 0xffff;
+}
+
+static inline unsigned long long rdtsc(void)
+{
+	unsigned long lo, hi;
+
+	__asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((unsigned long long) hi << 32) | lo;
+}
+
+#define BUFSIZE		8192
+#define REPS		200
+#define TRIES		7
+
+static unsigned char *src, *dst;
+static volatile unsigned long sink;
+
+static int check(void)
+{
+	int n, len, a, d, k, errors = 0;
+	unsigned short want, got;
+
+	for (n = 0; n < 50000; n++) {
+		len = rand() % 2001;
+		a = rand() & 3;
+		d = rand() & 3;
+		for (k = 0; k < len; k++)
+			src[a + k] = rand();
+		want = ref_csum(src + a, len);
+
+		got = (~old_csum(src + a, len)) & 0xffff;
+		if (got != want && errors++ < 10)
+			printf("old loop: len %d align %d: %04x, want %04x\n",
+				len, a, got, want);
+		got = csum_fold(csum_partial(src + a, len, 0));
+		if (got != want && errors++ < 10)
+			printf("csum_partial: len %d align %d: %04x, want %04x\n",
+				len, a, got, want);
+		memset(dst, 0x5a, len + 8);
+		got = csum_fold(csum_partial_copy(src + a, dst + d, len, 0));
+		if ((got != want || memcmp(src + a, dst + d, len) ||
+		     dst[d + len] != 0x5a) && errors++ < 10)
+			printf("csum_partial_copy: len %d align %d/%d: %04x, want %04x%s\n",
+				len, a, d, got, want,
+				memcmp(src + a, dst + d, len) || dst[d + len] != 0x5a ?
+				", bad copy" : "");
+		/* a block appended at an odd or even offset, as tcp_write() does */
+		k = len ? rand() % (len + 1) : 0;
+		got = csum_fold(csum_block_add(csum_partial(src + a, k, 0),
+			csum_partial_copy(src + a + k, dst + d, len - k, 0), k));
+		if (got != want && errors++ < 10)
+			printf("csum_block_add: len %d split %d: %04x, want %04x\n",
+				len, k, got, want);
+	}
+	return errors;
+}
+
+/* best of TRIES, in cycles per call */
+#define TIME(result, stmt) do { \
+	unsigned long long t, best = ~0ULL; \
+	int r, i; \
+	for (r = 0; r < TRIES; r++) { \
+		t = rdtsc(); \
+		for (i = 0; i < REPS; i++) \
+			stmt; \
+		t = rdtsc() - t; \
+		if (t < best) \
+			best = t; \
+	} \
+	result = (unsigned long) (best / REPS); \
+} while (0)
+
+int main(void)
+{
+	static int lengths[] = { 20, 40, 64, 128, 256, 512, 576, 1024, 1460, 1500, 4096 };
+	unsigned long c_old, c_new, c_oldcopy, c_copy;
+	int l, a, len, errors;
+
+	src = malloc(BUFSIZE + 16);
+	dst = malloc(BUFSIZE + 16);
+	if (!src || !dst) {
+		perror("malloc");
+		return 2;
+	}
+	srand(1);
+	errors = check();
+	printf("checked against the C sum: %s\n\n", errors ? "FAILED" : "ok");
+	for (l = 0; l < BUFSIZE + 16; l++)
+		src[l] = rand();
+
+	printf("cycles per call (best of %d x %d)\n", TRIES, REPS);
+	printf("  len align    old   new  copy+old  copy+sum\n");
+	for (l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+		len = lengths[l];
+		for (a = 0; a < 4; a++) {
+			TIME(c_old, sink += old_csum(src + a, len));
+			TIME(c_new, sink += csum_partial(src + a, len, 0));
+			TIME(c_oldcopy, (memcpy(dst + a, src + a, len),
+				sink += old_csum(dst + a, len)));
+			TIME(c_copy, sink += csum_partial_copy(src + a, dst + a, len, 0));
+			printf("%5d %5d %6lu %5lu %9lu %9lu\n",
+				len, a, c_old, c_new, c_oldcopy, c_copy);
+		}
+	}
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,368 @@
+/*
+ * timerbench.c: stress the kernel timer wheel in user space.
+ *
+ * Arms N timers with random expiries, cancels every other one and then
+ * ticks "jiffies" on until the rest have all gone off, once with the
+ * timer wheel from kernel/sched.c and once with the old single sorted
+ * list it replaced. Every timer has to go off on the tick after its
+ * expiry, and no cancelled one may go off at all.
+ *
+ *	make -C scripts timerbench
+ *	scripts/timerbench [ntimers]		(default 100000)
+ *
+ * Arming goes quadratic on the sorted list, so at 100000 that part
+ * takes a minute or two.
+ *
+ * The timer code below is a copy of the kernel's with cli()/sti() made
+ * no-ops: keep it in step with kernel/sched.c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#define cli()
+#define sti()
+#define save_flags(x)	((void) (x))
+#define restore_flags(x)
+#define printk		printf
+
+struct timer_list {
+	struct timer_list *next;
+	struct timer_list *prev;
+	unsigned long expires;
+	unsigned long data;
+	void (*function)(unsigned long);
+};
+
+static unsigned long jiffies = 1000;
+
+/*
+ * The timer wheel, as in kernel/sched.c.
+ */
+
+#define TVN_BITS 6
+#define TVR_BITS 8
+#define TVN_SIZE (1 << TVN_BITS)
+#define TVR_SIZE (1 << TVR_BITS)
+#define TVN_MASK (TVN_SIZE - 1)
+#define TVR_MASK (TVR_SIZE - 1)
+
+struct timer_vec {
+	int index;
+	struct timer_list vec[TVN_SIZE];
+};
+
+struct timer_vec_root {
+	int index;
+	struct timer_list vec[TVR_SIZE];
+};
+
+static struct timer_vec tv5 = { 0 };
+static struct timer_vec tv4 = { 0 };
+static struct timer_vec tv3 = { 0 };
+static struct timer_vec tv2 = { 0 };
+static struct timer_vec_root tv1 = { 0 };
+
+static struct timer_vec * const tvecs[] = {
+	(struct timer_vec *)&tv1, &tv2, &tv3, &tv4, &tv5
+};
+
+#define NOOF_TVECS (sizeof(tvecs) / sizeof(tvecs[0]))
+
+static unsigned long timer_jiffies = 0;
+
+static void init_timervecs(void)
+{
+	int i, shift;
+
+	for (i = 0; i < TVR_SIZE; i++)
+		tv1.vec[i].next = tv1.vec[i].prev = tv1.vec + i;
+	for (i = 0; i < TVN_SIZE; i++) {
+		tv2.vec[i].next = tv2.vec[i].prev = tv2.vec + i;
+		tv3.vec[i].next = tv3.vec[i].prev = tv3.vec + i;
+		tv4.vec[i].next = tv4.vec[i].prev = tv4.vec + i;
+		tv5.vec[i].next = tv5.vec[i].prev = tv5.vec + i;
+	}
+	timer_jiffies = jiffies;
+	tv1.index = timer_jiffies & TVR_MASK;
+	for (i = 1, shift = TVR_BITS; i < NOOF_TVECS; i++, shift += TVN_BITS) {
+		unsigned long idx = timer_jiffies >> shift;
+		if (timer_jiffies & ((1UL << shift) - 1))
+			idx++;
+		tvecs[i]->index = idx & TVN_MASK;
+	}
+}
+
+static inline void internal_add_timer(struct timer_list * timer)
+{
+	unsigned long expires = timer->expires;
+	unsigned long idx = expires - timer_jiffies;
+	struct timer_list * head;
+
+	if (idx < TVR_SIZE) {
+		head = tv1.vec + (expires & TVR_MASK);
+	} else if (idx < 1 << (TVR_BITS + TVN_BITS)) {
+		head = tv2.vec + ((expires >> TVR_BITS) & TVN_MASK);
+	} else if (idx < 1 << (TVR_BITS + 2 * TVN_BITS)) {
+		head = tv3.vec + ((expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK);
+	} else if (idx < 1 << (TVR_BITS + 3 * TVN_BITS)) {
+		head = tv4.vec + ((expires >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK);
+	} else if ((signed long) idx < 0) {
+		head = tv1.vec + tv1.index;
+	} else {
+		head = tv5.vec + ((expires >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK);
+	}
+	timer->next = head;
+	timer->prev = head->prev;
+	head->prev->next = timer;
+	head->prev = timer;
+}
+
+static void add_timer(struct timer_list * timer)
+{
+	unsigned long flags = 0;
+
+	save_flags(flags);
+	cli();
+	if ((long) timer->expires < 0)
+		timer->expires = (~0UL >> 1) - (jiffies - timer_jiffies);
+	timer->expires += jiffies;
+	internal_add_timer(timer);
+	restore_flags(flags);
+}
+
+static int del_timer(struct timer_list * timer)
+{
+	unsigned long flags = 0;
+
+	save_flags(flags);
+	cli();
+	if (timer->next) {
+		timer->next->prev = timer->prev;
+		timer->prev->next = timer->next;
+		timer->next = timer->prev = NULL;
+		restore_flags(flags);
+		timer->expires -= jiffies;
+		return 1;
+	}
+	restore_flags(flags);
+	return 0;
+}
+
+static inline void cascade_timers(struct timer_vec * tv)
+{
+	struct timer_list * head = tv->vec + tv->index;
+	struct timer_list * timer = head->next;
+
+	while (timer != head) {
+		struct timer_list * next = timer->next;
+		internal_add_timer(timer);
+		timer = next;
+	}
+	head->next = head->prev = head;
+	tv->index = (tv->index + 1) & TVN_MASK;
+}
+
+static inline void run_timer_list(void)
+{
+	struct timer_list * head;
+	struct timer_list * timer;
+
+	cli();
+	while ((long)(jiffies - timer_jiffies) > 0) {
+		if (!tv1.index) {
+			int n = 1;
+			do {
+				cascade_timers(tvecs[n]);
+			} while (tvecs[n]->index == 1 && ++n < NOOF_TVECS);
+		}
+		head = tv1.vec + tv1.index;
+		while ((timer = head->next) != head) {
+			void (*fn)(unsigned long) = timer->function;
+			unsigned long data = timer->data;
+
+			timer->next->prev = timer->prev;
+			timer->prev->next = timer->next;
+			timer->next = timer->prev = NULL;
+			sti();
+			fn(data);
+			cli();
+		}
+		++timer_jiffies;
+		tv1.index = (tv1.index + 1) & TVR_MASK;
+	}
+	sti();
+}
+
+/*
+ * The old sorted list, as it was before the wheel.
+ */
+
+static struct timer_list timer_head = { &timer_head, &timer_head, ~0, 0, NULL };
+
+static void list_add_timer(struct timer_list * timer)
+{
+	struct timer_list *p;
+
+	p = &timer_head;
+	timer->expires += jiffies;
+	do {
+		p = p->next;
+	} while (timer->expires > p->expires);
+	timer->next = p;
+	timer->prev = p->prev;
+	p->prev = timer;
+	timer->prev->next = timer;
+}
+
+static int list_del_timer(struct timer_list * timer)
+{
+	if (timer->next) {
+		timer->next->prev = timer->prev;
+		timer->prev->next = timer->next;
+		timer->next = timer->prev = NULL;
+		timer->expires -= jiffies;
+		return 1;
+	}
+	return 0;
+}
+
+static void list_run_timers(void)
+{
+	struct timer_list * timer;
+
+	while ((timer = timer_head.next) != &timer_head && timer->expires < jiffies) {
+		void (*fn)(unsigned long) = timer->function;
+		unsigned long data = timer->data;
+
+		timer->next->prev = timer->prev;
+		timer->prev->next = timer->next;
+		timer->next = timer->prev = NULL;
+		fn(data);
+	}
+}
+
+/*
+ * The stress run.
+ */
+
+struct bench_timer {
+	struct timer_list timer;
+	unsigned long when;		/* absolute expiry */
+	int cancelled;
+	int fired;
+};
+
+static struct bench_timer * timers;
+static unsigned long * delays;
+static int ntimers, fired, errors;
+
+static void bench_fn(unsigned long data)
+{
+	struct bench_timer * t = timers + data;
+
+	fired++;
+	if (t->cancelled || t->fired++ || jiffies != t->when + 1) {
+		if (errors++ < 10)
+			printf("timer %lu: expires %lu, went off at %lu%s\n",
+				data, t->when, jiffies,
+				t->cancelled ? " after being cancelled" : "");
+	}
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/*
+ * Mostly short timers, the way retransmit and delayed ack timers are,
+ * with a tail long enough to go through every level of the wheel.
+ */
+static unsigned long random_delay(void)
+{
+	switch (rand() % 8) {
+		case 0: return 1 + rand() % (1 << 22);
+		case 1: case 2: return 1 + rand() % (1 << 14);
+		default: return 1 + rand() % 256;
+	}
+}
+
+static int run(const char * name, void (*add)(struct timer_list *),
+	int (*del)(struct timer_list *), void (*tick)(void))
+{
+	double t0, t1, t2, t3;
+	unsigned long last = 0;
+	int i, cancelled = 0;
+
+	jiffies = 1000;
+	fired = errors = 0;
+	for (i = 0; i < ntimers; i++) {
+		struct bench_timer * t = timers + i;
+
+		t->timer.next = t->timer.prev = NULL;
+		t->timer.expires = delays[i];
+		t->timer.data = i;
+		t->timer.function = bench_fn;
+		t->when = jiffies + delays[i];
+		t->cancelled = t->fired = 0;
+		if (t->when > last)
+			last = t->when;
+	}
+
+	t0 = now();
+	for (i = 0; i < ntimers; i++)
+		add(&timers[i].timer);
+	t1 = now();
+	for (i = 0; i < ntimers; i += 2) {
+		if (!del(&timers[i].timer)) {
+			errors++;
+			printf("timer %d was not pending\n", i);
+		}
+		timers[i].cancelled = 1;
+		cancelled++;
+	}
+	t2 = now();
+	while (jiffies <= last) {
+		jiffies++;
+		tick();
+	}
+	t3 = now();
+
+	if (fired != ntimers - cancelled) {
+		errors++;
+		printf("%d timers went off, expected %d\n", fired, ntimers - cancelled);
+	}
+	printf("%-6s %7d timers: arm %9.2f ms  cancel %7.2f ms  run %8.2f ms  %s\n",
+		name, ntimers, t1 - t0, t2 - t1, t3 - t2, errors ? "FAILED" : "ok");
+	return errors;
+}
+
+int main(int argc, char ** argv)
+{
+	int i, bad;
+
+	ntimers = argc > 1 ? atoi(argv[1]) : 100000;
+	if (ntimers <= 0) {
+		fprintf(stderr, "usage: %s [ntimers]\n", argv[0]);
+		return 2;
+	}
+	timers = malloc(ntimers * sizeof(*timers));
+	delays = malloc(ntimers * sizeof(*delays));
+	if (!timers || !delays) {
+		perror("malloc");
+		return 2;
+	}
+	srand(1);
+	for (i = 0; i < ntimers; i++)
+		delays[i] = random_delay();
+
+	init_timervecs();
+	bad = run("wheel", add_timer, del_timer, run_timer_list);
+	bad += run("list", list_add_timer, list_del_timer, list_run_timers);
+	return bad ? 1 : 0;
+}